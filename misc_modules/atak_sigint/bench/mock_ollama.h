@@ -0,0 +1,220 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+namespace sigint::bench {
+    // Stand-in for an Ollama server, so the LLM stage can be benchmarked repeatably.
+    // Listens on 127.0.0.1 (ephemeral port), speaks HTTP/1.1 with keep-alive, and answers
+    // /api/version, /api/tags, /api/chat and /api/generate. Chat/generate responses wait for the
+    // configured latency, then stream a canned reply as chunked NDJSON one token at a time.
+    class MockOllama {
+    public:
+        struct Config {
+            int firstTokenMs = 200;     // Delay before the first token (prompt processing)
+            int tokenMs = 20;           // Delay between tokens (generation)
+            std::string reply = "Copy that, nothing actionable in this transmission. OVER";
+        };
+
+        ~MockOllama() { stop(); }
+
+        // Returns the port listened on, or -1
+        int start(const Config& config) {
+            cfg = config;
+            listenSock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (listenSock < 0) { return -1; }
+            int one = 1;
+            setsockopt(listenSock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = 0;
+            socklen_t len = sizeof(addr);
+            if (bind(listenSock, (sockaddr*)&addr, sizeof(addr)) || listen(listenSock, 16) || getsockname(listenSock, (sockaddr*)&addr, &len)) {
+                ::close(listenSock);
+                listenSock = -1;
+                return -1;
+            }
+            running = true;
+            acceptThread = std::thread(&MockOllama::acceptLoop, this);
+            return ntohs(addr.sin_port);
+        }
+
+        void stop() {
+            if (!running) { return; }
+            running = false;
+            if (acceptThread.joinable()) { acceptThread.join(); }
+            std::lock_guard<std::mutex> lck(mtx);
+            for (auto& t : clientThreads) {
+                if (t.joinable()) { t.join(); }
+            }
+            clientThreads.clear();
+            ::close(listenSock);
+            listenSock = -1;
+        }
+
+        uint64_t getRequestCount() { return requests; }
+        uint64_t getConnectionCount() { return connections; }
+
+    private:
+        void acceptLoop() {
+            while (running) {
+                pollfd pfd = { listenSock, POLLIN, 0 };
+                if (poll(&pfd, 1, 100) <= 0) { continue; }
+                int sock = accept4(listenSock, NULL, NULL, SOCK_CLOEXEC);
+                if (sock < 0) { continue; }
+                int one = 1;
+                setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                connections++;
+                std::lock_guard<std::mutex> lck(mtx);
+                clientThreads.push_back(std::thread(&MockOllama::clientLoop, this, sock));
+            }
+        }
+
+        void clientLoop(int sock) {
+            std::string buf;
+            while (running) {
+                // Headers
+                size_t headerEnd;
+                while ((headerEnd = buf.find("\r\n\r\n")) == std::string::npos) {
+                    if (!recvSome(sock, buf)) {
+                        ::close(sock);
+                        return;
+                    }
+                }
+                std::string head = buf.substr(0, headerEnd);
+                buf.erase(0, headerEnd + 4);
+
+                size_t contentLength = 0;
+                size_t pos = 0;
+                while ((pos = head.find("\r\n", pos)) != std::string::npos) {
+                    pos += 2;
+                    if (!strncasecmp(head.c_str() + pos, "Content-Length:", 15)) {
+                        contentLength = strtoul(head.c_str() + pos + 15, NULL, 10);
+                    }
+                }
+                while (buf.size() < contentLength) {
+                    if (!recvSome(sock, buf)) {
+                        ::close(sock);
+                        return;
+                    }
+                }
+                std::string body = buf.substr(0, contentLength);
+                buf.erase(0, contentLength);
+
+                std::string method = head.substr(0, head.find(' '));
+                size_t pathStart = head.find(' ') + 1;
+                std::string path = head.substr(pathStart, head.find(' ', pathStart) - pathStart);
+                requests++;
+                if (!respond(sock, method, path, body)) { break; }
+            }
+            ::close(sock);
+        }
+
+        bool respond(int sock, const std::string& method, const std::string& path, const std::string& body) {
+            if (method == "GET" && path == "/api/version") {
+                return sendFixed(sock, "200 OK", "{\"version\":\"mock\"}");
+            }
+            if (method == "GET" && path == "/api/tags") {
+                return sendFixed(sock, "200 OK", "{\"models\":[{\"name\":\"mock:latest\",\"digest\":\"0000\"}]}");
+            }
+            if (method != "POST" || (path != "/api/chat" && path != "/api/generate")) {
+                return sendFixed(sock, "404 Not Found", "{\"error\":\"not found\"}");
+            }
+
+            bool chat = (path == "/api/chat");
+            bool stream = (body.find("\"stream\":true") != std::string::npos);
+            std::this_thread::sleep_for(std::chrono::milliseconds(cfg.firstTokenMs));
+            if (!stream) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(cfg.tokenMs * countTokens()));
+                return sendFixed(sock, "200 OK", record(cfg.reply, chat, true));
+            }
+
+            std::string header = "HTTP/1.1 200 OK\r\nContent-Type: application/x-ndjson\r\nTransfer-Encoding: chunked\r\n\r\n";
+            if (!sendAll(sock, header)) { return false; }
+            size_t start = 0;
+            while (start < cfg.reply.size()) {
+                // Tokens are words, with their leading space
+                size_t end = cfg.reply.find(' ', start + 1);
+                if (end == std::string::npos) { end = cfg.reply.size(); }
+                if (!sendChunk(sock, record(cfg.reply.substr(start, end - start), chat, false))) { return false; }
+                start = end;
+                std::this_thread::sleep_for(std::chrono::milliseconds(cfg.tokenMs));
+            }
+            return sendChunk(sock, record("", chat, true)) && sendAll(sock, "0\r\n\r\n");
+        }
+
+        int countTokens() {
+            int count = 1;
+            for (char c : cfg.reply) { count += (c == ' '); }
+            return count;
+        }
+
+        static std::string record(const std::string& text, bool chat, bool done) {
+            std::string escaped;
+            for (char c : text) {
+                if (c == '"' || c == '\\') { escaped += '\\'; }
+                escaped += c;
+            }
+            std::string rec = chat ? "{\"message\":{\"role\":\"assistant\",\"content\":\"" + escaped + "\"}" : "{\"response\":\"" + escaped + "\"";
+            rec += done ? ",\"done\":true}\n" : ",\"done\":false}\n";
+            return rec;
+        }
+
+        static bool sendFixed(int sock, const std::string& status, const std::string& body) {
+            return sendAll(sock, "HTTP/1.1 " + status + "\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body);
+        }
+
+        static bool sendChunk(int sock, const std::string& data) {
+            char len[16];
+            snprintf(len, sizeof(len), "%zx\r\n", data.size());
+            return sendAll(sock, len + data + "\r\n");
+        }
+
+        static bool sendAll(int sock, const std::string& data) {
+            size_t done = 0;
+            while (done < data.size()) {
+                ssize_t ret = send(sock, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+                if (ret <= 0) { return false; }
+                done += ret;
+            }
+            return true;
+        }
+
+        bool recvSome(int sock, std::string& buf) {
+            while (running) {
+                pollfd pfd = { sock, POLLIN, 0 };
+                int ret = poll(&pfd, 1, 100);
+                if (ret < 0) { return false; }
+                if (ret == 0) { continue; }
+                char tmp[4096];
+                ssize_t len = recv(sock, tmp, sizeof(tmp), 0);
+                if (len <= 0) { return false; }
+                buf.append(tmp, len);
+                return true;
+            }
+            return false;
+        }
+
+        Config cfg;
+        int listenSock = -1;
+        std::atomic<bool> running = false;
+        std::thread acceptThread;
+        std::mutex mtx;
+        std::vector<std::thread> clientThreads;
+        std::atomic<uint64_t> requests = 0;
+        std::atomic<uint64_t> connections = 0;
+    };
+}
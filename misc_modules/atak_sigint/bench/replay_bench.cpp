@@ -0,0 +1,718 @@
+// Offline replay benchmark for the SIGINT transcription pipeline.
+// Feeds a recording through the same downmix/resampler -> ring -> segmenter -> decoder pool ->
+// analysis stage chain the module uses, without SDR++'s GUI, and reports real-time factor, per-stage
+// latency percentiles, dropped samples and peak memory. The LLM stage runs against a built-in mock
+// Ollama server (or a real one) so runs can be compared with each other.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include "audio_tap.h"
+#include "decoder_pool.h"
+#include "remote_decoders.h"
+#include "decode_scheduler.h"
+#include "doorbell.h"
+#include "llm_executor.h"
+#include "analysis_stage.h"
+#include "audio_archive.h"
+#include "mock_ollama.h"
+
+// Same values as the module
+#define WHISPER_SAMPLE_RATE 16000
+#define WHISPER_MIN_SAMPLES (WHISPER_SAMPLE_RATE + WHISPER_SAMPLE_RATE / 10)
+#define AUDIO_RING_CAPACITY (1 << 19)
+
+// Samples per block written into the DSP chain, about what SDR++'s audio streams deliver
+#define FEED_BLOCK_SIZE 1024
+
+// Silence between archived transmissions replayed back to back, longer than the VAD hang time
+#define ARCHIVE_GAP_MS 1500
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    std::string input;
+    std::string model = "ggml-tiny.en.bin";
+    int rawRate = 48000;            // Sample rate of raw captures, WAV files carry their own
+    int states = 2;
+    int threads = 0;                // Per state, 0 = split the cores
+    std::string workers;            // Comma separated host:port of decode workers, empty decodes in process
+    bool adaptive = false;          // Let the decode scheduler pick threads and sampling, as in the module
+    bool realtime = false;          // Pace the input at its sample rate instead of as fast as possible
+    std::string buffering = "vad";  // "vad" or "fixed"
+    int chunkMs = 5000;             // Chunk length for fixed buffering
+    float vadThresholdDb = 9.0f;
+    float vadHangMs = 800.0f;
+    int pollMs = 0;                 // Worker poll interval, 0 to wake on new audio as in the module
+    int maxBacklogSec = 0;          // Decode queue bound, 0 for none
+    std::string shed = "oldest";    // "oldest" or "lowest_priority"
+    bool llm = false;
+    std::string ollamaUrl;          // Empty uses the mock
+    std::string llmModel = "phi";
+    int llmWindowMs = 2000;         // Transcripts arriving within it share a request
+    int llmMaxInFlight = 1;
+    int mockFirstTokenMs = 200;
+    int mockTokenMs = 20;
+    bool print = false;
+    bool json = false;
+};
+
+static void usage() {
+    fprintf(stderr,
+        "Usage: atak_sigint_bench [options] <recording.wav | capture.f32 | archive directory>\n"
+        "  Input is a WAV file (16 bit PCM or 32 bit float, mono or stereo, any rate),\n"
+        "  a raw capture of interleaved stereo float samples, or the module's audio archive\n"
+        "  (atak_sigint_audio), whose transmissions are replayed back to back.\n"
+        "  --rate <Hz>             Sample rate of a raw capture (default 48000)\n"
+        "  --model <path>          Whisper model (default ggml-tiny.en.bin)\n"
+        "  --states <n>            Decoder states sharing the model (default 2)\n"
+        "  --threads <n>           Threads per decoder state (default: cores / states)\n"
+        "  --workers <host:port,...>  Decode on atak_sigint_worker processes instead of in process\n"
+        "  --adaptive              Schedule threads, beam/greedy and audio context per decode like the module\n"
+        "  --realtime              Feed at the input's sample rate instead of as fast as possible\n"
+        "  --buffering vad|fixed   Segment by voice activity or in fixed chunks (default vad)\n"
+        "  --chunk-ms <ms>         Chunk length for fixed buffering (default 5000)\n"
+        "  --vad-threshold <dB>    Open threshold above the noise floor (default 9)\n"
+        "  --vad-hang <ms>         Hang time before a transmission closes (default 800)\n"
+        "  --poll-ms <ms>          Poll the ring at a fixed interval instead of waking on new audio\n"
+        "  --max-backlog <s>       Bound the decode queue, shedding transmissions beyond it (default: unbounded)\n"
+        "  --shed oldest|lowest_priority  Which transmissions are shed (default oldest)\n"
+        "  --llm                   Send every transcript to the LLM stage\n"
+        "  --ollama <url>          Use a real Ollama server instead of the mock\n"
+        "  --llm-model <name>      Model name sent to Ollama (default phi)\n"
+        "  --llm-window <ms>       Coalesce transcripts arriving within this window into one request (default 2000)\n"
+        "  --llm-in-flight <n>     LLM requests in flight at most (default 1)\n"
+        "  --mock-first-token <ms> Mock prompt processing delay (default 200)\n"
+        "  --mock-token <ms>       Mock delay between tokens (default 20)\n"
+        "  --print                 Print transcripts as they come\n"
+        "  --json                  Print the report as JSON\n");
+}
+
+static bool parseArgs(int argc, char** argv, Options& opts) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Missing value for %s\n", arg.c_str());
+                exit(1);
+            }
+            return argv[++i];
+        };
+        if (arg == "--model") { opts.model = next(); }
+        else if (arg == "--rate") { opts.rawRate = atoi(next()); }
+        else if (arg == "--states") { opts.states = atoi(next()); }
+        else if (arg == "--threads") { opts.threads = atoi(next()); }
+        else if (arg == "--workers") { opts.workers = next(); }
+        else if (arg == "--adaptive") { opts.adaptive = true; }
+        else if (arg == "--realtime") { opts.realtime = true; }
+        else if (arg == "--buffering") { opts.buffering = next(); }
+        else if (arg == "--chunk-ms") { opts.chunkMs = atoi(next()); }
+        else if (arg == "--vad-threshold") { opts.vadThresholdDb = atof(next()); }
+        else if (arg == "--vad-hang") { opts.vadHangMs = atof(next()); }
+        else if (arg == "--poll-ms") { opts.pollMs = atoi(next()); }
+        else if (arg == "--max-backlog") { opts.maxBacklogSec = atoi(next()); }
+        else if (arg == "--shed") { opts.shed = next(); }
+        else if (arg == "--llm") { opts.llm = true; }
+        else if (arg == "--ollama") { opts.ollamaUrl = next(); opts.llm = true; }
+        else if (arg == "--llm-model") { opts.llmModel = next(); }
+        else if (arg == "--llm-window") { opts.llmWindowMs = atoi(next()); }
+        else if (arg == "--llm-in-flight") { opts.llmMaxInFlight = std::max<int>(1, atoi(next())); }
+        else if (arg == "--mock-first-token") { opts.mockFirstTokenMs = atoi(next()); }
+        else if (arg == "--mock-token") { opts.mockTokenMs = atoi(next()); }
+        else if (arg == "--print") { opts.print = true; }
+        else if (arg == "--json") { opts.json = true; }
+        else if (arg == "-h" || arg == "--help") { return false; }
+        else if (arg[0] == '-') {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return false;
+        }
+        else { opts.input = arg; }
+    }
+    if (opts.buffering != "vad" && opts.buffering != "fixed") {
+        fprintf(stderr, "Unknown buffering strategy %s\n", opts.buffering.c_str());
+        return false;
+    }
+    if (opts.shed != "oldest" && opts.shed != "lowest_priority") {
+        fprintf(stderr, "Unknown shed policy %s\n", opts.shed.c_str());
+        return false;
+    }
+    return !opts.input.empty() && opts.states > 0 && opts.rawRate > 0;
+}
+
+// Every transmission of an audio archive with a gap of silence after each, as 16 kHz stereo
+static bool loadArchive(const std::string& path, std::vector<dsp::stereo_t>& out, int& outSampleRate, std::string& error) {
+    sigint::AudioArchive archive;
+    sigint::AudioArchive::Config cfg;
+    cfg.dir = path;
+    cfg.quotaBytes = UINT64_MAX;
+    archive.start(cfg);
+    std::vector<sigint::AudioArchive::Entry> entries = archive.list();
+    std::vector<float> samples;
+    for (const auto& entry : entries) {
+        if (entry.sampleRate != WHISPER_SAMPLE_RATE || !archive.read(entry.id, samples)) { continue; }
+        for (float s : samples) { out.push_back(dsp::stereo_t{ s, s }); }
+        out.resize(out.size() + WHISPER_SAMPLE_RATE * ARCHIVE_GAP_MS / 1000, dsp::stereo_t{ 0.0f, 0.0f });
+    }
+    archive.stop();
+    if (out.empty()) {
+        error = "No archived transmissions in " + path;
+        return false;
+    }
+    outSampleRate = WHISPER_SAMPLE_RATE;
+    return true;
+}
+
+// Load a WAV file, raw stereo float capture or audio archive as stereo. sampleRate is only set for WAV
+// files and archives.
+static bool loadInput(const std::string& path, std::vector<dsp::stereo_t>& out, int& outSampleRate, std::string& error) {
+    struct stat st;
+    if (!stat(path.c_str(), &st) && S_ISDIR(st.st_mode)) { return loadArchive(path, out, outSampleRate, error); }
+
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        error = "Could not open " + path;
+        return false;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buf[65536];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), f)) > 0) { data.insert(data.end(), buf, buf + len); }
+    fclose(f);
+
+    // Raw capture
+    if (data.size() < 12 || memcmp(data.data(), "RIFF", 4) || memcmp(data.data() + 8, "WAVE", 4)) {
+        out.resize(data.size() / sizeof(dsp::stereo_t));
+        memcpy(out.data(), data.data(), out.size() * sizeof(dsp::stereo_t));
+        return true;
+    }
+
+    auto u16 = [&](size_t off) { return (uint32_t)data[off] | ((uint32_t)data[off + 1] << 8); };
+    auto u32 = [&](size_t off) { return u16(off) | (u16(off + 2) << 16); };
+    int format = 0, channels = 0, sampleRate = 0, bits = 0;
+    size_t dataOff = 0, dataLen = 0;
+    for (size_t off = 12; off + 8 <= data.size();) {
+        uint32_t chunkLen = u32(off + 4);
+        if (!memcmp(data.data() + off, "fmt ", 4) && chunkLen >= 16) {
+            format = u16(off + 8);
+            channels = u16(off + 10);
+            sampleRate = u32(off + 12);
+            bits = u16(off + 22);
+            // WAVE_FORMAT_EXTENSIBLE, the real format is the start of the sub-format GUID
+            if (format == 0xFFFE && chunkLen >= 26) { format = u16(off + 32); }
+        } else if (!memcmp(data.data() + off, "data", 4)) {
+            dataOff = off + 8;
+            dataLen = std::min<size_t>(chunkLen, data.size() - dataOff);
+        }
+        off += 8 + chunkLen + (chunkLen & 1);
+    }
+
+    if (!dataOff || channels < 1 || channels > 2) {
+        error = "Unsupported or malformed WAV file";
+        return false;
+    }
+    if (sampleRate <= 0) {
+        error = "WAV file has no sample rate";
+        return false;
+    }
+    outSampleRate = sampleRate;
+    if (!((format == 1 && bits == 16) || (format == 3 && bits == 32))) {
+        error = "Only 16 bit PCM and 32 bit float WAV files are supported";
+        return false;
+    }
+
+    int frameBytes = channels * bits / 8;
+    size_t frames = dataLen / frameBytes;
+    out.resize(frames);
+    for (size_t i = 0; i < frames; i++) {
+        const uint8_t* p = data.data() + dataOff + i * frameBytes;
+        float s[2];
+        for (int c = 0; c < channels; c++) {
+            if (format == 1) {
+                int16_t v;
+                memcpy(&v, p + c * 2, 2);
+                s[c] = (float)v / 32768.0f;
+            } else {
+                memcpy(&s[c], p + c * 4, 4);
+            }
+        }
+        out[i].l = s[0];
+        out[i].r = (channels == 2) ? s[1] : s[0];
+    }
+    return true;
+}
+
+// Latency samples of one pipeline stage
+class StageStats {
+public:
+    void add(double ms) {
+        std::lock_guard<std::mutex> lck(mtx);
+        samples.push_back(ms);
+    }
+
+    size_t count() {
+        std::lock_guard<std::mutex> lck(mtx);
+        return samples.size();
+    }
+
+    double sum() {
+        std::lock_guard<std::mutex> lck(mtx);
+        double total = 0.0;
+        for (double s : samples) { total += s; }
+        return total;
+    }
+
+    double percentile(double p) {
+        std::lock_guard<std::mutex> lck(mtx);
+        if (samples.empty()) { return 0.0; }
+        std::vector<double> sorted = samples;
+        std::sort(sorted.begin(), sorted.end());
+        size_t index = std::min<size_t>(sorted.size() - 1, (size_t)(p * (sorted.size() - 1) + 0.5));
+        return sorted[index];
+    }
+
+private:
+    std::mutex mtx;
+    std::vector<double> samples;
+};
+
+static double msBetween(Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parseArgs(argc, argv, opts)) {
+        usage();
+        return 1;
+    }
+
+    std::vector<dsp::stereo_t> audio;
+    std::string error;
+    int inputRate = opts.rawRate;
+    if (!loadInput(opts.input, audio, inputRate, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    double audioSec = (double)audio.size() / inputRate;
+    // Input samples per 16 kHz sample, to map ring positions back to input positions
+    double inputPerOutput = (double)inputRate / WHISPER_SAMPLE_RATE;
+
+    // Decoding in process, or on worker processes as the module does with decodeWorkers
+    sigint::DecoderPool decoderPool;
+    sigint::RemoteDecoders remoteDecoders;
+    bool remote = !opts.workers.empty();
+    if (remote) {
+        sigint::RemoteDecoders::Config rcfg;
+        size_t pos = 0;
+        while (pos <= opts.workers.size()) {
+            size_t comma = std::min(opts.workers.find(',', pos), opts.workers.size());
+            if (comma > pos) { rcfg.workers.push_back(opts.workers.substr(pos, comma - pos)); }
+            pos = comma + 1;
+        }
+        if (!remoteDecoders.start(rcfg, [](const std::string& message) { fprintf(stderr, "%s\n", message.c_str()); })) {
+            fprintf(stderr, "%s\n", remoteDecoders.getError().c_str());
+            return 1;
+        }
+        // So the first segments don't count the time it takes to connect
+        auto connectStart = Clock::now();
+        while (remoteDecoders.getReadyCount() < (int)rcfg.workers.size() && Clock::now() - connectStart < std::chrono::seconds(5)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    } else if (!decoderPool.load(opts.model, opts.states, opts.threads)) {
+        fprintf(stderr, "Failed to load Whisper model %s\n", opts.model.c_str());
+        return 1;
+    }
+
+    // LLM stage, against the mock unless a server was given
+    sigint::bench::MockOllama mock;
+    sigint::http::ConnectionPool ollamaPool;
+    sigint::LlmExecutor llmExecutor;
+    if (opts.llm) {
+        sigint::http::ConnectionPool::Config pcfg = ollamaPool.getConfig();
+        if (opts.ollamaUrl.empty()) {
+            sigint::bench::MockOllama::Config mcfg;
+            mcfg.firstTokenMs = opts.mockFirstTokenMs;
+            mcfg.tokenMs = opts.mockTokenMs;
+            pcfg.host = "127.0.0.1";
+            pcfg.port = mock.start(mcfg);
+            if (pcfg.port < 0) {
+                fprintf(stderr, "Could not start the mock Ollama server\n");
+                return 1;
+            }
+        } else if (!sigint::http::parseUrl(opts.ollamaUrl, pcfg.host, pcfg.port)) {
+            fprintf(stderr, "Invalid Ollama URL %s\n", opts.ollamaUrl.c_str());
+            return 1;
+        }
+        ollamaPool.configure(pcfg);
+        llmExecutor.init(&ollamaPool);
+        llmExecutor.start(opts.llmMaxInFlight);
+    }
+
+    StageStats captureStats;    // Input block written -> its samples read out of the ring (DSP chain + ring)
+    StageStats segmentStats;    // Last sample of a segment fed -> segment handed to the decoder pool (buffering/VAD)
+    StageStats queueStats;      // Segment submitted -> decode started
+    StageStats whisperStats;    // whisper_full
+    StageStats endToEndStats;   // Last sample of a segment fed -> transcript ready
+    StageStats llmFirstStats;   // Oldest transcript of a batch -> first LLM token (includes the batching window)
+    StageStats llmTotalStats;   // Oldest transcript of a batch -> LLM response complete
+
+    // Analysis stage, as in the module
+    sigint::AnalysisStage analysis;
+    std::atomic<int> llmRequests = 0;
+    int skippedTranscripts = 0;
+    if (opts.llm) {
+        sigint::AnalysisStage::Config acfg;
+        acfg.windowMs = opts.llmWindowMs;
+        acfg.maxInFlight = opts.llmMaxInFlight;
+        analysis.start(acfg, [&](const std::vector<sigint::AnalysisStage::Transcript>& batch, sigint::AnalysisStage::Done done) {
+            std::string content = "Intercepted Transmissions (HEARD), oldest first:";
+            for (const auto& t : batch) { content += "\n\"" + t.text + "\""; }
+            json payload;
+            payload["model"] = opts.llmModel;
+            payload["messages"] = json::array({
+                json::object({ { "role", "system" }, { "content", "You are RADAR, a SIGINT analyst. Be brief. End all transmissions with OVER." } }),
+                json::object({ { "role", "user" }, { "content", content } })
+            });
+            auto heard = batch.front().heard;
+            auto firstToken = std::make_shared<std::atomic<bool>>(false);
+            llmRequests++;
+            llmExecutor.submit("/api/chat", payload, [&, heard, firstToken](const std::string&) {
+                if (!firstToken->exchange(true)) { llmFirstStats.add(msBetween(heard, Clock::now())); }
+            }, [&, heard, done](bool success, const std::string&, const std::string& error) {
+                if (success) {
+                    llmTotalStats.add(msBetween(heard, Clock::now()));
+                } else {
+                    fprintf(stderr, "LLM error: %s\n", error.c_str());
+                }
+                done();
+            });
+            return true;
+        });
+    }
+
+    // When each input position was written, to turn sample positions back into wall clock times
+    std::mutex fedMtx;
+    std::vector<std::pair<uint64_t, Clock::time_point>> fedAt;
+    auto fedTime = [&](uint64_t inputPos) {
+        std::lock_guard<std::mutex> lck(fedMtx);
+        auto it = std::lower_bound(fedAt.begin(), fedAt.end(), inputPos, [](const std::pair<uint64_t, Clock::time_point>& e, uint64_t pos) { return e.first < pos; });
+        return (it == fedAt.end()) ? fedAt.back().second : it->second;
+    };
+
+    // Same chain as a VoxHunt channel
+    sigint::AudioTap tap(0, "replay", AUDIO_RING_CAPACITY, WHISPER_SAMPLE_RATE);
+    dsp::stream<dsp::stereo_t> input;
+    sigint::Doorbell workerBell;
+    tap.capture = true;
+    if (opts.pollMs <= 0) { tap.setDoorbell(&workerBell, WHISPER_SAMPLE_RATE / 10); }
+    tap.start(&input, inputRate);
+
+    sigint::VadSegmenter::Config vadConfig;
+    vadConfig.sampleRate = WHISPER_SAMPLE_RATE;
+    vadConfig.openDb = opts.vadThresholdDb;
+    vadConfig.closeDb = std::max<float>(opts.vadThresholdDb - 3.0f, 1.0f);
+    vadConfig.hangMs = opts.vadHangMs;
+    tap.segmenter.configure(vadConfig);
+
+    auto start = Clock::now();
+    std::atomic<bool> fed = false;
+    std::thread feeder([&]() {
+        for (size_t pos = 0; pos < audio.size(); pos += FEED_BLOCK_SIZE) {
+            size_t count = std::min<size_t>(FEED_BLOCK_SIZE, audio.size() - pos);
+            if (opts.realtime) {
+                std::this_thread::sleep_until(start + std::chrono::microseconds((int64_t)((pos + count) * 1000000.0 / inputRate)));
+            } else {
+                // As fast as possible, but without overrunning the ring
+                while (tap.ring.capacity() - tap.ring.available() < count + FEED_BLOCK_SIZE * 4) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+            memcpy(input.writeBuf, &audio[pos], count * sizeof(dsp::stereo_t));
+            {
+                std::lock_guard<std::mutex> lck(fedMtx);
+                fedAt.push_back({ pos + count, Clock::now() });
+            }
+            if (!input.swap(count)) { break; }
+        }
+        fed = true;
+    });
+
+    // Transcripts in completion order
+    std::mutex resultsMtx;
+    std::vector<std::string> transcripts;
+    std::atomic<int> decoding = 0;
+    std::atomic<int> shedCount = 0;
+    double speechSec = 0.0;
+    int segmentCount = 0;
+
+    // Backpressure, as in the module
+    sigint::DecoderPool::QueueConfig qcfg;
+    qcfg.maxSamples = (size_t)opts.maxBacklogSec * WHISPER_SAMPLE_RATE;
+    qcfg.policy = (opts.shed == "oldest") ? sigint::DecoderPool::SHED_OLDEST : sigint::DecoderPool::SHED_LOWEST_SCORE;
+    decoderPool.configureQueue(qcfg);
+    remoteDecoders.configureQueue(qcfg);
+
+    // Adaptive decoding, as in the module
+    sigint::DecodeScheduler scheduler;
+    scheduler.configure(sigint::DecodeScheduler::Config(), decoderPool.getStateCount());
+    std::atomic<int64_t> pendingSamples = 0;
+    std::atomic<int> modeCounts[3] = {};
+
+    // Where a transcript goes, from either kind of decoder
+    auto transcribed = [&](const sigint::VadSegment& seg, const std::string& transcript) {
+        if (opts.print) { printf("[%8.2f s] %s\n", (double)seg.startSample / WHISPER_SAMPLE_RATE, transcript.c_str()); }
+        {
+            std::lock_guard<std::mutex> lck(resultsMtx);
+            transcripts.push_back(transcript);
+        }
+
+        if (opts.llm && transcript.length() > 1 && analysis.submit("bench", transcript) != sigint::NOISE_NONE) {
+            std::lock_guard<std::mutex> lck(resultsMtx);
+            skippedTranscripts++;
+        }
+        decoding--;
+    };
+
+    auto submitSegment = [&](sigint::VadSegment&& segment) {
+        auto seg = std::make_shared<sigint::VadSegment>(std::move(segment));
+        auto lastFed = fedTime((uint64_t)((seg->startSample + seg->samples.size()) * inputPerOutput));
+        auto submitted = Clock::now();
+        segmentStats.add(msBetween(lastFed, submitted));
+        speechSec += (double)seg->samples.size() / WHISPER_SAMPLE_RATE;
+        segmentCount++;
+        decoding++;
+        pendingSamples += seg->samples.size();
+
+        sigint::DecoderPool::JobInfo info;
+        info.channel = tap.id;
+        info.levelDb = seg->peakDb - seg->noiseFloorDb;
+        info.samples = seg->samples.size();
+        // Shedding happens in submit(), on this thread
+        auto onDrop = [&, seg]() {
+            speechSec -= (double)seg->samples.size() / WHISPER_SAMPLE_RATE;
+            pendingSamples -= seg->samples.size();
+            shedCount++;
+            decoding--;
+        };
+        if (remote) {
+            // Queueing covers the network and the worker's own queue, the worker times the decode
+            remoteDecoders.submit(info, seg->samples, opts.adaptive ? -1 : 0, [&, seg, lastFed, submitted](bool success, const std::string& transcript, double decodeSec, const std::string&) {
+                auto decodeEnd = Clock::now();
+                pendingSamples -= seg->samples.size();
+                queueStats.add(std::max<double>(0.0, msBetween(submitted, decodeEnd) - decodeSec * 1000.0));
+                whisperStats.add(decodeSec * 1000.0);
+                endToEndStats.add(msBetween(lastFed, decodeEnd));
+                if (!success) { fprintf(stderr, "Decode failed: %s\n", transcript.c_str()); }
+                transcribed(*seg, transcript);
+            }, onDrop);
+            return;
+        }
+        decoderPool.submit(info, [&, seg, lastFed, submitted](whisper_context* ctx, whisper_state* state, int nThreads, sigint::DecoderPool::Cancel& cancel) {
+            auto decodeStart = Clock::now();
+            queueStats.add(msBetween(submitted, decodeStart));
+
+            whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+            params.print_progress = false;
+            params.print_special = false;
+            params.print_timestamps = false;
+            params.print_realtime = false;
+            params.translate = false;
+            params.language = "en";
+            params.n_threads = nThreads;
+            sigint::DecodeScheduler::Plan plan;
+            if (opts.adaptive) {
+                plan = scheduler.begin(seg->samples.size(), (double)pendingSamples / WHISPER_SAMPLE_RATE);
+                params = whisper_full_default_params(plan.beamSize ? WHISPER_SAMPLING_BEAM_SEARCH : WHISPER_SAMPLING_GREEDY);
+                params.print_progress = false;
+                params.print_special = false;
+                params.print_timestamps = false;
+                params.print_realtime = false;
+                params.translate = false;
+                params.language = "en";
+                params.n_threads = plan.nThreads;
+                if (plan.beamSize) { params.beam_search.beam_size = plan.beamSize; }
+                params.audio_ctx = plan.audioCtx;
+                modeCounts[plan.mode]++;
+            }
+            cancel.attach(params);
+            pendingSamples -= seg->samples.size();
+            std::vector<float> pcm = seg->samples;
+            if (pcm.size() < WHISPER_MIN_SAMPLES) { pcm.resize(WHISPER_MIN_SAMPLES, 0.0f); }
+
+            std::string transcript;
+            if (whisper_full_with_state(ctx, state, params, pcm.data(), pcm.size()) == 0) {
+                int n = whisper_full_n_segments_from_state(state);
+                for (int i = 0; i < n; i++) { transcript += whisper_full_get_segment_text_from_state(state, i); }
+            }
+            auto decodeEnd = Clock::now();
+            whisperStats.add(msBetween(decodeStart, decodeEnd));
+            if (opts.adaptive) { scheduler.end(msBetween(decodeStart, decodeEnd) / 1000.0, (double)seg->samples.size() / WHISPER_SAMPLE_RATE, true); }
+            endToEndStats.add(msBetween(lastFed, decodeEnd));
+            transcribed(*seg, transcript);
+        }, onDrop);
+    };
+
+    // Worker loop, the module's processTap without the UI
+    std::vector<sigint::VadSegment> segments;
+    std::vector<float> chunk;
+    uint64_t chunkStart = 0;
+    uint64_t received = 0;
+    size_t chunkSamples = (size_t)opts.chunkMs * WHISPER_SAMPLE_RATE / 1000;
+    auto lastData = Clock::now();
+    auto lastDspLoad = Clock::now();
+    while (true) {
+        if (opts.pollMs > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(opts.pollMs));
+        } else {
+            workerBell.wait(std::chrono::milliseconds(100));
+        }
+        if (opts.adaptive && Clock::now() - lastDspLoad >= std::chrono::seconds(1)) {
+            scheduler.updateDspLoad();
+            lastDspLoad = Clock::now();
+        }
+
+        const float* span;
+        size_t spanLen;
+        bool gotData = false;
+        while ((spanLen = tap.ring.readSpan(span)) > 0) {
+            if (opts.buffering == "vad") {
+                tap.segmenter.process(span, spanLen, segments);
+            } else {
+                for (size_t i = 0; i < spanLen; i++) {
+                    if (chunk.empty()) { chunkStart = received + i; }
+                    chunk.push_back(span[i]);
+                    if (chunk.size() >= chunkSamples) {
+                        segments.push_back(sigint::VadSegment{ std::move(chunk), chunkStart, 0.0f, 0.0f });
+                        chunk.clear();
+                    }
+                }
+            }
+            received += spanLen;
+            tap.ring.commit(spanLen);
+            gotData = true;
+        }
+        auto now = Clock::now();
+        if (gotData) {
+            captureStats.add(msBetween(fedTime((uint64_t)(received * inputPerOutput)), now));
+            lastData = now;
+        }
+
+        // The chain has no end of stream marker, the input is done once it's been quiet for a while
+        bool finished = fed && msBetween(lastData, now) > 500.0;
+        if (finished) {
+            if (opts.buffering == "vad") {
+                tap.segmenter.flush(segments);
+            } else if (!chunk.empty()) {
+                segments.push_back(sigint::VadSegment{ std::move(chunk), chunkStart, 0.0f, 0.0f });
+                chunk.clear();
+            }
+        }
+        for (auto& segment : segments) { submitSegment(std::move(segment)); }
+        segments.clear();
+        if (finished) { break; }
+    }
+    feeder.join();
+
+    while (decoding > 0) { std::this_thread::sleep_for(std::chrono::milliseconds(10)); }
+    double decodeWallSec = msBetween(start, Clock::now()) / 1000.0;
+    while (opts.llm && (analysis.queued() || analysis.inFlight())) { std::this_thread::sleep_for(std::chrono::milliseconds(10)); }
+    double totalWallSec = msBetween(start, Clock::now()) / 1000.0;
+
+    uint64_t dropped = tap.ring.overruns();
+    tap.stop();
+    remoteDecoders.stop();
+    analysis.stop();
+    llmExecutor.stop();
+    mock.stop();
+
+    // Whisper time over the audio it was given, independent of how busy the pipeline was
+    double whisperRtf = (speechSec > 0.0) ? (whisperStats.sum() / 1000.0) / speechSec : 0.0;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double peakRssMb = usage.ru_maxrss / 1024.0;
+
+    std::vector<std::pair<const char*, StageStats*>> stages = {
+        { "capture", &captureStats },
+        { "segment", &segmentStats },
+        { "queue", &queueStats },
+        { "whisper", &whisperStats },
+        { "end_to_end", &endToEndStats },
+        { "llm_first_token", &llmFirstStats },
+        { "llm_total", &llmTotalStats }
+    };
+
+    if (opts.json) {
+        json report;
+        report["input"] = opts.input;
+        report["model"] = opts.model;
+        if (remote) { report["workers"] = opts.workers; }
+        report["states"] = decoderPool.getStateCount();
+        report["threadsPerState"] = decoderPool.getThreadsPerState();
+        report["buffering"] = opts.buffering;
+        report["realtime"] = opts.realtime;
+        report["audioSec"] = audioSec;
+        report["inputRate"] = inputRate;
+        report["speechSec"] = speechSec;
+        report["segments"] = segmentCount;
+        report["shedSegments"] = shedCount.load();
+        report["decodeWallSec"] = decodeWallSec;
+        report["totalWallSec"] = totalWallSec;
+        report["rtf"] = decodeWallSec / audioSec;
+        report["whisperRtf"] = whisperRtf;
+        report["droppedSamples"] = dropped;
+        if (opts.llm) {
+            report["llmRequests"] = llmRequests.load();
+            report["llmSkippedTranscripts"] = skippedTranscripts;
+        }
+        if (opts.adaptive) {
+            report["decodeModes"]["accurate"] = modeCounts[sigint::DecodeScheduler::MODE_ACCURATE].load();
+            report["decodeModes"]["balanced"] = modeCounts[sigint::DecodeScheduler::MODE_BALANCED].load();
+            report["decodeModes"]["fast"] = modeCounts[sigint::DecodeScheduler::MODE_FAST].load();
+        }
+        report["peakRssMb"] = peakRssMb;
+        for (auto& [name, stats] : stages) {
+            json s;
+            s["count"] = stats->count();
+            s["p50"] = stats->percentile(0.5);
+            s["p90"] = stats->percentile(0.9);
+            s["p99"] = stats->percentile(0.99);
+            s["max"] = stats->percentile(1.0);
+            report["stages"][name] = s;
+        }
+        printf("%s\n", report.dump(4).c_str());
+        return 0;
+    }
+
+    printf("Input:            %s, %.1f s at %d Hz\n", opts.input.c_str(), audioSec, inputRate);
+    if (remote) {
+        printf("Pipeline:         %s buffering, decode workers %s, %s feed\n", opts.buffering.c_str(), opts.workers.c_str(), opts.realtime ? "real time" : "max speed");
+    } else {
+        printf("Pipeline:         %s buffering, %d states x %d threads, %s feed\n", opts.buffering.c_str(), decoderPool.getStateCount(), decoderPool.getThreadsPerState(), opts.realtime ? "real time" : "max speed");
+    }
+    printf("Segments:         %d, %.1f s of audio decoded\n", segmentCount, speechSec);
+    if (opts.maxBacklogSec > 0) { printf("Shed:             %d segments (%s, bound %d s)\n", shedCount.load(), opts.shed.c_str(), opts.maxBacklogSec); }
+    if (opts.adaptive) {
+        printf("Decode modes:     %d accurate, %d balanced, %d fast\n", modeCounts[sigint::DecodeScheduler::MODE_ACCURATE].load(),
+               modeCounts[sigint::DecodeScheduler::MODE_BALANCED].load(), modeCounts[sigint::DecodeScheduler::MODE_FAST].load());
+    }
+    printf("Wall time:        %.2f s to transcribe (RTF %.3f), %.2f s including LLM\n", decodeWallSec, decodeWallSec / audioSec, totalWallSec);
+    printf("Whisper:          RTF %.3f over the decoded audio\n", whisperRtf);
+    printf("Dropped samples:  %llu\n", (unsigned long long)dropped);
+    if (opts.llm) { printf("LLM:              %d requests, %d transcripts skipped as noise\n", llmRequests.load(), skippedTranscripts); }
+    printf("Peak RSS:         %.1f MB\n", peakRssMb);
+    printf("\n%-16s %7s %9s %9s %9s %9s\n", "Stage (ms)", "count", "p50", "p90", "p99", "max");
+    for (auto& [name, stats] : stages) {
+        if (!stats->count()) { continue; }
+        printf("%-16s %7zu %9.1f %9.1f %9.1f %9.1f\n", name, stats->count(), stats->percentile(0.5), stats->percentile(0.9), stats->percentile(0.99), stats->percentile(1.0));
+    }
+    return 0;
+}
@@ -0,0 +1,255 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <iterator>
+#include <ctype.h>
+
+namespace sigint {
+    enum TranscriptNoise {
+        NOISE_NONE,
+        NOISE_EMPTY,
+        NOISE_NON_SPEECH,       // Only annotations like "[BLANK_AUDIO]"
+        NOISE_HALLUCINATION,    // What Whisper makes up on noise, "Thanks for watching!" and the like
+        NOISE_REPETITION,       // Decoder stuck in a loop
+        NOISE_DUPLICATE,        // Same text as the channel's last transmission
+        NOISE_COUNT
+    };
+
+    inline const char* noiseName(TranscriptNoise noise) {
+        static const char* NAMES[NOISE_COUNT] = { "none", "empty", "non_speech", "hallucination", "repetition", "duplicate" };
+        return NAMES[noise];
+    }
+
+    // Words that are repeated on purpose on the air: figures, the phonetic alphabet and procedure words.
+    // "Zero zero zero zero" or "niner niner niner niner" is a real transmission, not a decoder loop.
+    inline bool isRadioWord(const std::string& word) {
+        static const std::set<std::string> RADIO_WORDS = {
+            "zero", "oh", "one", "two", "three", "four", "five", "six", "seven", "eight", "nine", "niner", "ten",
+            "hundred", "thousand", "decimal", "point", "alpha", "alfa", "bravo", "charlie", "delta", "echo", "foxtrot",
+            "golf", "hotel", "india", "juliet", "juliett", "kilo", "lima", "mike", "november", "oscar", "papa",
+            "quebec", "romeo", "sierra", "tango", "uniform", "victor", "whiskey", "xray", "yankee", "zulu",
+            "roger", "copy", "over", "out", "break", "wilco", "affirmative", "negative", "mayday", "pan", "securite",
+            "figures", "correction", "wait", "standby", "received"
+        };
+        return std::all_of(word.begin(), word.end(), [](char c) { return isdigit((unsigned char)c); }) || RADIO_WORDS.count(word);
+    }
+
+    // Transcripts that aren't worth a model call: nothing said, non-speech annotations, the phrases
+    // Whisper is known to hallucinate on noise, and degenerate repetition. Short replies ("Thanks.",
+    // "Bye.") and repeated figures or procedure words are real traffic and pass.
+    inline TranscriptNoise transcriptNoise(const std::string& text) {
+        // Lower case words, punctuation dropped. Bracketed annotations ("[BLANK_AUDIO]", "(static)",
+        // "*coughs*") are not speech.
+        std::vector<std::string> words;
+        std::string word;
+        char closing = 0;
+        bool annotated = false;
+        for (char c : text) {
+            if (closing) {
+                if (c == closing) { closing = 0; }
+                continue;
+            }
+            if (c == '[' || c == '(' || c == '*') {
+                closing = (c == '[') ? ']' : (c == '(') ? ')' : '*';
+                annotated = true;
+                continue;
+            }
+            if (isalnum((unsigned char)c) || c == '\'') {
+                word += (char)tolower((unsigned char)c);
+            } else if (!word.empty()) {
+                words.push_back(word);
+                word.clear();
+            }
+        }
+        if (!word.empty()) { words.push_back(word); }
+        if (words.empty()) { return annotated ? NOISE_NON_SPEECH : NOISE_EMPTY; }
+
+        // Only what Whisper takes from video captions, nobody says it on the radio
+        std::string joined;
+        for (const auto& w : words) { joined += (joined.empty() ? "" : " ") + w; }
+        static const std::set<std::string> HALLUCINATIONS = {
+            "thanks for watching", "thank you for watching", "thank you so much for watching", "thank you very much for watching",
+            "please subscribe", "please like and subscribe", "like and subscribe", "subscribe to my channel",
+            "subtitles by the amara org community", "see you in the next video"
+        };
+        if (HALLUCINATIONS.count(joined)) { return NOISE_HALLUCINATION; }
+
+        // Whisper stuck in a loop: the same word or short phrase six times back to back, unless it's
+        // made of radio words only
+        for (size_t n = 1; n <= 4; n++) {
+            size_t streak = 0;
+            for (size_t i = n; i < words.size(); i++) {
+                streak = (words[i] == words[i - n]) ? streak + 1 : 0;
+                if (streak >= 5 * n && !std::all_of(words.begin() + (i + 1 - n), words.begin() + (i + 1), isRadioWord)) { return NOISE_REPETITION; }
+            }
+        }
+        std::vector<std::string> spoken;
+        std::copy_if(words.begin(), words.end(), std::back_inserter(spoken), [](const std::string& w) { return !isRadioWord(w); });
+        if (spoken.size() >= 12) {
+            std::set<std::string> distinct(spoken.begin(), spoken.end());
+            if (distinct.size() * 4 < spoken.size()) { return NOISE_REPETITION; }
+        }
+        return NOISE_NONE;
+    }
+
+    // Feeds transcripts to the LLM on its own thread, so transcription never waits for analysis.
+    // Transcripts arriving close together are coalesced into one request: a batch is sent once no new
+    // transcript has arrived for windowMs, or maxWindowMs after it opened, or when it's full. At most
+    // maxInFlight batches are out at once; while they are, new transcripts keep joining the next batch,
+    // so a busy net costs fewer, larger requests instead of a growing queue. Noise is dropped on submit.
+    class AnalysisStage {
+    public:
+        struct Config {
+            int windowMs = 2000;        // Quiet time that closes a batch
+            int maxWindowMs = 10000;    // Longest a batch stays open on a busy net
+            int maxBatch = 12;          // Transcripts per request
+            int maxPending = 60;        // Transcripts waiting in total, the oldest are dropped beyond it
+            int maxInFlight = 1;
+        };
+
+        struct Transcript {
+            std::string channel;
+            std::string text;
+            std::chrono::steady_clock::time_point heard;
+        };
+
+        // Called on the stage's thread with a batch to analyze. Returns false if it wasn't sent (e.g. the
+        // LLM is unavailable), otherwise done() must be called once the request completes, from any thread,
+        // and before the stage is destroyed.
+        typedef std::function<void()> Done;
+        typedef std::function<bool(const std::vector<Transcript>& batch, Done done)> Dispatch;
+
+        ~AnalysisStage() { stop(); }
+
+        void start(const Config& config, Dispatch dispatch) {
+            stop();
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                cfg = config;
+                stopWorker = false;
+            }
+            this->dispatch = dispatch;
+            workerThread = std::thread(&AnalysisStage::worker, this);
+        }
+
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                stopWorker = true;
+            }
+            cnd.notify_all();
+            if (workerThread.joinable()) { workerThread.join(); }
+        }
+
+        void configure(const Config& config) {
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                cfg = config;
+            }
+            cnd.notify_all();
+        }
+
+        // Queue a transcript for analysis. Returns why it was skipped, NOISE_NONE if it was queued.
+        TranscriptNoise submit(const std::string& channel, const std::string& text) {
+            TranscriptNoise noise = transcriptNoise(text);
+            std::lock_guard<std::mutex> lck(mtx);
+            // Whisper repeating itself across transmissions is as much noise as within one
+            std::string& last = lastText[channel];
+            if (noise == NOISE_NONE && text == last) { noise = NOISE_DUPLICATE; }
+            last = text;
+            if (noise != NOISE_NONE) { return noise; }
+
+            auto now = std::chrono::steady_clock::now();
+            if (pending.empty()) { opened = now; }
+            pending.push_back(Transcript{ channel, text, now });
+            lastArrival = now;
+            while ((int)pending.size() > cfg.maxPending) {
+                pending.erase(pending.begin());
+                opened = pending.front().heard;
+                overflowed++;
+            }
+            cnd.notify_all();
+            return NOISE_NONE;
+        }
+
+        // Forget what's waiting, e.g. when analysis is switched off
+        void clear() {
+            std::lock_guard<std::mutex> lck(mtx);
+            pending.clear();
+        }
+
+        int queued() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return (int)pending.size();
+        }
+
+        int inFlight() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return running;
+        }
+
+        // Transcripts dropped because too many were waiting
+        uint64_t getOverflowed() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return overflowed;
+        }
+
+    private:
+        void worker() {
+            std::unique_lock<std::mutex> lck(mtx);
+            while (!stopWorker) {
+                if (pending.empty() || running >= cfg.maxInFlight) {
+                    cnd.wait(lck);
+                    continue;
+                }
+
+                auto now = std::chrono::steady_clock::now();
+                auto quietUntil = lastArrival + std::chrono::milliseconds(cfg.windowMs);
+                auto closeAt = opened + std::chrono::milliseconds(cfg.maxWindowMs);
+                if ((int)pending.size() < cfg.maxBatch && now < quietUntil && now < closeAt) {
+                    cnd.wait_until(lck, std::min(quietUntil, closeAt));
+                    continue;
+                }
+
+                size_t n = std::min<size_t>(pending.size(), cfg.maxBatch);
+                std::vector<Transcript> batch(pending.begin(), pending.begin() + n);
+                pending.erase(pending.begin(), pending.begin() + n);
+                if (!pending.empty()) { opened = pending.front().heard; }
+                running++;
+
+                lck.unlock();
+                bool sent = dispatch(batch, [this]() {
+                    {
+                        std::lock_guard<std::mutex> lck(mtx);
+                        running--;
+                    }
+                    cnd.notify_all();
+                });
+                lck.lock();
+                if (!sent) { running--; }
+            }
+        }
+
+        Dispatch dispatch;
+        std::thread workerThread;
+
+        std::mutex mtx;
+        std::condition_variable cnd;
+        Config cfg;
+        std::vector<Transcript> pending;
+        std::map<std::string, std::string> lastText;
+        std::chrono::steady_clock::time_point opened;
+        std::chrono::steady_clock::time_point lastArrival;
+        int running = 0;
+        uint64_t overflowed = 0;
+        bool stopWorker = false;
+    };
+}
@@ -0,0 +1,407 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "audio_codec.h"
+#include "telemetry.h"
+
+namespace sigint {
+    // The audio of every transmission, compressed on disk so it can be listened to again or run through
+    // another model later.
+    // Segments are handed over without copying and coded (AudioCodec) on the archive's own thread, then
+    // appended to archive files in a directory, which are rotated at fileBytes. The entry headers are
+    // indexed in memory, in time order, when the archive is started. Once the archive outgrows its quota
+    // the oldest files are deleted.
+    // Reading maps the entry's bytes and decodes straight out of the page cache, without read() copies.
+    // Times never go backwards, like in the transcript store.
+    class AudioArchive {
+    public:
+        struct Config {
+            std::string dir;
+            uint64_t quotaBytes = 2048ull << 20;    // Oldest files are deleted beyond this
+            uint64_t fileBytes = 64 << 20;          // An archive file is closed once it's this big
+            size_t queueSamples = 16000 * 600;      // Audio waiting to be coded before segments are dropped
+        };
+
+        struct Entry {
+            uint64_t id = 0;            // Stays valid until the entry expires
+            int64_t timeMs = 0;         // Unix time the transmission started
+            double frequency = 0.0;     // Hz, 0 if unknown
+            uint32_t samples = 0;
+            uint32_t sampleRate = 16000;
+            std::string channel;
+        };
+
+        struct Metrics {
+            telemetry::Counter archived;
+            telemetry::Counter dropped;         // Queue full or write failed
+            telemetry::Counter expiredFiles;    // Deleted to stay within the quota
+            telemetry::Counter rawBytes;        // Archived audio as float
+            telemetry::Counter storedBytes;     // The same audio on disk
+            telemetry::Histogram encodeSeconds;
+        };
+
+        ~AudioArchive() { stop(); }
+
+        // Indexes the archive files already there (headers only) and starts the encoder thread
+        void start(const Config& config) {
+            stop();
+            cfg = config;
+            cfg.fileBytes = std::max<uint64_t>(cfg.fileBytes, 1 << 20);
+            loadFiles();
+            std::lock_guard<std::mutex> lck(queueMtx);
+            stopWriter = false;
+            workerThread = std::thread(&AudioArchive::worker, this);
+        }
+
+        // Writes everything still queued before returning
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lck(queueMtx);
+                if (!workerThread.joinable()) { return; }
+                stopWriter = true;
+            }
+            queueCnd.notify_all();
+            workerThread.join();
+
+            std::unique_lock<std::shared_mutex> lck(indexMtx);
+            for (auto& file : files) { ::close(file.fd); }
+            files.clear();
+            entries.clear();
+            firstId = 0;
+            lastTimeMs = 0;
+        }
+
+        // Queue a transmission, never blocks on disk. The samples are only read, by the encoder thread.
+        void append(Entry entry, std::shared_ptr<const std::vector<float>> samples) {
+            {
+                std::lock_guard<std::mutex> lck(queueMtx);
+                if (!workerThread.joinable() || queuedSamples + samples->size() > cfg.queueSamples) {
+                    metrics.dropped.add();
+                    return;
+                }
+                queuedSamples += samples->size();
+                queue.push_back(Job{ std::move(entry), std::move(samples) });
+            }
+            queueCnd.notify_one();
+        }
+
+        // Entries of the given time range, oldest first
+        std::vector<Entry> list(int64_t fromMs = 0, int64_t toMs = INT64_MAX) {
+            std::shared_lock<std::shared_mutex> lck(indexMtx);
+            std::vector<Entry> results;
+            for (size_t i = firstAtOrAfter(fromMs); i < entries.size() && entries[i].timeMs <= toMs; i++) {
+                results.push_back(describe(i));
+            }
+            return results;
+        }
+
+        // The entry of a channel closest to the given time, within toleranceMs
+        bool find(const std::string& channel, int64_t timeMs, Entry& entry, int64_t toleranceMs = 10000) {
+            std::shared_lock<std::shared_mutex> lck(indexMtx);
+            int64_t bestDiff = toleranceMs + 1;
+            size_t best = entries.size();
+            for (size_t i = firstAtOrAfter(timeMs - toleranceMs); i < entries.size() && entries[i].timeMs <= timeMs + toleranceMs; i++) {
+                int64_t diff = std::abs(entries[i].timeMs - timeMs);
+                if (entries[i].channel == channel && diff < bestDiff) {
+                    bestDiff = diff;
+                    best = i;
+                }
+            }
+            if (best == entries.size()) { return false; }
+            entry = describe(best);
+            return true;
+        }
+
+        // Decodes an entry's audio. False if it expired or can't be read.
+        bool read(uint64_t id, std::vector<float>& samples) {
+            std::shared_lock<std::shared_mutex> lck(indexMtx);
+            if (id < firstId || id - firstId >= entries.size()) { return false; }
+            const Indexed& e = entries[id - firstId];
+            const File* file = findFile(e.file);
+            if (!file) { return false; }
+
+            // Map the pages holding the payload, the file stays open (and its pages valid) while indexMtx is held
+            static const uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+            uint64_t mapStart = e.offset & ~(pageSize - 1);
+            size_t mapLen = (size_t)(e.offset + e.bytes - mapStart);
+            if (!e.bytes) { mapLen = 1; }
+            void* map = mmap(NULL, mapLen, PROT_READ, MAP_SHARED, file->fd, (off_t)mapStart);
+            if (map == MAP_FAILED) { return false; }
+            bool ok = AudioCodec::decode((const uint8_t*)map + (e.offset - mapStart), e.bytes, e.samples, samples);
+            munmap(map, mapLen);
+            return ok;
+        }
+
+        size_t size() {
+            std::shared_lock<std::shared_mutex> lck(indexMtx);
+            return entries.size();
+        }
+
+        // Bytes of archive files on disk
+        uint64_t getBytes() {
+            std::shared_lock<std::shared_mutex> lck(indexMtx);
+            uint64_t bytes = 0;
+            for (const auto& file : files) { bytes += file.bytes; }
+            return bytes;
+        }
+
+        // Seconds of audio in the archive
+        double getSeconds() {
+            std::shared_lock<std::shared_mutex> lck(indexMtx);
+            double seconds = 0.0;
+            for (const auto& e : entries) { seconds += (double)e.samples / e.sampleRate; }
+            return seconds;
+        }
+
+        std::string getError() {
+            std::lock_guard<std::mutex> lck(queueMtx);
+            return error;
+        }
+
+        Metrics metrics;
+
+    private:
+        static constexpr char MAGIC[4] = { 'S', 'G', 'A', '1' };
+
+        // Followed by the channel name and the coded samples
+        struct EntryHeader {
+            char magic[4];
+            uint32_t bytes;         // Coded samples
+            int64_t timeMs;
+            double frequency;
+            uint32_t samples;
+            uint32_t sampleRate;
+            uint8_t channelLen;
+            uint8_t reserved[7];
+        };
+
+        struct File {
+            int number;
+            int fd;
+            uint64_t bytes;
+        };
+
+        struct Indexed {
+            int64_t timeMs;
+            double frequency;
+            uint32_t samples;
+            uint32_t sampleRate;
+            int file;
+            uint32_t bytes;
+            uint64_t offset;        // Of the coded samples
+            std::string channel;
+        };
+
+        struct Job {
+            Entry entry;
+            std::shared_ptr<const std::vector<float>> samples;
+        };
+
+        std::string path(int number) {
+            char name[64];
+            snprintf(name, sizeof(name), "/audio-%06d.arc", number);
+            return cfg.dir + name;
+        }
+
+        // Index the archive files on disk in name (i.e. creation) order. An entry cut short by a crash
+        // is cut off the file, so appending carries on from the last complete one.
+        void loadFiles() {
+            mkdir(cfg.dir.c_str(), 0755);
+            std::vector<int> numbers;
+            if (DIR* dir = opendir(cfg.dir.c_str())) {
+                while (dirent* entry = readdir(dir)) {
+                    std::string name = entry->d_name;
+                    if (!name.compare(0, 6, "audio-") && name.size() > 4 && !name.compare(name.size() - 4, 4, ".arc")) { numbers.push_back(atoi(name.c_str() + 6)); }
+                }
+                closedir(dir);
+            }
+            std::sort(numbers.begin(), numbers.end());
+
+            std::unique_lock<std::shared_mutex> lck(indexMtx);
+            for (int number : numbers) {
+                nextFileNumber = std::max<int>(nextFileNumber, number + 1);
+                int fd = ::open(path(number).c_str(), O_RDWR | O_CLOEXEC);
+                if (fd < 0) {
+                    setError("Could not open " + path(number) + ", skipped");
+                    continue;
+                }
+                struct stat st;
+                uint64_t end = fstat(fd, &st) ? 0 : (uint64_t)st.st_size;
+                uint64_t offset = 0;
+                EntryHeader hdr;
+                while (offset + sizeof(hdr) <= end && pread(fd, &hdr, sizeof(hdr), (off_t)offset) == (ssize_t)sizeof(hdr)) {
+                    uint64_t size = sizeof(hdr) + hdr.channelLen + hdr.bytes;
+                    if (memcmp(hdr.magic, MAGIC, sizeof(MAGIC)) || !hdr.sampleRate || offset + size > end) { break; }
+                    std::string channel(hdr.channelLen, '\0');
+                    if (pread(fd, &channel[0], hdr.channelLen, (off_t)(offset + sizeof(hdr))) != (ssize_t)hdr.channelLen) { break; }
+                    index(hdr, channel, number, offset + sizeof(hdr) + hdr.channelLen);
+                    offset += size;
+                }
+                if (offset < end && ftruncate(fd, (off_t)offset)) {
+                    setError("Could not repair " + path(number));
+                }
+                files.push_back(File{ number, fd, offset });
+            }
+        }
+
+        void worker() {
+            std::deque<Job> batch;
+            std::vector<uint8_t> buffer;
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lck(queueMtx);
+                    queueCnd.wait(lck, [this]() { return stopWriter || !queue.empty(); });
+                    batch.swap(queue);
+                    if (batch.empty() && stopWriter) { break; }
+                }
+                for (auto& job : batch) {
+                    write(job, buffer);
+                    std::lock_guard<std::mutex> lck(queueMtx);
+                    queuedSamples -= job.samples->size();
+                }
+                batch.clear();
+                enforceQuota();
+            }
+        }
+
+        void write(Job& job, std::vector<uint8_t>& buffer) {
+            // Header, channel and coded samples go out in one write
+            job.entry.channel.resize(std::min<size_t>(job.entry.channel.size(), 255));
+            buffer.resize(sizeof(EntryHeader) + job.entry.channel.size());
+            {
+                telemetry::ScopedTimer timer(metrics.encodeSeconds);
+                AudioCodec::encode(job.samples->data(), job.samples->size(), buffer);
+            }
+            EntryHeader hdr = {};
+            memcpy(hdr.magic, MAGIC, sizeof(MAGIC));
+            hdr.bytes = (uint32_t)(buffer.size() - sizeof(EntryHeader) - job.entry.channel.size());
+            hdr.timeMs = std::max<int64_t>(job.entry.timeMs, lastTimeMs);
+            hdr.frequency = job.entry.frequency;
+            hdr.samples = (uint32_t)job.samples->size();
+            hdr.sampleRate = std::max<uint32_t>(job.entry.sampleRate, 1);
+            hdr.channelLen = (uint8_t)job.entry.channel.size();
+            memcpy(buffer.data(), &hdr, sizeof(hdr));
+            memcpy(buffer.data() + sizeof(hdr), job.entry.channel.data(), job.entry.channel.size());
+
+            if (files.empty() || files.back().bytes >= cfg.fileBytes) {
+                int number = nextFileNumber++;
+                int fd = ::open(path(number).c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+                if (fd < 0) {
+                    setError("Could not create " + path(number) + ": " + strerror(errno));
+                    metrics.dropped.add();
+                    return;
+                }
+                std::unique_lock<std::shared_mutex> lck(indexMtx);
+                files.push_back(File{ number, fd, 0 });
+            }
+
+            // Only the encoder thread changes the last file's size, no lock needed to read it
+            File& file = files.back();
+            if (pwrite(file.fd, buffer.data(), buffer.size(), (off_t)file.bytes) != (ssize_t)buffer.size()) {
+                // Whatever made it out is overwritten by the next entry, or cut off by the next start
+                setError("Could not write " + path(file.number) + ": " + strerror(errno));
+                metrics.dropped.add();
+                return;
+            }
+
+            std::unique_lock<std::shared_mutex> lck(indexMtx);
+            index(hdr, job.entry.channel, file.number, file.bytes + sizeof(hdr) + hdr.channelLen);
+            file.bytes += buffer.size();
+            metrics.archived.add();
+            metrics.rawBytes.add(job.samples->size() * sizeof(float));
+            metrics.storedBytes.add(buffer.size());
+        }
+
+        // Delete the oldest files while over the quota, but never the one being written
+        void enforceQuota() {
+            std::unique_lock<std::shared_mutex> lck(indexMtx);
+            uint64_t total = 0;
+            for (const auto& file : files) { total += file.bytes; }
+            while (total > cfg.quotaBytes && files.size() > 1) {
+                File oldest = files.front();
+                files.erase(files.begin());
+                total -= oldest.bytes;
+                size_t count = 0;
+                while (count < entries.size() && entries[count].file == oldest.number) { count++; }
+                entries.erase(entries.begin(), entries.begin() + count);
+                firstId += count;
+                ::close(oldest.fd);
+                unlink(path(oldest.number).c_str());
+                metrics.expiredFiles.add();
+            }
+        }
+
+        // Requires indexMtx held exclusively
+        void index(const EntryHeader& hdr, const std::string& channel, int file, uint64_t offset) {
+            lastTimeMs = std::max<int64_t>(lastTimeMs, hdr.timeMs);
+            entries.push_back(Indexed{ lastTimeMs, hdr.frequency, hdr.samples, hdr.sampleRate, file, hdr.bytes, offset, channel });
+        }
+
+        // Requires indexMtx
+        Entry describe(size_t i) const {
+            const Indexed& e = entries[i];
+            Entry entry;
+            entry.id = firstId + i;
+            entry.timeMs = e.timeMs;
+            entry.frequency = e.frequency;
+            entry.samples = e.samples;
+            entry.sampleRate = e.sampleRate;
+            entry.channel = e.channel;
+            return entry;
+        }
+
+        // Requires indexMtx
+        const File* findFile(int number) const {
+            for (const auto& file : files) {
+                if (file.number == number) { return &file; }
+            }
+            return NULL;
+        }
+
+        // Index of the first entry at or after the given time. Requires indexMtx.
+        size_t firstAtOrAfter(int64_t timeMs) const {
+            return std::lower_bound(entries.begin(), entries.end(), timeMs, [](const Indexed& e, int64_t t) { return e.timeMs < t; }) - entries.begin();
+        }
+
+        void setError(const std::string& message) {
+            std::lock_guard<std::mutex> lck(queueMtx);
+            error = message;
+        }
+
+        Config cfg;
+        std::thread workerThread;
+
+        // Queue between producers and the encoder thread
+        std::mutex queueMtx;
+        std::condition_variable queueCnd;
+        std::deque<Job> queue;
+        size_t queuedSamples = 0;
+        bool stopWriter = false;
+        std::string error;
+
+        // Files and index, written by the encoder thread, read by anyone
+        std::shared_mutex indexMtx;
+        std::vector<File> files;
+        std::deque<Indexed> entries;
+        uint64_t firstId = 0;                   // Id of entries.front()
+        int64_t lastTimeMs = 0;
+        int nextFileNumber = 0;
+    };
+}
@@ -0,0 +1,212 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+namespace sigint {
+    // Lossless coding of 16 bit mono PCM in the style of FLAC, for archiving transmissions.
+    // Samples are quantized to 16 bits (which Whisper doesn't notice) and coded in blocks. Each block
+    // picks the fixed polynomial predictor (order 0 to 4) with the smallest residual, and the residual
+    // is Rice coded in partitions with their own parameter, or stored raw where that's smaller. Radio
+    // speech typically takes 6 to 10 bits per sample, against the 32 of float.
+    class AudioCodec {
+    public:
+        static constexpr int BLOCK_SIZE = 4096;
+        static constexpr int PARTITION_SIZE = 256;
+
+        // Appends the coded samples to out
+        static void encode(const float* samples, size_t count, std::vector<uint8_t>& out) {
+            BitWriter bw(out);
+            std::vector<int32_t> pcm(BLOCK_SIZE);
+            std::vector<uint32_t> residual(BLOCK_SIZE);
+            for (size_t pos = 0; pos < count; pos += BLOCK_SIZE) {
+                int n = (int)std::min<size_t>(BLOCK_SIZE, count - pos);
+                for (int i = 0; i < n; i++) {
+                    float s = std::clamp<float>(samples[pos + i], -1.0f, 1.0f) * 32767.0f;
+                    pcm[i] = (int32_t)lrintf(s);
+                }
+                encodeBlock(bw, pcm.data(), n, residual.data());
+            }
+            bw.flush();
+        }
+
+        // Decodes count samples. Returns false if the data is corrupt or too short.
+        static bool decode(const uint8_t* data, size_t len, size_t count, std::vector<float>& out) {
+            BitReader br(data, len);
+            out.resize(count);
+            std::vector<int32_t> pcm(BLOCK_SIZE);
+            for (size_t pos = 0; pos < count; pos += BLOCK_SIZE) {
+                int n = (int)std::min<size_t>(BLOCK_SIZE, count - pos);
+                if (!decodeBlock(br, pcm.data(), n)) { return false; }
+                for (int i = 0; i < n; i++) { out[pos + i] = (float)pcm[i] / 32767.0f; }
+            }
+            return true;
+        }
+
+    private:
+        static constexpr int MAX_ORDER = 4;
+        static constexpr int MAX_RICE = 30;
+        static constexpr int ESCAPE = 31;   // Partition stored raw, followed by the bit width
+
+        class BitWriter {
+        public:
+            BitWriter(std::vector<uint8_t>& out) : out(out) {}
+
+            void put(uint32_t value, int bits) {
+                if (!bits) { return; }
+                acc = (acc << bits) | (value & (uint32_t)((1ull << bits) - 1));
+                fill += bits;
+                while (fill >= 8) {
+                    fill -= 8;
+                    out.push_back((uint8_t)(acc >> fill));
+                }
+            }
+
+            void putUnary(uint32_t q) {
+                while (q >= 32) {
+                    put(0, 32);
+                    q -= 32;
+                }
+                put(1, q + 1);
+            }
+
+            void flush() {
+                if (fill) { put(0, 8 - fill); }
+            }
+
+        private:
+            std::vector<uint8_t>& out;
+            uint64_t acc = 0;
+            int fill = 0;
+        };
+
+        class BitReader {
+        public:
+            BitReader(const uint8_t* data, size_t len) : data(data), len(len) {}
+
+            bool get(int bits, uint32_t& value) {
+                value = 0;
+                for (int i = 0; i < bits; i++) {
+                    if (pos >= len * 8) { return false; }
+                    value = (value << 1) | ((data[pos >> 3] >> (7 - (pos & 7))) & 1);
+                    pos++;
+                }
+                return true;
+            }
+
+            bool getUnary(uint32_t& q) {
+                q = 0;
+                while (true) {
+                    if (pos >= len * 8) { return false; }
+                    if ((data[pos >> 3] >> (7 - (pos & 7))) & 1) {
+                        pos++;
+                        return true;
+                    }
+                    pos++;
+                    q++;
+                }
+            }
+
+        private:
+            const uint8_t* data;
+            size_t len;
+            size_t pos = 0;
+        };
+
+        static uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+        static int32_t unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+        // Prediction of pcm[i] from the previous order samples. 64 bit, so it can't overflow on any input.
+        static int64_t predict(const int32_t* pcm, int i, int order) {
+            switch (order) {
+            case 1: return pcm[i - 1];
+            case 2: return 2 * (int64_t)pcm[i - 1] - pcm[i - 2];
+            case 3: return 3 * (int64_t)pcm[i - 1] - 3 * (int64_t)pcm[i - 2] + pcm[i - 3];
+            case 4: return 4 * (int64_t)pcm[i - 1] - 6 * (int64_t)pcm[i - 2] + 4 * (int64_t)pcm[i - 3] - pcm[i - 4];
+            default: return 0;
+            }
+        }
+
+        static void encodeBlock(BitWriter& bw, const int32_t* pcm, int n, uint32_t* residual) {
+            // Predictor with the smallest residual magnitude
+            int order = 0;
+            uint64_t best = UINT64_MAX;
+            for (int o = 0; o <= std::min<int>(MAX_ORDER, n - 1); o++) {
+                uint64_t sum = 0;
+                for (int i = o; i < n; i++) { sum += zigzag((int32_t)(pcm[i] - predict(pcm, i, o))); }
+                if (sum < best) {
+                    best = sum;
+                    order = o;
+                }
+            }
+
+            bw.put(order, 3);
+            for (int i = 0; i < order; i++) { bw.put((uint32_t)pcm[i] & 0xFFFF, 16); }
+            for (int i = order; i < n; i++) { residual[i] = zigzag((int32_t)(pcm[i] - predict(pcm, i, order))); }
+
+            for (int start = order; start < n; start += PARTITION_SIZE) {
+                int end = std::min<int>(start + PARTITION_SIZE, n);
+                // Cheapest Rice parameter, or raw if nothing beats it
+                uint32_t maxValue = 0;
+                for (int i = start; i < end; i++) { maxValue = std::max<uint32_t>(maxValue, residual[i]); }
+                int width = 0;
+                while (width < 32 && (maxValue >> width)) { width++; }
+                uint64_t bestBits = 5 + (uint64_t)width * (end - start);
+                int bestK = ESCAPE;
+                for (int k = 0; k <= std::min<int>(MAX_RICE, width); k++) {
+                    uint64_t bits = 0;
+                    for (int i = start; i < end; i++) { bits += (residual[i] >> k) + 1 + k; }
+                    if (bits < bestBits) {
+                        bestBits = bits;
+                        bestK = k;
+                    }
+                }
+
+                bw.put(bestK, 5);
+                if (bestK == ESCAPE) {
+                    bw.put(width, 6);
+                    for (int i = start; i < end; i++) { bw.put(residual[i], width); }
+                    continue;
+                }
+                for (int i = start; i < end; i++) {
+                    bw.putUnary(residual[i] >> bestK);
+                    bw.put(residual[i], bestK);
+                }
+            }
+        }
+
+        static bool decodeBlock(BitReader& br, int32_t* pcm, int n) {
+            uint32_t order, v;
+            if (!br.get(3, order) || order > MAX_ORDER || (int)order > n) { return false; }
+            for (uint32_t i = 0; i < order; i++) {
+                if (!br.get(16, v)) { return false; }
+                pcm[i] = (int16_t)v;
+            }
+
+            for (int start = order; start < n; start += PARTITION_SIZE) {
+                int end = std::min<int>(start + PARTITION_SIZE, n);
+                uint32_t k;
+                if (!br.get(5, k)) { return false; }
+                uint32_t width = 0;
+                if (k == ESCAPE && (!br.get(6, width) || width > 32)) { return false; }
+                for (int i = start; i < end; i++) {
+                    uint32_t r;
+                    if (k == ESCAPE) {
+                        if (!br.get(width, r)) { return false; }
+                    } else {
+                        uint32_t q;
+                        if (!br.getUnary(q) || !br.get(k, r)) { return false; }
+                        r |= q << k;
+                    }
+                    // Coded samples are 16 bit, anything else is corrupt (or hostile) data
+                    int64_t sample = unzigzag(r) + predict(pcm, i, order);
+                    if (sample < INT16_MIN || sample > INT16_MAX) { return false; }
+                    pcm[i] = (int32_t)sample;
+                }
+            }
+            return true;
+        }
+    };
+}
@@ -0,0 +1,174 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <signal_path/signal_path.h>
+#include "mono_decimator.h"
+#include "spsc_ring.h"
+#include "doorbell.h"
+#include "vad_segmenter.h"
+#include "streaming_transcriber.h"
+#include "telemetry.h"
+
+namespace sigint {
+    // Audio tap on one SDR++ audio stream (one VFO).
+    // Each tap reads its own stream from the sink manager (which already splits the VFO's audio per
+    // consumer) with a MonoDecimator that writes straight into a lock-free ring, and has its own
+    // segmenter and streaming state. Decoding is done by the shared DecoderPool.
+    class AudioTap {
+    public:
+        AudioTap(int id, std::string streamName, size_t ringCapacity, int outSampleRate) : ring(ringCapacity) {
+            this->id = id;
+            this->streamName = streamName;
+            this->outSampleRate = outSampleRate;
+        }
+
+        ~AudioTap() {
+            stop();
+        }
+
+        // Bind to the audio stream. Returns false if the stream doesn't exist (yet).
+        bool start() {
+            if (running) { return true; }
+            audioStream = sigpath::sinkManager.bindStream(streamName);
+            if (!audioStream) { return false; }
+            boundToSink = true;
+            float sampleRate = sigpath::sinkManager.getStreamSampleRate(streamName);
+            startChain((sampleRate > 0.0f) ? sampleRate : DEFAULT_INPUT_RATE);
+            return true;
+        }
+
+        // Run the chain from a caller owned stream instead of an SDR++ audio stream (offline replay)
+        void start(dsp::stream<dsp::stereo_t>* input, double sampleRate) {
+            if (running) { return; }
+            audioStream = input;
+            boundToSink = false;
+            startChain(sampleRate);
+        }
+
+        void stop() {
+            if (!running) { return; }
+            decimator.stop();
+            if (boundToSink) { sigpath::sinkManager.unbindStream(streamName, audioStream); }
+            audioStream = NULL;
+            running = false;
+        }
+
+        bool isRunning() { return running; }
+
+        // Raise the decode priority by boost for the given time, e.g. when a watch term was heard
+        void boostPriority(int boost, int seconds) {
+            auto until = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+            priorityBoost = boost;
+            boostUntil = until.time_since_epoch().count();
+        }
+
+        // priority plus the boost while it lasts
+        int effectivePriority() {
+            bool boosted = std::chrono::steady_clock::now().time_since_epoch().count() < boostUntil;
+            return priority + (boosted ? (int)priorityBoost : 0);
+        }
+
+        // Follow the audio stream's sample rate (the sink's rate can change at any time, e.g. when
+        // switching audio devices). Cheap, meant to be polled. The filter is redesigned on the DSP thread.
+        void followSampleRate() {
+            if (!running || !boundToSink) { return; }
+            float sampleRate = sigpath::sinkManager.getStreamSampleRate(streamName);
+            if (sampleRate <= 0.0f || sampleRate == inputSampleRate) { return; }
+            inputSampleRate = sampleRate;
+            decimator.setInSampleRate(sampleRate);
+        }
+
+        double getInputSampleRate() { return inputSampleRate; }
+
+        // Frequency and demodulator of the tap's VFO, 0 and empty while unknown. Set from the UI thread,
+        // SDR++'s VFO manager and module interfaces can't be called from the decoder threads that read it.
+        void setTuning(double frequency, const std::string& mode) {
+            std::lock_guard<std::mutex> lck(tuningMtx);
+            tunedFrequency = frequency;
+            tunedMode = mode;
+        }
+
+        void getTuning(double& frequency, std::string& mode) {
+            std::lock_guard<std::mutex> lck(tuningMtx);
+            frequency = tunedFrequency;
+            mode = tunedMode;
+        }
+
+        // Ring the consumer's doorbell whenever at least wakeSamples are waiting in the ring. Set before start().
+        void setDoorbell(Doorbell* doorbell, size_t wakeSamples) {
+            this->doorbell = doorbell;
+            this->wakeSamples = wakeSamples;
+        }
+
+        int id;
+        std::string streamName;
+        std::atomic<bool> capture = false;
+        std::atomic<int> priority = 0;          // Decode priority against the other taps when the decoders are behind
+        std::atomic<int> priorityBoost = 0;
+        std::atomic<int64_t> boostUntil = 0;    // steady_clock ticks
+
+        SpscRing<float> ring;
+        uint64_t lastOverruns = 0;
+        VadSegmenter segmenter;
+
+        // Streaming state, only touched from decoder jobs (which run one at a time per tap)
+        StreamingTranscriber streamer;
+        std::atomic<bool> partialInFlight = false;
+        std::atomic<bool> streamerStale = false;   // A transmission was shed, its committed text must go
+        size_t lastPartialSize = 0;
+
+        // Exported metrics
+        telemetry::Counter samplesIn;           // Captured into the ring
+        telemetry::Counter samplesDropped;      // Lost to ring overruns
+        telemetry::Histogram handlerSeconds;    // Time spent in the DSP thread callback
+        telemetry::Gauge ringDepth;             // Samples waiting in the ring
+        telemetry::Counter segmentsShed;        // Transmissions dropped from the decode queue
+
+    private:
+        // Used when the sink manager doesn't know the stream's rate
+        static constexpr double DEFAULT_INPUT_RATE = 48000.0;
+
+        void startChain(double sampleRate) {
+            inputSampleRate = sampleRate;
+            if (!chainInit) {
+                decimator.init(audioStream, sampleRate, outSampleRate, handler, this);
+                chainInit = true;
+            } else {
+                decimator.setInput(audioStream);
+                decimator.setInSampleRate(sampleRate);
+            }
+
+            decimator.start();
+            running = true;
+        }
+
+        static void handler(float* data, int count, void* ctx) {
+            AudioTap* _this = (AudioTap*)ctx;
+            if (!_this->capture) { return; }
+            telemetry::ScopedTimer timer(_this->handlerSeconds);
+            // Lock-free, never blocks the DSP thread. Samples that don't fit are counted as overruns.
+            _this->ring.write(data, count);
+            _this->samplesIn.add(count);
+            if (_this->doorbell && _this->ring.available() >= _this->wakeSamples) { _this->doorbell->ring(); }
+        }
+
+        int outSampleRate;
+        bool running = false;
+        bool chainInit = false;
+        bool boundToSink = false;
+
+        std::atomic<double> inputSampleRate = DEFAULT_INPUT_RATE;
+        Doorbell* doorbell = NULL;
+        size_t wakeSamples = 0;
+
+        dsp::stream<dsp::stereo_t>* audioStream = NULL;
+        MonoDecimator decimator;
+
+        std::mutex tuningMtx;
+        double tunedFrequency = 0.0;
+        std::string tunedMode;
+    };
+}
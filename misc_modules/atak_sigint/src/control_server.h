@@ -0,0 +1,308 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <list>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <ctype.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "telemetry.h"
+
+namespace sigint {
+    // Line protocol on a Unix domain socket, to control and watch the pipeline without the UI (e.g. with
+    // "socat - UNIX-CONNECT:<path>"). Clients send one command per line and get one reply line for it,
+    // "OK ..." or "ERR ...". "SUB <topic>" and "UNSUB <topic>" are handled here, they pick the events
+    // pushed to the client as lines of their own between replies. Every other command goes to the
+    // handler, on the server's thread. A client that doesn't keep up with its events loses the ones
+    // that don't fit in its buffer, publishing never blocks. The socket is only accessible to its owner.
+    class ControlServer {
+    public:
+        typedef std::function<std::string(const std::string& command, const std::string& args)> CommandHandler;
+
+        struct Metrics {
+            telemetry::Counter commands;
+            telemetry::Counter events;          // Event lines queued to clients
+            telemetry::Counter eventsDropped;   // Not queued, the client's buffer was full
+            telemetry::Gauge clients;
+        };
+
+        static constexpr size_t MAX_CLIENTS = 16;
+        static constexpr size_t MAX_LINE = 4096;
+        static constexpr size_t MAX_BUFFERED = 1 << 20;    // Per client, bytes waiting to be sent
+
+        ~ControlServer() { stop(); }
+
+        // Commands are uppercased before they reach the handler. Events can only be subscribed from the given topics.
+        bool start(const std::string& path, const std::vector<std::string>& topics, CommandHandler handler) {
+            stop();
+            this->topics = topics;
+            this->handler = handler;
+            error.clear();
+
+            sockaddr_un addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+                error = "Control socket path '" + path + "' is empty or too long";
+                return false;
+            }
+            strcpy(addr.sun_path, path.c_str());
+
+            // A socket left behind by a crash is replaced, one still answering belongs to another instance
+            struct stat st;
+            if (!lstat(path.c_str(), &st)) {
+                if (!S_ISSOCK(st.st_mode)) {
+                    error = path + " exists and isn't a socket";
+                    return false;
+                }
+                int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                bool inUse = probe >= 0 && !connect(probe, (sockaddr*)&addr, sizeof(addr));
+                if (probe >= 0) { ::close(probe); }
+                if (inUse) {
+                    error = path + " is in use by another instance";
+                    return false;
+                }
+                unlink(path.c_str());
+            }
+
+            listenSock = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (listenSock < 0 || bind(listenSock, (sockaddr*)&addr, sizeof(addr)) || chmod(path.c_str(), 0600) || listen(listenSock, 4) || pipe2(wakePipe, O_NONBLOCK | O_CLOEXEC)) {
+                error = "Could not listen on " + path + ": " + strerror(errno);
+                closeAll();
+                unlink(path.c_str());
+                return false;
+            }
+            this->path = path;
+            running = true;
+            workerThread = std::thread(&ControlServer::worker, this);
+            return true;
+        }
+
+        void stop() {
+            if (!running) { return; }
+            running = false;
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                wake();
+            }
+            if (workerThread.joinable()) { workerThread.join(); }
+            closeAll();
+            unlink(path.c_str());
+        }
+
+        // Queue an event line (without the newline) for the clients subscribed to the topic. Any thread.
+        void publish(const std::string& topic, const std::string& line) {
+            if (!running) { return; }
+            std::lock_guard<std::mutex> lck(mtx);
+            bool queued = false;
+            for (auto& client : clients) {
+                if (!client.topics.count(topic)) { continue; }
+                if (client.out.size() + line.size() + 1 > MAX_BUFFERED) {
+                    metrics.eventsDropped.add();
+                    continue;
+                }
+                client.out += line;
+                client.out += '\n';
+                metrics.events.add();
+                queued = true;
+            }
+            if (queued) { wake(); }
+        }
+
+        // Tabs and line breaks in event fields would break the framing
+        static std::string field(std::string text) {
+            std::replace_if(text.begin(), text.end(), [](char c) { return c == '\t' || c == '\n' || c == '\r'; }, ' ');
+            return text;
+        }
+
+        int getClientCount() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return (int)clients.size();
+        }
+
+        bool isRunning() { return running; }
+        const std::string& getPath() { return path; }
+        const std::string& getError() { return error; }
+
+        Metrics metrics;
+
+    private:
+        struct Client {
+            int sock = -1;
+            std::string in;             // Server thread only
+            std::string out;            // Guarded by mtx
+            std::set<std::string> topics;
+            bool closing = false;       // Close once out is sent
+        };
+
+        void worker() {
+            std::vector<pollfd> pfds;
+            while (running) {
+                pfds.clear();
+                pfds.push_back(pollfd{ wakePipe[0], POLLIN, 0 });
+                pfds.push_back(pollfd{ listenSock, POLLIN, 0 });
+                {
+                    std::lock_guard<std::mutex> lck(mtx);
+                    for (auto& client : clients) {
+                        short events = (client.closing ? 0 : POLLIN) | (client.out.empty() ? 0 : POLLOUT);
+                        pfds.push_back(pollfd{ client.sock, events, 0 });
+                    }
+                }
+                if (poll(pfds.data(), pfds.size(), 1000) <= 0) { continue; }
+
+                if (pfds[0].revents & POLLIN) {
+                    char buf[64];
+                    while (read(wakePipe[0], buf, sizeof(buf)) > 0) {}
+                }
+                if (pfds[1].revents & POLLIN) { accept(); }
+
+                // Clients are only added and removed on this thread, the list still matches pfds
+                size_t i = 2;
+                for (auto it = clients.begin(); it != clients.end() && i < pfds.size(); i++) {
+                    bool alive = true;
+                    if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) { alive = receive(*it); }
+                    if (alive) { alive = send(*it); }
+                    if (alive) {
+                        it++;
+                        continue;
+                    }
+                    std::lock_guard<std::mutex> lck(mtx);
+                    ::close(it->sock);
+                    it = clients.erase(it);
+                    metrics.clients.set(clients.size());
+                }
+            }
+        }
+
+        void accept() {
+            int sock = accept4(listenSock, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (sock < 0) { return; }
+            std::lock_guard<std::mutex> lck(mtx);
+            if (clients.size() >= MAX_CLIENTS) {
+                const char* busy = "ERR too many clients\n";
+                ::send(sock, busy, strlen(busy), MSG_NOSIGNAL | MSG_DONTWAIT);
+                ::close(sock);
+                return;
+            }
+            clients.emplace_back();
+            clients.back().sock = sock;
+            metrics.clients.set(clients.size());
+        }
+
+        // Read and run complete commands. Returns false once the client is gone. A client that sends its
+        // commands and closes its end at once (echo ... | socat) still gets its replies before it's closed.
+        bool receive(Client& client) {
+            char buf[4096];
+            bool eof = false;
+            while (true) {
+                ssize_t len = recv(client.sock, buf, sizeof(buf), MSG_DONTWAIT);
+                if (len == 0) {
+                    eof = true;
+                    break;
+                }
+                if (len < 0) {
+                    if (errno == EINTR) { continue; }
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) { break; }
+                    return false;
+                }
+                client.in.append(buf, len);
+            }
+
+            size_t start = 0, end;
+            while (!client.closing && (end = client.in.find('\n', start)) != std::string::npos) {
+                std::string line = client.in.substr(start, end - start);
+                start = end + 1;
+                if (!line.empty() && line.back() == '\r') { line.pop_back(); }
+                if (line.empty()) { continue; }
+                std::string reply = execute(client, line);
+                std::lock_guard<std::mutex> lck(mtx);
+                client.out += reply + "\n";
+            }
+            client.in.erase(0, start);
+            if (client.in.size() > MAX_LINE) {
+                std::lock_guard<std::mutex> lck(mtx);
+                client.out += "ERR line too long\n";
+                client.closing = true;
+                client.in.clear();
+            }
+            if (eof) {
+                std::lock_guard<std::mutex> lck(mtx);
+                client.closing = true;
+                client.in.clear();
+            }
+            return true;
+        }
+
+        std::string execute(Client& client, const std::string& line) {
+            metrics.commands.add();
+            size_t space = line.find(' ');
+            std::string command = line.substr(0, space);
+            std::string args;
+            if (space != std::string::npos && line.find_first_not_of(' ', space) != std::string::npos) { args = line.substr(line.find_first_not_of(' ', space)); }
+            std::transform(command.begin(), command.end(), command.begin(), [](unsigned char c) { return toupper(c); });
+
+            if (command == "SUB" || command == "UNSUB") {
+                if (std::find(topics.begin(), topics.end(), args) == topics.end()) {
+                    std::string known;
+                    for (const auto& topic : topics) { known += " " + topic; }
+                    return "ERR unknown topic, one of:" + known;
+                }
+                std::lock_guard<std::mutex> lck(mtx);
+                if (command == "SUB") { client.topics.insert(args); } else { client.topics.erase(args); }
+                return "OK " + args;
+            }
+            return handler(command, args);
+        }
+
+        // Send what's buffered. Returns false once the client is gone or done.
+        bool send(Client& client) {
+            std::lock_guard<std::mutex> lck(mtx);
+            while (!client.out.empty()) {
+                ssize_t len = ::send(client.sock, client.out.data(), client.out.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+                if (len < 0) { return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR; }
+                client.out.erase(0, len);
+            }
+            return !client.closing;
+        }
+
+        // Requires mtx, so the pipe can't be closed underneath. A full pipe is as good as a write.
+        void wake() {
+            if (wakePipe[1] < 0) { return; }
+            ssize_t ret = write(wakePipe[1], "", 1);
+            (void)ret;
+        }
+
+        void closeAll() {
+            std::lock_guard<std::mutex> lck(mtx);
+            for (auto& client : clients) { ::close(client.sock); }
+            clients.clear();
+            metrics.clients.set(0);
+            for (int* fd : { &listenSock, &wakePipe[0], &wakePipe[1] }) {
+                if (*fd >= 0) { ::close(*fd); }
+                *fd = -1;
+            }
+        }
+
+        std::string path;
+        std::vector<std::string> topics;
+        CommandHandler handler;
+        std::string error;
+        int listenSock = -1;
+        int wakePipe[2] = { -1, -1 };
+        std::atomic<bool> running = false;
+        std::thread workerThread;
+
+        std::mutex mtx;     // Guards the client list against publishers, and what's buffered for the clients
+        std::list<Client> clients;
+    };
+}
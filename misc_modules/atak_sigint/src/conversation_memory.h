@@ -0,0 +1,154 @@
+#pragma once
+#include <string>
+#include <deque>
+#include <mutex>
+#include <algorithm>
+#include <config.h>
+
+namespace sigint {
+    // What the LLM remembers of the operation: a fixed system prompt, a rolling summary of older turns
+    // and the most recent turns verbatim. Everything is serialized once, when it's added, and request
+    // bodies are put together from those pieces.
+    // The prompt only ever grows at the end between compactions, so Ollama can reuse the cached prefix
+    // and only evaluates the new turns. Once there are more than maxTurns, the oldest ones are folded
+    // into the summary by a background request, in one go, so the prefix changes once per compaction
+    // instead of on every request.
+    class ConversationMemory {
+    public:
+        struct Config {
+            int maxTurns = 16;              // Turns kept verbatim before compacting
+            int keepTurns = 6;              // Turns left verbatim after compacting
+            int summaryWords = 200;         // Target length of the rolling summary
+            std::string keepAlive = "30m";  // Keeps the model and its prompt cache loaded between requests
+        };
+
+        void configure(const Config& config) {
+            std::lock_guard<std::mutex> lck(mtx);
+            cfg = config;
+            keepAliveJson = json(cfg.keepAlive).dump();
+        }
+
+        void setSystemPrompt(const std::string& prompt) {
+            std::lock_guard<std::mutex> lck(mtx);
+            systemJson = message("system", prompt);
+        }
+
+        // role is "user" or "assistant"
+        void append(const std::string& role, const std::string& content) {
+            std::lock_guard<std::mutex> lck(mtx);
+            turns.push_back(Turn{ role, content, message(role, content) });
+        }
+
+        // Body of a streaming /api/chat request with the whole memory, plus one more user message that
+        // isn't part of it (yet) if given. options is a serialized JSON object.
+        std::string chatBody(const std::string& model, const std::string& options, const std::string* extraUser = NULL) {
+            std::lock_guard<std::mutex> lck(mtx);
+            std::string body = "{\"model\":" + json(model).dump() + ",\"stream\":true,\"keep_alive\":" + keepAliveJson + ",\"options\":" + options + ",\"messages\":[";
+            appendMessages(body);
+            if (extraUser) { body += "," + message("user", *extraUser); }
+            body += "]}";
+            return body;
+        }
+
+        // Body of a request that loads the model and evaluates the memory as it stands, so the next real
+        // request finds it cached
+        std::string warmupBody(const std::string& model) {
+            std::lock_guard<std::mutex> lck(mtx);
+            std::string body = "{\"model\":" + json(model).dump() + ",\"stream\":false,\"keep_alive\":" + keepAliveJson + ",\"options\":{\"num_predict\":1},\"messages\":[";
+            appendMessages(body);
+            body += "]}";
+            return body;
+        }
+
+        // If it's time to compact and no compaction is running, returns true with the body of the
+        // summarization request. Hand its outcome to finishCompaction().
+        bool beginCompaction(const std::string& model, std::string& body) {
+            std::lock_guard<std::mutex> lck(mtx);
+            if (compacting || (int)turns.size() <= cfg.maxTurns) { return false; }
+            compacting = true;
+            compactCount = turns.size() - std::min<size_t>(turns.size(), cfg.keepTurns);
+            compactGeneration = generation;
+
+            std::string text = summary.empty() ? "Summary so far: (none)\n\n" : "Summary so far:\n" + summary + "\n\n";
+            text += "New exchanges, oldest first:\n";
+            for (size_t i = 0; i < compactCount; i++) {
+                text += (turns[i].role == "assistant" ? "RADAR: " : "") + turns[i].content + "\n";
+            }
+            text += "\nWrite the updated summary in at most " + std::to_string(cfg.summaryWords) + " words. Keep every callsign, "
+                    "location, frequency, time, unit and standing OPERATOR instruction. Drop chatter. Plain text only.";
+
+            body = "{\"model\":" + json(model).dump() + ",\"stream\":true,\"keep_alive\":" + keepAliveJson + ",\"options\":{\"temperature\":0.2,\"num_predict\":" +
+                   std::to_string(cfg.summaryWords * 2) + "},\"messages\":[" +
+                   message("system", "You keep the running situation summary of a SIGINT operation.") + "," + message("user", text) + "]}";
+            return true;
+        }
+
+        // Replaces the summary and drops the turns it covers. On failure the turns stay and the next
+        // beginCompaction() tries again.
+        void finishCompaction(bool success, const std::string& newSummary) {
+            std::lock_guard<std::mutex> lck(mtx);
+            compacting = false;
+            if (!success || newSummary.empty() || compactGeneration != generation) { return; }
+            summary = newSummary;
+            summaryJson = message("system", "Summary of the operation so far: " + summary);
+            turns.erase(turns.begin(), turns.begin() + std::min<size_t>(compactCount, turns.size()));
+            compactions++;
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lck(mtx);
+            turns.clear();
+            summary.clear();
+            summaryJson.clear();
+            generation++;
+        }
+
+        int getTurnCount() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return (int)turns.size();
+        }
+
+        std::string getSummary() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return summary;
+        }
+
+        uint64_t getCompactions() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return compactions;
+        }
+
+    private:
+        struct Turn {
+            std::string role;
+            std::string content;
+            std::string serialized;
+        };
+
+        // System prompt, summary and turns, comma separated. Requires mtx.
+        void appendMessages(std::string& body) {
+            body += systemJson;
+            if (!summaryJson.empty()) { body += "," + summaryJson; }
+            for (const auto& turn : turns) { body += "," + turn.serialized; }
+        }
+
+        static std::string message(const std::string& role, const std::string& content) {
+            // Transcripts and recalled intercepts aren't guaranteed to be valid UTF-8
+            return "{\"role\":" + json(role).dump() + ",\"content\":" + json(content).dump(-1, ' ', false, json::error_handler_t::replace) + "}";
+        }
+
+        std::mutex mtx;
+        Config cfg;
+        std::string keepAliveJson = "\"30m\"";
+        std::string systemJson = message("system", "");
+        std::string summary;
+        std::string summaryJson;
+        std::deque<Turn> turns;
+
+        bool compacting = false;
+        size_t compactCount = 0;
+        uint64_t generation = 0;            // Bumped by clear(), a compaction started before is discarded
+        uint64_t compactGeneration = 0;
+        uint64_t compactions = 0;
+    };
+}
@@ -0,0 +1,309 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include "audio_codec.h"
+
+namespace sigint::remote {
+    // Framing of the decode job protocol between the module and its Whisper worker processes, over TCP.
+    // Every frame is a type and a payload length (both 32 bit little endian) followed by the payload.
+    // Integers are little endian, strings and byte blocks are prefixed with their 32 bit length, so
+    // workers on other machines don't have to share the module's byte order. A worker greets with
+    // HELLO, then answers JOB with RESULT (in any order) and PING with PONG, also while it's decoding.
+    // Audio travels as 16 kHz mono PCM coded with AudioCodec, about a third the size of float.
+
+    static constexpr uint32_t PROTOCOL_VERSION = 1;
+    static constexpr int DEFAULT_PORT = 7355;
+    static constexpr uint32_t MAX_PAYLOAD = 16 << 20;   // About 20 minutes of coded audio, more is a broken peer
+    static constexpr uint32_t MAX_JOB_SAMPLES = 16000 * 300;    // 5 minutes, transmissions are cut at 28 s
+    static constexpr size_t HEADER_SIZE = 8;
+
+    enum FrameType : uint32_t {
+        FRAME_HELLO = 1,    // Worker -> module, once: version, decoder slots, name, model
+        FRAME_JOB,          // Module -> worker: id, priority, beam size (-1 lets the worker pick), samples, coded audio
+        FRAME_RESULT,       // Worker -> module: id, success, decode seconds, text or error
+        FRAME_PING,         // Module -> worker: sequence
+        FRAME_PONG          // Worker -> module: sequence, jobs the worker holds in total, and of this connection
+    };
+
+    struct Hello {
+        uint32_t version = PROTOCOL_VERSION;
+        uint32_t slots = 1;         // Decodes the worker runs at once
+        std::string name;
+        std::string model;
+    };
+
+    struct Job {
+        uint64_t id = 0;
+        int32_t priority = 0;
+        int32_t beamSize = -1;
+        uint32_t samples = 0;
+        std::string audio;          // AudioCodec
+    };
+
+    struct Result {
+        uint64_t id = 0;
+        bool success = false;
+        float decodeSec = 0.0f;
+        std::string text;           // The transcript, or what went wrong
+    };
+
+    struct Pong {
+        uint64_t seq = 0;
+        uint32_t busy = 0;          // Queued and running, from every connection
+        uint32_t mine = 0;          // Of those, this connection's
+    };
+
+    // Appends little endian fields to a payload
+    class Writer {
+    public:
+        Writer(std::string& out) : out(out) {}
+
+        void u32(uint32_t v) {
+            for (int i = 0; i < 4; i++) { out += (char)((v >> (i * 8)) & 0xFF); }
+        }
+
+        void u64(uint64_t v) {
+            for (int i = 0; i < 8; i++) { out += (char)((v >> (i * 8)) & 0xFF); }
+        }
+
+        void f32(float v) {
+            uint32_t bits;
+            memcpy(&bits, &v, sizeof(bits));
+            u32(bits);
+        }
+
+        void bytes(const std::string& v) {
+            u32((uint32_t)v.size());
+            out += v;
+        }
+
+    private:
+        std::string& out;
+    };
+
+    // Reads fields back, every read fails once the payload runs short
+    class Reader {
+    public:
+        Reader(const std::string& payload) : data(payload) {}
+
+        bool u32(uint32_t& v) {
+            if (data.size() - pos < 4) { return fail(); }
+            v = 0;
+            for (int i = 0; i < 4; i++) { v |= (uint32_t)(uint8_t)data[pos++] << (i * 8); }
+            return true;
+        }
+
+        bool u64(uint64_t& v) {
+            if (data.size() - pos < 8) { return fail(); }
+            v = 0;
+            for (int i = 0; i < 8; i++) { v |= (uint64_t)(uint8_t)data[pos++] << (i * 8); }
+            return true;
+        }
+
+        bool f32(float& v) {
+            uint32_t bits;
+            if (!u32(bits)) { return false; }
+            memcpy(&v, &bits, sizeof(v));
+            return true;
+        }
+
+        bool bytes(std::string& v) {
+            uint32_t len;
+            if (!u32(len)) { return false; }
+            if (data.size() - pos < len) { return fail(); }
+            v = data.substr(pos, len);
+            pos += len;
+            return true;
+        }
+
+        bool isOk() { return ok; }
+
+    private:
+        bool fail() {
+            ok = false;
+            pos = data.size();
+            return false;
+        }
+
+        const std::string& data;
+        size_t pos = 0;
+        bool ok = true;
+    };
+
+    // Appends a frame to a send buffer
+    inline void frame(std::string& out, FrameType type, const std::string& payload) {
+        Writer w(out);
+        w.u32(type);
+        w.u32((uint32_t)payload.size());
+        out += payload;
+    }
+
+    inline std::string encodeHello(const Hello& m) {
+        std::string p;
+        Writer w(p);
+        w.u32(m.version);
+        w.u32(m.slots);
+        w.bytes(m.name);
+        w.bytes(m.model);
+        return p;
+    }
+
+    inline bool decodeHello(const std::string& payload, Hello& m) {
+        Reader r(payload);
+        r.u32(m.version) && r.u32(m.slots) && r.bytes(m.name) && r.bytes(m.model);
+        return r.isOk() && m.slots > 0;
+    }
+
+    // Codes the samples into the job
+    inline std::string encodeJob(uint64_t id, int32_t priority, int32_t beamSize, const std::vector<float>& samples) {
+        std::vector<uint8_t> coded;
+        AudioCodec::encode(samples.data(), samples.size(), coded);
+        std::string p;
+        Writer w(p);
+        w.u64(id);
+        w.u32((uint32_t)priority);
+        w.u32((uint32_t)beamSize);
+        w.u32((uint32_t)samples.size());
+        w.bytes(std::string((const char*)coded.data(), coded.size()));
+        return p;
+    }
+
+    inline bool decodeJob(const std::string& payload, Job& m) {
+        Reader r(payload);
+        uint32_t priority, beamSize;
+        r.u64(m.id) && r.u32(priority) && r.u32(beamSize) && r.u32(m.samples) && r.bytes(m.audio);
+        m.priority = (int32_t)priority;
+        m.beamSize = (int32_t)beamSize;
+        // The decoder allocates the sample count before reading any audio, a peer can't pick it freely
+        return r.isOk() && m.samples <= MAX_JOB_SAMPLES;
+    }
+
+    // Job audio back to float, false if it's corrupt
+    inline bool decodeAudio(const Job& m, std::vector<float>& samples) {
+        return AudioCodec::decode((const uint8_t*)m.audio.data(), m.audio.size(), m.samples, samples);
+    }
+
+    inline std::string encodeResult(const Result& m) {
+        std::string p;
+        Writer w(p);
+        w.u64(m.id);
+        w.u32(m.success ? 1 : 0);
+        w.f32(m.decodeSec);
+        w.bytes(m.text);
+        return p;
+    }
+
+    inline bool decodeResult(const std::string& payload, Result& m) {
+        Reader r(payload);
+        uint32_t success;
+        r.u64(m.id) && r.u32(success) && r.f32(m.decodeSec) && r.bytes(m.text);
+        m.success = (success != 0);
+        return r.isOk();
+    }
+
+    inline std::string encodePing(uint64_t seq) {
+        std::string p;
+        Writer(p).u64(seq);
+        return p;
+    }
+
+    inline bool decodePing(const std::string& payload, uint64_t& seq) {
+        Reader r(payload);
+        return r.u64(seq);
+    }
+
+    inline std::string encodePong(const Pong& m) {
+        std::string p;
+        Writer w(p);
+        w.u64(m.seq);
+        w.u32(m.busy);
+        w.u32(m.mine);
+        return p;
+    }
+
+    inline bool decodePong(const std::string& payload, Pong& m) {
+        Reader r(payload);
+        r.u64(m.seq) && r.u32(m.busy) && r.u32(m.mine);
+        return r.isOk();
+    }
+
+    // Bytes received on a connection, cut into frames
+    class FrameBuffer {
+    public:
+        // Read what the nonblocking socket has. Returns false once the peer is gone.
+        bool receive(int sock) {
+            char buf[65536];
+            while (true) {
+                ssize_t len = recv(sock, buf, sizeof(buf), MSG_DONTWAIT);
+                if (len == 0) { return false; }
+                if (len < 0) {
+                    if (errno == EINTR) { continue; }
+                    return errno == EAGAIN || errno == EWOULDBLOCK;
+                }
+                in.append(buf, len);
+            }
+        }
+
+        // The next complete frame, if there is one. Sets bad on a frame that can't be valid.
+        bool next(uint32_t& type, std::string& payload, bool& bad) {
+            bad = false;
+            if (in.size() - pos < HEADER_SIZE) { return compact(); }
+            std::string header = in.substr(pos, HEADER_SIZE);
+            Reader r(header);
+            uint32_t len;
+            r.u32(type);
+            r.u32(len);
+            if (len > MAX_PAYLOAD || type < FRAME_HELLO || type > FRAME_PONG) {
+                bad = true;
+                return false;
+            }
+            if (in.size() - pos - HEADER_SIZE < len) { return compact(); }
+            payload = in.substr(pos + HEADER_SIZE, len);
+            pos += HEADER_SIZE + len;
+            return true;
+        }
+
+        void clear() {
+            in.clear();
+            pos = 0;
+        }
+
+    private:
+        // Drop the frames already taken, once per batch rather than per frame
+        bool compact() {
+            in.erase(0, pos);
+            pos = 0;
+            return false;
+        }
+
+        std::string in;
+        size_t pos = 0;
+    };
+
+    // Send what the nonblocking socket takes. Returns false once the peer is gone.
+    inline bool flush(int sock, std::string& out) {
+        while (!out.empty()) {
+            ssize_t len = ::send(sock, out.data(), out.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (len < 0) { return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR; }
+            out.erase(0, len);
+        }
+        return true;
+    }
+
+    // Split "host:port" (or a bare host, on the default port). Returns false if it can't be parsed.
+    inline bool parseAddress(const std::string& address, std::string& host, int& port) {
+        size_t colon = address.rfind(':');
+        port = DEFAULT_PORT;
+        host = address;
+        if (colon != std::string::npos) {
+            port = atoi(address.c_str() + colon + 1);
+            host = address.substr(0, colon);
+        }
+        return !host.empty() && port > 0 && port < 65536;
+    }
+}
@@ -0,0 +1,198 @@
+#pragma once
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include "decoder_pool.h"
+
+namespace sigint {
+    // CPU used by the rest of SDR++ (DSP chains, UI, other modules), i.e. every thread of the process
+    // except the decoders. Decoder threads are recognized by the name DecoderPool gives them.
+    class DspLoadMonitor {
+    public:
+        // Cores' worth of CPU used by non-decoder threads since the last call
+        double sample() {
+            long ticks = 0;
+            DIR* dir = opendir("/proc/self/task");
+            if (!dir) { return lastCores; }
+            while (dirent* entry = readdir(dir)) {
+                if (entry->d_name[0] == '.') { continue; }
+                ticks += threadTicks(entry->d_name);
+            }
+            closedir(dir);
+
+            auto now = std::chrono::steady_clock::now();
+            if (lastTicks >= 0 && ticks >= lastTicks) {
+                double sec = std::chrono::duration<double>(now - lastTime).count();
+                if (sec > 0.0) { lastCores = (double)(ticks - lastTicks) / (double)sysconf(_SC_CLK_TCK) / sec; }
+            }
+            lastTicks = ticks;
+            lastTime = now;
+            return lastCores;
+        }
+
+    private:
+        // utime + stime of a thread, 0 for decoder threads
+        static long threadTicks(const char* tid) {
+            char path[64];
+            snprintf(path, sizeof(path), "/proc/self/task/%s/stat", tid);
+            FILE* f = fopen(path, "r");
+            if (!f) { return 0; }
+            char buf[512];
+            size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+            fclose(f);
+            buf[len] = 0;
+
+            // The name is in parentheses and may contain spaces, fields are counted after it
+            char* open = strchr(buf, '(');
+            char* close = strrchr(buf, ')');
+            if (!open || !close) { return 0; }
+            if (!strncmp(open + 1, DecoderPool::THREAD_NAME, strlen(DecoderPool::THREAD_NAME))) { return 0; }
+            unsigned long utime = 0, stime = 0;
+            if (sscanf(close + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2) { return 0; }
+            return (long)(utime + stime);
+        }
+
+        long lastTicks = -1;
+        std::chrono::steady_clock::time_point lastTime;
+        double lastCores = 0.0;
+    };
+
+    // Picks Whisper settings per decode from how the decoders are keeping up.
+    // With headroom (small backlog, low real-time factor) a lone decode gets every core the DSP
+    // threads leave free and uses beam search. Under pressure decodes switch to greedy sampling,
+    // split the cores between the decoder states so they run in parallel, and encode only as much
+    // audio context as the segment needs. Modes change with hysteresis so they don't flap.
+    class DecodeScheduler {
+    public:
+        struct Config {
+            int maxThreads = 0;             // Cap on decoder threads in total, 0 for every core
+            int maxThreadsPerDecode = 8;    // Whisper stops scaling beyond about this many
+            int beamSize = 5;
+            double fastBacklogSec = 20.0;   // Backlog above which throughput wins
+            double fastRtf = 0.8;           // Real-time factor above which throughput wins
+            double accurateBacklogSec = 3.0;
+            double accurateRtf = 0.25;      // Beam search is roughly 2-3x slower than greedy
+            int sampleRate = 16000;
+        };
+
+        enum Mode {
+            MODE_ACCURATE,  // Beam search, full context
+            MODE_BALANCED,  // Greedy, full context
+            MODE_FAST       // Greedy, truncated context, threads split between states
+        };
+
+        struct Plan {
+            Mode mode;
+            int nThreads;
+            int beamSize;   // 0 for greedy
+            int audioCtx;   // 0 for the full 30 s
+        };
+
+        void configure(const Config& config, int stateCount) {
+            std::lock_guard<std::mutex> lck(mtx);
+            cfg = config;
+            states = std::max<int>(1, stateCount);
+        }
+
+        // Call every so often (e.g. from a housekeeping loop) to follow the DSP load
+        void updateDspLoad() {
+            double cores = dspLoad.sample();
+            std::lock_guard<std::mutex> lck(mtx);
+            dspCores = cores;
+        }
+
+        // Call when a decode starts, with the length of its audio and the audio still waiting behind it
+        Plan begin(size_t samples, double backlogSec) {
+            std::lock_guard<std::mutex> lck(mtx);
+            running++;
+
+            // Hysteresis: each mode is only left once its own bounds are crossed
+            bool pressure = backlogSec > cfg.fastBacklogSec || rtf > cfg.fastRtf;
+            bool headroom = backlogSec < cfg.accurateBacklogSec && rtf < cfg.accurateRtf;
+            bool relieved = backlogSec < cfg.fastBacklogSec / 2.0 && rtf < cfg.fastRtf / 2.0;
+            bool strained = backlogSec > cfg.accurateBacklogSec * 2.0 || rtf > cfg.accurateRtf * 2.0;
+            if (pressure) {
+                mode = MODE_FAST;
+            } else if (mode == MODE_FAST) {
+                if (relieved) { mode = MODE_BALANCED; }
+            } else if (mode == MODE_ACCURATE) {
+                if (strained) { mode = MODE_BALANCED; }
+            } else if (headroom) {
+                mode = MODE_ACCURATE;
+            }
+
+            // Leave the DSP threads the cores they're using, rounded up
+            int cores = std::max<int>(1, (int)std::thread::hardware_concurrency());
+            int budget = (cfg.maxThreads > 0) ? std::min<int>(cfg.maxThreads, cores) : cores;
+            budget = std::max<int>(1, std::min<int>(budget, cores - (int)(dspCores + 0.99)));
+
+            Plan plan;
+            plan.mode = mode;
+            plan.nThreads = (mode == MODE_FAST) ? budget / states : budget / running;
+            plan.nThreads = std::clamp<int>(plan.nThreads, 1, cfg.maxThreadsPerDecode);
+            plan.beamSize = (mode == MODE_ACCURATE) ? cfg.beamSize : 0;
+            // The encoder sees 50 frames per second of audio, plus some margin
+            plan.audioCtx = (mode == MODE_FAST) ? std::min<int>(1500, (int)(samples * 50 / cfg.sampleRate) + 64) : 0;
+            lastThreads = plan.nThreads;
+            return plan;
+        }
+
+        // Call when the decode started with begin() is done. rtf is only fed by final decodes.
+        void end(double decodeSec, double audioSec, bool final) {
+            std::lock_guard<std::mutex> lck(mtx);
+            running = std::max<int>(0, running - 1);
+            if (!final || audioSec <= 0.0) { return; }
+            double r = decodeSec / audioSec;
+            rtf = (decodes++ > 0) ? rtf * 0.8 + r * 0.2 : r;
+        }
+
+        Mode getMode() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return mode;
+        }
+
+        int getLastThreads() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return lastThreads;
+        }
+
+        double getDspCores() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return dspCores;
+        }
+
+        double getRtf() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return rtf;
+        }
+
+        static const char* modeName(Mode mode) {
+            switch (mode) {
+            case MODE_ACCURATE: return "accurate";
+            case MODE_BALANCED: return "balanced";
+            default:            return "fast";
+            }
+        }
+
+    private:
+        std::mutex mtx;
+        Config cfg;
+        int states = 1;
+        Mode mode = MODE_BALANCED;
+        int running = 0;
+        double rtf = 0.0;
+        uint64_t decodes = 0;
+        double dspCores = 0.0;
+        int lastThreads = 0;
+
+        // Only touched by updateDspLoad(), from one thread
+        DspLoadMonitor dspLoad;
+    };
+}
@@ -0,0 +1,479 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <set>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <pthread.h>
+#include "whisper.h"
+
+namespace sigint {
+    // One Whisper model shared by a pool of decoder states.
+    // The model weights are loaded once (no_state), and each worker thread owns its own whisper_state,
+    // so memory grows per state rather than per model copy. Jobs of the same channel run one at a time
+    // and in submission order, jobs of different channels run in parallel on different states.
+    // Models can be loaded in the background and swapped while the pool runs. Jobs wait in the queue
+    // until a model is ready, a job already running finishes on the model it started with, and the
+    // old model is freed once the last of those is done.
+    // The queue is bounded by the audio it holds. Among the channels that are free, the job decoded
+    // next is the one with the best score (channel priority, then signal level and time waited). When
+    // the bound is exceeded jobs are shed, the oldest or the lowest scored first, and their drop
+    // handler is called instead.
+    // Running decodes can be interrupted through Whisper's abort callback: on unload, when another
+    // model is swapped in, and when a job of a higher priority channel is waiting while every state
+    // is busy. Interrupted jobs are put back at the head of their channel's queue and run again.
+    // Whisper can't interrupt a model load, so unload doesn't wait for one: the loader thread is
+    // detached, and frees the model itself when it finishes instead of switching to it.
+    class DecoderPool {
+    public:
+        // Handed to each job, attach() it to the Whisper params so the decode can be interrupted.
+        // The callback is polled between graph nodes, so an abort takes effect within milliseconds.
+        class Cancel {
+        public:
+            enum Reason {
+                REASON_NONE,
+                REASON_SHUTDOWN,
+                REASON_MODEL_SWAP,
+                REASON_PREEMPT
+            };
+
+            void attach(whisper_full_params& params) {
+                params.abort_callback = abortCallback;
+                params.abort_callback_user_data = this;
+            }
+
+            // Whisper actually gave up on a decode of this job, its results are incomplete
+            bool interrupted() const { return fired; }
+            Reason getReason() const { return reason; }
+
+            static bool abortCallback(void* data) {
+                Cancel* _this = (Cancel*)data;
+                if (_this->reason == REASON_NONE) { return false; }
+                _this->fired = true;
+                return true;
+            }
+
+        private:
+            friend class DecoderPool;
+            std::atomic<Reason> reason = REASON_NONE;
+            std::atomic<bool> fired = false;
+        };
+
+        typedef std::function<void(whisper_context* ctx, whisper_state* state, int nThreads, Cancel& cancel)> Job;
+        typedef std::function<void()> DropHandler;
+        typedef std::function<void(bool success, const std::string& modelPath, double seconds)> LoadHandler;
+
+        // What a job is about, to order and shed the queue
+        struct JobInfo {
+            int channel = 0;
+            int priority = 0;       // Channel priority, higher is decoded first
+            float levelDb = 0.0f;   // Signal level above the noise floor
+            size_t samples = 0;     // Audio the job decodes, counted against the bound
+        };
+
+        enum ShedPolicy {
+            SHED_OLDEST,
+            SHED_LOWEST_SCORE
+        };
+
+        struct QueueConfig {
+            size_t maxSamples = 0;              // Audio the queue may hold, 0 for no bound
+            ShedPolicy policy = SHED_OLDEST;
+            float priorityWeight = 100.0f;      // Score per priority step, priority dominates by default
+            float ageWeight = 1.0f;             // Score per second waited, so nothing starves
+            bool preempt = false;               // Interrupt a lower priority decode when a job can't get a state
+        };
+
+        enum ModelState {
+            MODEL_NONE,
+            MODEL_LOADING,
+            MODEL_READY,
+            MODEL_FAILED
+        };
+
+        // Name of the worker threads, which the threads ggml starts from them inherit
+        static constexpr const char* THREAD_NAME = "sigint-decode";
+
+        ~DecoderPool() { unload(); }
+
+        // Start the workers without a model. threadsPerState = 0 splits the cores evenly between the states.
+        void start(int stateCount, int threadsPerState = 0) {
+            unload();
+            int cores = std::max<int>(1, (int)std::thread::hardware_concurrency());
+            this->stateCount = std::max<int>(1, stateCount);
+            this->threadsPerState = (threadsPerState > 0) ? threadsPerState : std::max<int>(1, cores / this->stateCount);
+            {
+                std::lock_guard<std::mutex> lck(queueMtx);
+                stop = false;
+                slots.clear();
+                for (int i = 0; i < this->stateCount; i++) { slots.push_back(std::make_unique<Slot>()); }
+            }
+            for (int i = 0; i < this->stateCount; i++) {
+                workers.push_back(std::thread(&DecoderPool::workerLoop, this, i));
+            }
+        }
+
+        // Start the workers and load a model, blocking until it's loaded
+        bool load(const std::string& modelPath, int stateCount, int threadsPerState = 0) {
+            start(stateCount, threadsPerState);
+            state = MODEL_LOADING;
+            std::shared_ptr<Model> m = loadModel(modelPath, this->stateCount);
+            if (!m) {
+                state = MODEL_FAILED;
+                return false;
+            }
+            swapModel(m);
+            return true;
+        }
+
+        // Load a model on a background thread and switch to it once it's ready. Decoding carries on
+        // with the current model meanwhile. If another load is requested while one is running, only
+        // the most recent request is loaded after it.
+        void loadAsync(const std::string& modelPath, LoadHandler onDone = NULL) {
+            std::lock_guard<std::mutex> lck(loaderMtx);
+            requestedPath = modelPath;
+            requestedHandler = onDone;
+            hasRequest = true;
+            if (loaderBusy) { return; }
+            if (loaderThread.joinable()) { loaderThread.join(); }
+            loaderBusy = true;
+            state = MODEL_LOADING;
+            loaderThread = std::thread(&DecoderPool::loaderLoop, this, loaderControl);
+        }
+
+        void unload() {
+            {
+                // Abandon the load in progress, the loader won't touch the pool once this is set
+                std::shared_ptr<LoaderControl> control = loaderControl;
+                std::lock_guard<std::mutex> ctl(control->mtx);
+                control->abandoned = true;
+                std::lock_guard<std::mutex> lck(loaderMtx);
+                hasRequest = false;
+                loaderBusy = false;
+                if (loaderThread.joinable()) { loaderThread.detach(); }
+                loaderControl = std::make_shared<LoaderControl>();
+            }
+            {
+                std::lock_guard<std::mutex> lck(queueMtx);
+                stop = true;
+                queue.clear();
+                queuedSamples = 0;
+                cancelRunning(Cancel::REASON_SHUTDOWN);
+            }
+            queueCnd.notify_all();
+            for (auto& worker : workers) {
+                if (worker.joinable()) { worker.join(); }
+            }
+            workers.clear();
+            {
+                std::lock_guard<std::mutex> lck(queueMtx);
+                model.reset();
+            }
+            state = MODEL_NONE;
+        }
+
+        void configureQueue(const QueueConfig& config) {
+            std::vector<DropHandler> dropped;
+            {
+                std::lock_guard<std::mutex> lck(queueMtx);
+                queueCfg = config;
+                shed(dropped);
+            }
+            for (auto& onDrop : dropped) { onDrop(); }
+        }
+
+        // Queue a decode job for a channel. May shed queued jobs (possibly this one), their drop handlers
+        // are called before returning, on this thread.
+        void submit(const JobInfo& info, Job job, DropHandler onDrop = NULL) {
+            std::vector<DropHandler> dropped;
+            {
+                std::lock_guard<std::mutex> lck(queueMtx);
+                if (stop) { return; }
+                queue.push_back(Entry{ info, std::move(job), std::move(onDrop), std::chrono::steady_clock::now() });
+                queuedSamples += info.samples;
+                shed(dropped);
+                if (queueCfg.preempt) { preemptFor(info); }
+            }
+            queueCnd.notify_all();
+            for (auto& onDrop : dropped) { onDrop(); }
+        }
+
+        void submit(int channel, Job job) {
+            JobInfo info;
+            info.channel = channel;
+            submit(info, std::move(job));
+        }
+
+        // A model is loaded and decoding (a new one may be loading in the background)
+        bool isLoaded() {
+            std::lock_guard<std::mutex> lck(queueMtx);
+            return model != nullptr;
+        }
+
+        ModelState getModelState() { return state; }
+
+        std::string getModelPath() {
+            std::lock_guard<std::mutex> lck(queueMtx);
+            return model ? model->path : "";
+        }
+
+        int getStateCount() { return stateCount; }
+        int getThreadsPerState() { return threadsPerState; }
+
+        int pending() {
+            std::lock_guard<std::mutex> lck(queueMtx);
+            return (int)queue.size();
+        }
+
+        // Audio held by queued jobs, per JobInfo::samples
+        size_t pendingSamples() {
+            std::lock_guard<std::mutex> lck(queueMtx);
+            return queuedSamples;
+        }
+
+        // Jobs interrupted to make room for a higher priority one
+        uint64_t getPreemptions() { return preemptions; }
+
+    private:
+        struct Entry {
+            JobInfo info;
+            Job job;
+            DropHandler onDrop;
+            std::chrono::steady_clock::time_point submitted;
+        };
+
+        float score(const Entry& e, std::chrono::steady_clock::time_point now) {
+            float waited = std::chrono::duration<float>(now - e.submitted).count();
+            return (float)e.info.priority * queueCfg.priorityWeight + e.info.levelDb + waited * queueCfg.ageWeight;
+        }
+
+        // Per worker, what it's running
+        struct Slot {
+            bool running = false;
+            JobInfo info;
+            Cancel cancel;
+        };
+
+        // Requires queueMtx
+        void cancelRunning(Cancel::Reason reason) {
+            for (auto& slot : slots) {
+                if (slot->running) { slot->cancel.reason = reason; }
+            }
+        }
+
+        // Interrupt the lowest priority decode if a job of a higher priority channel would otherwise have
+        // to wait for it. Requires queueMtx.
+        void preemptFor(const JobInfo& info) {
+            if (!model || busy.count(info.channel)) { return; }
+            Slot* victim = nullptr;
+            for (auto& slot : slots) {
+                if (!slot->running) { return; }
+                if (slot->cancel.reason != Cancel::REASON_NONE || slot->info.priority >= info.priority) { continue; }
+                if (!victim || slot->info.priority < victim->info.priority) { victim = slot.get(); }
+            }
+            if (!victim) { return; }
+            victim->cancel.reason = Cancel::REASON_PREEMPT;
+            preemptions++;
+        }
+
+        // Drop jobs until the queue is back within its bound, always keeping at least one. Requires queueMtx.
+        void shed(std::vector<DropHandler>& dropped) {
+            if (!queueCfg.maxSamples) { return; }
+            auto now = std::chrono::steady_clock::now();
+            while (queuedSamples > queueCfg.maxSamples && queue.size() > 1) {
+                auto victim = queue.begin();
+                if (queueCfg.policy == SHED_LOWEST_SCORE) {
+                    victim = std::min_element(queue.begin(), queue.end(), [&](const Entry& a, const Entry& b) { return score(a, now) < score(b, now); });
+                }
+                queuedSamples -= victim->info.samples;
+                if (victim->onDrop) { dropped.push_back(std::move(victim->onDrop)); }
+                queue.erase(victim);
+            }
+        }
+
+        // A loaded model and one decoder state per worker
+        struct Model {
+            ~Model() {
+                for (auto s : states) { whisper_free_state(s); }
+                if (ctx) { whisper_free(ctx); }
+            }
+
+            std::string path;
+            whisper_context* ctx = nullptr;
+            std::vector<whisper_state*> states;
+        };
+
+        // Doesn't touch the pool, so an abandoned loader can still run it
+        static std::shared_ptr<Model> loadModel(const std::string& modelPath, int stateCount) {
+            auto m = std::make_shared<Model>();
+            m->path = modelPath;
+            whisper_context_params cparams = whisper_context_default_params();
+            m->ctx = whisper_init_from_file_with_params_no_state(modelPath.c_str(), cparams);
+            if (!m->ctx) { return nullptr; }
+            for (int i = 0; i < stateCount; i++) {
+                whisper_state* s = whisper_init_state(m->ctx);
+                if (!s) { return nullptr; }
+                m->states.push_back(s);
+            }
+            return m;
+        }
+
+        void swapModel(const std::shared_ptr<Model>& m) {
+            std::shared_ptr<Model> old;
+            {
+                std::lock_guard<std::mutex> lck(queueMtx);
+                old = std::move(model);
+                model = m;
+                // Decodes running on the old model start over on the new one
+                if (old) { cancelRunning(Cancel::REASON_MODEL_SWAP); }
+            }
+            state = MODEL_READY;
+            queueCnd.notify_all();
+            // Jobs running on the old model keep it alive until they return
+        }
+
+        // Shared with the loader thread so it can tell it was abandoned after the pool is gone.
+        // The loader holds mtx whenever it touches the pool, except while loading.
+        struct LoaderControl {
+            std::mutex mtx;
+            bool abandoned = false;
+        };
+
+        void loaderLoop(std::shared_ptr<LoaderControl> control) {
+            std::unique_lock<std::mutex> ctl(control->mtx);
+            while (!control->abandoned) {
+                std::string path;
+                LoadHandler onDone;
+                int states;
+                {
+                    std::lock_guard<std::mutex> lck(loaderMtx);
+                    if (!hasRequest) {
+                        loaderBusy = false;
+                        return;
+                    }
+                    path = requestedPath;
+                    onDone = requestedHandler;
+                    hasRequest = false;
+                    states = stateCount;
+                }
+                state = MODEL_LOADING;
+
+                ctl.unlock();
+                auto loadStart = std::chrono::steady_clock::now();
+                std::shared_ptr<Model> m = loadModel(path, states);
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+                ctl.lock();
+                if (control->abandoned) {
+                    // Superseded by unload, free the model without publishing it
+                    ctl.unlock();
+                    return;
+                }
+                if (m) {
+                    swapModel(m);
+                } else {
+                    // Keep decoding with the previous model if there is one
+                    state = isLoaded() ? MODEL_READY : MODEL_FAILED;
+                }
+                if (onDone) { onDone(m != nullptr, path, seconds); }
+            }
+        }
+
+        // Best scored job among the oldest queued job of each channel that isn't busy, so each
+        // channel's jobs still run in order. Requires queueMtx.
+        std::deque<Entry>::iterator pickNext() {
+            auto now = std::chrono::steady_clock::now();
+            auto best = queue.end();
+            float bestScore = 0.0f;
+            std::set<int> seen;
+            for (auto it = queue.begin(); it != queue.end(); it++) {
+                if (!seen.insert(it->info.channel).second || busy.count(it->info.channel)) { continue; }
+                float s = score(*it, now);
+                if (best == queue.end() || s > bestScore) {
+                    best = it;
+                    bestScore = s;
+                }
+            }
+            return best;
+        }
+
+        void workerLoop(int index) {
+            pthread_setname_np(pthread_self(), THREAD_NAME);
+            Slot* slot;
+            {
+                std::lock_guard<std::mutex> lck(queueMtx);
+                slot = slots[index].get();
+            }
+            while (true) {
+                Entry entry;
+                std::shared_ptr<Model> m;
+                {
+                    // Wait for a model, and for a job whose channel isn't already being decoded by another state
+                    std::unique_lock<std::mutex> lck(queueMtx);
+                    std::deque<Entry>::iterator it;
+                    queueCnd.wait(lck, [&]() {
+                        if (stop) { return true; }
+                        if (!model) { return false; }
+                        it = pickNext();
+                        return it != queue.end();
+                    });
+                    if (stop) { return; }
+                    entry = std::move(*it);
+                    queue.erase(it);
+                    queuedSamples -= entry.info.samples;
+                    busy.insert(entry.info.channel);
+                    m = model;
+                    slot->running = true;
+                    slot->info = entry.info;
+                    slot->cancel.reason = Cancel::REASON_NONE;
+                    slot->cancel.fired = false;
+                }
+
+                entry.job(m->ctx, m->states[index], threadsPerState, slot->cancel);
+                m.reset();
+
+                {
+                    std::lock_guard<std::mutex> lck(queueMtx);
+                    busy.erase(entry.info.channel);
+                    slot->running = false;
+                    // An interrupted job goes back ahead of the rest of its channel, unless the pool is stopping
+                    if (slot->cancel.interrupted() && !stop) {
+                        queuedSamples += entry.info.samples;
+                        queue.push_front(std::move(entry));
+                    }
+                }
+                queueCnd.notify_all();
+            }
+        }
+
+        int stateCount = 1;
+        int threadsPerState = 1;
+        std::vector<std::thread> workers;
+        std::atomic<ModelState> state = MODEL_NONE;
+
+        std::mutex queueMtx;
+        std::condition_variable queueCnd;
+        std::shared_ptr<Model> model;
+        std::deque<Entry> queue;
+        size_t queuedSamples = 0;
+        QueueConfig queueCfg;
+        std::set<int> busy;
+        std::vector<std::unique_ptr<Slot>> slots;
+        std::atomic<uint64_t> preemptions = 0;
+        bool stop = false;
+
+        std::mutex loaderMtx;
+        std::thread loaderThread;
+        std::shared_ptr<LoaderControl> loaderControl = std::make_shared<LoaderControl>();
+        bool loaderBusy = false;
+        bool hasRequest = false;
+        std::string requestedPath;
+        LoadHandler requestedHandler;
+    };
+}
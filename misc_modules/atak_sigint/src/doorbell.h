@@ -0,0 +1,39 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+namespace sigint {
+    // Wakes a consumer thread sleeping until there's work, e.g. the Whisper worker waiting for audio.
+    // Ringing is a single atomic exchange unless the consumer is actually asleep, and only the first
+    // ring per sleep takes the lock and notifies, so the DSP threads can ring on every block.
+    class Doorbell {
+    public:
+        // Any thread
+        void ring() {
+            if (!waiting.exchange(false, std::memory_order_acq_rel)) { return; }
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                rung = true;
+            }
+            cnd.notify_one();
+        }
+
+        // Consumer thread. Returns true if woken by a ring, false on timeout.
+        bool wait(std::chrono::milliseconds timeout) {
+            std::unique_lock<std::mutex> lck(mtx);
+            waiting.store(true, std::memory_order_release);
+            bool woken = cnd.wait_for(lck, timeout, [this]() { return rung; });
+            rung = false;
+            waiting.store(false, std::memory_order_release);
+            return woken;
+        }
+
+    private:
+        std::atomic<bool> waiting = false;
+        std::mutex mtx;
+        std::condition_variable cnd;
+        bool rung = false;
+    };
+}
@@ -0,0 +1,268 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <atomic>
+#include <config.h>
+#include "http_stream.h"
+#include "vector_index.h"
+#include "telemetry.h"
+
+namespace sigint {
+    // Turns transcripts into embeddings through Ollama on its own thread and adds them to the vector
+    // index, so nothing on the decode path waits for it. Transcripts are sent in batches of up to
+    // maxBatch per request (/api/embed), one at a time to servers that predate it (/api/embeddings).
+    // Queries (search boxes, retrieval for the LLM) go ahead of queued transcripts. While Ollama is
+    // unreachable, failing or the embedding model is missing, transcripts wait and are retried every
+    // retrySec. A batch Ollama rejects (a 4xx for its input) is retried one transcript at a time, and
+    // the transcripts rejected on their own are dropped, so one bad input can't hold up the rest.
+    class EmbeddingStage {
+    public:
+        struct Config {
+            std::string model = "nomic-embed-text";
+            int maxBatch = 16;
+            int maxPending = 2000;      // Transcripts waiting, the oldest are dropped beyond it
+            int retrySec = 30;
+        };
+
+        struct Metrics {
+            telemetry::Counter embedded;
+            telemetry::Counter failed;          // Requests that failed
+            telemetry::Counter dropped;         // Too many waiting, rejected by Ollama, or the index refused them
+            telemetry::Histogram requestSeconds;
+        };
+
+        typedef std::function<void(bool success, const std::vector<float>& vector)> QueryHandler;
+
+        ~EmbeddingStage() { stop(); }
+
+        // Requests go through the given pool, embeddings into the given index. Both must outlive the stage.
+        void start(const Config& config, http::ConnectionPool* pool, VectorIndex* index) {
+            stop();
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                cfg = config;
+                stopWorker = false;
+                cancel = false;
+                retryAt = std::chrono::steady_clock::time_point();
+            }
+            this->pool = pool;
+            this->index = index;
+            workerThread = std::thread(&EmbeddingStage::worker, this);
+        }
+
+        // Queries still waiting are answered with a failure
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                stopWorker = true;
+            }
+            // Abort a request in progress rather than waiting for a stalled server to time out
+            cancel = true;
+            cnd.notify_all();
+            if (workerThread.joinable()) { workerThread.join(); }
+            std::deque<Query> dropped;
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                dropped.swap(queries);
+            }
+            for (auto& q : dropped) { q.onDone(false, {}); }
+        }
+
+        // Queue a transcript for the index
+        void submit(const VectorIndex::Doc& doc) {
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                pending.push_back(doc);
+                while ((int)pending.size() > cfg.maxPending) {
+                    pending.pop_front();
+                    metrics.dropped.add();
+                }
+            }
+            cnd.notify_all();
+        }
+
+        // Embed a query, onDone is called on the stage's thread
+        void query(const std::string& text, QueryHandler onDone) {
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                queries.push_back(Query{ text, onDone });
+            }
+            cnd.notify_all();
+        }
+
+        int queued() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return (int)pending.size();
+        }
+
+        std::string getError() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return error;
+        }
+
+        Metrics metrics;
+
+    private:
+        struct Query {
+            std::string text;
+            QueryHandler onDone;
+        };
+
+        enum Outcome {
+            EMBEDDED,
+            RETRY,          // Ollama unreachable, failing or without the model, worth trying again later
+            REJECTED        // Ollama refused the input, it won't do any better later
+        };
+
+        void worker() {
+            std::unique_lock<std::mutex> lck(mtx);
+            while (!stopWorker) {
+                if (!queries.empty()) {
+                    std::vector<Query> batch;
+                    while (!queries.empty() && (int)batch.size() < cfg.maxBatch) {
+                        batch.push_back(std::move(queries.front()));
+                        queries.pop_front();
+                    }
+                    std::vector<std::string> texts;
+                    for (const auto& q : batch) { texts.push_back(q.text); }
+                    lck.unlock();
+                    std::vector<std::vector<float>> vectors;
+                    bool success = (embed(texts, vectors) == EMBEDDED);
+                    for (size_t i = 0; i < batch.size(); i++) { batch[i].onDone(success, success ? vectors[i] : std::vector<float>()); }
+                    lck.lock();
+                    continue;
+                }
+
+                auto now = std::chrono::steady_clock::now();
+                if (pending.empty() || now < retryAt) {
+                    if (pending.empty()) { cnd.wait(lck); } else { cnd.wait_until(lck, retryAt); }
+                    continue;
+                }
+
+                size_t count = std::min<size_t>(pending.size(), cfg.maxBatch);
+                std::vector<VectorIndex::Doc> batch(pending.begin(), pending.begin() + count);
+                pending.erase(pending.begin(), pending.begin() + count);
+                std::vector<std::string> texts;
+                for (const auto& doc : batch) { texts.push_back(doc.text); }
+                lck.unlock();
+                std::vector<std::vector<float>> vectors;
+                Outcome outcome = embed(texts, vectors);
+                size_t done = 0;
+                if (outcome == EMBEDDED) {
+                    for (; done < batch.size(); done++) { addToIndex(batch[done], vectors[done]); }
+                } else if (outcome == REJECTED) {
+                    // Find the transcripts that were refused, the others still go in
+                    for (; done < batch.size(); done++) {
+                        outcome = embed({ texts[done] }, vectors);
+                        if (outcome == RETRY) { break; }
+                        if (outcome == EMBEDDED) { addToIndex(batch[done], vectors[0]); } else { metrics.dropped.add(); }
+                    }
+                }
+                lck.lock();
+                if (done < batch.size()) {
+                    // Back in front, in order, to be retried
+                    pending.insert(pending.begin(), batch.begin() + done, batch.end());
+                    retryAt = std::chrono::steady_clock::now() + std::chrono::seconds(cfg.retrySec);
+                }
+            }
+        }
+
+        void addToIndex(const VectorIndex::Doc& doc, std::vector<float>& vector) {
+            if (index->add(doc, std::move(vector))) { metrics.embedded.add(); } else { metrics.dropped.add(); }
+        }
+
+        // One vector per text. Called without mtx.
+        Outcome embed(const std::vector<std::string>& texts, std::vector<std::vector<float>>& vectors) {
+            std::string model;
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                model = cfg.model;
+            }
+            std::string failure;
+            int failedStatus = 0;
+            try {
+                telemetry::ScopedTimer timer(metrics.requestSeconds);
+                if (!legacy) {
+                    json body;
+                    body["model"] = model;
+                    body["input"] = texts;
+                    json response;
+                    int status = post("/api/embed", body, response);
+                    // Servers without /api/embed answer with a plain 404 page, a missing model with a JSON error
+                    if (status == 404 && !response.is_object()) {
+                        legacy = true;
+                    } else if (status != 200 || !response.contains("embeddings") || response["embeddings"].size() != texts.size()) {
+                        failedStatus = status;
+                        failure = response.is_object() && response.contains("error") ? response["error"].get<std::string>() : "HTTP status " + std::to_string(status);
+                    } else {
+                        vectors = response["embeddings"].get<std::vector<std::vector<float>>>();
+                    }
+                }
+                if (legacy) {
+                    vectors.clear();
+                    for (const auto& text : texts) {
+                        json body;
+                        body["model"] = model;
+                        body["prompt"] = text;
+                        json response;
+                        int status = post("/api/embeddings", body, response);
+                        if (status != 200 || !response.contains("embedding")) {
+                            failedStatus = status;
+                            failure = response.is_object() && response.contains("error") ? response["error"].get<std::string>() : "HTTP status " + std::to_string(status);
+                            break;
+                        }
+                        vectors.push_back(response["embedding"].get<std::vector<float>>());
+                    }
+                }
+            } catch (const std::exception& e) {
+                failure = e.what();
+            }
+
+            std::lock_guard<std::mutex> lck(mtx);
+            if (!failure.empty()) {
+                error = failure;
+                metrics.failed.add();
+                return rejected(failedStatus) ? REJECTED : RETRY;
+            }
+            error.clear();
+            return EMBEDDED;
+        }
+
+        // Client errors are about the input, except a missing model (404), a timeout and rate limiting
+        static bool rejected(int status) {
+            return status >= 400 && status < 500 && status != 404 && status != 408 && status != 429;
+        }
+
+        // Response body parsed as JSON, or discarded if it isn't
+        int post(const std::string& path, const json& body, json& response) {
+            std::string text;
+            // Transcripts aren't guaranteed to be valid UTF-8
+            std::string payload = body.dump(-1, ' ', false, json::error_handler_t::replace);
+            int status = pool->request("POST", path, payload, [&](const char* data, size_t len) { text.append(data, len); }, &cancel);
+            response = json::parse(text, nullptr, false);
+            if (response.is_discarded()) { response = json(); }
+            return status;
+        }
+
+        http::ConnectionPool* pool = nullptr;
+        VectorIndex* index = nullptr;
+        std::thread workerThread;
+        bool legacy = false;        // Worker thread only
+
+        std::mutex mtx;
+        std::condition_variable cnd;
+        Config cfg;
+        std::deque<VectorIndex::Doc> pending;
+        std::deque<Query> queries;
+        std::chrono::steady_clock::time_point retryAt;
+        std::string error;
+        bool stopWorker = false;
+        std::atomic<bool> cancel = false;
+    };
+}
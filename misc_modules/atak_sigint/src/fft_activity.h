@@ -0,0 +1,105 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace sigint::fft {
+    // A run of FFT bins above the activity threshold
+    struct Carrier {
+        int startBin;
+        int endBin;     // Exclusive
+        int peakBin;
+        float peakDb;
+    };
+
+    // Noise floor of a spectrum (dB bins), estimated as a low percentile so carriers don't pull it up.
+    // scratch is reused between calls to avoid reallocating.
+    inline float noiseFloor(const float* data, int count, std::vector<float>& scratch, float percentile = 0.25f) {
+        if (count <= 0) { return -150.0f; }
+        scratch.assign(data, data + count);
+        auto nth = scratch.begin() + (int)(percentile * (count - 1));
+        std::nth_element(scratch.begin(), nth, scratch.end());
+        return *nth;
+    }
+
+    // Highest bin level in [start, end)
+    inline float maxInRange(const float* data, int start, int end) {
+        float best = -1e30f;
+        int i = start;
+#if defined(__SSE__)
+        __m128 vbest = _mm_set1_ps(best);
+        for (; i + 4 <= end; i += 4) {
+            vbest = _mm_max_ps(vbest, _mm_loadu_ps(&data[i]));
+        }
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, vbest);
+        best = std::max<float>(std::max<float>(lanes[0], lanes[1]), std::max<float>(lanes[2], lanes[3]));
+#elif defined(__ARM_NEON)
+        float32x4_t vbest = vdupq_n_f32(best);
+        for (; i + 4 <= end; i += 4) {
+            vbest = vmaxq_f32(vbest, vld1q_f32(&data[i]));
+        }
+        float32x2_t half = vpmax_f32(vget_low_f32(vbest), vget_high_f32(vbest));
+        best = std::max<float>(vget_lane_f32(half, 0), vget_lane_f32(half, 1));
+#endif
+        for (; i < end; i++) {
+            best = std::max<float>(best, data[i]);
+        }
+        return best;
+    }
+
+    // Find every run of at least minWidth bins above threshold (dB). Four bins are compared per
+    // instruction, and blocks entirely below threshold, the common case, are skipped without branching per bin.
+    inline void findCarriers(const float* data, int count, float threshold, int minWidth, std::vector<Carrier>& carriers) {
+        carriers.clear();
+        Carrier current;
+        bool inCarrier = false;
+
+        auto visit = [&](int bin) {
+            bool above = data[bin] > threshold;
+            if (above && !inCarrier) {
+                current.startBin = bin;
+                current.peakBin = bin;
+                current.peakDb = data[bin];
+                inCarrier = true;
+            } else if (above) {
+                if (data[bin] > current.peakDb) {
+                    current.peakDb = data[bin];
+                    current.peakBin = bin;
+                }
+            } else if (inCarrier) {
+                current.endBin = bin;
+                if (current.endBin - current.startBin >= minWidth) { carriers.push_back(current); }
+                inCarrier = false;
+            }
+        };
+
+        int i = 0;
+#if defined(__SSE__)
+        __m128 vthresh = _mm_set1_ps(threshold);
+        for (; i + 4 <= count; i += 4) {
+            int mask = _mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(&data[i]), vthresh));
+            if (!mask && !inCarrier) { continue; }
+            for (int j = i; j < i + 4; j++) { visit(j); }
+        }
+#elif defined(__ARM_NEON)
+        float32x4_t vthresh = vdupq_n_f32(threshold);
+        for (; i + 4 <= count; i += 4) {
+            uint32x4_t gt = vcgtq_f32(vld1q_f32(&data[i]), vthresh);
+            uint32x2_t any = vorr_u32(vget_low_u32(gt), vget_high_u32(gt));
+            if (!(vget_lane_u32(any, 0) | vget_lane_u32(any, 1)) && !inCarrier) { continue; }
+            for (int j = i; j < i + 4; j++) { visit(j); }
+        }
+#endif
+        for (; i < count; i++) { visit(i); }
+
+        if (inCarrier) {
+            current.endBin = count;
+            if (current.endBin - current.startBin >= minWidth) { carriers.push_back(current); }
+        }
+    }
+}
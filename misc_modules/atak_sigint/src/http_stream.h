@@ -0,0 +1,464 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <atomic>
+#include <stdexcept>
+#include <chrono>
+#include <algorithm>
+#include <string.h>
+#include <errno.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "telemetry.h"
+
+namespace sigint::http {
+    typedef std::function<void(const char* data, size_t len)> DataHandler;
+
+    // Split an "http://host:port" endpoint URL, any path is ignored. Returns false if it can't be parsed.
+    inline bool parseUrl(const std::string& url, std::string& host, int& port) {
+        std::string rest = url;
+        if (!rest.compare(0, 7, "http://")) {
+            rest = rest.substr(7);
+        } else if (rest.find("://") != std::string::npos) {
+            return false;
+        }
+        rest = rest.substr(0, rest.find('/'));
+        size_t colon = rest.rfind(':');
+        port = 80;
+        if (colon != std::string::npos) {
+            port = atoi(rest.c_str() + colon + 1);
+            rest = rest.substr(0, colon);
+        }
+        host = rest;
+        return !host.empty() && port > 0 && port < 65536;
+    }
+
+    // Minimal HTTP/1.1 client connection for talking to a local Ollama server.
+    // Unlike net::http::Client the response body is handed out as it arrives (chunked transfer
+    // encoding is decoded on the fly), so token streams can be consumed while they're generated.
+    // Connections are kept alive between requests unless the server says otherwise.
+    // Every blocking call polls in short slices so a request can be cancelled from another thread.
+    // Errors, timeouts and cancellation are reported by throwing std::runtime_error.
+    class Connection {
+    public:
+        Connection(std::string host, int port, int connectTimeoutMs, int requestTimeoutMs) {
+            this->host = host;
+            this->port = port;
+            this->connectTimeoutMs = connectTimeoutMs;
+            this->requestTimeoutMs = requestTimeoutMs;
+        }
+
+        ~Connection() { close(); }
+
+        // Perform a request and stream the decoded body into onData. Returns the HTTP status code.
+        int request(const std::string& method, const std::string& path, const std::string& body, const DataHandler& onData, const std::atomic<bool>* cancel = nullptr) {
+            this->cancel = cancel;
+            gotResponse = false;
+            requests++;
+            try {
+                if (sock < 0) { connect(); }
+
+                std::string req = method + " " + path + " HTTP/1.1\r\n";
+                req += "Host: " + host + ":" + std::to_string(port) + "\r\n";
+                req += "Connection: keep-alive\r\n";
+                if (!body.empty() || method == "POST") {
+                    req += "Content-Type: application/json\r\n";
+                    req += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+                }
+                req += "\r\n";
+                req += body;
+                timeoutMs = requestTimeoutMs;
+                sendAll(req.data(), req.size());
+
+                int status = readResponse(onData);
+                if (!keepAlive) { close(); }
+                lastUsed = std::chrono::steady_clock::now();
+                return status;
+            } catch (...) {
+                // Whatever is left of the response can't be trusted, never reuse the socket
+                close();
+                throw;
+            }
+        }
+
+        void close() {
+            if (sock >= 0) {
+                ::close(sock);
+                sock = -1;
+            }
+        }
+
+        bool isOpen() { return sock >= 0; }
+
+        // An idle keep-alive connection the server has closed (or sent garbage on) reads as ready
+        bool isStale(int idleTimeoutMs) {
+            if (sock < 0) { return true; }
+            if (std::chrono::steady_clock::now() - lastUsed > std::chrono::milliseconds(idleTimeoutMs)) { return true; }
+            pollfd pfd = { sock, POLLIN, 0 };
+            return poll(&pfd, 1, 0) != 0;
+        }
+
+        // True if the last request failed before anything came back, i.e. it's safe to resend
+        bool failedBeforeResponse() { return !gotResponse; }
+
+        // Number of requests sent on this connection
+        int getRequestCount() { return requests; }
+
+        const std::string& getHost() { return host; }
+        int getPort() { return port; }
+
+    private:
+        void connect() {
+            close();
+            addrinfo hints;
+            memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            addrinfo* res = NULL;
+            if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res) || !res) {
+                throw std::runtime_error("Could not resolve " + host);
+            }
+
+            timeoutMs = connectTimeoutMs;
+            for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+                sock = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+                if (sock < 0) { continue; }
+                try {
+                    if (::connect(sock, ai->ai_addr, ai->ai_addrlen) == 0 || (errno == EINPROGRESS && waitFor(POLLOUT) && socketError() == 0)) {
+                        break;
+                    }
+                } catch (...) {
+                    freeaddrinfo(res);
+                    throw;
+                }
+                close();
+            }
+            freeaddrinfo(res);
+            if (sock < 0) {
+                throw std::runtime_error("Could not connect to " + host + ":" + std::to_string(port));
+            }
+            int one = 1;
+            setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            requests = 0;
+        }
+
+        int socketError() {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len);
+            return err;
+        }
+
+        // Wait for the socket to become ready in short slices, so cancellation is noticed quickly.
+        // The timeout applies to each wait, i.e. it is an inactivity timeout.
+        bool waitFor(short events) {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+            while (true) {
+                if (cancel && *cancel) { throw std::runtime_error("Request cancelled"); }
+                pollfd pfd = { sock, events, 0 };
+                int ret = poll(&pfd, 1, 100);
+                if (ret > 0) { return true; }
+                if (ret < 0 && errno != EINTR) { return false; }
+                if (std::chrono::steady_clock::now() > deadline) {
+                    throw std::runtime_error("Request timed out");
+                }
+            }
+        }
+
+        void sendAll(const char* data, size_t len) {
+            while (len) {
+                ssize_t n = send(sock, data, len, MSG_NOSIGNAL);
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    waitFor(POLLOUT);
+                    continue;
+                }
+                if (n <= 0) { throw std::runtime_error("Connection lost while sending request"); }
+                data += n;
+                len -= n;
+            }
+        }
+
+        // Read more data into buf, returns false on EOF
+        bool fill() {
+            char tmp[8192];
+            while (true) {
+                ssize_t n = recv(sock, tmp, sizeof(tmp), 0);
+                if (n > 0) {
+                    buf.append(tmp, n);
+                    return true;
+                }
+                if (n == 0) { return false; }
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    throw std::runtime_error("Connection lost while reading response");
+                }
+                waitFor(POLLIN);
+            }
+        }
+
+        std::string readLine() {
+            size_t pos;
+            while ((pos = buf.find("\r\n")) == std::string::npos) {
+                if (!fill()) { throw std::runtime_error("Connection closed mid-response"); }
+            }
+            std::string line = buf.substr(0, pos);
+            buf.erase(0, pos + 2);
+            return line;
+        }
+
+        int readResponse(const DataHandler& onData) {
+            buf.clear();
+
+            // Status line and headers
+            std::string statusLine = readLine();
+            gotResponse = true;
+            size_t sp = statusLine.find(' ');
+            if (sp == std::string::npos || statusLine.compare(0, 5, "HTTP/")) {
+                throw std::runtime_error("Malformed HTTP response");
+            }
+            int status = atoi(statusLine.c_str() + sp + 1);
+            keepAlive = statusLine.compare(0, 8, "HTTP/1.0");
+            bool chunked = false;
+            long long contentLength = -1;
+            while (true) {
+                std::string line = readLine();
+                if (line.empty()) { break; }
+                size_t colon = line.find(':');
+                if (colon == std::string::npos) { continue; }
+                std::string key = line.substr(0, colon);
+                std::string value = line.substr(colon + 1);
+                value.erase(0, value.find_first_not_of(" \t"));
+                if (!strcasecmp(key.c_str(), "Transfer-Encoding") && strcasestr(value.c_str(), "chunked")) {
+                    chunked = true;
+                } else if (!strcasecmp(key.c_str(), "Content-Length")) {
+                    contentLength = atoll(value.c_str());
+                } else if (!strcasecmp(key.c_str(), "Connection")) {
+                    keepAlive = !strcasestr(value.c_str(), "close");
+                }
+            }
+
+            if (chunked) {
+                while (true) {
+                    size_t chunkSize = strtoul(readLine().c_str(), NULL, 16);
+                    if (!chunkSize) {
+                        // Trailers, if any
+                        while (!readLine().empty()) {}
+                        break;
+                    }
+                    while (buf.size() < chunkSize) {
+                        if (!fill()) { throw std::runtime_error("Connection closed mid-chunk"); }
+                    }
+                    onData(buf.data(), chunkSize);
+                    buf.erase(0, chunkSize);
+                    readLine();
+                }
+            } else if (contentLength >= 0) {
+                long long remaining = contentLength;
+                while (remaining > 0) {
+                    if (buf.empty() && !fill()) { throw std::runtime_error("Connection closed mid-body"); }
+                    size_t n = std::min<size_t>(buf.size(), remaining);
+                    onData(buf.data(), n);
+                    buf.erase(0, n);
+                    remaining -= n;
+                }
+            } else {
+                // Body runs until the server closes the connection
+                keepAlive = false;
+                do {
+                    if (!buf.empty()) {
+                        onData(buf.data(), buf.size());
+                        buf.clear();
+                    }
+                } while (fill());
+            }
+
+            // Anything after the body would belong to no request
+            if (!buf.empty()) { keepAlive = false; }
+            return status;
+        }
+
+        std::string host;
+        int port;
+        int connectTimeoutMs;
+        int requestTimeoutMs;
+        int timeoutMs;
+        int sock = -1;
+        int requests = 0;
+        bool keepAlive = false;
+        bool gotResponse = false;
+        std::string buf;
+        const std::atomic<bool>* cancel = nullptr;
+        std::chrono::steady_clock::time_point lastUsed;
+    };
+
+    // Pool of keep-alive connections to one HTTP endpoint.
+    // Requests borrow an idle connection (or open a new one), and hand it back when the response
+    // was read completely. A request that fails on a reused connection before any response came
+    // back is retried once on a fresh connection, since the server may have closed it while idle.
+    // Every request also tells whether the server is reachable: getting any response means it is,
+    // failing to connect or send means it isn't. The reachability handler is called when that flips.
+    class ConnectionPool {
+    public:
+        typedef std::function<void(bool reachable)> ReachabilityHandler;
+
+        struct Config {
+            std::string host = "localhost";
+            int port = 11434;
+            int connectTimeoutMs = 3000;
+            int requestTimeoutMs = 120000;  // Inactivity timeout while waiting for the server
+            int maxIdle = 4;
+            int idleTimeoutMs = 30000;      // Idle connections older than this are not reused
+        };
+
+        void configure(const Config& config) {
+            std::lock_guard<std::mutex> lck(mtx);
+            cfg = config;
+            idle.clear();
+            failures = 0;
+            lastResponseMs = 0;
+        }
+
+        // Must be set before any request is made
+        void setReachabilityHandler(ReachabilityHandler handler) {
+            onReachability = handler;
+        }
+
+        Config getConfig() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return cfg;
+        }
+
+        // Perform a request, streaming the body into onData. Returns the HTTP status code.
+        int request(const std::string& method, const std::string& path, const std::string& body, const DataHandler& onData, const std::atomic<bool>* cancel = nullptr) {
+            requestCount.add();
+            bool responded = false;
+            try {
+                telemetry::ScopedTimer timer(requestSeconds);
+                int status = attempt(method, path, body, onData, cancel, responded);
+                setReachable(true);
+                return status;
+            } catch (const std::exception&) {
+                failureCount.add();
+                // A cancelled request says nothing about the server
+                if (responded || !(cancel && *cancel)) { setReachable(responded); }
+                throw;
+            }
+        }
+
+        // Convenience wrappers returning the whole body, any non 2xx status is thrown as an error
+        std::string get(const std::string& path, const std::atomic<bool>* cancel = nullptr) {
+            return fetch("GET", path, "", cancel);
+        }
+
+        std::string post(const std::string& path, const std::string& body, const std::atomic<bool>* cancel = nullptr) {
+            return fetch("POST", path, body, cancel);
+        }
+
+        uint64_t getConnectionsOpened() { return connectionsOpened.get(); }
+        uint64_t getRequestCount() { return requestCount.get(); }
+
+        // Exported metrics
+        telemetry::Counter connectionsOpened;
+        telemetry::Counter requestCount;
+        telemetry::Counter failureCount;         // Requests that threw (connection, protocol or cancelled)
+        telemetry::Histogram requestSeconds;     // Whole request, including streaming the response
+
+        // Reachability as seen by the last request that completed or failed to connect
+        bool isReachable() { return reachable; }
+        int getConsecutiveFailures() { return failures; }
+
+        // Time since the server last answered anything, very large if it never did
+        int64_t getMsSinceLastResponse() {
+            int64_t last = lastResponseMs;
+            return last ? nowMs() - last : INT64_MAX;
+        }
+
+    private:
+        int attempt(const std::string& method, const std::string& path, const std::string& body, const DataHandler& onData, const std::atomic<bool>* cancel, bool& responded) {
+            bool reused;
+            auto conn = acquire(reused);
+            try {
+                int status = conn->request(method, path, body, onData, cancel);
+                release(std::move(conn));
+                return status;
+            } catch (const std::exception&) {
+                responded = !conn->failedBeforeResponse();
+                if (!reused || responded || (cancel && *cancel)) { throw; }
+            }
+            conn = acquire(reused, true);
+            try {
+                int status = conn->request(method, path, body, onData, cancel);
+                release(std::move(conn));
+                return status;
+            } catch (const std::exception&) {
+                responded = !conn->failedBeforeResponse();
+                throw;
+            }
+        }
+
+        void setReachable(bool ok) {
+            if (ok) {
+                failures = 0;
+                lastResponseMs = nowMs();
+            } else {
+                failures++;
+            }
+            if (reachable.exchange(ok) != ok && onReachability) { onReachability(ok); }
+        }
+
+        static int64_t nowMs() {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        std::string fetch(const std::string& method, const std::string& path, const std::string& body, const std::atomic<bool>* cancel) {
+            std::string resp;
+            int status = request(method, path, body, [&](const char* data, size_t len) { resp.append(data, len); }, cancel);
+            if (status < 200 || status >= 300) {
+                throw std::runtime_error("HTTP status " + std::to_string(status) + ": " + resp);
+            }
+            return resp;
+        }
+
+        std::unique_ptr<Connection> acquire(bool& reused, bool fresh = false) {
+            std::lock_guard<std::mutex> lck(mtx);
+            while (!fresh && !idle.empty()) {
+                auto conn = std::move(idle.back());
+                idle.pop_back();
+                if (!conn->isStale(cfg.idleTimeoutMs)) {
+                    reused = true;
+                    return conn;
+                }
+            }
+            reused = false;
+            connectionsOpened.add();
+            return std::make_unique<Connection>(cfg.host, cfg.port, cfg.connectTimeoutMs, cfg.requestTimeoutMs);
+        }
+
+        void release(std::unique_ptr<Connection> conn) {
+            std::lock_guard<std::mutex> lck(mtx);
+            // Connections to an endpoint that was reconfigured while they were in use are dropped
+            if (conn->isOpen() && conn->getHost() == cfg.host && conn->getPort() == cfg.port && idle.size() < (size_t)cfg.maxIdle) {
+                idle.push_back(std::move(conn));
+            }
+        }
+
+        Config cfg;
+        std::mutex mtx;
+        std::vector<std::unique_ptr<Connection>> idle;
+
+        ReachabilityHandler onReachability;
+        std::atomic<bool> reachable = false;
+        std::atomic<int> failures = 0;
+        std::atomic<int64_t> lastResponseMs = 0;
+    };
+}
@@ -0,0 +1,402 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <ctype.h>
+#include <sys/stat.h>
+
+namespace sigint {
+    // Spots watch terms (callsigns, unit names, "mayday", grid references) in transcripts without a
+    // model call. Terms and transcripts are reduced to words, numbers to single digits ("four five six",
+    // "456" and "4-5-6" are the same), and words to a phonetic code so Whisper's spelling of a name
+    // doesn't matter. Codes one edit apart still match. All terms are matched in a single pass with an
+    // Aho-Corasick automaton over words, so a transcript costs microseconds however long the watchlist.
+    //
+    // The watchlist is a text file with one term per line. '#' starts a comment, and a term starting
+    // with '!' raises the channel's priority when it's heard.
+    class KeywordSpotter {
+    public:
+        struct Match {
+            std::string term;   // As written in the watchlist
+            std::string heard;  // The words it matched
+            bool exact;         // Same words, not only a phonetic or fuzzy match
+            bool boost;         // Raise the channel's priority
+        };
+
+        // Watch the given file, loading it if it exists
+        void setPath(const std::string& path) {
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                this->path = path;
+                mtime = 0;
+            }
+            reloadIfChanged();
+        }
+
+        // Load the file again if it changed since it was last read. Cheap, meant to be polled.
+        // Returns true if the terms were replaced.
+        bool reloadIfChanged() {
+            std::string file;
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                file = path;
+            }
+            struct stat st;
+            if (file.empty() || stat(file.c_str(), &st)) { return false; }
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                if (st.st_mtime == mtime) { return false; }
+                mtime = st.st_mtime;
+            }
+            std::ifstream in(file);
+            if (!in) { return false; }
+            std::stringstream ss;
+            ss << in.rdbuf();
+            setText(ss.str());
+            return true;
+        }
+
+        // Write a new watchlist to the file and use it
+        bool save(const std::string& text) {
+            std::string file;
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                file = path;
+            }
+            std::ofstream out(file, std::ios::trunc);
+            if (!out) { return false; }
+            out << text;
+            out.close();
+            if (!out) { return false; }
+            setText(text);
+            struct stat st;
+            std::lock_guard<std::mutex> lck(mtx);
+            if (!stat(file.c_str(), &st)) { mtime = st.st_mtime; }
+            return true;
+        }
+
+        // Replace the terms with the ones in a watchlist. The new automaton is built before it's swapped
+        // in, matching never waits for it.
+        void setText(const std::string& text) {
+            auto index = std::make_shared<Index>();
+            std::istringstream lines(text);
+            std::string line;
+            while (std::getline(lines, line)) {
+                size_t hash = line.find('#');
+                if (hash != std::string::npos) { line.erase(hash); }
+                size_t start = line.find_first_not_of(" \t\r");
+                if (start == std::string::npos) { continue; }
+                line = line.substr(start, line.find_last_not_of(" \t\r") + 1 - start);
+                bool boost = (line[0] == '!');
+                if (boost) {
+                    // A bare "!" has no term after it
+                    size_t term = line.find_first_not_of(" \t", 1);
+                    if (term == std::string::npos) { continue; }
+                    line = line.substr(term);
+                }
+                index->addTerm(line, boost);
+            }
+            index->build();
+
+            std::lock_guard<std::mutex> lck(mtx);
+            this->text = text;
+            this->index = index;
+            version++;
+        }
+
+        // Every term heard in the transcript, each once. Any thread.
+        std::vector<Match> match(const std::string& transcript) {
+            std::shared_ptr<const Index> index;
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                index = this->index;
+            }
+            std::vector<Match> matches;
+            if (!index || index->terms.empty()) { return matches; }
+
+            std::vector<std::string> heard = words(transcript);
+            std::vector<bool> reported(index->terms.size(), false);
+            int node = 0;
+            for (size_t i = 0; i < heard.size(); i++) {
+                node = index->step(node, index->symbol(heard[i]));
+                for (int v : index->nodes[node].out) {
+                    const Variant& variant = index->variants[v];
+                    if (reported[variant.term]) { continue; }
+                    reported[variant.term] = true;
+
+                    const Term& term = index->terms[variant.term];
+                    size_t first = i + 1 - variant.words.size();
+                    Match m;
+                    m.term = term.text;
+                    m.exact = true;
+                    for (size_t j = 0; j < variant.words.size(); j++) {
+                        m.heard += (j ? " " : "") + heard[first + j];
+                        m.exact &= (heard[first + j] == variant.words[j]);
+                    }
+                    m.boost = term.boost;
+                    matches.push_back(m);
+                }
+            }
+            return matches;
+        }
+
+        std::string getText() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return text;
+        }
+
+        std::string getPath() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return path;
+        }
+
+        int getTermCount() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return index ? (int)index->terms.size() : 0;
+        }
+
+        // Bumped whenever the terms change, so an editor can tell its copy is stale
+        uint64_t getVersion() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return version;
+        }
+
+        // Lower case words without punctuation, with numbers as single digits. Hyphenated words are
+        // joined ("re-supply").
+        static std::vector<std::string> words(const std::string& text) {
+            static const std::map<std::string, std::string> DIGITS = {
+                { "zero", "0" }, { "one", "1" }, { "two", "2" }, { "three", "3" }, { "four", "4" }, { "five", "5" },
+                { "six", "6" }, { "seven", "7" }, { "eight", "8" }, { "nine", "9" }, { "niner", "9" }
+            };
+            std::vector<std::string> out;
+            std::string word;
+            auto flush = [&]() {
+                if (word.empty()) { return; }
+                auto it = DIGITS.find(word);
+                out.push_back(it != DIGITS.end() ? it->second : word);
+                word.clear();
+            };
+            for (char c : text) {
+                if (isdigit((unsigned char)c)) {
+                    flush();
+                    out.push_back(std::string(1, c));
+                } else if (isalpha((unsigned char)c)) {
+                    word += (char)tolower((unsigned char)c);
+                } else if (c != '\'' && c != '-') {
+                    flush();
+                }
+            }
+            flush();
+            return out;
+        }
+
+        // Phonetic code of a lower case word, in the spirit of Metaphone: all vowels are the same, letters
+        // that sound alike share a code, silent letters are dropped and doubled sounds collapse
+        static std::string phonetic(const std::string& word) {
+            if (word.empty() || isdigit((unsigned char)word[0])) { return word; }
+            std::string w = word;
+            if (w.size() > 1 && (!w.compare(0, 2, "kn") || !w.compare(0, 2, "gn") || !w.compare(0, 2, "wr") || !w.compare(0, 2, "ps"))) { w.erase(0, 1); }
+
+            auto vowel = [](char c) { return c == 'a' || c == 'e' || c == 'i' || c == 'o' || c == 'u' || c == 'y'; };
+            std::string code;
+            for (size_t i = 0; i < w.size(); i++) {
+                char c = w[i];
+                char next = (i + 1 < w.size()) ? w[i + 1] : 0;
+                char out = 0;
+                if (vowel(c)) {
+                    out = 'a';
+                } else if (c == 'p' && next == 'h') {
+                    out = 'f';
+                    i++;
+                } else if ((c == 's' || c == 'c') && next == 'h') {
+                    out = 'x';
+                    i++;
+                } else if (c == 't' && next == 'h') {
+                    out = '0';
+                    i++;
+                } else if (c == 'g' && next == 'h') {
+                    i++;    // Silent, as in "night"
+                } else if (c == 'c') {
+                    out = (next == 'e' || next == 'i' || next == 'y') ? 's' : 'k';
+                } else if (c == 'g') {
+                    out = (next == 'e' || next == 'i' || next == 'y') ? 'j' : 'k';
+                } else if (c == 'h' || c == 'w') {
+                    if (vowel(next) && (i == 0 || !vowel(w[i - 1]))) { out = c; }
+                } else if (c == 'q') {
+                    out = 'k';
+                } else if (c == 'x') {
+                    if (code.empty() || code.back() != 'k') { code += 'k'; }
+                    out = 's';
+                } else if (c == 'z') {
+                    out = 's';
+                } else if (c == 'v') {
+                    out = 'f';
+                } else if (c == 'd' && next == 'g') {
+                    out = 'j';
+                    i++;
+                } else {
+                    out = c;
+                }
+                if (out && (code.empty() || code.back() != out)) { code += out; }
+            }
+            // A trailing vowel is the least reliable part of a spelling ("fuel", "fule")
+            if (code.size() > 1 && code.back() == 'a') { code.pop_back(); }
+            return code.empty() ? w.substr(0, 1) : code;
+        }
+
+    private:
+        // Phonetic codes this long or longer also match codes one edit away
+        static constexpr size_t FUZZY_MIN_CODE = 4;
+
+        // A heard word only stands for a term's word if their lengths are about the same, so "made"
+        // doesn't pass for "mayday" although they sound alike on paper
+        static bool similarLength(size_t heard, size_t term) {
+            size_t slack = 1 + term / 8;
+            return heard + slack >= term && heard <= term + slack;
+        }
+
+        struct Term {
+            std::string text;
+            bool boost;
+        };
+
+        // One way a term can be heard: its words, or its words run together ("may day", "mayday")
+        struct Variant {
+            int term;
+            std::vector<std::string> words;
+        };
+
+        struct Node {
+            std::unordered_map<int, int> next;
+            int fail = 0;
+            std::vector<int> out;   // Variants ending here, including through fail links
+        };
+
+        // Immutable once built, shared by concurrent matches
+        struct Index {
+            std::vector<Term> terms;
+            std::vector<Variant> variants;
+            std::vector<Node> nodes = std::vector<Node>(1);
+            std::unordered_map<std::string, int> symbols;   // Phonetic code -> symbol
+            std::unordered_map<std::string, int> deletions; // Code with one letter removed -> symbol
+            std::vector<std::vector<size_t>> lengths;       // Symbol -> lengths of the words it was made from
+
+            void addTerm(const std::string& text, bool boost) {
+                std::vector<std::string> w = words(text);
+                if (w.empty()) { return; }
+                int id = (int)terms.size();
+                terms.push_back(Term{ text, boost });
+                addVariant(id, w);
+
+                bool spoken = std::none_of(w.begin(), w.end(), [](const std::string& s) { return isdigit((unsigned char)s[0]); });
+                if (w.size() > 1 && w.size() <= 3 && spoken) {
+                    std::string joined;
+                    for (const auto& s : w) { joined += s; }
+                    addVariant(id, { joined });
+                }
+            }
+
+            void addVariant(int term, const std::vector<std::string>& w) {
+                int v = (int)variants.size();
+                variants.push_back(Variant{ term, w });
+                int node = 0;
+                for (const auto& word : w) {
+                    int sym = intern(phonetic(word));
+                    if (std::find(lengths[sym].begin(), lengths[sym].end(), word.size()) == lengths[sym].end()) { lengths[sym].push_back(word.size()); }
+                    auto it = nodes[node].next.find(sym);
+                    if (it != nodes[node].next.end()) {
+                        node = it->second;
+                        continue;
+                    }
+                    nodes[node].next[sym] = (int)nodes.size();
+                    node = (int)nodes.size();
+                    nodes.push_back(Node());
+                }
+                nodes[node].out.push_back(v);
+            }
+
+            int intern(const std::string& code) {
+                auto it = symbols.find(code);
+                if (it != symbols.end()) { return it->second; }
+                int sym = (int)symbols.size();
+                symbols[code] = sym;
+                lengths.push_back({});
+                if (code.size() >= FUZZY_MIN_CODE) {
+                    for (size_t i = 0; i < code.size(); i++) {
+                        deletions.emplace(code.substr(0, i) + code.substr(i + 1), sym);
+                    }
+                }
+                return sym;
+            }
+
+            // Fail links breadth first, outputs are merged along them
+            void build() {
+                std::vector<int> queue;
+                for (auto& [sym, child] : nodes[0].next) {
+                    nodes[child].fail = 0;
+                    queue.push_back(child);
+                }
+                for (size_t q = 0; q < queue.size(); q++) {
+                    int node = queue[q];
+                    for (auto& [sym, child] : nodes[node].next) {
+                        nodes[child].fail = step(nodes[node].fail, sym);
+                        const std::vector<int>& inherited = nodes[nodes[child].fail].out;
+                        nodes[child].out.insert(nodes[child].out.end(), inherited.begin(), inherited.end());
+                        queue.push_back(child);
+                    }
+                }
+            }
+
+            int step(int node, int sym) const {
+                if (sym < 0) { return 0; }
+                while (true) {
+                    auto it = nodes[node].next.find(sym);
+                    if (it != nodes[node].next.end()) { return it->second; }
+                    if (node == 0) { return 0; }
+                    node = nodes[node].fail;
+                }
+            }
+
+            // The symbol a heard word stands for, -1 if it's in no term. Codes one edit apart match
+            // (symmetric deletion: both sides with one letter removed).
+            int symbol(const std::string& word) const {
+                int sym = lookup(phonetic(word));
+                if (sym < 0) { return -1; }
+                for (size_t len : lengths[sym]) {
+                    if (similarLength(word.size(), len)) { return sym; }
+                }
+                return -1;
+            }
+
+            int lookup(const std::string& code) const {
+                auto it = symbols.find(code);
+                if (it != symbols.end()) { return it->second; }
+                if (code.size() + 1 < FUZZY_MIN_CODE) { return -1; }
+                it = deletions.find(code);
+                if (it != deletions.end()) { return it->second; }
+                if (code.size() < FUZZY_MIN_CODE) { return -1; }
+                for (size_t i = 0; i < code.size(); i++) {
+                    std::string shorter = code.substr(0, i) + code.substr(i + 1);
+                    it = symbols.find(shorter);
+                    if (it != symbols.end() && shorter.size() >= FUZZY_MIN_CODE) { return it->second; }
+                    it = deletions.find(shorter);
+                    if (it != deletions.end()) { return it->second; }
+                }
+                return -1;
+            }
+        };
+
+        std::mutex mtx;
+        std::string path;
+        time_t mtime = 0;
+        std::string text;
+        std::shared_ptr<const Index> index;
+        uint64_t version = 0;
+    };
+}
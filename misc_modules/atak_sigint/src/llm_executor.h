@@ -0,0 +1,244 @@
+#pragma once
+#include <string>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+#include <config.h>
+#include "http_stream.h"
+#include "telemetry.h"
+
+namespace sigint {
+    // Executes LLM requests against the Ollama API on dedicated threads.
+    // Callers never block: a request is queued and its result is handed back through the completion
+    // handler, while generated tokens are streamed to the token handler as they arrive ("stream": true).
+    // Queued and running requests can be cancelled, a running request is aborted by closing its connection.
+    class LlmExecutor {
+    public:
+        typedef uint64_t JobId;
+        typedef std::function<void(const std::string& token)> TokenHandler;
+        typedef std::function<void(bool success, const std::string& text, const std::string& error)> CompletionHandler;
+
+        // Upper bounds for token counts
+        static constexpr double TOKEN_BOUNDS[] = { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192 };
+
+        struct Metrics {
+            telemetry::Histogram queueSeconds;      // Submitted -> sent
+            telemetry::Histogram firstTokenSeconds; // Sent -> first token
+            telemetry::Histogram requestSeconds;    // Sent -> complete
+            telemetry::Counter completed;
+            telemetry::Counter failed;
+            telemetry::Counter cancelled;
+            // Prompt tokens the server had to evaluate, i.e. not served from its prompt cache
+            telemetry::Histogram promptEvalTokens = telemetry::Histogram(TOKEN_BOUNDS, sizeof(TOKEN_BOUNDS) / sizeof(double));
+            telemetry::Counter evalTokens;          // Tokens generated
+        };
+
+        ~LlmExecutor() { stop(); }
+
+        // Requests are sent over the given connection pool, which must outlive the executor
+        void init(http::ConnectionPool* pool) {
+            this->pool = pool;
+        }
+
+        void start(int workerCount = 1) {
+            std::lock_guard<std::mutex> lck(mtx);
+            if (!workers.empty()) { return; }
+            stopWorkers = false;
+            for (int i = 0; i < workerCount; i++) {
+                workers.push_back(std::thread(&LlmExecutor::worker, this));
+            }
+        }
+
+        void stop() {
+            cancelAll();
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                stopWorkers = true;
+            }
+            cnd.notify_all();
+            for (auto& w : workers) {
+                if (w.joinable()) { w.join(); }
+            }
+            workers.clear();
+        }
+
+        // Queue a request. path is the API endpoint (/api/chat or /api/generate), streaming is forced on.
+        JobId submit(const std::string& path, json payload, TokenHandler onToken, CompletionHandler onComplete) {
+            payload["stream"] = true;
+            return submitBody(path, payload.dump(), onToken, onComplete);
+        }
+
+        // Queue a request whose body is already serialized, it must ask for "stream": true
+        JobId submitBody(const std::string& path, std::string body, TokenHandler onToken, CompletionHandler onComplete) {
+            auto job = std::make_shared<Job>();
+            job->path = path;
+            job->body = std::move(body);
+            job->onToken = onToken;
+            job->onComplete = onComplete;
+            job->submitted = std::chrono::steady_clock::now();
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                job->id = nextId++;
+                queue.push_back(job);
+            }
+            cnd.notify_one();
+            return job->id;
+        }
+
+        // Cancel a queued or running request. Its completion handler is called with an error.
+        void cancel(JobId id) {
+            std::shared_ptr<Job> dropped;
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                for (auto it = queue.begin(); it != queue.end(); it++) {
+                    if ((*it)->id == id) {
+                        dropped = *it;
+                        queue.erase(it);
+                        break;
+                    }
+                }
+                for (auto& job : running) {
+                    if (job->id == id) { job->cancel = true; }
+                }
+            }
+            if (dropped) { metrics.cancelled.add(); }
+            if (dropped && dropped->onComplete) { dropped->onComplete(false, "", "Request cancelled"); }
+        }
+
+        void cancelAll() {
+            std::deque<std::shared_ptr<Job>> dropped;
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                dropped.swap(queue);
+                for (auto& job : running) { job->cancel = true; }
+            }
+            metrics.cancelled.add(dropped.size());
+            for (auto& job : dropped) {
+                if (job->onComplete) { job->onComplete(false, "", "Request cancelled"); }
+            }
+        }
+
+        int queued() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return (int)queue.size();
+        }
+
+        int inFlight() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return (int)running.size();
+        }
+
+        Metrics metrics;
+
+    private:
+        struct Job {
+            JobId id;
+            std::string path;
+            std::string body;
+            TokenHandler onToken;
+            CompletionHandler onComplete;
+            std::chrono::steady_clock::time_point submitted;
+            std::atomic<bool> cancel = false;
+        };
+
+        void worker() {
+            while (true) {
+                std::shared_ptr<Job> job;
+                {
+                    std::unique_lock<std::mutex> lck(mtx);
+                    cnd.wait(lck, [&]() { return stopWorkers || !queue.empty(); });
+                    if (stopWorkers) { return; }
+                    job = queue.front();
+                    queue.pop_front();
+                    running.push_back(job);
+                }
+
+                execute(job);
+
+                {
+                    std::lock_guard<std::mutex> lck(mtx);
+                    running.erase(std::find(running.begin(), running.end(), job));
+                }
+            }
+        }
+
+        void execute(const std::shared_ptr<Job>& job) {
+            std::string text;
+            std::string error;
+            std::string pending;
+            bool done = false;
+            bool gotToken = false;
+            auto sent = std::chrono::steady_clock::now();
+            metrics.queueSeconds.observe(std::chrono::duration<double>(sent - job->submitted).count());
+            try {
+                // Ollama streams one JSON object per line
+                int status = pool->request("POST", job->path, job->body, [&](const char* data, size_t len) {
+                    pending.append(data, len);
+                    size_t nl;
+                    while ((nl = pending.find('\n')) != std::string::npos) {
+                        std::string line = pending.substr(0, nl);
+                        pending.erase(0, nl + 1);
+                        if (line.empty()) { continue; }
+                        json obj = json::parse(line);
+                        if (obj.contains("error")) {
+                            throw std::runtime_error(obj["error"].get<std::string>());
+                        }
+                        std::string token;
+                        if (obj.contains("message") && obj["message"].contains("content")) {
+                            token = obj["message"]["content"].get<std::string>();
+                        } else if (obj.contains("response")) {
+                            token = obj["response"].get<std::string>();
+                        }
+                        if (!token.empty()) {
+                            if (!gotToken) {
+                                metrics.firstTokenSeconds.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - sent).count());
+                                gotToken = true;
+                            }
+                            text += token;
+                            if (job->onToken) { job->onToken(token); }
+                        }
+                        if (obj.value("done", false)) {
+                            done = true;
+                            // The last object carries the token counts
+                            if (obj.contains("prompt_eval_count")) { metrics.promptEvalTokens.observe(obj["prompt_eval_count"].get<double>()); }
+                            if (obj.contains("eval_count")) { metrics.evalTokens.add(obj["eval_count"].get<uint64_t>()); }
+                        }
+                    }
+                }, &job->cancel);
+                if (status != 200 && error.empty()) {
+                    error = "HTTP status " + std::to_string(status);
+                }
+                if (!done && error.empty()) {
+                    error = "Stream ended before the response was complete";
+                }
+            } catch (const std::exception& e) {
+                error = e.what();
+            }
+            if (error.empty()) {
+                metrics.completed.add();
+                metrics.requestSeconds.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - sent).count());
+            } else if (job->cancel) {
+                metrics.cancelled.add();
+            } else {
+                metrics.failed.add();
+            }
+            if (job->onComplete) { job->onComplete(error.empty(), text, error); }
+        }
+
+        http::ConnectionPool* pool = nullptr;
+
+        std::mutex mtx;
+        std::condition_variable cnd;
+        std::deque<std::shared_ptr<Job>> queue;
+        std::vector<std::shared_ptr<Job>> running;
+        std::vector<std::thread> workers;
+        JobId nextId = 1;
+        bool stopWorkers = false;
+    };
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+
+namespace sigint {
+    // Capped log store for the UI.
+    // Any thread can push lines without taking a lock (intrusive MPSC queue, one atomic exchange per
+    // line). The UI thread drains the queue once per frame into a ring of the most recent lines, which
+    // it then reads without locking at all. Every line gets a stable, increasing ID so consumers can tell
+    // which lines they've already seen even after older ones were evicted. Multi-line messages are split
+    // so every entry is exactly one line high, as required for clipped rendering.
+    // An optional sink sees every message as it's pushed, on the pushing thread, e.g. to write it to disk.
+    class LogStore {
+    public:
+        typedef std::function<void(const std::string& text)> Sink;
+
+        struct Entry {
+            uint64_t id;
+            std::string text;
+        };
+
+        LogStore(size_t capacity) {
+            this->capacity = capacity;
+            lines.resize(capacity);
+            head = new Node();
+            tail = head.load();
+        }
+
+        ~LogStore() {
+            while (tail) {
+                Node* next = tail->next.load();
+                delete tail;
+                tail = next;
+            }
+        }
+
+        // Must be set before anything is pushed, and must not block
+        void setSink(Sink sink) {
+            this->sink = sink;
+        }
+
+        // Queue a message, callable from any thread. If the UI hasn't drained the queue for so long
+        // that a whole store worth of lines is waiting, the message is dropped and counted instead.
+        void push(std::string text) {
+            if (sink) { sink(text); }
+            if (pending.fetch_add(1, std::memory_order_relaxed) >= capacity) {
+                pending.fetch_sub(1, std::memory_order_relaxed);
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            Node* node = new Node();
+            node->text = std::move(text);
+            Node* prev = head.exchange(node, std::memory_order_acq_rel);
+            prev->next.store(node, std::memory_order_release);
+        }
+
+        // Move queued messages into the store. UI thread only. Returns the number of new lines.
+        size_t update() {
+            size_t added = 0;
+            while (true) {
+                Node* next = tail->next.load(std::memory_order_acquire);
+                if (!next) { break; }
+                delete tail;
+                tail = next;
+                pending.fetch_sub(1, std::memory_order_relaxed);
+
+                // One entry per line
+                const std::string& text = next->text;
+                size_t start = 0;
+                while (true) {
+                    size_t end = text.find('\n', start);
+                    append(text.substr(start, end - start));
+                    added++;
+                    if (end == std::string::npos) { break; }
+                    start = end + 1;
+                }
+                next->text.clear();
+            }
+
+            uint64_t lost = dropped.exchange(0, std::memory_order_relaxed);
+            if (lost) {
+                append("[LOG] " + std::to_string(lost) + " messages dropped.");
+                added++;
+            }
+            return added;
+        }
+
+        // Access to the stored lines, oldest first. UI thread only.
+        size_t size() { return count; }
+        const Entry& at(size_t index) { return lines[(first + index) % capacity]; }
+
+        // ID the next line will get
+        uint64_t getNextId() { return nextId; }
+
+    private:
+        struct Node {
+            std::atomic<Node*> next = nullptr;
+            std::string text;
+        };
+
+        void append(std::string text) {
+            size_t index = (first + count) % capacity;
+            if (count == capacity) {
+                first = (first + 1) % capacity;
+            } else {
+                count++;
+            }
+            lines[index].id = nextId++;
+            lines[index].text = std::move(text);
+        }
+
+        size_t capacity;
+        Sink sink;
+
+        // Producer side
+        std::atomic<Node*> head;
+        std::atomic<size_t> pending = 0;
+        std::atomic<uint64_t> dropped = 0;
+
+        // Consumer side
+        Node* tail;
+        std::vector<Entry> lines;
+        size_t first = 0;
+        size_t count = 0;
+        uint64_t nextId = 0;
+    };
+}
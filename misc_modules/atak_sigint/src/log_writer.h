@@ -0,0 +1,229 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <config.h>
+
+namespace sigint {
+    // Writes log lines to disk on its own thread.
+    // Callers only append to a bounded in-memory queue (lines are dropped and counted when it's full),
+    // the writer thread takes the whole queue at once, formats it into one buffer and writes it with a
+    // single write() call. The file is fsync'd periodically rather than per line, and rotated to
+    // <path>.1, <path>.2, ... when it gets too big or too old.
+    class LogWriter {
+    public:
+        struct Config {
+            std::string path = "/tmp/atak_sigint.log";
+            bool jsonl = false;             // One JSON record per line instead of plain text
+            size_t maxBytes = 16 << 20;     // Rotate when the file gets this big, 0 to disable
+            int maxAgeSec = 24 * 3600;      // Rotate when the file gets this old, 0 to disable
+            int keepFiles = 5;              // Rotated files kept
+            int fsyncIntervalMs = 2000;
+            size_t queueCapacity = 8192;
+        };
+
+        struct Record {
+            std::chrono::system_clock::time_point time;
+            std::string line;
+        };
+
+        ~LogWriter() { stop(); }
+
+        void start(const Config& config) {
+            stop();
+            cfg = config;
+            useJsonl = cfg.jsonl;
+            stopWriter = false;
+            workerThread = std::thread(&LogWriter::worker, this);
+        }
+
+        // Flushes everything still queued before returning
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                if (!workerThread.joinable()) { return; }
+                stopWriter = true;
+            }
+            cnd.notify_all();
+            workerThread.join();
+        }
+
+        void setJsonl(bool jsonl) { useJsonl = jsonl; }
+
+        // Queue a log line, never blocks on disk
+        void write(const std::string& line) {
+            Record rec{ std::chrono::system_clock::now(), line };
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                if (!workerThread.joinable()) { return; }
+                if (queue.size() >= cfg.queueCapacity) {
+                    dropped++;
+                    return;
+                }
+                queue.push_back(std::move(rec));
+            }
+            cnd.notify_one();
+        }
+
+        uint64_t getDropped() { return dropped; }
+        uint64_t getWritten() { return written; }
+
+    private:
+        // Split the "[SOURCE][channel] text" prefix the module's log lines use
+        static void parseLine(const std::string& line, std::string& source, std::string& channel, std::string& text) {
+            size_t pos = 0;
+            std::string tags[2];
+            for (int i = 0; i < 2 && pos < line.size() && line[pos] == '['; i++) {
+                size_t end = line.find(']', pos);
+                if (end == std::string::npos) { break; }
+                tags[i] = line.substr(pos + 1, end - pos - 1);
+                pos = end + 1;
+            }
+            if (tags[0].empty() && !line.compare(0, 9, "OPERATOR:")) {
+                tags[0] = "OPERATOR";
+                pos = 9;
+            }
+            while (pos < line.size() && line[pos] == ' ') { pos++; }
+            source = tags[0];
+            channel = tags[1];
+            text = (pos == 0) ? line : line.substr(pos);
+        }
+
+        void worker() {
+            std::vector<Record> batch;
+            std::string buffer;
+            auto lastSync = std::chrono::steady_clock::now();
+            bool dirty = false;
+
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lck(mtx);
+                    cnd.wait_for(lck, std::chrono::milliseconds(cfg.fsyncIntervalMs), [this]() { return stopWriter || !queue.empty(); });
+                    batch.swap(queue);
+                    if (batch.empty() && stopWriter) { break; }
+                }
+
+                if (!batch.empty()) {
+                    if (fd < 0 || needsRotation()) { reopen(); }
+                    buffer.clear();
+                    for (const auto& rec : batch) { format(rec, buffer); }
+                    uint64_t lost = dropped.exchange(0);
+                    if (lost) {
+                        format(Record{ std::chrono::system_clock::now(), "[LOG] " + std::to_string(lost) + " lines dropped, writer queue full." }, buffer);
+                    }
+                    writeAll(buffer);
+                    written += batch.size();
+                    batch.clear();
+                    dirty = true;
+                }
+
+                auto now = std::chrono::steady_clock::now();
+                if (dirty && fd >= 0 && now - lastSync >= std::chrono::milliseconds(cfg.fsyncIntervalMs)) {
+                    fsync(fd);
+                    lastSync = now;
+                    dirty = false;
+                }
+            }
+
+            if (fd >= 0) {
+                fsync(fd);
+                ::close(fd);
+                fd = -1;
+            }
+        }
+
+        void format(const Record& rec, std::string& out) {
+            if (!useJsonl) {
+                out += rec.line;
+                out += '\n';
+                return;
+            }
+
+            // ISO 8601 UTC timestamp with milliseconds
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(rec.time.time_since_epoch()).count();
+            time_t sec = (time_t)(ms / 1000);
+            tm utc;
+            gmtime_r(&sec, &utc);
+            char ts[32];
+            snprintf(ts, sizeof(ts), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday, utc.tm_hour, utc.tm_min, utc.tm_sec, (int)(ms % 1000));
+
+            std::string source, channel, text;
+            parseLine(rec.line, source, channel, text);
+            nlohmann::ordered_json j;
+            j["timestamp"] = ts;
+            j["source"] = source;
+            j["channel"] = channel;
+            j["text"] = text;
+            out += j.dump(-1, ' ', false, json::error_handler_t::replace);
+            out += '\n';
+        }
+
+        void writeAll(const std::string& data) {
+            if (fd < 0) { return; }
+            size_t done = 0;
+            while (done < data.size()) {
+                ssize_t ret = ::write(fd, data.data() + done, data.size() - done);
+                if (ret < 0) {
+                    if (errno == EINTR) { continue; }
+                    return;
+                }
+                done += ret;
+                fileSize += ret;
+            }
+        }
+
+        bool needsRotation() {
+            if (cfg.maxBytes && fileSize >= cfg.maxBytes) { return true; }
+            if (cfg.maxAgeSec && std::chrono::steady_clock::now() - openedAt >= std::chrono::seconds(cfg.maxAgeSec)) { return true; }
+            return false;
+        }
+
+        void reopen() {
+            if (fd >= 0) {
+                fsync(fd);
+                ::close(fd);
+                fd = -1;
+
+                // Shift <path>.N to <path>.N+1, the oldest one falls off
+                for (int i = cfg.keepFiles - 1; i >= 1; i--) {
+                    rename((cfg.path + "." + std::to_string(i)).c_str(), (cfg.path + "." + std::to_string(i + 1)).c_str());
+                }
+                if (cfg.keepFiles > 0) {
+                    rename(cfg.path.c_str(), (cfg.path + ".1").c_str());
+                } else {
+                    unlink(cfg.path.c_str());
+                }
+            }
+
+            fd = open(cfg.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            struct stat st;
+            fileSize = (fd >= 0 && !fstat(fd, &st)) ? st.st_size : 0;
+            openedAt = std::chrono::steady_clock::now();
+        }
+
+        Config cfg;
+        std::atomic<bool> useJsonl = false;
+
+        std::mutex mtx;
+        std::condition_variable cnd;
+        std::vector<Record> queue;
+        bool stopWriter = false;
+        std::thread workerThread;
+        std::atomic<uint64_t> dropped = 0;
+        std::atomic<uint64_t> written = 0;
+
+        int fd = -1;
+        size_t fileSize = 0;
+        std::chrono::steady_clock::time_point openedAt;
+    };
+}
@@ -6,29 +6,28 @@
 #include <atomic>
 #include <thread>
 #include <mutex>
-#include <fstream>
-#include <unistd.h> // For chdir
-#include <signal.h> // For kill
+#include <memory>
+#include <map>
 #include <signal_path/signal_path.h>
 #include <gui/widgets/waterfall.h>
-#include <dsp/sink/handler_sink.h>
-#include <dsp/routing/splitter.h>
-#include <dsp/multirate/rational_resampler.h>
-#include <dsp/convert/stereo_to_mono.h>
-#include <utils/proto/http.h>
 #include <config.h>
-#include "whisper.h"
 #include <core.h>
-#include <sys/wait.h> // For waitpid
-#include <fcntl.h>    // For open
-#include <limits.h>   // For PATH_MAX
-#include <stdlib.h>   // For realpath
+#include "pipeline.h"
 
 #define STRINGIFY(x) #x
 #define TOSTRING(x) STRINGIFY(x)
 
-// Whisper sample rate is always 16000 Hz
-#define WHISPER_SAMPLE_RATE 16000
+// "When Behind" choices, in sigint::ShedPolicy order
+static const char* SHED_POLICY_LABELS = "Drop oldest\0Drop lowest priority\0Use a smaller model\0";
+
+// Size of the watchlist editor, in bytes
+#define WATCHLIST_EDIT_CAPACITY (64 << 10)
+
+// Transcript search results shown at most
+#define TRANSCRIPT_SEARCH_LIMIT 1000
+
+// Search by meaning: hits listed for a query
+#define SEMANTIC_SEARCH_HITS 20
 
 SDRPP_MOD_INFO{
     /* Name:            */ "SIGINT AI",
@@ -38,94 +37,29 @@ SDRPP_MOD_INFO{
     /* Max instances    */ 1
 };
 
+ConfigManager config;
+
+// The module's menu, everything else is in the pipeline. In SDR++'s server mode there is no menu, the
+// pipeline runs headless and is driven over its control socket.
 class AtakSigintModule : public ModuleManager::Instance {
 public:
-    AtakSigintModule(std::string name) {
+    AtakSigintModule(std::string name) : headless(core::args["server"].b()), pipeline(config, headless) {
         this->name = name;
-        gui::menu.registerEntry(name, menuHandler, this, NULL);
-        logMessages.push_back("ATAK SIGINT Module Initialized.");
-        
+        if (!headless) { gui::menu.registerEntry(name, menuHandler, this, NULL); }
+        strncpy(ollamaUrlInput, pipeline.ollamaUrl.c_str(), sizeof(ollamaUrlInput) - 1);
+
         // Set pop-out log window to be shown by default
         showLogWindow = true;
     }
 
     ~AtakSigintModule() {
-        stopWhisperWorker = true;
-        if (whisperWorker.joinable()) {
-            whisperWorker.join();
-        }
-        stopOllamaMonitor = true;
-        if (ollamaMonitorThread.joinable()) {
-            ollamaMonitorThread.join();
-        }
-
-        gui::menu.removeEntry(name);
-        if (audioStream) {
-            sigpath::sinkManager.unbindStream(selectedStreamName, audioStream);
-        }
-        splitter.stop();
-        splitter.unbindStream(&splitterOutput);
-        stereoToMono.stop();
-        resampler.stop();
-        if (whisperCtx) {
-            whisper_free(whisperCtx);
-        }
+        if (!headless) { gui::menu.removeEntry(name); }
+        // Search by meaning answers into the UI state, which goes before the pipeline
+        pipeline.embeddingStage.stop();
     }
 
     void postInit() {
-        // Determine path of model relative to the executable
-        std::string modelPath = "";
-        char exePath[PATH_MAX];
-        ssize_t len = readlink("/proc/self/exe", exePath, sizeof(exePath) - 1);
-        if (len != -1) {
-            exePath[len] = '\0';
-            std::string exeDir = std::string(exePath);
-            size_t lastSlash = exeDir.find_last_of("/");
-            if (lastSlash != std::string::npos) {
-                exeDir = exeDir.substr(0, lastSlash);
-            }
-            modelPath = exeDir + "/ggml-tiny.en.bin";
-        } else {
-            logMessages.push_back("[ERROR] Could not determine executable path. Cannot load Whisper model.");
-            return;
-        }
-        
-        logMessages.push_back("Loading Whisper model from: " + modelPath);
-        whisperCtx = whisper_init_from_file(modelPath.c_str());
-        if (whisperCtx) {
-            logMessages.push_back("Whisper model loaded successfully.");
-        } else {
-            logMessages.push_back("Error: Failed to load Whisper model.");
-            return;
-        }
-
-        logMessages.push_back("Attempting to bind to '" + selectedStreamName + "' audio stream...");
-        audioStream = sigpath::sinkManager.bindStream(selectedStreamName);
-        if (audioStream) {
-            // Initialize the splitter with the main audio stream
-            splitter.init(audioStream);
-            splitter.start();
-            // Bind our output stream to the splitter
-            splitter.bindStream(&splitterOutput);
-
-            // Convert stereo to mono float
-            stereoToMono.init(&splitterOutput);
-            stereoToMono.start();
-
-            // Initialize resampler (assuming 48kHz input from SDR++, 16kHz for Whisper)
-            resampler.init(&stereoToMono.out, 48000.0f, (float)WHISPER_SAMPLE_RATE);
-            resampler.start();
-
-            // Initialize our audio sink with the resampler's output stream
-            audioSink.init(&resampler.out, audioHandler, this);
-            audioSink.start();
-            logMessages.push_back("Successfully bound to audio stream via splitter, stereo-to-mono, and resampler.");
-        } else {
-            logMessages.push_back("Error: Could not bind to audio stream. Is Radio running?");
-        }
-
-        ollamaMonitorThread = std::thread(&AtakSigintModule::ollamaMonitorLoop, this);
-        whisperWorker = std::thread(&AtakSigintModule::whisperWorkerLoop, this);
+        pipeline.start();
     }
 
     void enable() { enabled = true; }
@@ -138,172 +72,476 @@ private:
         _this->draw();
     }
 
-    static void audioHandler(float* data, int count, void* ctx) {
-        AtakSigintModule* _this = (AtakSigintModule*)ctx;
-        if (!_this->voiceHuntActive) { return; }
-        std::lock_guard<std::mutex> lock(_this->audioBufferMutex);
-        for (int i = 0; i < count; i++) {
-            _this->audioBuffer.push_back(data[i]);
+    void drawWhisperModel() {
+        if (pipeline.remoteDecoding) {
+            drawDecodeWorkers();
+        } else {
+            drawWhisperModelSelect();
         }
-    }
 
-    void checkOllamaStatus() {
-        // Use lsof and grep for LISTEN state. This is the most reliable check.
-        // It ensures a process is actively listening on the port.
-        int result = system("lsof -i :11434 | grep LISTEN > /dev/null 2>&1");
+        // Backpressure: how much audio may wait for the decoders, and what gives when it's exceeded
+        ImGui::Text("Max Backlog"); ImGui::SameLine();
+        ImGui::PushItemWidth(-1);
+        int backlog = pipeline.decodeBacklogSec;
+        if (ImGui::SliderInt("##decode_backlog", &backlog, DECODE_BACKLOG_MIN_SEC, DECODE_BACKLOG_MAX_SEC, "%d s")) {
+            pipeline.setDecodeBacklog(backlog, pipeline.shedPolicy);
+        }
+        ImGui::PopItemWidth();
+        ImGui::Text("When Behind"); ImGui::SameLine();
+        ImGui::PushItemWidth(-1);
+        int policy = pipeline.shedPolicy;
+        if (ImGui::Combo("##shed_policy", &policy, SHED_POLICY_LABELS)) {
+            pipeline.setDecodeBacklog(pipeline.decodeBacklogSec, (sigint::ShedPolicy)policy);
+        }
+        ImGui::PopItemWidth();
 
-        bool is_running = (WIFEXITED(result) && WEXITSTATUS(result) == 0);
+        switch (pipeline.remoteDecoding ? sigint::DecoderPool::MODEL_READY : pipeline.decoderPool.getModelState()) {
+        case sigint::DecoderPool::MODEL_LOADING:
+            if (pipeline.decoderPool.isLoaded()) {
+                ImGui::Text("Loading model, decoding continues with the current one...");
+            } else {
+                ImGui::Text("Loading model, %.0f s of audio waiting...", (double)pipeline.pendingDecodeSamples / WHISPER_SAMPLE_RATE);
+            }
+            break;
+        case sigint::DecoderPool::MODEL_FAILED:
+            ImGui::Text("No Whisper model loaded, select one above.");
+            break;
+        default:
+            break;
+        }
+    }
 
-        if (is_running && !ollamaRunning) {
-            ollamaRunning = true;
-            std::lock_guard<std::mutex> lock(logMutex);
-            logMessages.push_back("[OLLAMA Status Check] Ollama detected as running.");
-        } else if (!is_running && ollamaRunning) {
-            ollamaRunning = false;
-            std::lock_guard<std::mutex> lock(logMutex);
-            logMessages.push_back("[OLLAMA Status Check] Ollama not detected as running.");
+    void drawWhisperModelSelect() {
+        ImGui::Text("Whisper Model"); ImGui::SameLine();
+        ImGui::PushItemWidth(-1);
+        std::string chosen;
+        {
+            std::lock_guard<std::mutex> lck(pipeline.whisperModelMtx);
+            if (ImGui::BeginCombo("##whisper_model_select", pipeline.whisperModel.c_str())) {
+                // Pick up models added since the list was last shown
+                if (ImGui::IsWindowAppearing()) { pipeline.scanWhisperModels(); }
+                for (const auto& model : pipeline.whisperModels) {
+                    bool selected = (model.name == pipeline.whisperModel);
+                    std::string label = model.name + " (" + std::to_string(model.sizeMb) + " MB)";
+                    if (ImGui::Selectable(label.c_str(), selected) && !selected) { chosen = model.name; }
+                    if (selected) { ImGui::SetItemDefaultFocus(); }
+                }
+                if (pipeline.whisperModels.empty()) { ImGui::TextUnformatted("No ggml-*.bin models found"); }
+                ImGui::EndCombo();
+            }
         }
+        ImGui::PopItemWidth();
+        if (!chosen.empty()) { pipeline.selectWhisperModel(chosen); }
     }
 
+    // Decode workers (decodeWorkers) in place of the local model, with the jobs each holds for us and for others
+    void drawDecodeWorkers() {
+        auto workers = pipeline.remoteDecoders.getWorkers();
+        if (!ImGui::BeginTable("##decode_workers", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) { return; }
+        ImGui::TableSetupColumn("Worker");
+        ImGui::TableSetupColumn("Model");
+        ImGui::TableSetupColumn("Load");
+        ImGui::TableSetupColumn("Done");
+        ImGui::TableSetupColumn("Status");
+        ImGui::TableHeadersRow();
+        for (const auto& w : workers) {
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::TextUnformatted(w.address.c_str());
+            ImGui::TableSetColumnIndex(1);
+            ImGui::TextUnformatted(w.model.c_str());
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%d+%d/%d", w.inFlight, w.foreign, w.slots);
+            ImGui::TableSetColumnIndex(3);
+            ImGui::Text("%llu", (unsigned long long)w.completed);
+            ImGui::TableSetColumnIndex(4);
+            if (w.ready) {
+                ImGui::Text("up, %.1f ms", w.rttMs);
+            } else {
+                ImGui::TextUnformatted(w.error.empty() ? "connecting" : w.error.c_str());
+            }
+        }
+        ImGui::EndTable();
+    }
 
+    void drawLlmQueueStatus() {
+        int queued = pipeline.llmExecutor.queued();
+        int running = pipeline.llmExecutor.inFlight();
+        int waiting = pipeline.analysisStage.queued();
+        if (!queued && !running && !waiting) { return; }
+        ImGui::Text("AI requests: %d running, %d queued, %d transcripts waiting", running, queued, waiting);
+        ImGui::SameLine();
+        if (ImGui::SmallButton("Cancel##llm_cancel")) {
+            pipeline.analysisStage.clear();
+            pipeline.llmExecutor.cancelAll();
+        }
+    }
 
-    void ollamaMonitorLoop() {
-        while (!stopOllamaMonitor) {
-            checkOllamaStatus();
-            if (ollamaRunning && !modelsLoaded) {
-                fetchOllamaModels();
+    void drawAnalysisSettings() {
+        ImGui::Text("Batch Window"); ImGui::SameLine();
+        ImGui::PushItemWidth(-1);
+        int windowMs = pipeline.llmBatchWindowMs;
+        if (ImGui::SliderInt("##llm_batch_window", &windowMs, 0, 10000, "%d ms")) {
+            pipeline.setBatchWindow(windowMs);
+        }
+        ImGui::PopItemWidth();
+        if (pipeline.embeddingEnabled) {
+            bool retrieval = pipeline.llmRetrieval;
+            if (ImGui::Checkbox("Recall past intercepts##llm_retrieval", &retrieval)) {
+                pipeline.setLlmRetrieval(retrieval);
             }
-            std::this_thread::sleep_for(std::chrono::seconds(1)); // Check every 1 second
         }
     }
 
-    void fetchOllamaModels() {
-        net::http::Client httpClient;
-        std::string ollamaResponse;
-        try {
-            ollamaResponse = httpClient.get("http://localhost:11434/api/tags");
-            std::lock_guard<std::mutex> lock(logMutex); // Lock for logging
-            logMessages.push_back("[OLLAMA] Raw API response: " + ollamaResponse); // Log raw response for debugging
-            
-            if (ollamaResponse.empty()) {
-                logMessages.push_back("[OLLAMA Error] Empty response from Ollama API. Is the server running?");
-                modelsLoaded = false;
-                return;
+    void drawStats() {
+        if (!ImGui::CollapsingHeader("Pipeline Stats")) { return; }
+
+        std::vector<std::shared_ptr<sigint::AudioTap>> activeTaps;
+        {
+            std::lock_guard<std::mutex> lck(pipeline.tapsMtx);
+            activeTaps = pipeline.taps;
+        }
+        if (ImGui::BeginTable("##stats_taps", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Channel");
+            ImGui::TableSetupColumn("Input");
+            ImGui::TableSetupColumn("Captured");
+            ImGui::TableSetupColumn("Dropped");
+            ImGui::TableSetupColumn("Ring");
+            ImGui::TableSetupColumn("Handler p99");
+            ImGui::TableSetupColumn("Shed");
+            ImGui::TableHeadersRow();
+            for (auto& tap : activeTaps) {
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::TextUnformatted(tap->streamName.c_str());
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%.1f kHz", tap->getInputSampleRate() / 1000.0);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%.0f s", (double)tap->samplesIn.get() / WHISPER_SAMPLE_RATE);
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%llu", (unsigned long long)tap->samplesDropped.get());
+                ImGui::TableSetColumnIndex(4);
+                ImGui::Text("%.0f", tap->ringDepth.get());
+                ImGui::TableSetColumnIndex(5);
+                ImGui::Text("%.0f us", tap->handlerSeconds.quantile(0.99) * 1e6);
+                ImGui::TableSetColumnIndex(6);
+                ImGui::Text("%llu", (unsigned long long)tap->segmentsShed.get());
             }
+            ImGui::EndTable();
+        }
 
-            json responseJson = json::parse(ollamaResponse);
-            if (responseJson.contains("models") && responseJson["models"].is_array()) {
-                logMessages.push_back("[OLLAMA] Detected models:");
-                availableModels.clear(); // Clear previous models
-                for (const auto& model : responseJson["models"]) {
-                    if (model.contains("name") && model["name"].is_string()) {
-                        availableModels.push_back(model["name"].get<std::string>());
-                        logMessages.push_back("  - " + model["name"].get<std::string>());
-                    }
-                    // Check if the default model "llama3:8b" is available and select it
-                    if (model["name"].get<std::string>() == "llama3:8b" && selectedModelIndex == 0) {
-                        selectedModelIndex = availableModels.size() - 1; // Select this model if it's the default and not already set
-                    }
-                }
-                if (!availableModels.empty()) {
-                    modelsLoaded = true;
-                } else {
-                    logMessages.push_back("[OLLAMA] No models found.");
-                    modelsLoaded = false;
-                }
+        ImGui::Text("Whisper: %llu decodes, p50 %.0f ms, p99 %.0f ms, RTF %.2f", (unsigned long long)pipeline.whisperFinalSeconds.count(),
+                    pipeline.whisperFinalSeconds.quantile(0.5) * 1e3, pipeline.whisperFinalSeconds.quantile(0.99) * 1e3, pipeline.whisperRtf.get());
+        ImGui::Text("Backlog: %.1f s of audio, %.0f jobs, bound %d s (%s)", pipeline.decodeBacklogSeconds.get(), pipeline.decodeQueueJobs.get(), (int)pipeline.decodeBacklogSec,
+                    sigint::SHED_POLICY_NAMES[pipeline.shedPolicy]);
+        if (pipeline.decodesPreempted.get() || pipeline.decodesRestarted.get()) {
+            ImGui::Text("Interrupted: %llu preempted by a higher priority channel, %llu restarted on a new model", (unsigned long long)pipeline.decodesPreempted.get(),
+                        (unsigned long long)pipeline.decodesRestarted.get());
+        }
+        if (pipeline.remoteDecoding) {
+            auto& remote = pipeline.remoteDecoders.metrics;
+            ImGui::Text("Decode workers: %.0f ready, %.0f jobs out, round trip p50 %.0f ms, %llu retried, %llu failed, %llu workers lost", remote.workersReady.get(),
+                        remote.inFlight.get(), remote.roundTripSeconds.quantile(0.5) * 1e3, (unsigned long long)remote.retried.get(), (unsigned long long)remote.failed.get(),
+                        (unsigned long long)remote.workersLost.get());
+        } else {
+            ImGui::Text("Scheduler: %s, %d threads per decode, DSP using %.1f cores", sigint::DecodeScheduler::modeName(pipeline.decodeScheduler.getMode()),
+                        pipeline.decodeScheduler.getLastThreads(), pipeline.decodeScheduler.getDspCores());
+        }
+        ImGui::Text("Worker loop p99: %.1f ms", pipeline.workerLoopSeconds.quantile(0.99) * 1e3);
+        ImGui::Text("LLM: %.0f queued, %.0f running, first token p50 %.2f s, total p50 %.2f s", pipeline.llmQueueLength.get(), pipeline.llmInFlight.get(),
+                    pipeline.llmExecutor.metrics.firstTokenSeconds.quantile(0.5), pipeline.llmExecutor.metrics.requestSeconds.quantile(0.5));
+        ImGui::Text("LLM memory: %d turns, %llu compactions, prompt tokens evaluated p50 %.0f", pipeline.conversation.getTurnCount(),
+                    (unsigned long long)pipeline.memoryCompactions.get(), pipeline.llmExecutor.metrics.promptEvalTokens.quantile(0.5));
+        if (pipeline.embeddingEnabled) {
+            ImGui::Text("Semantic index: %zu transcripts, %d waiting, search p50 %.2f ms, %llu LLM requests with recalled intercepts", pipeline.vectorIndex.size(),
+                        pipeline.embeddingStage.queued(), pipeline.vectorIndex.metrics.searchSeconds.quantile(0.5) * 1e3, (unsigned long long)pipeline.llmRetrievals.get());
+            std::string embeddingError = pipeline.embeddingStage.getError();
+            if (embeddingError.empty()) { embeddingError = pipeline.vectorIndex.getError(); }
+            if (!embeddingError.empty()) { ImGui::Text("Embeddings: %s", embeddingError.c_str()); }
+        }
+        if (pipeline.audioArchive.metrics.rawBytes.get()) {
+            ImGui::Text("Audio archive: %llu transmissions, %.0f%% of float size, %llu dropped", (unsigned long long)pipeline.audioArchive.metrics.archived.get(),
+                        100.0 * pipeline.audioArchive.metrics.storedBytes.get() / pipeline.audioArchive.metrics.rawBytes.get(), (unsigned long long)pipeline.audioArchive.metrics.dropped.get());
+        }
+        ImGui::Text("Ollama HTTP: %llu requests, %llu failed, %llu connections", (unsigned long long)pipeline.ollamaPool.requestCount.get(),
+                    (unsigned long long)pipeline.ollamaPool.failureCount.get(), (unsigned long long)pipeline.ollamaPool.connectionsOpened.get());
+        if (pipeline.warmupSeconds.count() || pipeline.warmupFailures.get()) {
+            ImGui::Text("Warmups: %llu, p50 %.1f s, %llu failed", (unsigned long long)pipeline.warmupSeconds.count(), pipeline.warmupSeconds.quantile(0.5),
+                        (unsigned long long)pipeline.warmupFailures.get());
+        }
+    }
+
+    void drawWatchlist() {
+        if (!ImGui::CollapsingHeader("Watchlist")) { return; }
+
+        // Follow the file while there are no unsaved edits
+        uint64_t version = pipeline.keywordSpotter.getVersion();
+        if (watchlistEdit.empty() || (version != watchlistVersion && !watchlistEdited)) {
+            std::string text = pipeline.keywordSpotter.getText();
+            watchlistEdit.assign(WATCHLIST_EDIT_CAPACITY, 0);
+            memcpy(watchlistEdit.data(), text.data(), std::min<size_t>(text.size(), WATCHLIST_EDIT_CAPACITY - 1));
+            watchlistVersion = version;
+        }
+
+        ImGui::Text("%d terms, %llu alerts. One term per line, # comments, ! raises the channel's priority.", pipeline.keywordSpotter.getTermCount(),
+                    (unsigned long long)(pipeline.keywordMatches[0].get() + pipeline.keywordMatches[1].get()));
+        if (ImGui::InputTextMultiline("##watchlist", watchlistEdit.data(), watchlistEdit.size(), ImVec2(-1, ImGui::GetTextLineHeightWithSpacing() * 8))) {
+            watchlistEdited = true;
+        }
+        ImGui::BeginDisabled(!watchlistEdited);
+        if (ImGui::Button("Save##watchlist_save")) {
+            if (pipeline.keywordSpotter.save(watchlistEdit.data())) {
+                watchlistEdited = false;
+                pipeline.logStore.push("[WATCH] Watchlist saved, " + std::to_string(pipeline.keywordSpotter.getTermCount()) + " watch terms.");
             } else {
-                logMessages.push_back("[OLLAMA Error] API response did not contain 'models' array or was malformed.");
-                modelsLoaded = false;
+                pipeline.logStore.push("[WATCH] Could not write " + pipeline.keywordSpotter.getPath() + ".");
             }
-        } catch (const std::exception& e) {
-            std::lock_guard<std::mutex> lock(logMutex);
-            logMessages.push_back("[OLLAMA Error] Failed to fetch models: " + std::string(e.what()));
-            if (!ollamaResponse.empty()) {
-                logMessages.push_back("[OLLAMA Error] Response that caused error: " + ollamaResponse);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Revert##watchlist_revert")) {
+            watchlistEdited = false;
+            watchlistEdit.clear();
+        }
+        ImGui::EndDisabled();
+
+        int boost = pipeline.keywordBoost;
+        int boostSec = pipeline.keywordBoostSec;
+        ImGui::PushItemWidth(80);
+        bool changed = ImGui::InputInt("Priority boost##keyword_boost", &boost);
+        ImGui::SameLine();
+        changed |= ImGui::InputInt("for (s)##keyword_boost_sec", &boostSec, 30);
+        ImGui::PopItemWidth();
+        if (changed) { pipeline.setKeywordBoost(boost, boostSec); }
+    }
+
+    // "HH:MM" (today), "YYYY-MM-DD" or "YYYY-MM-DD HH:MM" in local time to Unix ms, fallback if empty or invalid.
+    // A date alone is the start of that day, or its last millisecond for an upper bound (endOfDay).
+    static int64_t parseSearchTime(const char* text, int64_t fallback, bool endOfDay = false) {
+        tm t = {};
+        int64_t extraMs = 0;
+        time_t now = time(NULL);
+        localtime_r(&now, &t);
+        t.tm_sec = 0;
+        const char* end = NULL;
+        if ((end = strptime(text, "%Y-%m-%d %H:%M", &t)) == NULL) {
+            tm day = t;
+            if ((end = strptime(text, "%Y-%m-%d", &day)) != NULL) {
+                t = day;
+                t.tm_hour = endOfDay ? 23 : 0;
+                t.tm_min = endOfDay ? 59 : 0;
+                t.tm_sec = endOfDay ? 59 : 0;
+                extraMs = endOfDay ? 999 : 0;
+            } else {
+                end = strptime(text, "%H:%M", &t);
             }
-            modelsLoaded = false;
         }
+        if (!end || *end) { return fallback; }
+        t.tm_isdst = -1;
+        return (int64_t)mktime(&t) * 1000 + extraMs;
     }
 
-    void whisperWorkerLoop() {
-        while (!stopWhisperWorker) {
-            std::vector<float> pcm32f;
-            {
-                std::lock_guard<std::mutex> lock(audioBufferMutex);
-                if (audioBuffer.size() > WHISPER_SAMPLE_RATE * 5) { // Process ~5 seconds of 16kHz audio
-                    pcm32f = audioBuffer;
-                    audioBuffer.clear();
+    void drawTranscriptSearch() {
+        if (!ImGui::CollapsingHeader("Transcript Search")) { return; }
+
+        ImGui::PushItemWidth(-1);
+        bool search = ImGui::InputText("##ts_text", transcriptSearchText, sizeof(transcriptSearchText), ImGuiInputTextFlags_EnterReturnsTrue);
+        ImGui::PopItemWidth();
+        ImGui::PushItemWidth(110);
+        search |= ImGui::InputDouble("MHz##ts_freq", &transcriptSearchMhz, 0.0, 0.0, "%.4f", ImGuiInputTextFlags_EnterReturnsTrue);
+        ImGui::SameLine();
+        search |= ImGui::InputDouble("kHz##ts_tol", &transcriptSearchToleranceKhz, 0.0, 0.0, "%.1f", ImGuiInputTextFlags_EnterReturnsTrue);
+        search |= ImGui::InputText("From##ts_from", transcriptSearchFrom, sizeof(transcriptSearchFrom), ImGuiInputTextFlags_EnterReturnsTrue);
+        ImGui::SameLine();
+        search |= ImGui::InputText("To##ts_to", transcriptSearchTo, sizeof(transcriptSearchTo), ImGuiInputTextFlags_EnterReturnsTrue);
+        ImGui::PopItemWidth();
+        search |= ImGui::Button("Search##ts_search");
+        ImGui::SameLine();
+        ImGui::Text("%zu transcripts stored%s", pipeline.transcriptStore.size(), pipeline.transcriptStore.isLoading() ? ", indexing..." : "");
+        if (pipeline.audioArchive.size()) {
+            ImGui::Text("Audio archive: %.1f h in %.0f MB", pipeline.audioArchive.getSeconds() / 3600.0, (double)pipeline.audioArchive.getBytes() / (1 << 20));
+        }
+
+        if (search) {
+            sigint::TranscriptStore::Query q;
+            q.text = transcriptSearchText;
+            q.frequency = transcriptSearchMhz * 1e6;
+            q.toleranceHz = std::max<double>(0.0, transcriptSearchToleranceKhz) * 1e3;
+            q.fromMs = parseSearchTime(transcriptSearchFrom, 0);
+            q.toMs = parseSearchTime(transcriptSearchTo, INT64_MAX, true);
+            q.limit = TRANSCRIPT_SEARCH_LIMIT;
+            auto start = std::chrono::steady_clock::now();
+            transcriptResults = pipeline.transcriptStore.query(q);
+            transcriptSearchMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            transcriptSearched = true;
+        }
+        if (!transcriptSearched) { return; }
+
+        ImGui::Text("%zu%s results in %.1f ms", transcriptResults.size(), (transcriptResults.size() >= TRANSCRIPT_SEARCH_LIMIT) ? "+" : "", transcriptSearchMs);
+        ImGui::BeginChild("TranscriptResults", ImVec2(0, ImGui::GetTextLineHeightWithSpacing() * 10), true, ImGuiWindowFlags_HorizontalScrollbar);
+        ImGuiListClipper clipper;
+        clipper.Begin((int)transcriptResults.size());
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                const auto& r = transcriptResults[i];
+                if (pipeline.audioArchive.size()) {
+                    ImGui::PushID(i);
+                    if (ImGui::SmallButton("Decode")) { pipeline.replayTranscript(r); }
+                    ImGui::PopID();
+                    ImGui::SameLine();
                 }
+                ImGui::Text("%s  %.4f MHz %s  %.0f dB  %.1f s  [%s] %s", sigint::Pipeline::formatLocalTime(r.timeMs).c_str(), r.frequency / 1e6, r.mode.c_str(), r.snrDb, r.durationSec,
+                            r.channel.c_str(), r.text.c_str());
             }
+        }
+        clipper.End();
+        ImGui::EndChild();
+    }
 
-            if (!pcm32f.empty()) {
-                if (!whisperCtx) { continue; }
-                whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
-                params.print_progress = false;
-                params.print_special = false;
-                params.print_timestamps = false;
-                params.print_realtime = false;
-                params.translate = false;
-                params.language = "en";
-                params.n_threads = 4;
-
-                if (whisper_full(whisperCtx, params, pcm32f.data(), pcm32f.size()) == 0) {
-                    int n_segments = whisper_full_n_segments(whisperCtx);
-                    std::string transcript = "";
-                    for (int i = 0; i < n_segments; ++i) {
-                        transcript += whisper_full_get_segment_text(whisperCtx, i);
-                    }
+    void drawScanner() {
+        if (!ImGui::CollapsingHeader("Scanner")) { return; }
 
-                    if (transcript.length() > 1) {
-                        std::lock_guard<std::mutex> lock(logMutex);
-                        logMessages.push_back("[WHISPER] " + transcript);
+        bool scanning = pipeline.scanner.isRunning();
+        if (ImGui::Checkbox("Scan", &scanning)) {
+            if (scanning) { pipeline.scanner.start(); } else { pipeline.scanner.stop(); }
+        }
+        if (pipeline.scanner.isRunning()) {
+            ImGui::SameLine();
+            if (pipeline.scanner.getState() == sigint::Scanner::STATE_RECEIVING) {
+                ImGui::Text("Receiving %.4f MHz", pipeline.scanner.getCurrentFrequency() / 1e6);
+            } else {
+                ImGui::Text("Scanning (floor %.1f dB)", pipeline.scanner.getNoiseFloor());
+            }
+        }
 
-                        // Ollama Integration
-                        if (atakAiActive && ollamaRunning && modelsLoaded && !availableModels.empty()) {
-                            // Lazy initialize Ollama messages with a system prompt for context
-                            if (!ollamaInitialized) {
-                                ollamaMessages.push_back(json::parse(R"({"role": "system", "content": "You are a U.S. Navy S.E.A.L. on a covert SIGINT operation. Your callsign is RADAR. Be brief and professional. Report only significant, actionable intelligence. Otherwise, learn from the OPERATOR's instructions. When responding to the OPERATOR, be concise. End all transmissions with OVER."})"));
-                                ollamaInitialized = true;
-                            }
+        sigint::Scanner::Config scanConfig = pipeline.scanner.getConfig();
+        bool changed = false;
+        ImGui::PushItemWidth(-1);
+        changed |= ImGui::SliderFloat("##scan_threshold", &scanConfig.thresholdDb, 3.0f, 40.0f, "Threshold %.0f dB");
+        changed |= ImGui::SliderFloat("##scan_dwell", &scanConfig.dwellMs, 50.0f, 2000.0f, "Dwell %.0f ms");
+        changed |= ImGui::SliderFloat("##scan_hold", &scanConfig.holdMs, 0.0f, 10000.0f, "Hold %.0f ms");
+        ImGui::PopItemWidth();
+        if (changed) { pipeline.scanner.setConfig(scanConfig); }
+
+        // Scan list with per-channel revisit latency
+        std::vector<sigint::Scanner::Entry> entries = pipeline.scanner.getEntries();
+        int removeIndex = -1;
+        if (!entries.empty() && ImGui::BeginTable("##scan_list", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("MHz");
+            ImGui::TableSetupColumn("Prio");
+            ImGui::TableSetupColumn("Level");
+            ImGui::TableSetupColumn("Revisit avg/max");
+            ImGui::TableSetupColumn("Hits");
+            ImGui::TableSetupColumn("");
+            ImGui::TableHeadersRow();
+            for (int i = 0; i < (int)entries.size(); i++) {
+                const auto& e = entries[i];
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%.4f", e.frequency / 1e6);
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%d", e.priority);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%s%.1f", e.active ? "* " : "", e.levelDb);
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%.0f / %.0f ms", e.revisitAvgMs, e.revisitMaxMs);
+                ImGui::TableSetColumnIndex(4);
+                ImGui::Text("%llu", (unsigned long long)e.hits);
+                ImGui::TableSetColumnIndex(5);
+                if (ImGui::SmallButton(("X##scan_remove_" + std::to_string(i)).c_str())) { removeIndex = i; }
+            }
+            ImGui::EndTable();
+        }
+        if (removeIndex >= 0) { pipeline.scanner.removeEntry(removeIndex); }
+
+        ImGui::PushItemWidth(120);
+        ImGui::InputDouble("MHz##scan_add_freq", &scanAddFrequencyMhz, 0.0, 0.0, "%.4f");
+        ImGui::SameLine();
+        ImGui::InputInt("Prio##scan_add_prio", &scanAddPriority);
+        ImGui::PopItemWidth();
+        ImGui::SameLine();
+        if (ImGui::Button("Add##scan_add")) {
+            pipeline.scanner.addEntry(scanAddFrequencyMhz * 1e6, scanAddPriority);
+        }
+        if (ImGui::Button("Reset stats##scan_reset")) { pipeline.scanner.resetStats(); }
+        ImGui::SameLine();
+        ImGui::Text("%d active carriers in view", (int)pipeline.scanner.getCarriers().size());
+    }
 
-                            // Add current transcription to Ollama messages
-                            json userMessage;
-                            userMessage["role"] = "user";
-                            userMessage["content"] = "Intercepted Transmission (HEARD): \"" + transcript + "\"";
-                            ollamaMessages.push_back(userMessage);
+    // Search by meaning above the log. The query is embedded on the embedding stage, which also runs
+    // the index search and hands back the hits.
+    void drawSemanticSearch() {
+        if (!pipeline.embeddingEnabled) { return; }
+        ImGui::PushItemWidth(-150);
+        bool search = ImGui::InputText("##semantic_query", semanticQuery, sizeof(semanticQuery), ImGuiInputTextFlags_EnterReturnsTrue);
+        ImGui::PopItemWidth();
+        ImGui::SameLine();
+        search |= ImGui::Button("Search by meaning", ImVec2(140, 0));
+
+        std::lock_guard<std::mutex> lck(semanticMtx);
+        if (search && semanticQuery[0] && !semanticSearching) {
+            semanticSearching = true;
+            auto submitted = std::chrono::steady_clock::now();
+            pipeline.embeddingStage.query(semanticQuery, [this, submitted](bool success, const std::vector<float>& vector) {
+                auto embedded = std::chrono::steady_clock::now();
+                std::vector<sigint::VectorIndex::Hit> hits;
+                if (success) { hits = pipeline.vectorIndex.search(vector, SEMANTIC_SEARCH_HITS); }
+                auto searched = std::chrono::steady_clock::now();
+                std::lock_guard<std::mutex> lck(semanticMtx);
+                semanticHits = std::move(hits);
+                semanticError = success ? "" : pipeline.embeddingStage.getError();
+                semanticEmbedMs = std::chrono::duration<double, std::milli>(embedded - submitted).count();
+                semanticSearchMs = std::chrono::duration<double, std::milli>(searched - embedded).count();
+                semanticSearching = false;
+                semanticShown = true;
+            });
+        }
+        if (semanticSearching) {
+            ImGui::Text("Searching...");
+            return;
+        }
+        if (!semanticShown) { return; }
 
-                            // Limit history length
-                            while (ollamaMessages.size() > MAX_HISTORY_LENGTH) {
-                                ollamaMessages.erase(ollamaMessages.begin() + 1); // Keep system prompt, remove oldest user/assistant
-                            }
+        if (!semanticError.empty()) {
+            ImGui::Text("Search failed: %s", semanticError.c_str());
+        } else {
+            ImGui::Text("%zu hits in %.1f ms (embedding the query took %.0f ms)", semanticHits.size(), semanticSearchMs, semanticEmbedMs);
+        }
+        ImGui::SameLine();
+        if (ImGui::SmallButton("Close##semantic_close")) {
+            semanticShown = false;
+            semanticHits.clear();
+            return;
+        }
+        if (semanticHits.empty()) { return; }
+        ImGui::BeginChild("SemanticHits", ImVec2(0, ImGui::GetTextLineHeightWithSpacing() * 8), true, ImGuiWindowFlags_HorizontalScrollbar);
+        for (const auto& hit : semanticHits) {
+            ImGui::Text("%.2f  %s  %.4f MHz  [%s] %s", hit.score, sigint::Pipeline::formatLocalTime(hit.doc.timeMs).c_str(), hit.doc.frequency / 1e6,
+                        hit.doc.channel.c_str(), hit.doc.text.c_str());
+        }
+        ImGui::EndChild();
+    }
 
-                            json ollamaPayload;
-                            ollamaPayload["model"] = availableModels[selectedModelIndex]; // Use selected model
-                            ollamaPayload["messages"] = ollamaMessages; // Send the entire message history
-                            ollamaPayload["stream"] = false;
-                            ollamaPayload["options"]["temperature"] = 0.4;
-                            ollamaPayload["options"]["num_predict"] = 80;
-
-                            net::http::Client httpClient;
-                            try {
-                                std::string ollamaResponse = httpClient.post("http://localhost:11434/api/chat", ollamaPayload.dump()); // Use /api/chat for messages array
-                                json responseJson = json::parse(ollamaResponse);
-                                std::string aiText = responseJson["message"]["content"].get<std::string>();
-                                logMessages.push_back("[RADAR] " + aiText);
-
-                                // Add AI response to Ollama messages
-                                json assistantMessage;
-                                assistantMessage["role"] = "assistant";
-                                assistantMessage["content"] = aiText;
-                                ollamaMessages.push_back(assistantMessage);
-                            } catch (const std::exception& e) {
-                                logMessages.push_back("[AI Error] HTTP or JSON error: " + std::string(e.what()));
-                            }
-                        }
-                    }
+    // Only the visible part of the log is submitted to ImGui, followed by the lines still in progress
+    void drawLogLines() {
+        ImGuiListClipper clipper;
+        clipper.Begin((int)pipeline.logStore.size());
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                const std::string& text = pipeline.logStore.at(i).text;
+                if (!text.compare(0, 7, "[ALERT]")) {
+                    ImGui::TextColored(ImVec4(1.0f, 0.35f, 0.2f, 1.0f), "%s", text.c_str());
+                } else {
+                    ImGui::TextUnformatted(text.c_str());
                 }
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        }
+        clipper.End();
+        for (const auto& [streamName, partial] : livePartials) {
+            if (partial.empty()) { continue; }
+            ImGui::TextColored(ImVec4(0.6f, 0.6f, 0.6f, 1.0f), "[WHISPER ...][%s] %s", streamName.c_str(), partial.c_str());
+        }
+        for (const auto& [key, text] : liveLlmStreams) {
+            ImGui::TextColored(ImVec4(0.6f, 0.6f, 0.6f, 1.0f), "%s", text.c_str());
         }
     }
 
@@ -313,21 +551,15 @@ private:
             ImGui::GetIO().WantCaptureMouse = true;
         }
 
+        // Pick up new log lines, and take a copy of the lines still in progress so the lock
+        // isn't held while rendering
+        size_t newLines = pipeline.logStore.update();
         {
-            std::lock_guard<std::mutex> lock(logMutex);
-            if (lastLogSize != logMessages.size()) {
-                // Open the log file in append mode
-                std::ofstream logFile("/tmp/atak_sigint.log", std::ios_base::app);
-                if (logFile.is_open()) {
-                    // Write only the new messages
-                    for (size_t i = lastLogSize; i < logMessages.size(); ++i) {
-                        logFile << logMessages[i] << std::endl;
-                    }
-                }
-                lastLogSize = logMessages.size();
-                scrollToBottom = true;
-            }
+            std::lock_guard<std::mutex> lock(pipeline.logMutex);
+            livePartials = pipeline.partialTranscripts;
+            liveLlmStreams = pipeline.llmStreams;
         }
+        if (newLines) { scrollToBottom = true; }
 
         ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(4, 8));
 
@@ -335,30 +567,39 @@ private:
         if (ImGui::Button("Pop-out Log")) {
             showLogWindow = !showLogWindow;
         }
+        ImGui::SameLine();
+        bool jsonl = pipeline.logJsonl;
+        if (ImGui::Checkbox("JSONL log file", &jsonl)) { pipeline.setLogJsonl(jsonl); }
 
         ImGui::Separator();
 
         // Ollama Control
-        ImGui::Text("Ollama Server Status: %s", ollamaRunning ? "Running" : "Not Running");
-        if (isWarmingModel) {
-            ImGui::Text("%s", warmingStatusMessage.c_str());
+        ImGui::Text("Ollama URL"); ImGui::SameLine();
+        ImGui::PushItemWidth(-1);
+        if (ImGui::InputText("##ollama_url", ollamaUrlInput, sizeof(ollamaUrlInput), ImGuiInputTextFlags_EnterReturnsTrue)) {
+            pipeline.setOllamaUrl(ollamaUrlInput);
+        }
+        ImGui::PopItemWidth();
+        ImGui::Text("Ollama Server Status: %s", pipeline.ollamaRunning ? "Running" : "Not Running");
+        if (pipeline.isWarmingModel) {
+            ImGui::Text("%s", pipeline.warmingStatusMessage.c_str());
         }
+        drawAnalysisSettings();
+        drawLlmQueueStatus();
         ImGui::Separator();
 
         // Ollama Model Selection
-        ImGui::BeginDisabled(isWarmingModel);
-        if (ollamaRunning && modelsLoaded && !availableModels.empty()) {
+        ImGui::BeginDisabled(pipeline.isWarmingModel);
+        int selectedModel = 0;
+        std::vector<std::string> models = pipeline.getOllamaModels(selectedModel);
+        if (pipeline.ollamaRunning && pipeline.modelsLoaded && selectedModel < (int)models.size()) {
             ImGui::Text("AI Model"); ImGui::SameLine();
             ImGui::PushItemWidth(-1);
-            if (ImGui::BeginCombo("##ollama_model_select", availableModels[selectedModelIndex].c_str())) {
-                for (int i = 0; i < availableModels.size(); ++i) {
-                    const bool is_selected = (selectedModelIndex == i);
-                    if (ImGui::Selectable(availableModels[i].c_str(), is_selected)) {
-                        if (selectedModelIndex != i) {
-                            int oldIndex = selectedModelIndex;
-                            selectedModelIndex = i;
-                            std::thread(&AtakSigintModule::warmupModel, this, i, oldIndex).detach();
-                        }
+            if (ImGui::BeginCombo("##ollama_model_select", models[selectedModel].c_str())) {
+                for (int i = 0; i < (int)models.size(); ++i) {
+                    const bool is_selected = (selectedModel == i);
+                    if (ImGui::Selectable(models[i].c_str(), is_selected)) {
+                        pipeline.selectOllamaModel(i);
                     }
                     if (is_selected) {
                         ImGui::SetItemDefaultFocus();
@@ -367,23 +608,94 @@ private:
                 ImGui::EndCombo();
             }
             ImGui::PopItemWidth();
-        } else if (ollamaRunning && !modelsLoaded) {
+        } else if (pipeline.ollamaRunning && !pipeline.modelsLoaded) {
             ImGui::Text("Loading Ollama models...");
         } else {
             ImGui::Text("Ollama not running. Start server to select models.");
         }
         ImGui::EndDisabled();
+        ImGui::Separator();
+
+        drawWhisperModel();
+        ImGui::Separator();
+
+        // VoxHunt transmission segmentation
+        ImGui::Text("VoxHunt Squelch");
+        float threshold = pipeline.vadThresholdDb;
+        float hang = pipeline.vadHangMs;
+        float preRoll = pipeline.vadPreRollMs;
+        bool streaming = pipeline.streamingMode;
+        ImGui::PushItemWidth(-1);
+        if (ImGui::SliderFloat("##vad_threshold", &threshold, 3.0f, 30.0f, "Threshold %.0f dB")) { pipeline.vadThresholdDb = threshold; }
+        if (ImGui::SliderFloat("##vad_hang", &hang, 100.0f, 3000.0f, "Hang %.0f ms")) { pipeline.vadHangMs = hang; }
+        if (ImGui::SliderFloat("##vad_preroll", &preRoll, 0.0f, 1000.0f, "Pre-roll %.0f ms")) { pipeline.vadPreRollMs = preRoll; }
+        ImGui::PopItemWidth();
+        // Partial hypotheses need the model in this process
+        if (!pipeline.remoteDecoding && ImGui::Checkbox("Streaming transcription", &streaming)) { pipeline.streamingMode = streaming; }
+        ImGui::Separator();
+
+        // VoxHunt channels, one per audio stream
+        ImGui::Text("VoxHunt Channels");
+        {
+            int removeId = -1;
+            std::vector<std::string> tapped;
+            {
+                std::lock_guard<std::mutex> lck(pipeline.tapsMtx);
+                for (auto& tap : pipeline.taps) {
+                    ImGui::Text("%s%s", tap->streamName.c_str(), tap->isRunning() ? "" : " (waiting for stream)");
+                    ImGui::SameLine();
+                    // Decoded first when the decoders are behind, and shed last with the lowest priority policy
+                    int prio = tap->priority;
+                    ImGui::PushItemWidth(80);
+                    if (ImGui::InputInt(("Prio##tap_prio_" + std::to_string(tap->id)).c_str(), &prio)) {
+                        tap->priority = prio;
+                    }
+                    ImGui::PopItemWidth();
+                    ImGui::SameLine();
+                    if (ImGui::SmallButton(("Remove##tap_" + std::to_string(tap->id)).c_str())) {
+                        removeId = tap->id;
+                    }
+                    tapped.push_back(tap->streamName);
+                }
+            }
+            if (removeId >= 0) { pipeline.removeTap(removeId); }
+
+            std::vector<std::string> untapped;
+            for (const auto& streamName : sigpath::sinkManager.getStreamNames()) {
+                if (std::find(tapped.begin(), tapped.end(), streamName) == tapped.end()) {
+                    untapped.push_back(streamName);
+                }
+            }
+            if (!untapped.empty()) {
+                addStreamIndex = std::clamp<int>(addStreamIndex, 0, untapped.size() - 1);
+                ImGui::PushItemWidth(-60);
+                if (ImGui::BeginCombo("##add_stream_select", untapped[addStreamIndex].c_str())) {
+                    for (int i = 0; i < (int)untapped.size(); ++i) {
+                        if (ImGui::Selectable(untapped[i].c_str(), addStreamIndex == i)) {
+                            addStreamIndex = i;
+                        }
+                    }
+                    ImGui::EndCombo();
+                }
+                ImGui::PopItemWidth();
+                ImGui::SameLine();
+                if (ImGui::Button("Add##add_stream", ImVec2(50, 0))) {
+                    pipeline.addTap(untapped[addStreamIndex]);
+                }
+            }
+        }
+
+        drawScanner();
+        drawWatchlist();
+        drawTranscriptSearch();
+        drawStats();
 
         // Embedded Log Window (only visible if not popped out)
         if (!showLogWindow) {
             ImGui::Text("SIGINT LOG");
+            drawSemanticSearch();
             ImGui::BeginChild("LogWindow", ImVec2(0, -ImGui::GetFrameHeightWithSpacing() * 2), true, ImGuiWindowFlags_HorizontalScrollbar);
-            {
-                std::lock_guard<std::mutex> lock(logMutex);
-                for (const auto& msg : logMessages) {
-                    ImGui::TextUnformatted(msg.c_str());
-                }
-            }
+            drawLogLines();
             if (scrollToBottom) {
                 ImGui::SetScrollHereY(1.0f);
                 scrollToBottom = false;
@@ -392,84 +704,13 @@ private:
 
             ImGui::Separator();
 
-            ImGui::BeginDisabled(isWarmingModel);
+            ImGui::BeginDisabled(pipeline.isWarmingModel);
             ImGui::PushItemWidth(-150);
             if (ImGui::InputText("##chat", chatInputBuffer, sizeof(chatInputBuffer), ImGuiInputTextFlags_EnterReturnsTrue) || ImGui::Button("Send", ImVec2(140, 0))) {
                 if (strlen(chatInputBuffer) > 0) {
-                    // Copy input to a separate string so we can clear the buffer
                     std::string message = chatInputBuffer;
                     memset(chatInputBuffer, 0, sizeof(chatInputBuffer));
-
-                    // All network and processing happens outside of any locks
-                    std::string ollamaResponse;
-                    std::string aiText;
-                    std::string errorMessage;
-                    bool success = false;
-
-                    if (atakAiActive && ollamaRunning && modelsLoaded && !availableModels.empty()) {
-                        // Prepare payload
-                        json ollamaPayload;
-                        json userMessage;
-                        userMessage["role"] = "user";
-                        userMessage["content"] = message;
-                        
-                        auto tempMessages = ollamaMessages;
-                        tempMessages.push_back(userMessage);
-
-                        if (!ollamaInitialized) {
-                            tempMessages.insert(tempMessages.begin(), json::parse(R"({"role": "system", "content": "You are a U.S. Navy S.E.A.L. on a covert SIGINT operation. Your callsign is RADAR. Be brief and professional. Report only significant, actionable intelligence. Otherwise, learn from the OPERATOR's instructions. When responding to the OPERATOR, be concise. End all transmissions with OVER."})"));
-                            ollamaInitialized = true;
-                        }
-
-                        while (tempMessages.size() > MAX_HISTORY_LENGTH) {
-                            tempMessages.erase(tempMessages.begin() + 1);
-                        }
-
-                        ollamaPayload["model"] = availableModels[selectedModelIndex];
-                        ollamaPayload["messages"] = tempMessages;
-                        ollamaPayload["stream"] = false;
-                        ollamaPayload["options"]["temperature"] = 0.4;
-                        ollamaPayload["options"]["num_predict"] = 80;
-
-                        // Perform network request
-                        net::http::Client httpClient;
-                        try {
-                            ollamaResponse = httpClient.post("http://localhost:11434/api/chat", ollamaPayload.dump());
-                            json responseJson = json::parse(ollamaResponse);
-                            aiText = responseJson["message"]["content"].get<std::string>();
-                            success = true;
-                        } catch (const std::exception& e) {
-                            errorMessage = "[AI Error] HTTP or JSON error: " + std::string(e.what());
-                            success = false;
-                        }
-                    }
-
-                    // Now, acquire a single lock to update all logs and state
-                    {
-                        std::lock_guard<std::mutex> lock(logMutex);
-                        logMessages.push_back("OPERATOR: " + message);
-                        if (success) {
-                            logMessages.push_back("[AI Raw Response] " + ollamaResponse);
-                            logMessages.push_back("[AI] " + aiText);
-
-                            json userMsgJson;
-                            userMsgJson["role"] = "user";
-                            userMsgJson["content"] = message;
-                            ollamaMessages.push_back(userMsgJson);
-
-                            json assistantMsgJson;
-                            assistantMsgJson["role"] = "assistant";
-                            assistantMsgJson["content"] = aiText;
-                            ollamaMessages.push_back(assistantMsgJson);
-
-                            while (ollamaMessages.size() > MAX_HISTORY_LENGTH) {
-                                ollamaMessages.erase(ollamaMessages.begin() + 1);
-                            }
-                        } else if (!errorMessage.empty()) {
-                            logMessages.push_back(errorMessage);
-                        }
-                        scrollToBottom = true;
-                    }
+                    pipeline.sendOperatorMessage(message);
                 }
             }
             ImGui::PopItemWidth();
@@ -480,33 +721,34 @@ private:
         // Pop-out Log Window
         if (showLogWindow) {
             if (ImGui::Begin("SIGINT LOG", &showLogWindow)) {
-                // Checkboxes inside the pop-out window
-                ImGui::Checkbox("VoxHunt", &voiceHuntActive);
+                // Checkboxes inside the pop-out window. Checked state comes from the pipeline, the control socket can toggle them too
+                bool hunting = pipeline.voiceHuntActive;
+                bool analyzing = pipeline.atakAiActive;
+                if (ImGui::Checkbox("VoxHunt", &hunting)) { pipeline.voiceHuntActive = hunting; }
                 ImGui::SameLine();
-                ImGui::Checkbox("W*A*L*T*E*R", &atakAiActive);
+                if (ImGui::Checkbox("W*A*L*T*E*R", &analyzing)) { pipeline.atakAiActive = analyzing; }
                 ImGui::Separator();
 
                 // Ollama Control in pop-out window
-                ImGui::Text("Ollama Server Status: %s", ollamaRunning ? "Running" : "Not Running");
-                if (isWarmingModel) {
-                    ImGui::Text("%s", warmingStatusMessage.c_str());
+                ImGui::Text("Ollama Server Status: %s", pipeline.ollamaRunning ? "Running" : "Not Running");
+                if (pipeline.isWarmingModel) {
+                    ImGui::Text("%s", pipeline.warmingStatusMessage.c_str());
                 }
+                drawLlmQueueStatus();
                 ImGui::Separator();
 
                 // Ollama Model Selection in pop-out window
-                ImGui::BeginDisabled(isWarmingModel);
-                if (ollamaRunning && modelsLoaded && !availableModels.empty()) {
+                ImGui::BeginDisabled(pipeline.isWarmingModel);
+                int selectedModel = 0;
+                std::vector<std::string> models = pipeline.getOllamaModels(selectedModel);
+                if (pipeline.ollamaRunning && pipeline.modelsLoaded && selectedModel < (int)models.size()) {
                     ImGui::Text("AI Model"); ImGui::SameLine();
                     ImGui::PushItemWidth(-1);
-                    if (ImGui::BeginCombo("##ollama_model_select_popout", availableModels[selectedModelIndex].c_str())) {
-                        for (int i = 0; i < availableModels.size(); ++i) {
-                            const bool is_selected = (selectedModelIndex == i);
-                            if (ImGui::Selectable(availableModels[i].c_str(), is_selected)) {
-                                if (selectedModelIndex != i) {
-                                    int oldIndex = selectedModelIndex;
-                                    selectedModelIndex = i;
-                                    std::thread(&AtakSigintModule::warmupModel, this, i, oldIndex).detach();
-                                }
+                    if (ImGui::BeginCombo("##ollama_model_select_popout", models[selectedModel].c_str())) {
+                        for (int i = 0; i < (int)models.size(); ++i) {
+                            const bool is_selected = (selectedModel == i);
+                            if (ImGui::Selectable(models[i].c_str(), is_selected)) {
+                                pipeline.selectOllamaModel(i);
                             }
                             if (is_selected) {
                                 ImGui::SetItemDefaultFocus();
@@ -515,7 +757,7 @@ private:
                         ImGui::EndCombo();
                     }
                     ImGui::PopItemWidth();
-                } else if (ollamaRunning && !modelsLoaded) {
+                } else if (pipeline.ollamaRunning && !pipeline.modelsLoaded) {
                     ImGui::Text("Loading Ollama models...");
                 } else {
                     ImGui::Text("Ollama not running. Start server to select models.");
@@ -523,13 +765,9 @@ private:
                 ImGui::EndDisabled();
                 ImGui::Separator();
 
+                drawSemanticSearch();
                 ImGui::BeginChild("PopOutLogWindow", ImVec2(0, -ImGui::GetFrameHeightWithSpacing() * 2), true, ImGuiWindowFlags_HorizontalScrollbar);
-                {
-                    std::lock_guard<std::mutex> lock(logMutex);
-                    for (const auto& msg : logMessages) {
-                        ImGui::TextUnformatted(msg.c_str());
-                    }
-                }
+                drawLogLines();
                 if (scrollToBottom) {
                     ImGui::SetScrollHereY(1.0f);
                     scrollToBottom = false;
@@ -538,84 +776,13 @@ private:
 
                 ImGui::Separator();
 
-                ImGui::BeginDisabled(isWarmingModel);
+                ImGui::BeginDisabled(pipeline.isWarmingModel);
                 ImGui::PushItemWidth(-150);
                 if (ImGui::InputText("##chatPopOut", chatInputBuffer, sizeof(chatInputBuffer), ImGuiInputTextFlags_EnterReturnsTrue) || ImGui::Button("Send", ImVec2(140, 0))) {
                     if (strlen(chatInputBuffer) > 0) {
-                        // Copy input to a separate string so we can clear the buffer
                         std::string message = chatInputBuffer;
                         memset(chatInputBuffer, 0, sizeof(chatInputBuffer));
-
-                        // All network and processing happens outside of any locks
-                        std::string ollamaResponse;
-                        std::string aiText;
-                        std::string errorMessage;
-                        bool success = false;
-
-                        if (atakAiActive && ollamaRunning && modelsLoaded && !availableModels.empty()) {
-                            // Prepare payload
-                            json ollamaPayload;
-                            json userMessage;
-                            userMessage["role"] = "user";
-                            userMessage["content"] = message;
-                            
-                            auto tempMessages = ollamaMessages;
-                            tempMessages.push_back(userMessage);
-
-                            if (!ollamaInitialized) {
-                                tempMessages.insert(tempMessages.begin(), json::parse(R"({"role": "system", "content": "You are a U.S. Navy S.E.A.L. on a covert SIGINT operation. Your callsign is RADAR. Be brief and professional. Report only significant, actionable intelligence. Otherwise, learn from the OPERATOR's instructions. When responding to the OPERATOR, be concise. End all transmissions with OVER."})"));
-                                ollamaInitialized = true;
-                            }
-
-                            while (tempMessages.size() > MAX_HISTORY_LENGTH) {
-                                tempMessages.erase(tempMessages.begin() + 1);
-                            }
-
-                            ollamaPayload["model"] = availableModels[selectedModelIndex];
-                            ollamaPayload["messages"] = tempMessages;
-                            ollamaPayload["stream"] = false;
-                            ollamaPayload["options"]["temperature"] = 0.4;
-                            ollamaPayload["options"]["num_predict"] = 80;
-
-                            // Perform network request
-                            net::http::Client httpClient;
-                            try {
-                                ollamaResponse = httpClient.post("http://localhost:11434/api/chat", ollamaPayload.dump());
-                                json responseJson = json::parse(ollamaResponse);
-                                aiText = responseJson["message"]["content"].get<std::string>();
-                                success = true;
-                            } catch (const std::exception& e) {
-                                errorMessage = "[AI Error] HTTP or JSON error: " + std::string(e.what());
-                                success = false;
-                            }
-                        }
-
-                        // Now, acquire a single lock to update all logs and state
-                        {
-                            std::lock_guard<std::mutex> lock(logMutex);
-                            logMessages.push_back("OPERATOR: " + message);
-                            if (success) {
-                                logMessages.push_back("[AI Raw Response] " + ollamaResponse);
-                                logMessages.push_back("[AI] " + aiText);
-
-                                json userMsgJson;
-                                userMsgJson["role"] = "user";
-                                userMsgJson["content"] = message;
-                                ollamaMessages.push_back(userMsgJson);
-
-                                json assistantMsgJson;
-                                assistantMsgJson["role"] = "assistant";
-                                assistantMsgJson["content"] = aiText;
-                                ollamaMessages.push_back(assistantMsgJson);
-
-                                while (ollamaMessages.size() > MAX_HISTORY_LENGTH) {
-                                    ollamaMessages.erase(ollamaMessages.begin() + 1);
-                                }
-                            } else if (!errorMessage.empty()) {
-                                logMessages.push_back(errorMessage);
-                            }
-                            scrollToBottom = true;
-                        }
+                        pipeline.sendOperatorMessage(message);
                     }
                 }
                 ImGui::PopItemWidth();
@@ -627,127 +794,92 @@ private:
 
     std::string name;
     bool enabled = true;
+    bool headless = false;
+    sigint::Pipeline pipeline;
 
     // UI State
-    bool voiceHuntActive = false;
-    bool atakAiActive = false;
     char chatInputBuffer[256] = { 0 };
     bool showLogWindow = false; // New member for pop-out window
-    
-    // Log State
-    std::vector<std::string> logMessages;
-    std::mutex logMutex;
-    int lastLogSize = 0;
-    bool scrollToBottom = false;
+    char ollamaUrlInput[256] = "";
+    int addStreamIndex = 0;
+    double scanAddFrequencyMhz = 146.52;
+    int scanAddPriority = 0;
 
-    // Audio Processing State
-    std::string selectedStreamName = "Radio";
-    dsp::stream<dsp::stereo_t>* audioStream = NULL;
-    dsp::sink::Handler<float> audioSink;
-    dsp::routing::Splitter<dsp::stereo_t> splitter;
-    dsp::stream<dsp::stereo_t> splitterOutput; // Output stream for stereo_t
-    dsp::convert::StereoToMono stereoToMono; // Stereo to Mono converter
-    dsp::stream<float> monoOutput; // Output stream for stereoToMono
-    dsp::multirate::RationalResampler<float> resampler; // Resampler for Whisper
-    
-    // Whisper State
-    whisper_context* whisperCtx = nullptr;
-    std::vector<float> audioBuffer;
-    std::mutex audioBufferMutex;
-    std::thread whisperWorker;
-    std::atomic<bool> stopWhisperWorker = false;
-
-    // Ollama State
-    std::vector<json> ollamaMessages;
-    bool ollamaInitialized = false; // Flag for lazy initialization
-    const size_t MAX_HISTORY_LENGTH = 10; // Max messages to keep in history (user + assistant)
-    std::vector<std::string> availableModels;
-    int selectedModelIndex = 0;
-    bool modelsLoaded = false;
-    std::atomic<bool> ollamaRunning = false;
-    std::thread ollamaMonitorThread;
-    std::atomic<bool> stopOllamaMonitor = false;
-    std::atomic<bool> isWarmingModel = false;
-    std::string warmingStatusMessage = "";
-
-private:
-    void warmupModel(int newModelIndex, int oldModelIndex);
+    // Log view, with UI thread copies of the lines still in progress
+    bool scrollToBottom = false;
+    std::map<uint64_t, std::string> liveLlmStreams;
+    std::map<std::string, std::string> livePartials;
+
+    // Watchlist editor
+    std::vector<char> watchlistEdit;
+    uint64_t watchlistVersion = 0;
+    bool watchlistEdited = false;
+
+    // Transcript search box
+    char transcriptSearchText[256] = "";
+    char transcriptSearchFrom[32] = "";
+    char transcriptSearchTo[32] = "";
+    double transcriptSearchMhz = 0.0;
+    double transcriptSearchToleranceKhz = 5.0;
+    std::vector<sigint::TranscriptStore::Record> transcriptResults;
+    double transcriptSearchMs = 0.0;
+    bool transcriptSearched = false;
+
+    // Search by meaning above the log
+    std::mutex semanticMtx;     // Guards the results below, written by the embedding stage
+    char semanticQuery[256] = "";
+    bool semanticSearching = false;
+    bool semanticShown = false;
+    std::vector<sigint::VectorIndex::Hit> semanticHits;
+    std::string semanticError;
+    double semanticEmbedMs = 0.0;
+    double semanticSearchMs = 0.0;
 };
 
-void AtakSigintModule::warmupModel(int newModelIndex, int oldModelIndex) {
-    isWarmingModel = true;
-    
-    // Unload the old model first
-    if (oldModelIndex >= 0 && oldModelIndex < availableModels.size()) {
-        std::string oldModelName = availableModels[oldModelIndex];
-        {
-            std::lock_guard<std::mutex> lock(logMutex);
-            warmingStatusMessage = "Unloading model: " + oldModelName + "...";
-            logMessages.push_back("[OLLAMA] " + warmingStatusMessage);
-        }
-        try {
-            json unloadPayload;
-            unloadPayload["model"] = oldModelName;
-            unloadPayload["prompt"] = "";
-            unloadPayload["keep_alive"] = 0;
-
-            net::http::Client httpClient;
-            httpClient.post("http://localhost:11434/api/generate", unloadPayload.dump());
-            
-            {
-                std::lock_guard<std::mutex> lock(logMutex);
-                logMessages.push_back("[OLLAMA] Model '" + oldModelName + "' unloaded.");
-            }
-        } catch (const std::exception& e) {
-            std::lock_guard<std::mutex> lock(logMutex);
-            logMessages.push_back("[OLLAMA Error] Failed to unload model: " + oldModelName + " - " + e.what());
-        }
-    }
-
-    // Now, warm up the new model
-    std::string newModelName;
-    if (newModelIndex >= 0 && newModelIndex < availableModels.size()) {
-        newModelName = availableModels[newModelIndex];
-    } else {
-        isWarmingModel = false;
-        return;
-    }
-
-    {
-        std::lock_guard<std::mutex> lock(logMutex);
-        warmingStatusMessage = "Warming model: " + newModelName + "...";
-        logMessages.push_back("[OLLAMA] " + warmingStatusMessage);
+MOD_EXPORT void _INIT_() {
+    json def = json({});
+    def["ollamaUrl"] = "http://localhost:11434";
+    def["connectTimeoutMs"] = 3000;
+    def["requestTimeoutMs"] = 120000;
+    def["logPath"] = "/tmp/atak_sigint.log";
+    def["logJsonl"] = false;
+    def["logMaxMB"] = 16;
+    def["logRotateHours"] = 24;
+    def["metricsPath"] = "/tmp/atak_sigint.prom";
+    def["metricsPort"] = 0;
+    def["metricsIntervalSec"] = 10;
+    def["whisperModel"] = "ggml-tiny.en.bin";
+    def["whisperModelDir"] = "";
+    def["llmBatchWindowMs"] = 2000;
+    def["llmMaxInFlight"] = 1;
+    def["llmMemoryTurns"] = 16;
+    def["llmKeepAlive"] = "30m";
+    def["decodeBacklogSec"] = 60;
+    def["watchlistPath"] = core::args["root"].s() + "/atak_sigint_watchlist.txt";
+    def["keywordBoost"] = 1;
+    def["keywordBoostSec"] = 300;
+    def["transcriptDir"] = core::args["root"].s() + "/atak_sigint_transcripts";
+    def["audioArchiveDir"] = core::args["root"].s() + "/atak_sigint_audio";
+    def["audioArchiveMB"] = 2048;
+    def["embeddingModel"] = "nomic-embed-text";
+    def["embeddingIndexPath"] = core::args["root"].s() + "/atak_sigint_embeddings.hnsw";
+    def["llmRetrieval"] = true;
+    def["shedPolicy"] = "oldest";
+    def["controlSocket"] = core::args["root"].s() + "/atak_sigint.sock";
+    def["decodeWorkers"] = json::array();
+
+    config.setPath(core::args["root"].s() + "/atak_sigint_config.json");
+    config.load(def);
+    config.enableAutoSave();
+
+    // Fill in settings added since the config file was written
+    config.acquire();
+    for (auto& [key, value] : def.items()) {
+        if (!config.conf.contains(key)) { config.conf[key] = value; }
     }
-
-    try {
-        json warmupPayload;
-        warmupPayload["model"] = newModelName;
-        warmupPayload["messages"] = json::array({
-            json::object({{"role", "user"}, {"content", "Hello"}})
-        });
-        warmupPayload["stream"] = false;
-
-        net::http::Client httpClient;
-        httpClient.post("http://localhost:11434/api/chat", warmupPayload.dump());
-
-        {
-            std::lock_guard<std::mutex> lock(logMutex);
-            warmingStatusMessage = "Model '" + newModelName + "' is ready.";
-            logMessages.push_back("[OLLAMA] " + warmingStatusMessage);
-        }
-    } catch (const std::exception& e) {
-        std::lock_guard<std::mutex> lock(logMutex);
-        warmingStatusMessage = "Failed to warm model: " + newModelName;
-        logMessages.push_back("[OLLAMA Error] " + warmingStatusMessage + " - " + e.what());
-    }
-
-    std::this_thread::sleep_for(std::chrono::seconds(2));
-    warmingStatusMessage = "";
-    isWarmingModel = false;
+    config.release(true);
 }
 
-MOD_EXPORT void _INIT_() {}
-
 MOD_EXPORT ModuleManager::Instance* _CREATE_INSTANCE_(std::string name) {
     return new AtakSigintModule(name);
 }
@@ -756,4 +888,7 @@ MOD_EXPORT void _DELETE_INSTANCE_(void* instance) {
     delete (AtakSigintModule*)instance;
 }
 
-MOD_EXPORT void _END_() {}
+MOD_EXPORT void _END_() {
+    config.disableAutoSave();
+    config.save();
+}
@@ -0,0 +1,221 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <numeric>
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+#include <dsp/sink.h>
+#include <dsp/types.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIGINT_DSP_X86
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace sigint {
+    // Dot products for the FIR kernel. On x86 the AVX2/FMA version is picked at runtime when the
+    // CPU has it, the module itself is built for the baseline ISA.
+    namespace simd {
+        inline float dotScalar(const float* a, const float* b, int n) {
+            float sum = 0.0f;
+            for (int i = 0; i < n; i++) { sum += a[i] * b[i]; }
+            return sum;
+        }
+
+#if defined(SIGINT_DSP_X86)
+        __attribute__((target("avx2,fma"))) inline float dotAvx2(const float* a, const float* b, int n) {
+            __m256 acc0 = _mm256_setzero_ps();
+            __m256 acc1 = _mm256_setzero_ps();
+            int i = 0;
+            for (; i + 16 <= n; i += 16) {
+                acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(&a[i]), _mm256_loadu_ps(&b[i]), acc0);
+                acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(&a[i + 8]), _mm256_loadu_ps(&b[i + 8]), acc1);
+            }
+            for (; i + 8 <= n; i += 8) {
+                acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(&a[i]), _mm256_loadu_ps(&b[i]), acc0);
+            }
+            __m256 acc = _mm256_add_ps(acc0, acc1);
+            __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+            half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+            half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+            return _mm_cvtss_f32(half) + dotScalar(&a[i], &b[i], n - i);
+        }
+
+        inline float dotSse(const float* a, const float* b, int n) {
+            __m128 acc0 = _mm_setzero_ps();
+            __m128 acc1 = _mm_setzero_ps();
+            int i = 0;
+            for (; i + 8 <= n; i += 8) {
+                acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(&a[i]), _mm_loadu_ps(&b[i])));
+                acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(&a[i + 4]), _mm_loadu_ps(&b[i + 4])));
+            }
+            __m128 acc = _mm_add_ps(acc0, acc1);
+            acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+            acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+            return _mm_cvtss_f32(acc) + dotScalar(&a[i], &b[i], n - i);
+        }
+#elif defined(__ARM_NEON)
+        inline float dotNeon(const float* a, const float* b, int n) {
+            float32x4_t acc0 = vdupq_n_f32(0.0f);
+            float32x4_t acc1 = vdupq_n_f32(0.0f);
+            int i = 0;
+            for (; i + 8 <= n; i += 8) {
+                acc0 = vmlaq_f32(acc0, vld1q_f32(&a[i]), vld1q_f32(&b[i]));
+                acc1 = vmlaq_f32(acc1, vld1q_f32(&a[i + 4]), vld1q_f32(&b[i + 4]));
+            }
+            float32x4_t acc = vaddq_f32(acc0, acc1);
+            float32x2_t half = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+            return vget_lane_f32(vpadd_f32(half, half), 0) + dotScalar(&a[i], &b[i], n - i);
+        }
+#endif
+
+        typedef float (*DotFunc)(const float* a, const float* b, int n);
+
+        inline DotFunc bestDot() {
+#if defined(SIGINT_DSP_X86)
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) { return dotAvx2; }
+            return dotSse;
+#elif defined(__ARM_NEON)
+            return dotNeon;
+#else
+            return dotScalar;
+#endif
+        }
+    }
+
+    // Stereo audio stream in, mono samples at a fixed rate out, in one block and one pass.
+    // Downmixes into a history buffer, then runs a polyphase rational resampler (windowed sinc
+    // prototype, one contiguous tap set per phase so every output sample is a single SIMD dot product)
+    // and hands the result straight to a callback on the DSP thread. The input rate can be changed
+    // from any thread, the taps are rebuilt by the DSP thread before the next block.
+    class MonoDecimator : public dsp::Sink<dsp::stereo_t> {
+        using base_type = dsp::Sink<dsp::stereo_t>;
+    public:
+        typedef void (*Handler)(float* data, int count, void* ctx);
+
+        // Phases are capped so odd input rates don't blow up the tap table, see design()
+        static constexpr int MAX_PHASES = 1024;
+
+        void init(dsp::stream<dsp::stereo_t>* in, double inSampleRate, int outSampleRate, Handler handler, void* ctx) {
+            this->outSampleRate = outSampleRate;
+            this->handler = handler;
+            this->ctx = ctx;
+            dot = simd::bestDot();
+            design(inSampleRate);
+            base_type::init(in);
+        }
+
+        void setInSampleRate(double sampleRate) {
+            if (sampleRate > 0.0) { pendingRate = sampleRate; }
+        }
+
+        int run() {
+            int count = _in->read();
+            if (count < 0) { return -1; }
+
+            double rate = pendingRate.exchange(0.0);
+            if (rate > 0.0 && rate != inSampleRate) { design(rate); }
+
+            int outCount = process(_in->readBuf, count);
+            _in->flush();
+            if (outCount) { handler(outBuf.data(), outCount, ctx); }
+            return count;
+        }
+
+    private:
+        // Builds the tap table for inSampleRate -> outSampleRate and resets the filter state
+        void design(double sampleRate) {
+            inSampleRate = sampleRate;
+            long in = std::lround(sampleRate);
+            long g = std::gcd(in, (long)outSampleRate);
+            if (outSampleRate / g > MAX_PHASES) {
+                // Not a sensible audio rate, resample from the nearest multiple of 100 Hz instead
+                in = std::max<long>(100, std::lround(sampleRate / 100.0) * 100);
+                g = std::gcd(in, (long)outSampleRate);
+            }
+            interp = outSampleRate / g;
+            decim = in / g;
+
+            // Cutoff just below the lower Nyquist rate, with a transition band a fifth of it wide.
+            // A Blackman window needs about 5.5 / transition taps, at the input rate per phase.
+            double nyquist = std::min<double>(in, outSampleRate) / 2.0;
+            double cutoff = 0.9 * nyquist;
+            double transition = 0.2 * nyquist;
+            tapsPerPhase = (int)std::ceil(5.5 * (double)in / transition);
+            tapsPerPhase = (tapsPerPhase + 7) & ~7;
+
+            // Prototype at the interpolated rate, normalized so each phase has unity gain. The
+            // stereo downmix's 0.5 is folded into the taps as well.
+            int len = interp * tapsPerPhase;
+            double fc = cutoff / ((double)in * interp);
+            std::vector<double> proto(len);
+            double sum = 0.0;
+            for (int n = 0; n < len; n++) {
+                double t = (double)n - (double)(len - 1) / 2.0;
+                double x = 2.0 * M_PI * fc * t;
+                double sinc = (t == 0.0) ? 1.0 : std::sin(x) / x;
+                double w = 0.42 - 0.5 * std::cos(2.0 * M_PI * n / (len - 1)) + 0.08 * std::cos(4.0 * M_PI * n / (len - 1));
+                proto[n] = 2.0 * fc * sinc * w;
+                sum += proto[n];
+            }
+            double gain = 0.5 * (double)interp / sum;
+
+            // Phase p's taps, reversed so they line up with the history buffer (oldest sample first)
+            taps.resize(len);
+            for (int p = 0; p < interp; p++) {
+                for (int j = 0; j < tapsPerPhase; j++) {
+                    taps[p * tapsPerPhase + (tapsPerPhase - 1 - j)] = (float)(proto[p + j * interp] * gain);
+                }
+            }
+
+            history.assign(tapsPerPhase - 1, 0.0f);
+            phase = 0;
+            nextInput = 0;
+        }
+
+        int process(const dsp::stereo_t* in, int count) {
+            int histLen = tapsPerPhase - 1;
+            if ((int)history.size() < histLen + count) { history.resize(histLen + count); }
+            float* buf = history.data();
+            for (int i = 0; i < count; i++) { buf[histLen + i] = in[i].l + in[i].r; }
+
+            size_t maxOut = (size_t)(((int64_t)count * interp) / decim + 2);
+            if (outBuf.size() < maxOut) { outBuf.resize(maxOut); }
+
+            // Output n uses input sample floor(n * decim / interp) as its newest one, with phase
+            // (n * decim) % interp. nextInput is relative to the first sample of this block.
+            int outCount = 0;
+            while (nextInput < count) {
+                outBuf[outCount++] = dot(&buf[nextInput], &taps[phase * tapsPerPhase], tapsPerPhase);
+                phase += decim;
+                nextInput += phase / interp;
+                phase %= interp;
+            }
+            nextInput -= count;
+
+            // Keep the last samples for the next block
+            memmove(buf, buf + count, histLen * sizeof(float));
+            return outCount;
+        }
+
+        int outSampleRate = 16000;
+        Handler handler = NULL;
+        void* ctx = NULL;
+        simd::DotFunc dot = simd::dotScalar;
+
+        double inSampleRate = 0.0;
+        std::atomic<double> pendingRate = 0.0;
+        int interp = 1;
+        int decim = 1;
+        int tapsPerPhase = 0;
+        std::vector<float> taps;
+
+        // Filter state, DSP thread only
+        std::vector<float> history;
+        std::vector<float> outBuf;
+        int phase = 0;
+        int nextInput = 0;
+    };
+}
@@ -0,0 +1,1604 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <map>
+#include <functional>
+#include <unistd.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <signal_path/signal_path.h>
+#include <gui/gui.h>
+#include <core.h>
+#include <config.h>
+#include "whisper.h"
+#include "audio_tap.h"
+#include "decoder_pool.h"
+#include "remote_decoders.h"
+#include "decode_scheduler.h"
+#include "doorbell.h"
+#include "scanner.h"
+#include "llm_executor.h"
+#include "analysis_stage.h"
+#include "conversation_memory.h"
+#include "keyword_spotter.h"
+#include "transcript_store.h"
+#include "audio_archive.h"
+#include "vector_index.h"
+#include "embedding_stage.h"
+#include "control_server.h"
+#include "log_store.h"
+#include "log_writer.h"
+#include "telemetry.h"
+
+// Whisper sample rate is always 16000 Hz
+#define WHISPER_SAMPLE_RATE 16000
+
+// Shortest input Whisper will decode (a little over one second)
+#define WHISPER_MIN_SAMPLES (WHISPER_SAMPLE_RATE + WHISPER_SAMPLE_RATE / 10)
+
+// Audio ring between the DSP thread and the Whisper worker (~32 seconds of 16kHz audio)
+#define AUDIO_RING_CAPACITY (1 << 19)
+
+// Number of Whisper decoder states sharing the model, i.e. how many channels can be decoded at once
+#define DECODER_STATE_COUNT 2
+
+// The Whisper worker sleeps until a tap has this much new audio (100 ms) or the housekeeping interval passes
+#define WORKER_WAKE_SAMPLES     (WHISPER_SAMPLE_RATE / 10)
+#define WORKER_IDLE_MS          250
+#define DSP_LOAD_INTERVAL_MS    1000
+
+// How often the UI thread copies where each tap's VFO is tuned, for the transcripts' frequency and mode
+#define TUNING_REFRESH_MS       250
+
+// Audio the decode queue may hold before transmissions are shed. With the downgrade policy the bound is
+// doubled, and a smaller model is loaded once the backlog passes the configured one (at most once per cooldown).
+#define DECODE_BACKLOG_MIN_SEC          10
+#define DECODE_BACKLOG_MAX_SEC          600
+#define MODEL_DOWNGRADE_COOLDOWN_SEC    120
+
+// Decode queue score per channel priority step, so priority outweighs signal level (dB) and waiting time (s)
+#define DECODE_PRIORITY_WEIGHT          100.0f
+
+// Standing orders for the LLM, the first message of every chat request
+#define RADAR_SYSTEM_PROMPT "You are a U.S. Navy S.E.A.L. on a covert SIGINT operation. Your callsign is RADAR. Be brief and professional. " \
+                            "Report only significant, actionable intelligence. Otherwise, learn from the OPERATOR's instructions. " \
+                            "When responding to the OPERATOR, be concise. End all transmissions with OVER."
+
+// Sampling options of analysis and chat requests
+#define LLM_CHAT_OPTIONS "{\"temperature\":0.4,\"num_predict\":80}"
+
+// Demodulator of the radio module behind an audio stream, from SDR++'s radio_interface.h
+#define RADIO_IFACE_CMD_GET_MODE    0
+
+// Decoder pool channel of archived transmissions decoded again, they run one at a time and below every live channel
+#define REPLAY_DECODE_CHANNEL   -1
+#define REPLAY_DECODE_PRIORITY  -1000
+
+// Past intercepts handed to the LLM with a request
+#define LLM_RETRIEVAL_HITS          5
+#define LLM_RETRIEVAL_MIN_SCORE     0.5f
+// Intercepts this recent are in the conversation already, retrieval for analysis skips them
+#define LLM_RETRIEVAL_RECENT_SEC    600
+
+// Number of lines kept in the log view
+#define LOG_CAPACITY 5000
+
+// Ollama liveness probing: how often to check a server that is up (skipped while real requests
+// are succeeding), and the backoff range used while it's down
+#define OLLAMA_PROBE_INTERVAL_MS    5000
+#define OLLAMA_BACKOFF_MIN_MS       1000
+#define OLLAMA_BACKOFF_MAX_MS       30000
+
+// How often the model list is checked for changes while the server is up
+#define OLLAMA_TAGS_INTERVAL_MS     15000
+
+namespace sigint {
+    // What gives when the decode backlog is full. The names are the "shedPolicy" config values.
+    enum ShedPolicy {
+        SHED_POLICY_OLDEST,             // Drop the transmission that has waited longest
+        SHED_POLICY_LOWEST_PRIORITY,    // Drop the lowest scored one (channel priority, then signal level)
+        SHED_POLICY_DOWNGRADE,          // Switch to a smaller model, drop the lowest scored past twice the bound
+        SHED_POLICY_COUNT
+    };
+    static const char* SHED_POLICY_NAMES[SHED_POLICY_COUNT] = { "oldest", "lowest_priority", "downgrade" };
+
+    // Demodulator names, by the mode RADIO_IFACE_CMD_GET_MODE returns
+    static const char* RADIO_MODE_NAMES[] = { "NFM", "WFM", "AM", "DSB", "USB", "CW", "LSB", "RAW" };
+
+    // The capture -> segment -> transcribe -> analyze pipeline, without any UI: audio taps, the Whisper
+    // worker and decoder pool (or the decode workers it hands transmissions to), the stores, the watchlist, the scanner and W.A.L.T.E.R with its Ollama
+    // connection. Settings are read from the module config and the setters save them back. The UI draws
+    // from the public members, the control socket (controlSocket, see control()) drives the same pipeline
+    // without one, e.g. under SDR++'s server mode.
+    class Pipeline {
+    public:
+        // Headless, nothing reads the log store, the Whisper worker drains it instead
+        Pipeline(ConfigManager& config, bool headless) : config(config), headless(headless) {
+            // Everything that goes to the log view is also written to disk by the log writer thread, and
+            // sent to control socket clients that asked for it
+            LogWriter::Config logConfig;
+            config.acquire();
+            logConfig.path = config.conf["logPath"];
+            logConfig.jsonl = config.conf["logJsonl"];
+            logConfig.maxBytes = (size_t)config.conf["logMaxMB"].get<int>() << 20;
+            logConfig.maxAgeSec = config.conf["logRotateHours"].get<int>() * 3600;
+            config.release();
+            logJsonl = logConfig.jsonl;
+            logWriter.start(logConfig);
+            logStore.setSink([this](const std::string& text) {
+                logWriter.write(text);
+                controlServer.publish("log", "LOG\t" + ControlServer::field(text));
+            });
+            logStore.push("ATAK SIGINT Module Initialized.");
+
+            // Watch terms are spotted in every transcript, the file is reloaded when it changes
+            config.acquire();
+            std::string watchlistPath = config.conf["watchlistPath"];
+            keywordBoost = config.conf["keywordBoost"].get<int>();
+            keywordBoostSec = config.conf["keywordBoostSec"].get<int>();
+            config.release();
+            keywordSpotter.setPath(watchlistPath);
+            logStore.push("[WATCH] " + std::to_string(keywordSpotter.getTermCount()) + " watch terms from " + watchlistPath + ".");
+
+            // Transcripts are also kept on disk with frequency and time, indexed for search
+            TranscriptStore::Config storeConfig;
+            config.acquire();
+            storeConfig.dir = config.conf["transcriptDir"];
+            config.release();
+            transcriptStore.start(storeConfig);
+
+            // So is the audio, compressed, to be decoded again later. A quota of 0 turns it off.
+            AudioArchive::Config archiveConfig;
+            config.acquire();
+            archiveConfig.dir = config.conf["audioArchiveDir"];
+            archiveConfig.quotaBytes = (uint64_t)std::max<int>(0, config.conf["audioArchiveMB"]) << 20;
+            config.release();
+            if (archiveConfig.quotaBytes) { audioArchive.start(archiveConfig); }
+
+            // And embedded through Ollama for search by meaning, once the pool below is set up
+            EmbeddingStage::Config embeddingConfig;
+            config.acquire();
+            std::string vectorIndexPath = config.conf["embeddingIndexPath"];
+            embeddingConfig.model = config.conf["embeddingModel"];
+            llmRetrieval = config.conf["llmRetrieval"].get<bool>();
+            config.release();
+            embeddingEnabled = !embeddingConfig.model.empty();
+            if (embeddingEnabled && !vectorIndex.open(vectorIndexPath)) {
+                logStore.push("[SEARCH] " + vectorIndex.getError() + ", search by meaning is off.");
+                embeddingEnabled = false;
+            }
+
+            // Follow audio streams coming and going so taps can rebind
+            streamRegisteredHandler.handler = streamRegisteredHandlerFn;
+            streamRegisteredHandler.ctx = this;
+            streamUnregisterHandler.handler = streamUnregisterHandlerFn;
+            streamUnregisterHandler.ctx = this;
+            sigpath::sinkManager.onStreamRegistered.bindHandler(&streamRegisteredHandler);
+            sigpath::sinkManager.onStreamUnregister.bindHandler(&streamUnregisterHandler);
+
+            // Where each tap's VFO is tuned is read on the UI thread, once the waterfall is drawn. Headless
+            // there's no UI and transcripts are stored without frequency and mode.
+            fftRedrawHandler.handler = fftRedrawHandlerFn;
+            fftRedrawHandler.ctx = this;
+            if (!headless) { gui::waterfall.onFFTRedraw.bindHandler(&fftRedrawHandler); }
+
+            // Ollama endpoint, every request goes through the same keep-alive pool
+            config.acquire();
+            ollamaUrl = config.conf["ollamaUrl"];
+            config.release();
+            ollamaPool.setReachabilityHandler([this](bool reachable) { ollamaReachabilityChanged(reachable); });
+            applyOllamaUrl();
+            // Transcripts are analyzed in coalesced batches, with a cap on requests in flight. Operator
+            // chat and memory compaction go straight to the executor, they get a worker each.
+            AnalysisStage::Config analysisConfig;
+            ConversationMemory::Config memoryConfig;
+            config.acquire();
+            analysisConfig.windowMs = config.conf["llmBatchWindowMs"];
+            analysisConfig.maxInFlight = std::max<int>(1, config.conf["llmMaxInFlight"]);
+            memoryConfig.maxTurns = std::max<int>(memoryConfig.keepTurns + 2, config.conf["llmMemoryTurns"]);
+            memoryConfig.keepAlive = config.conf["llmKeepAlive"];
+            config.release();
+            llmBatchWindowMs = analysisConfig.windowMs;
+            conversation.configure(memoryConfig);
+            conversation.setSystemPrompt(RADAR_SYSTEM_PROMPT);
+            llmExecutor.init(&ollamaPool);
+            llmExecutor.start(analysisConfig.maxInFlight + 2);
+            if (embeddingEnabled) { embeddingStage.start(embeddingConfig, &ollamaPool, &vectorIndex); }
+            analysisStage.start(analysisConfig, [this](const std::vector<AnalysisStage::Transcript>& batch, AnalysisStage::Done done) {
+                return analyzeTranscripts(batch, done);
+            });
+
+            // Pipeline metrics, exported for monitoring
+            registerMetrics();
+            telemetry::Exporter::Config exportConfig;
+            config.acquire();
+            exportConfig.path = config.conf["metricsPath"];
+            exportConfig.port = config.conf["metricsPort"];
+            exportConfig.intervalSec = config.conf["metricsIntervalSec"];
+            config.release();
+            if (!metricsExporter.start(&metrics, exportConfig)) {
+                logStore.push("[STATS] Could not listen on port " + std::to_string(exportConfig.port) + " for metrics.");
+            }
+        }
+
+        ~Pipeline() {
+            controlServer.stop();
+            metricsExporter.stop();
+            scanner.stop();
+            analysisStage.stop();
+            embeddingStage.stop();
+            llmExecutor.stop();
+            stopWhisperWorker = true;
+            workerBell.ring();
+            if (whisperWorker.joinable()) {
+                whisperWorker.join();
+            }
+            {
+                std::lock_guard<std::mutex> lck(ollamaMonitorMtx);
+                stopOllamaMonitor = true;
+            }
+            ollamaMonitorCnd.notify_all();
+            if (ollamaMonitorThread.joinable()) {
+                ollamaMonitorThread.join();
+            }
+
+            sigpath::sinkManager.onStreamRegistered.unbindHandler(&streamRegisteredHandler);
+            sigpath::sinkManager.onStreamUnregister.unbindHandler(&streamUnregisterHandler);
+            if (!headless) { gui::waterfall.onFFTRedraw.unbindHandler(&fftRedrawHandler); }
+
+            // Drop queued decodes before the taps they reference go away
+            remoteDecoders.stop();
+            decoderPool.unload();
+            transcriptStore.stop();
+            audioArchive.stop();
+            std::lock_guard<std::mutex> lck(tapsMtx);
+            for (auto& tap : taps) { tap->stop(); }
+            taps.clear();
+        }
+
+        // Once SDR++ has loaded every module: load the model, tap the default stream and start the workers
+        void start() {
+            // Whisper models live next to the executable unless configured otherwise
+            config.acquire();
+            whisperModelDir = config.conf["whisperModelDir"];
+            whisperModel = config.conf["whisperModel"];
+            decodeBacklogSec = std::clamp<int>(config.conf["decodeBacklogSec"], DECODE_BACKLOG_MIN_SEC, DECODE_BACKLOG_MAX_SEC);
+            shedPolicy = shedPolicyFromName(config.conf["shedPolicy"]);
+            config.release();
+            if (whisperModelDir.empty()) {
+                char exePath[PATH_MAX];
+                ssize_t len = readlink("/proc/self/exe", exePath, sizeof(exePath) - 1);
+                if (len != -1) {
+                    exePath[len] = '\0';
+                    std::string exeDir = std::string(exePath);
+                    size_t lastSlash = exeDir.find_last_of("/");
+                    if (lastSlash != std::string::npos) {
+                        exeDir = exeDir.substr(0, lastSlash);
+                    }
+                    whisperModelDir = exeDir;
+                } else {
+                    logStore.push("[ERROR] Could not determine executable path. Cannot load Whisper model.");
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lck(whisperModelMtx);
+                scanWhisperModels();
+            }
+
+            // Transmissions go to decode worker processes if any are configured, a local model isn't loaded then
+            RemoteDecoders::Config remoteConfig;
+            config.acquire();
+            remoteConfig.workers = config.conf["decodeWorkers"].get<std::vector<std::string>>();
+            config.release();
+            if (!remoteConfig.workers.empty()) {
+                remoteDecoding = remoteDecoders.start(remoteConfig, [this](const std::string& message) { logStore.push("[DECODE] " + message); });
+                if (remoteDecoding) {
+                    logStore.push("[DECODE] Decoding on " + std::to_string(remoteConfig.workers.size()) + " workers, no local Whisper model.");
+                } else {
+                    logStore.push("[DECODE] " + remoteDecoders.getError() + ", decoding locally.");
+                }
+            }
+
+            // The model loads in the background, transmissions queue up for it in the meantime
+            if (!remoteDecoding) { decoderPool.start(DECODER_STATE_COUNT); }
+            applyDecodeQueueConfig();
+            decodeScheduler.configure(DecodeScheduler::Config(), decoderPool.getStateCount());
+            if (!whisperModelDir.empty() && !remoteDecoding) { loadWhisperModel(whisperModel); }
+
+            addTap(DEFAULT_STREAM_NAME);
+
+            ollamaMonitorThread = std::thread(&Pipeline::ollamaMonitorLoop, this);
+            whisperWorker = std::thread(&Pipeline::whisperWorkerLoop, this);
+
+            // Control socket, an empty path turns it off
+            config.acquire();
+            std::string controlPath = config.conf["controlSocket"];
+            config.release();
+            if (controlPath.empty()) { return; }
+            if (controlServer.start(controlPath, { "transcripts", "alerts", "log" }, [this](const std::string& command, const std::string& args) { return control(command, args); })) {
+                logStore.push("[CONTROL] Listening on " + controlPath + ".");
+            } else {
+                logStore.push("[CONTROL] " + controlServer.getError() + ", no control socket.");
+            }
+        }
+
+        // Commands of the control socket, on its thread. Replies are a single line.
+        std::string control(const std::string& command, const std::string& args) {
+            if (command == "HUNT" || command == "AI") {
+                std::atomic<bool>& active = (command == "HUNT") ? voiceHuntActive : atakAiActive;
+                if (args == "on" || args == "off") {
+                    active = (args == "on");
+                    logStore.push(std::string("[CONTROL] ") + (command == "HUNT" ? "VoxHunt " : "W.A.L.T.E.R ") + args + ".");
+                } else if (!args.empty()) {
+                    return "ERR expected on or off";
+                }
+                return std::string("OK ") + (active ? "on" : "off");
+            }
+            if (command == "CHAT") {
+                if (args.empty()) { return "ERR nothing to send"; }
+                if (!sendOperatorMessage(args)) { return "ERR W.A.L.T.E.R is off or has no model"; }
+                return "OK the answer follows on the log topic";
+            }
+            if (command == "STATS") { return "OK " + getStats(); }
+            if (command == "HELP") { return "OK HUNT [on|off], AI [on|off], CHAT <text>, STATS, SUB|UNSUB <transcripts|alerts|log>"; }
+            return "ERR unknown command, try HELP";
+        }
+
+        // Pipeline state as space separated key=value pairs
+        std::string getStats() {
+            int channels;
+            {
+                std::lock_guard<std::mutex> lck(tapsMtx);
+                channels = (int)taps.size();
+            }
+            std::string model = remoteDecoding ? "remote" : decoderPool.getModelPath();
+            model = model.empty() ? "none" : model.substr(model.find_last_of('/') + 1);
+            char stats[512];
+            snprintf(stats, sizeof(stats), "hunt=%s ai=%s channels=%d segments=%llu decodes=%llu decode_p50_ms=%.0f rtf=%.2f backlog_s=%.1f model=%s workers=%d/%zu "
+                     "transcripts=%zu alerts=%llu llm_queued=%d llm_running=%d ollama=%s clients=%d",
+                     voiceHuntActive ? "on" : "off", atakAiActive ? "on" : "off", channels, (unsigned long long)segmentsTotal.get(),
+                     (unsigned long long)whisperFinalSeconds.count(), whisperFinalSeconds.quantile(0.5) * 1e3, whisperRtf.get(),
+                     (double)pendingDecodeSamples / WHISPER_SAMPLE_RATE, model.c_str(), remoteDecoders.getReadyCount(), remoteDecoders.getWorkers().size(), transcriptStore.size(),
+                     (unsigned long long)(keywordMatches[0].get() + keywordMatches[1].get()), llmExecutor.queued(), llmExecutor.inFlight(),
+                     ollamaRunning ? "up" : "down", controlServer.getClientCount());
+            return stats;
+        }
+
+        void setLogJsonl(bool jsonl) {
+            logJsonl = jsonl;
+            logWriter.setJsonl(jsonl);
+            config.acquire();
+            config.conf["logJsonl"] = jsonl;
+            config.release(true);
+        }
+
+        void selectWhisperModel(const std::string& fileName) {
+            {
+                std::lock_guard<std::mutex> lck(whisperModelMtx);
+                whisperModel = fileName;
+            }
+            config.acquire();
+            config.conf["whisperModel"] = fileName;
+            config.release(true);
+            loadWhisperModel(fileName);
+        }
+
+        void setDecodeBacklog(int sec, ShedPolicy policy) {
+            decodeBacklogSec = std::clamp<int>(sec, DECODE_BACKLOG_MIN_SEC, DECODE_BACKLOG_MAX_SEC);
+            shedPolicy = policy;
+            config.acquire();
+            config.conf["decodeBacklogSec"] = (int)decodeBacklogSec;
+            config.conf["shedPolicy"] = SHED_POLICY_NAMES[policy];
+            config.release(true);
+            applyDecodeQueueConfig();
+        }
+
+        void setBatchWindow(int windowMs) {
+            AnalysisStage::Config analysisConfig;
+            llmBatchWindowMs = windowMs;
+            config.acquire();
+            config.conf["llmBatchWindowMs"] = windowMs;
+            analysisConfig.maxInFlight = std::max<int>(1, config.conf["llmMaxInFlight"]);
+            config.release(true);
+            analysisConfig.windowMs = windowMs;
+            analysisStage.configure(analysisConfig);
+        }
+
+        void setLlmRetrieval(bool retrieval) {
+            llmRetrieval = retrieval;
+            config.acquire();
+            config.conf["llmRetrieval"] = retrieval;
+            config.release(true);
+        }
+
+        void setKeywordBoost(int boost, int boostSec) {
+            keywordBoost = std::max<int>(0, boost);
+            keywordBoostSec = std::max<int>(0, boostSec);
+            config.acquire();
+            config.conf["keywordBoost"] = (int)keywordBoost;
+            config.conf["keywordBoostSec"] = (int)keywordBoostSec;
+            config.release(true);
+        }
+
+        // Saved and the model list fetched again if the URL is valid. UI thread.
+        void setOllamaUrl(const std::string& url) {
+            ollamaUrl = url;
+            if (!applyOllamaUrl()) { return; }
+            config.acquire();
+            config.conf["ollamaUrl"] = ollamaUrl;
+            config.release(true);
+            modelsLoaded = false;
+            wakeOllamaMonitor();
+        }
+
+        // Switch W.A.L.T.E.R to another of the models listed by getOllamaModels(), the old one is unloaded and the new
+        // one warmed up in the background
+        void selectOllamaModel(int index) {
+            std::string newModelName, oldModelName;
+            {
+                std::lock_guard<std::mutex> lck(modelsMtx);
+                if (selectedModelIndex == index || index < 0 || index >= (int)availableModels.size()) { return; }
+                if (selectedModelIndex < (int)availableModels.size()) { oldModelName = availableModels[selectedModelIndex]; }
+                newModelName = availableModels[index];
+                selectedModelIndex = index;
+            }
+            std::thread(&Pipeline::warmupModel, this, newModelName, oldModelName).detach();
+        }
+
+        // Copy of the Ollama models and the index of the selected one. The monitor replaces the list when models are
+        // pulled or removed, the UI draws from the copy.
+        std::vector<std::string> getOllamaModels(int& selected) {
+            std::lock_guard<std::mutex> lck(modelsMtx);
+            selected = selectedModelIndex;
+            return availableModels;
+        }
+
+        // Queue an operator chat message, the reply streams into the log. False if W.A.L.T.E.R can't answer.
+        bool sendOperatorMessage(const std::string& message) {
+            logStore.push("OPERATOR: " + message);
+            if (!(atakAiActive && ollamaRunning && modelsLoaded)) { return false; }
+            std::string model = selectedOllamaModel();
+            if (model.empty()) { return false; }
+
+            // The message only joins the conversation once it's answered, the intercepts recalled for it never do
+            recallIntercepts(message, INT64_MAX, [this, model, message](const std::string& recalled) {
+                std::string prompt = recalled.empty() ? message : recalled + "\n\n" + message;
+                uint64_t streamKey;
+                {
+                    std::lock_guard<std::mutex> lock(logMutex);
+                    streamKey = beginLlmStream("[AI ...] ");
+                }
+                llmExecutor.submitBody("/api/chat", conversation.chatBody(model, LLM_CHAT_OPTIONS, &prompt), llmTokenHandler(streamKey),
+                                       [this, streamKey, model, message](bool success, const std::string& aiText, const std::string& error) {
+                    {
+                        std::lock_guard<std::mutex> lock(logMutex);
+                        llmStreams.erase(streamKey);
+                        if (!success) {
+                            logStore.push("[AI Error] HTTP or JSON error: " + error);
+                            return;
+                        }
+                        logStore.push("[AI] " + aiText);
+                    }
+                    conversation.append("user", message);
+                    conversation.append("assistant", aiText);
+                    compactMemory(model);
+                });
+            });
+            return true;
+        }
+
+        // List the ggml-*.bin models in the model directory, smallest (fastest) first. Requires whisperModelMtx.
+        void scanWhisperModels() {
+            whisperModels.clear();
+            DIR* dir = opendir(whisperModelDir.c_str());
+            if (!dir) { return; }
+            while (dirent* entry = readdir(dir)) {
+                std::string fileName = entry->d_name;
+                if (fileName.rfind("ggml-", 0) != 0 || fileName.size() < 9 || fileName.compare(fileName.size() - 4, 4, ".bin")) { continue; }
+                struct stat st;
+                if (stat((whisperModelDir + "/" + fileName).c_str(), &st) || !S_ISREG(st.st_mode)) { continue; }
+                whisperModels.push_back(WhisperModelFile{ fileName, (size_t)(st.st_size >> 20) });
+            }
+            closedir(dir);
+            std::sort(whisperModels.begin(), whisperModels.end(), [](const WhisperModelFile& a, const WhisperModelFile& b) {
+                return (a.sizeMb != b.sizeMb) ? a.sizeMb < b.sizeMb : a.name < b.name;
+            });
+        }
+
+
+        void addTap(std::string streamName) {
+            auto tap = std::make_shared<AudioTap>(nextTapId++, streamName, AUDIO_RING_CAPACITY, WHISPER_SAMPLE_RATE);
+            tap->setDoorbell(&workerBell, WORKER_WAKE_SAMPLES);
+            bool bound = tap->start();
+            registerTapMetrics(tap);
+            {
+                std::lock_guard<std::mutex> lck(tapsMtx);
+                taps.push_back(tap);
+            }
+            if (bound) {
+                logStore.push("Successfully bound to '" + streamName + "' audio stream.");
+            } else {
+                logStore.push("Error: Could not bind to '" + streamName + "' audio stream. Waiting for it to appear.");
+            }
+        }
+
+        void removeTap(int id) {
+            std::lock_guard<std::mutex> lck(tapsMtx);
+            for (auto it = taps.begin(); it != taps.end(); it++) {
+                if ((*it)->id != id) { continue; }
+                // Pending decoder jobs may still hold a reference, unbind now rather than when they finish
+                (*it)->stop();
+                metrics.removeLabels(tapLabels(**it));
+                {
+                    std::lock_guard<std::mutex> lock(logMutex);
+                    partialTranscripts.erase((*it)->streamName);
+                }
+                taps.erase(it);
+                return;
+            }
+        }
+
+        // Decode an archived transmission again with the model loaded now, with beam search. Replays queue
+        // behind live traffic and are the first to be shed or interrupted.
+        void replayTranscript(const TranscriptStore::Record& record) {
+            AudioArchive::Entry entry;
+            if (!audioArchive.find(record.channel, record.timeMs, entry)) {
+                logStore.push("[REPLAY][" + record.channel + "] No archived audio for this transmission.");
+                return;
+            }
+            DecoderPool::JobInfo info;
+            info.channel = REPLAY_DECODE_CHANNEL;
+            info.priority = REPLAY_DECODE_PRIORITY;
+            if (remoteDecoding) {
+                std::vector<float> samples;
+                if (!audioArchive.read(entry.id, samples)) {
+                    logStore.push("[REPLAY][" + entry.channel + "] Archived audio expired or unreadable.");
+                    return;
+                }
+                remoteDecoders.submit(info, samples, 5, [this, entry](bool success, const std::string& transcript, double, const std::string& worker) {
+                    if (!success) {
+                        logStore.push("[REPLAY][" + entry.channel + "] Decode workers failed, " + transcript + ".");
+                        return;
+                    }
+                    logStore.push("[REPLAY][" + entry.channel + "] " + transcript + " (" + worker + ")");
+                    replaysDecoded.add();
+                }, [this, entry]() {
+                    logStore.push("[REPLAY][" + entry.channel + "] Decoders are busy with live traffic, replay dropped.");
+                });
+                return;
+            }
+            decoderPool.submit(info, [this, entry](whisper_context* ctx, whisper_state* state, int nThreads, DecoderPool::Cancel& cancel) {
+                std::vector<float> samples;
+                if (!audioArchive.read(entry.id, samples)) {
+                    logStore.push("[REPLAY][" + entry.channel + "] Archived audio expired or unreadable.");
+                    return;
+                }
+                if (samples.size() < WHISPER_MIN_SAMPLES) { samples.resize(WHISPER_MIN_SAMPLES, 0.0f); }
+                whisper_full_params params = whisperParams(5, nThreads, 0);
+                cancel.attach(params);
+                if (whisper_full_with_state(ctx, state, params, samples.data(), samples.size()) != 0 || cancel.interrupted()) { return; }
+                std::string transcript;
+                int n_segments = whisper_full_n_segments_from_state(state);
+                for (int i = 0; i < n_segments; ++i) {
+                    transcript += whisper_full_get_segment_text_from_state(state, i);
+                }
+                std::string model = decoderPool.getModelPath();
+                model = model.substr(model.find_last_of('/') + 1);
+                logStore.push("[REPLAY][" + entry.channel + "] " + transcript + " (" + model + ")");
+                replaysDecoded.add();
+            }, [this, entry]() {
+                logStore.push("[REPLAY][" + entry.channel + "] Decoders are busy with live traffic, replay dropped.");
+            });
+        }
+
+        static int64_t nowUnixMs() {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        // Unix ms as "YYYY-MM-DD HH:MM:SS" local time
+        static std::string formatLocalTime(int64_t timeMs) {
+            time_t sec = (time_t)(timeMs / 1000);
+            tm local;
+            localtime_r(&sec, &local);
+            char when[32];
+            strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &local);
+            return when;
+        }
+
+        // Hunting (capturing and transcribing transmissions) and analysis by W.A.L.T.E.R
+        std::atomic<bool> voiceHuntActive = false;
+        std::atomic<bool> atakAiActive = false;
+
+        // Log State
+        LogWriter logWriter;            // Declared before the store so it outlives it
+        ControlServer controlServer;    // So does the socket, the store's sink publishes to it
+        LogStore logStore{ LOG_CAPACITY };
+        std::atomic<bool> logJsonl = false;
+        std::mutex logMutex; // Guards the in-progress lines below, the conversation and model state
+        std::map<uint64_t, std::string> llmStreams; // LLM responses still being generated
+        std::map<std::string, std::string> partialTranscripts; // Transmissions in progress per stream (streaming mode), rewritten as they're decoded
+
+        // Audio Processing State (one tap per monitored audio stream)
+        const std::string DEFAULT_STREAM_NAME = "Radio";
+        std::vector<std::shared_ptr<AudioTap>> taps;
+        std::mutex tapsMtx;
+
+        // Scanner State
+        Scanner scanner;
+
+        // Whisper State
+        DecoderPool decoderPool;
+        RemoteDecoders remoteDecoders;              // Used instead of the pool when decodeWorkers lists any
+        std::atomic<bool> remoteDecoding = false;
+        DecodeScheduler decodeScheduler;
+        std::mutex whisperModelMtx;     // The downgrade policy changes the model from the Whisper worker
+        std::string whisperModel;       // File name in whisperModelDir
+        struct WhisperModelFile {
+            std::string name;
+            size_t sizeMb;
+        };
+        std::vector<WhisperModelFile> whisperModels;
+        std::atomic<int> decodeBacklogSec = 60;
+        std::atomic<ShedPolicy> shedPolicy = SHED_POLICY_OLDEST;
+        std::atomic<bool> streamingMode = false;
+        std::atomic<int64_t> pendingDecodeSamples = 0;
+
+        // Transmission segmentation settings
+        std::atomic<float> vadThresholdDb = 9.0f;
+        std::atomic<float> vadHangMs = 800.0f;
+        std::atomic<float> vadPreRollMs = 300.0f;
+
+        // Ollama State
+        // Declared before the executor so it outlives it
+        http::ConnectionPool ollamaPool;
+        std::string ollamaUrl;
+        LlmExecutor llmExecutor;
+        AnalysisStage analysisStage;
+        std::atomic<int> llmBatchWindowMs = 2000;
+        ConversationMemory conversation;
+        std::mutex modelsMtx;   // Guards availableModels and selectedModelIndex, read by the UI and the LLM paths
+        std::vector<std::string> availableModels;
+        int selectedModelIndex = 0;
+        std::atomic<bool> modelsLoaded = false;
+        std::atomic<bool> ollamaRunning = false;
+        std::atomic<bool> isWarmingModel = false;
+        std::string warmingStatusMessage = "";
+
+        // Watchlist, matched on decoder threads
+        KeywordSpotter keywordSpotter;
+        std::atomic<int> keywordBoost = 1;     // Priority added to a channel when a '!' term is heard
+        std::atomic<int> keywordBoostSec = 300;
+
+        // Transcript store, compressed audio of every transmission, and replays of it through the decoders
+        TranscriptStore transcriptStore;
+        AudioArchive audioArchive;
+        telemetry::Counter replaysDecoded;
+
+        // Transcript embeddings, for search by meaning and retrieval for the LLM. Embedding queries call
+        // back into the pipeline and the UI, the stage is stopped early in the destructor.
+        VectorIndex vectorIndex;
+        EmbeddingStage embeddingStage;
+        bool embeddingEnabled = false;
+        std::atomic<bool> llmRetrieval = true;
+        telemetry::Counter llmRetrievals;
+
+        // Telemetry, the exporter is stopped first thing in the destructor
+        telemetry::Registry metrics;
+        telemetry::Exporter metricsExporter;
+        telemetry::Histogram workerLoopSeconds;
+        telemetry::Counter segmentsTotal;
+        telemetry::Counter modelDowngrades;
+        telemetry::Counter decodesPreempted;
+        telemetry::Counter decodesRestarted;
+        telemetry::Gauge whisperModelLoaded;
+        telemetry::Histogram whisperModelLoadSeconds;
+        telemetry::Histogram whisperFinalSeconds;
+        telemetry::Histogram whisperPartialSeconds;
+        telemetry::Counter whisperAudioSamples;
+        telemetry::Gauge whisperRtf;
+        telemetry::Gauge decodeBacklogSeconds;
+        telemetry::Gauge decodeQueueJobs;
+        telemetry::Gauge decodeQueueSeconds;
+        telemetry::Gauge decodeThreads;
+        telemetry::Gauge decodeMode;
+        telemetry::Gauge dspCoresBusy;
+        static constexpr double BATCH_SIZE_BOUNDS[] = { 1, 2, 3, 4, 6, 8, 12, 16 };
+        telemetry::Counter transcriptsSkipped[NOISE_COUNT];     // NOISE_NONE counts the ones queued
+        telemetry::Histogram analysisBatchSize = telemetry::Histogram(BATCH_SIZE_BOUNDS, sizeof(BATCH_SIZE_BOUNDS) / sizeof(double));
+        telemetry::Gauge analysisWaiting;
+        telemetry::Gauge llmQueueLength;
+        telemetry::Gauge llmInFlight;
+        telemetry::Gauge ollamaUp;
+        telemetry::Histogram warmupSeconds;
+        telemetry::Counter warmupFailures;
+        telemetry::Counter memoryCompactions;
+        telemetry::Counter keywordMatches[2];   // Exact, fuzzy
+        telemetry::Histogram keywordMatchSeconds;
+
+    private:
+        static void streamRegisteredHandlerFn(std::string streamName, void* ctx) {
+            Pipeline* _this = (Pipeline*)ctx;
+            std::lock_guard<std::mutex> lck(_this->tapsMtx);
+            for (auto& tap : _this->taps) {
+                if (tap->streamName == streamName && !tap->isRunning() && tap->start()) {
+                    _this->logStore.push("[AUDIO] Rebound to '" + streamName + "' audio stream.");
+                }
+            }
+        }
+
+        static void streamUnregisterHandlerFn(std::string streamName, void* ctx) {
+            Pipeline* _this = (Pipeline*)ctx;
+            std::lock_guard<std::mutex> lck(_this->tapsMtx);
+            for (auto& tap : _this->taps) {
+                if (tap->streamName == streamName && tap->isRunning()) {
+                    tap->stop();
+                    _this->logStore.push("[AUDIO] '" + streamName + "' audio stream went away, waiting for it to come back.");
+                }
+            }
+        }
+
+        // UI thread, every frame. The taps' tuning is refreshed a few times a second.
+        static void fftRedrawHandlerFn(ImGui::WaterFall::FFTRedrawArgs, void* ctx) {
+            Pipeline* _this = (Pipeline*)ctx;
+            auto now = std::chrono::steady_clock::now();
+            if (now - _this->lastTuningRefresh < std::chrono::milliseconds(TUNING_REFRESH_MS)) { return; }
+            _this->lastTuningRefresh = now;
+            std::lock_guard<std::mutex> lck(_this->tapsMtx);
+            for (auto& tap : _this->taps) { refreshTuning(*tap); }
+        }
+
+        // Reads SDR++'s VFO and radio state, UI thread only
+        static void refreshTuning(AudioTap& tap) {
+            double frequency = 0.0;
+            std::string mode;
+            if (sigpath::vfoManager.vfoExists(tap.streamName)) {
+                frequency = gui::waterfall.getCenterFrequency() + sigpath::vfoManager.getOffset(tap.streamName);
+            }
+            int modeId = -1;
+            if (core::modComManager.interfaceExists(tap.streamName) && core::modComManager.getModuleName(tap.streamName) == "radio" &&
+                core::modComManager.callInterface(tap.streamName, RADIO_IFACE_CMD_GET_MODE, NULL, &modeId) &&
+                modeId >= 0 && modeId < (int)(sizeof(RADIO_MODE_NAMES) / sizeof(RADIO_MODE_NAMES[0]))) {
+                mode = RADIO_MODE_NAMES[modeId];
+            }
+            tap.setTuning(frequency, mode);
+        }
+
+        // Load a model in the background, decoding switches over to it once it's ready
+        void loadWhisperModel(const std::string& fileName) {
+            std::string path = whisperModelDir + "/" + fileName;
+            logStore.push("[WHISPER] Loading model " + path + "...");
+            decoderPool.loadAsync(path, [this](bool success, const std::string& modelPath, double seconds) {
+                if (!success) {
+                    std::string current = decoderPool.getModelPath();
+                    logStore.push("[WHISPER] Failed to load model " + modelPath + (current.empty() ? "." : ", still using " + current + "."));
+                    return;
+                }
+                whisperModelLoadSeconds.observe(seconds);
+                char took[32];
+                snprintf(took, sizeof(took), "%.1f", seconds);
+                logStore.push("[WHISPER] Model " + modelPath + " ready after " + took + " s (" + std::to_string(decoderPool.getStateCount()) + " decoder states, " + std::to_string(decoderPool.getThreadsPerState()) + " threads each).");
+            });
+        }
+
+        static ShedPolicy shedPolicyFromName(const std::string& name) {
+            for (int i = 0; i < SHED_POLICY_COUNT; i++) {
+                if (name == SHED_POLICY_NAMES[i]) { return (ShedPolicy)i; }
+            }
+            return SHED_POLICY_OLDEST;
+        }
+
+        void applyDecodeQueueConfig() {
+            DecoderPool::QueueConfig qcfg;
+            qcfg.maxSamples = (size_t)decodeBacklogSec * WHISPER_SAMPLE_RATE;
+            qcfg.policy = (shedPolicy == SHED_POLICY_OLDEST) ? DecoderPool::SHED_OLDEST : DecoderPool::SHED_LOWEST_SCORE;
+            qcfg.priorityWeight = DECODE_PRIORITY_WEIGHT;
+            // A higher priority channel keying up doesn't wait for a lower priority decode to finish
+            qcfg.preempt = true;
+            // Downgrading takes a model load to help, give the queue room to ride it out
+            if (shedPolicy == SHED_POLICY_DOWNGRADE) { qcfg.maxSamples *= 2; }
+            decoderPool.configureQueue(qcfg);
+            remoteDecoders.configureQueue(qcfg);
+        }
+
+        // Called by the decoder pool instead of decoding a transmission it had to shed, from whichever thread
+        // submitted or reconfigured. The transmission is gone, so is its progress.
+        void segmentShed(const std::shared_ptr<AudioTap>& tap, size_t samples) {
+            pendingDecodeSamples -= samples;
+            tap->segmentsShed.add();
+            tap->streamerStale = true;
+            {
+                std::lock_guard<std::mutex> lock(logMutex);
+                partialTranscripts.erase(tap->streamName);
+            }
+            char len[32];
+            snprintf(len, sizeof(len), "%.1f", (double)samples / WHISPER_SAMPLE_RATE);
+            logStore.push("[WHISPER][" + tap->streamName + "] Decoders are behind, " + len + " s transmission dropped (" + SHED_POLICY_NAMES[shedPolicy] + ").");
+        }
+
+        // Downgrade policy: when the backlog outgrows its bound, switch to the next smaller model. Whisper worker thread.
+        void checkModelDowngrade(std::chrono::steady_clock::time_point now) {
+            if (shedPolicy != SHED_POLICY_DOWNGRADE || decoderPool.getModelState() != DecoderPool::MODEL_READY) { return; }
+            if (pendingDecodeSamples <= (int64_t)decodeBacklogSec * WHISPER_SAMPLE_RATE) { return; }
+            if (lastDowngrade.time_since_epoch().count() && now - lastDowngrade < std::chrono::seconds(MODEL_DOWNGRADE_COOLDOWN_SEC)) { return; }
+
+            std::string loaded = decoderPool.getModelPath();
+            std::string smaller;
+            {
+                std::lock_guard<std::mutex> lck(whisperModelMtx);
+                // Models are listed smallest first. One that isn't listed (renamed, deleted, another directory)
+                // has no known smaller model.
+                bool found = false;
+                for (auto& model : whisperModels) {
+                    if (whisperModelDir + "/" + model.name == loaded) {
+                        found = true;
+                        break;
+                    }
+                    smaller = model.name;
+                }
+                if (!found || smaller.empty()) { return; }
+                // Not saved, the configured model is loaded again on the next start
+                whisperModel = smaller;
+            }
+            lastDowngrade = now;
+            modelDowngrades.add();
+            logStore.push("[WHISPER] Decoders are " + std::to_string(pendingDecodeSamples / WHISPER_SAMPLE_RATE) + " s behind, switching to the smaller " + smaller + ".");
+            loadWhisperModel(smaller);
+        }
+
+        // Called by the connection pool whenever a request (probe or real) changes the server's reachability
+        void ollamaReachabilityChanged(bool reachable) {
+            ollamaRunning = reachable;
+            ollamaUp.set(reachable ? 1.0 : 0.0);
+            logStore.push(reachable ? "[OLLAMA Status Check] Ollama detected as running." : "[OLLAMA Status Check] Ollama not detected as running.");
+            wakeOllamaMonitor();
+        }
+
+        void wakeOllamaMonitor() {
+            {
+                std::lock_guard<std::mutex> lck(ollamaMonitorMtx);
+                ollamaMonitorWake = true;
+            }
+            ollamaMonitorCnd.notify_all();
+        }
+
+        void ollamaMonitorLoop() {
+            int backoffMs = OLLAMA_BACKOFF_MIN_MS;
+            auto lastTagsCheck = std::chrono::steady_clock::time_point();
+            while (!stopOllamaMonitor) {
+                // Real requests answering recently are proof enough, otherwise probe the cheapest endpoint.
+                // The pool opens connections non-blocking with a timeout and reuses them when idle.
+                if (!ollamaPool.isReachable() || ollamaPool.getMsSinceLastResponse() >= OLLAMA_PROBE_INTERVAL_MS) {
+                    try {
+                        ollamaPool.get("/api/version");
+                    } catch (const std::exception&) {
+                        // Reported through the reachability handler
+                    }
+                }
+
+                int waitMs;
+                if (ollamaPool.isReachable()) {
+                    backoffMs = OLLAMA_BACKOFF_MIN_MS;
+                    auto now = std::chrono::steady_clock::now();
+                    if (!modelsLoaded || now - lastTagsCheck >= std::chrono::milliseconds(OLLAMA_TAGS_INTERVAL_MS)) {
+                        fetchOllamaModels();
+                        lastTagsCheck = now;
+                    }
+                    waitMs = OLLAMA_PROBE_INTERVAL_MS;
+                } else {
+                    waitMs = backoffMs;
+                    backoffMs = std::min<int>(backoffMs * 2, OLLAMA_BACKOFF_MAX_MS);
+                }
+
+                std::unique_lock<std::mutex> lck(ollamaMonitorMtx);
+                ollamaMonitorCnd.wait_for(lck, std::chrono::milliseconds(waitMs), [this]() { return stopOllamaMonitor || ollamaMonitorWake; });
+                ollamaMonitorWake = false;
+            }
+        }
+
+        // Point the connection pool at the configured Ollama URL
+        bool applyOllamaUrl() {
+            http::ConnectionPool::Config pcfg = ollamaPool.getConfig();
+            if (!http::parseUrl(ollamaUrl, pcfg.host, pcfg.port)) {
+                logStore.push("[OLLAMA Error] Invalid Ollama URL: " + ollamaUrl);
+                return false;
+            }
+            config.acquire();
+            pcfg.connectTimeoutMs = config.conf["connectTimeoutMs"];
+            pcfg.requestTimeoutMs = config.conf["requestTimeoutMs"];
+            config.release();
+            ollamaPool.configure(pcfg);
+            return true;
+        }
+
+        void fetchOllamaModels() {
+            std::string ollamaResponse;
+            try {
+                ollamaResponse = ollamaPool.get("/api/tags");
+                json responseJson = ollamaResponse.empty() ? json() : json::parse(ollamaResponse);
+
+                // Only rebuild the list when the set of models (names and digests) actually changed
+                std::string digest;
+                if (responseJson.contains("models") && responseJson["models"].is_array()) {
+                    for (const auto& model : responseJson["models"]) {
+                        digest += model.value("name", "") + "@" + model.value("digest", "") + ";";
+                    }
+                }
+                if (modelsLoaded && digest == ollamaTagsDigest) { return; }
+                ollamaTagsDigest = digest;
+
+                std::lock_guard<std::mutex> lock(logMutex); // Lock for logging
+                logStore.push("[OLLAMA] Raw API response: " + ollamaResponse); // Log raw response for debugging
+
+                if (ollamaResponse.empty()) {
+                    logStore.push("[OLLAMA Error] Empty response from Ollama API. Is the server running?");
+                    modelsLoaded = false;
+                    return;
+                }
+
+                if (responseJson.contains("models") && responseJson["models"].is_array()) {
+                    logStore.push("[OLLAMA] Detected models:");
+                    // Keep the current selection if the model is still there. The list is built aside and swapped in,
+                    // the UI never sees it half done.
+                    std::string selectedName = selectedOllamaModel();
+                    std::vector<std::string> models;
+                    int selected = 0;
+                    for (const auto& model : responseJson["models"]) {
+                        if (model.contains("name") && model["name"].is_string()) {
+                            models.push_back(model["name"].get<std::string>());
+                            logStore.push("  - " + model["name"].get<std::string>());
+                            if (models.back() == selectedName) { selected = models.size() - 1; }
+                            // Check if the default model "llama3:8b" is available and select it
+                            if (selectedName.empty() && models.back() == "llama3:8b" && selected == 0) {
+                                selected = models.size() - 1; // Select this model if it's the default and not already set
+                            }
+                        }
+                    }
+                    bool found = !models.empty();
+                    {
+                        std::lock_guard<std::mutex> lck(modelsMtx);
+                        availableModels.swap(models);
+                        selectedModelIndex = selected;
+                    }
+                    if (found) {
+                        modelsLoaded = true;
+                    } else {
+                        logStore.push("[OLLAMA] No models found.");
+                        modelsLoaded = false;
+                    }
+                } else {
+                    logStore.push("[OLLAMA Error] API response did not contain 'models' array or was malformed.");
+                    modelsLoaded = false;
+                }
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(logMutex);
+                logStore.push("[OLLAMA Error] Failed to fetch models: " + std::string(e.what()));
+                if (!ollamaResponse.empty()) {
+                    logStore.push("[OLLAMA Error] Response that caused error: " + ollamaResponse);
+                }
+                modelsLoaded = false;
+            }
+        }
+
+        void whisperWorkerLoop() {
+            std::vector<VadSegment> segments;
+            auto lastDspLoad = std::chrono::steady_clock::now();
+
+            while (!stopWhisperWorker) {
+                // Segmenter settings from the UI, shared by every channel
+                VadSegmenter::Config vadConfig;
+                vadConfig.sampleRate = WHISPER_SAMPLE_RATE;
+                vadConfig.hangMs = vadHangMs;
+                vadConfig.preRollMs = vadPreRollMs;
+                vadConfig.openDb = vadThresholdDb;
+                vadConfig.closeDb = std::max<float>(vadThresholdDb - 3.0f, 1.0f);
+
+                std::vector<std::shared_ptr<AudioTap>> activeTaps;
+                {
+                    std::lock_guard<std::mutex> lck(tapsMtx);
+                    activeTaps = taps;
+                }
+                bool voiceActive = false;
+                {
+                    telemetry::ScopedTimer timer(workerLoopSeconds);
+                    for (auto& tap : activeTaps) {
+                        processTap(tap, vadConfig, segments);
+                        voiceActive |= tap->segmenter.isActive();
+                    }
+                }
+                // Keep the scanner on the channel while someone is talking
+                scanner.setVoiceActive(voiceActive);
+
+                if (remoteDecoding) {
+                    decodeQueueJobs.set(remoteDecoders.pending());
+                    whisperModelLoaded.set(remoteDecoders.getReadyCount() > 0);
+                    decodeQueueSeconds.set((double)remoteDecoders.pendingSamples() / WHISPER_SAMPLE_RATE);
+                } else {
+                    decodeQueueJobs.set(decoderPool.pending());
+                    whisperModelLoaded.set(decoderPool.isLoaded());
+                    decodeQueueSeconds.set((double)decoderPool.pendingSamples() / WHISPER_SAMPLE_RATE);
+                }
+                decodeBacklogSeconds.set((double)pendingDecodeSamples / WHISPER_SAMPLE_RATE);
+                analysisWaiting.set(analysisStage.queued());
+                llmQueueLength.set(llmExecutor.queued());
+                llmInFlight.set(llmExecutor.inFlight());
+
+                auto now = std::chrono::steady_clock::now();
+                if (now - lastDspLoad >= std::chrono::milliseconds(DSP_LOAD_INTERVAL_MS)) {
+                    decodeScheduler.updateDspLoad();
+                    dspCoresBusy.set(decodeScheduler.getDspCores());
+                    lastDspLoad = now;
+                    if (keywordSpotter.reloadIfChanged()) {
+                        logStore.push("[WATCH] Watchlist reloaded, " + std::to_string(keywordSpotter.getTermCount()) + " watch terms.");
+                    }
+                    // Without a UI nothing else reads the log, the sink has already seen every line
+                    if (headless) { logStore.update(); }
+                }
+                checkModelDowngrade(now);
+
+                // Sleep until a tap has audio to segment, the taps ring the bell from their DSP threads
+                workerBell.wait(std::chrono::milliseconds(WORKER_IDLE_MS));
+            }
+        }
+
+        void processTap(const std::shared_ptr<AudioTap>& tap, const VadSegmenter::Config& vadConfig, std::vector<VadSegment>& segments) {
+            tap->capture = voiceHuntActive.load();
+            tap->followSampleRate();
+
+            // Pick up segmenter settings changed from the UI
+            const VadSegmenter::Config& current = tap->segmenter.getConfig();
+            if (current.hangMs != vadConfig.hangMs || current.preRollMs != vadConfig.preRollMs || current.openDb != vadConfig.openDb) {
+                tap->segmenter.configure(vadConfig);
+            }
+
+            // Drain the ring span by span straight into the segmenter, nothing is copied under a lock
+            const float* span;
+            size_t spanLen;
+            tap->ringDepth.set(tap->ring.available());
+            while ((spanLen = tap->ring.readSpan(span)) > 0) {
+                tap->segmenter.process(span, spanLen, segments);
+                tap->ring.commit(spanLen);
+            }
+            if (!voiceHuntActive) {
+                tap->segmenter.flush(segments);
+            }
+
+            uint64_t overruns = tap->ring.overruns();
+            if (overruns != tap->lastOverruns) {
+                logStore.push("[AUDIO][" + tap->streamName + "] Ring overrun, " + std::to_string(overruns - tap->lastOverruns) + " samples lost.");
+                tap->samplesDropped.add(overruns - tap->lastOverruns);
+                tap->lastOverruns = overruns;
+            }
+
+            // Only keyed transmissions ever reach the model, one decode per transmission. The queue is
+            // bounded (also while no model is loaded yet), what doesn't fit is shed by the pool.
+            for (auto& segment : segments) {
+                auto seg = std::make_shared<VadSegment>(std::move(segment));
+                bool streaming = streamingMode;
+                tap->lastPartialSize = 0;
+                segmentsTotal.add();
+
+                // Where and when it was heard, taken now since the scanner may retune before it's decoded
+                auto meta = std::make_shared<TranscriptStore::Record>();
+                describeChannel(*tap, *meta);
+                meta->durationSec = (float)seg->samples.size() / WHISPER_SAMPLE_RATE;
+                meta->timeMs = nowUnixMs() - (int64_t)(meta->durationSec * 1000.0f);
+                meta->levelDb = seg->peakDb;
+                meta->snrDb = seg->peakDb - seg->noiseFloorDb;
+
+                // The archive reads the samples on its own thread while they're decoded, nothing is copied
+                AudioArchive::Entry archived;
+                archived.timeMs = meta->timeMs;
+                archived.frequency = meta->frequency;
+                archived.sampleRate = WHISPER_SAMPLE_RATE;
+                archived.channel = tap->streamName;
+                audioArchive.append(std::move(archived), std::shared_ptr<const std::vector<float>>(seg, &seg->samples));
+
+                DecoderPool::JobInfo info;
+                info.channel = tap->id;
+                info.priority = tap->effectivePriority();
+                info.levelDb = seg->peakDb - seg->noiseFloorDb;
+                info.samples = seg->samples.size();
+                pendingDecodeSamples += seg->samples.size();
+                if (remoteDecoding) {
+                    // The worker's own scheduler picks the sampling. Results come back in order per channel.
+                    remoteDecoders.submit(info, seg->samples, -1, [this, tap, seg, meta](bool success, const std::string& transcript, double decodeSec, const std::string&) {
+                        pendingDecodeSamples -= seg->samples.size();
+                        double audioSec = (double)seg->samples.size() / WHISPER_SAMPLE_RATE;
+                        if (!success) {
+                            char len[32];
+                            snprintf(len, sizeof(len), "%.1f", audioSec);
+                            logStore.push("[DECODE][" + tap->streamName + "] " + len + " s transmission lost, " + transcript + ".");
+                            return;
+                        }
+                        whisperFinalSeconds.observe(decodeSec);
+                        whisperAudioSamples.add(seg->samples.size());
+                        whisperRtf.set(decodeSec / audioSec);
+                        handleTranscript(tap, *meta, transcript);
+                    }, [this, tap, seg]() {
+                        segmentShed(tap, seg->samples.size());
+                    });
+                    continue;
+                }
+                decoderPool.submit(info, [this, tap, seg, meta, streaming](whisper_context* ctx, whisper_state* state, int, DecoderPool::Cancel& cancel) {
+                    pendingDecodeSamples -= seg->samples.size();
+                    transcribeSegment(tap, *seg, *meta, streaming, ctx, state, cancel);
+                    // Interrupted decodes are queued again by the pool
+                    if (cancel.interrupted()) {
+                        pendingDecodeSamples += seg->samples.size();
+                        countInterrupted(cancel);
+                    }
+                }, [this, tap, seg]() {
+                    segmentShed(tap, seg->samples.size());
+                });
+            }
+            segments.clear();
+
+            // Partial hypothesis for the transmission still in progress, one in flight per channel
+            size_t step = WHISPER_SAMPLE_RATE / 2;
+            if (streamingMode && decoderPool.isLoaded() && tap->segmenter.isActive() && !tap->partialInFlight) {
+                const std::vector<float>& active = tap->segmenter.getActiveAudio();
+                if (active.size() >= tap->lastPartialSize + step) {
+                    auto snapshot = std::make_shared<std::vector<float>>(active);
+                    tap->lastPartialSize = active.size();
+                    tap->partialInFlight = true;
+                    // Partials hold no audio against the bound, but can still be shed
+                    DecoderPool::JobInfo info;
+                    info.channel = tap->id;
+                    info.priority = tap->effectivePriority();
+                    decoderPool.submit(info, [this, tap, snapshot](whisper_context* ctx, whisper_state* state, int, DecoderPool::Cancel& cancel) {
+                        if (tap->streamer.getContext() != ctx) { tap->streamer.init(ctx); }
+                        if (tap->streamerStale.exchange(false)) { tap->streamer.reset(); }
+                        tap->streamer.setAbortCallback(DecoderPool::Cancel::abortCallback, &cancel);
+                        // Partials are always greedy with truncated context, only the thread count is scheduled
+                        DecodeScheduler::Plan plan = decodeScheduler.begin(snapshot->size(), (double)pendingDecodeSamples / WHISPER_SAMPLE_RATE);
+                        StreamingTranscriber::Config scfg = tap->streamer.getConfig();
+                        scfg.nThreads = plan.nThreads;
+                        tap->streamer.configure(scfg);
+                        bool updated;
+                        auto partialStart = std::chrono::steady_clock::now();
+                        {
+                            telemetry::ScopedTimer timer(whisperPartialSeconds);
+                            updated = tap->streamer.update(*snapshot, state);
+                        }
+                        decodeScheduler.end(std::chrono::duration<double>(std::chrono::steady_clock::now() - partialStart).count(), 0.0, false);
+                        if (cancel.interrupted()) {
+                            // Runs again, still in flight
+                            countInterrupted(cancel);
+                            return;
+                        }
+                        if (updated) {
+                            std::lock_guard<std::mutex> lock(logMutex);
+                            partialTranscripts[tap->streamName] = tap->streamer.getPartial();
+                        }
+                        tap->partialInFlight = false;
+                    }, [tap]() {
+                        tap->partialInFlight = false;
+                    });
+                }
+            }
+        }
+
+        void countInterrupted(const DecoderPool::Cancel& cancel) {
+            switch (cancel.getReason()) {
+            case DecoderPool::Cancel::REASON_PREEMPT:       decodesPreempted.add(); break;
+            case DecoderPool::Cancel::REASON_MODEL_SWAP:    decodesRestarted.add(); break;
+            default: break;
+            }
+        }
+
+        // Frequency and demodulator of the VFO behind an audio stream (the radio module names both after itself)
+        // Channel, frequency and mode as last seen by the UI thread
+        void describeChannel(AudioTap& tap, TranscriptStore::Record& record) {
+            record.channel = tap.streamName;
+            tap.getTuning(record.frequency, record.mode);
+        }
+
+        static whisper_full_params whisperParams(int beamSize, int nThreads, int audioCtx) {
+            whisper_full_params params = whisper_full_default_params(beamSize ? WHISPER_SAMPLING_BEAM_SEARCH : WHISPER_SAMPLING_GREEDY);
+            params.print_progress = false;
+            params.print_special = false;
+            params.print_timestamps = false;
+            params.print_realtime = false;
+            params.translate = false;
+            params.language = "en";
+            params.n_threads = nThreads;
+            if (beamSize) { params.beam_search.beam_size = beamSize; }
+            params.audio_ctx = audioCtx;
+            return params;
+        }
+
+        // Runs on a decoder pool thread, jobs of the same tap never run concurrently. Returns without a
+        // transcript if the decode is interrupted, the pool runs it again.
+        void transcribeSegment(const std::shared_ptr<AudioTap>& tap, const VadSegment& segment, const TranscriptStore::Record& meta, bool streaming, whisper_context* ctx, whisper_state* state,
+                               DecoderPool::Cancel& cancel) {
+            std::string transcript = "";
+            auto decodeStart = std::chrono::steady_clock::now();
+
+            // The model may have been swapped since this tap's last decode, and the transmission before may have been shed
+            if (tap->streamer.getContext() != ctx) { tap->streamer.init(ctx); }
+            if (tap->streamerStale.exchange(false)) { tap->streamer.reset(); }
+            tap->streamer.setAbortCallback(DecoderPool::Cancel::abortCallback, &cancel);
+
+            // Threads, sampling and context picked from the current backlog and real-time factor
+            DecodeScheduler::Plan plan = decodeScheduler.begin(segment.samples.size(), (double)pendingDecodeSamples / WHISPER_SAMPLE_RATE);
+            decodeThreads.set(plan.nThreads);
+            decodeMode.set(plan.mode);
+
+            if (streaming) {
+                // Most of the transmission has already been committed while it was in progress
+                StreamingTranscriber::Config scfg = tap->streamer.getConfig();
+                scfg.nThreads = plan.nThreads;
+                tap->streamer.configure(scfg);
+                transcript = tap->streamer.finish(segment.samples, state);
+                if (cancel.interrupted()) {
+                    decodeScheduler.end(0.0, 0.0, false);
+                    return;
+                }
+            } else {
+                tap->streamer.reset();
+                whisper_full_params params = whisperParams(plan.beamSize, plan.nThreads, plan.audioCtx);
+                cancel.attach(params);
+
+                // Whisper refuses input shorter than one second, pad short transmissions like "copy that" with silence
+                const std::vector<float>* pcm32f = &segment.samples;
+                std::vector<float> padded;
+                if (segment.samples.size() < WHISPER_MIN_SAMPLES) {
+                    padded = segment.samples;
+                    padded.resize(WHISPER_MIN_SAMPLES, 0.0f);
+                    pcm32f = &padded;
+                }
+
+                if (whisper_full_with_state(ctx, state, params, pcm32f->data(), pcm32f->size()) != 0) {
+                    decodeScheduler.end(0.0, 0.0, false);
+                    return;
+                }
+                int n_segments = whisper_full_n_segments_from_state(state);
+                for (int i = 0; i < n_segments; ++i) {
+                    transcript += whisper_full_get_segment_text_from_state(state, i);
+                }
+            }
+
+            // Decode time against the audio it covered, above 1 means transcription can't keep up
+            double decodeSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - decodeStart).count();
+            double audioSec = (double)segment.samples.size() / WHISPER_SAMPLE_RATE;
+            whisperFinalSeconds.observe(decodeSec);
+            whisperAudioSamples.add(segment.samples.size());
+            decodeScheduler.end(decodeSec, audioSec, true);
+            whisperRtf.set(decodeScheduler.getRtf());
+            handleTranscript(tap, meta, transcript);
+        }
+
+        // A transmission's transcript, from a local decode or a worker: alerts, the stores, the log and analysis.
+        // Calls for the same tap come one at a time, in order.
+        void handleTranscript(const std::shared_ptr<AudioTap>& tap, const TranscriptStore::Record& meta, const std::string& transcript) {
+            // Watch terms raise an alert right away, without waiting for the LLM
+            std::vector<KeywordSpotter::Match> alerts;
+            if (transcript.length() > 1) {
+                telemetry::ScopedTimer timer(keywordMatchSeconds);
+                alerts = keywordSpotter.match(transcript);
+            }
+            if (transcript.length() > 1) {
+                TranscriptStore::Record record = meta;
+                size_t start = transcript.find_first_not_of(' ');
+                record.text = (start == std::string::npos) ? "" : transcript.substr(start);
+                if (embeddingEnabled && transcriptNoise(record.text) == NOISE_NONE) {
+                    VectorIndex::Doc doc;
+                    doc.timeMs = record.timeMs;
+                    doc.frequency = record.frequency;
+                    doc.channel = record.channel;
+                    doc.text = record.text;
+                    embeddingStage.submit(doc);
+                }
+                char frequency[32];
+                snprintf(frequency, sizeof(frequency), "%.0f", record.frequency);
+                controlServer.publish("transcripts", "TRANSCRIPT\t" + std::to_string(record.timeMs) + "\t" + frequency + "\t" + record.mode + "\t" +
+                                                     ControlServer::field(record.channel) + "\t" + ControlServer::field(record.text));
+                transcriptStore.append(std::move(record));
+            }
+
+            std::lock_guard<std::mutex> lock(logMutex);
+            partialTranscripts.erase(tap->streamName);
+            if (transcript.length() > 1) {
+                logStore.push("[WHISPER][" + tap->streamName + "] " + transcript);
+                for (const auto& alert : alerts) {
+                    logStore.push("[ALERT][" + tap->streamName + "] " + alert.term + (alert.exact ? "" : " (heard \"" + alert.heard + "\")"));
+                    keywordMatches[alert.exact ? 0 : 1].add();
+                    controlServer.publish("alerts", "ALERT\t" + ControlServer::field(tap->streamName) + "\t" + ControlServer::field(alert.term) + "\t" +
+                                                    ControlServer::field(alert.heard));
+                    if (alert.boost && keywordBoost > 0) { tap->boostPriority(keywordBoost, keywordBoostSec); }
+                }
+
+                // Analysis runs on its own stage, noise never reaches the model
+                if (atakAiActive) {
+                    TranscriptNoise noise = analysisStage.submit(tap->streamName, transcript);
+                    transcriptsSkipped[noise].add();
+                }
+            }
+        }
+
+        // Called by the analysis stage with transcripts coalesced into one request. The response streams
+        // into the log, done() frees the stage's in-flight slot.
+        bool analyzeTranscripts(const std::vector<AnalysisStage::Transcript>& batch, AnalysisStage::Done done) {
+            if (!(atakAiActive && ollamaRunning && modelsLoaded)) { return false; }
+            std::string model = selectedOllamaModel();
+            if (model.empty()) { return false; }
+
+            // The transcriptions only join the conversation once they're answered, so a failed request
+            // doesn't leave a user turn without a reply
+            std::string content;
+            if (batch.size() == 1) {
+                content = "Intercepted Transmission (HEARD): \"" + batch[0].text + "\"";
+            } else {
+                content = "Intercepted Transmissions (HEARD), oldest first:";
+                for (const auto& t : batch) {
+                    int offset = (int)std::chrono::duration_cast<std::chrono::seconds>(t.heard - batch[0].heard).count();
+                    content += "\n[" + t.channel + " +" + std::to_string(offset) + "s] \"" + t.text + "\"";
+                }
+            }
+            analysisBatchSize.observe((double)batch.size());
+
+            // Related older intercepts ride along with the transcriptions, they never join the conversation
+            int64_t recentMs = nowUnixMs() - LLM_RETRIEVAL_RECENT_SEC * 1000;
+            recallIntercepts(content, recentMs, [this, model, content, done](const std::string& recalled) {
+                std::string prompt = recalled.empty() ? content : recalled + "\n\n" + content;
+                uint64_t streamKey;
+                {
+                    std::lock_guard<std::mutex> lock(logMutex);
+                    streamKey = beginLlmStream("[RADAR ...] ");
+                }
+                llmExecutor.submitBody("/api/chat", conversation.chatBody(model, LLM_CHAT_OPTIONS, &prompt), llmTokenHandler(streamKey),
+                                       [this, streamKey, model, content, done](bool success, const std::string& aiText, const std::string& error) {
+                    {
+                        std::lock_guard<std::mutex> lock(logMutex);
+                        llmStreams.erase(streamKey);
+                        if (!success) {
+                            logStore.push("[AI Error] HTTP or JSON error: " + error);
+                        } else {
+                            logStore.push("[RADAR] " + aiText);
+                        }
+                    }
+                    if (success) {
+                        conversation.append("user", content);
+                        conversation.append("assistant", aiText);
+                        compactMemory(model);
+                    }
+                    done();
+                });
+            });
+            return true;
+        }
+
+        // Past intercepts related to a text (heard before beforeMs), as a message for the LLM. then() gets
+        // it, or nothing if retrieval is off or nothing is close enough, on the embedding stage's thread or
+        // right away.
+        void recallIntercepts(const std::string& text, int64_t beforeMs, std::function<void(const std::string& recalled)> then) {
+            if (!embeddingEnabled || !llmRetrieval || !vectorIndex.size()) {
+                then("");
+                return;
+            }
+            embeddingStage.query(text, [this, beforeMs, then](bool success, const std::vector<float>& vector) {
+                std::string recalled;
+                if (success) {
+                    for (const auto& hit : vectorIndex.search(vector, LLM_RETRIEVAL_HITS, beforeMs)) {
+                        if (hit.score < LLM_RETRIEVAL_MIN_SCORE) { break; }
+                        char freq[32];
+                        snprintf(freq, sizeof(freq), "%.4f MHz", hit.doc.frequency / 1e6);
+                        recalled += "\n[" + formatLocalTime(hit.doc.timeMs) + ", " + freq + ", " + hit.doc.channel + "] \"" + hit.doc.text + "\"";
+                    }
+                }
+                if (!recalled.empty()) {
+                    recalled = "Earlier intercepts that may be related, for reference:" + recalled;
+                    llmRetrievals.add();
+                }
+                then(recalled);
+            });
+        }
+
+        // Fold the oldest turns into the rolling summary once there are too many, in the background.
+        // Requests keep using the current memory until the summary is in.
+        void compactMemory(const std::string& model) {
+            std::string body;
+            if (!conversation.beginCompaction(model, body)) { return; }
+            llmExecutor.submitBody("/api/chat", body, NULL, [this](bool success, const std::string& summary, const std::string& error) {
+                conversation.finishCompaction(success, summary);
+                if (success) {
+                    memoryCompactions.add();
+                    return;
+                }
+                std::lock_guard<std::mutex> lock(logMutex);
+                logStore.push("[AI Error] Could not summarize the conversation: " + error);
+            });
+        }
+
+        // Start a live log line for a streaming LLM response. Requires logMutex.
+        uint64_t beginLlmStream(const std::string& prefix) {
+            uint64_t key = nextLlmStreamKey++;
+            llmStreams[key] = prefix;
+            return key;
+        }
+
+        LlmExecutor::TokenHandler llmTokenHandler(uint64_t streamKey) {
+            return [this, streamKey](const std::string& token) {
+                std::lock_guard<std::mutex> lock(logMutex);
+                auto it = llmStreams.find(streamKey);
+                if (it != llmStreams.end()) { it->second += token; }
+            };
+        }
+
+        void registerMetrics() {
+            metrics.add("sigint_worker_loop_seconds", "Time spent per Whisper worker loop iteration, excluding the poll sleep.", "", &workerLoopSeconds);
+            metrics.add("sigint_segments_total", "Transmissions handed to the decoder pool.", "", &segmentsTotal);
+            metrics.add("sigint_decodes_interrupted_total", "Decodes interrupted and queued again.", "reason=\"preempt\"", &decodesPreempted);
+            metrics.add("sigint_decodes_interrupted_total", "Decodes interrupted and queued again.", "reason=\"model_swap\"", &decodesRestarted);
+            metrics.add("sigint_whisper_model_downgrades_total", "Smaller models loaded by the downgrade policy because decoding fell behind.", "", &modelDowngrades);
+            metrics.add("sigint_whisper_model_loaded", "Whether a Whisper model is loaded and decoding.", "", &whisperModelLoaded);
+            metrics.add("sigint_whisper_model_load_seconds", "Time to load a Whisper model.", "", &whisperModelLoadSeconds);
+            metrics.add("sigint_whisper_decode_seconds", "Whisper decode time.", "kind=\"final\"", &whisperFinalSeconds);
+            metrics.add("sigint_whisper_decode_seconds", "Whisper decode time.", "kind=\"partial\"", &whisperPartialSeconds);
+            metrics.add("sigint_whisper_audio_samples_total", "16 kHz samples transcribed by final decodes.", "", &whisperAudioSamples);
+            metrics.add("sigint_whisper_realtime_factor", "Recent decode time over audio duration, above 1 means transcription is falling behind.", "", &whisperRtf);
+            metrics.add("sigint_decode_backlog_seconds", "Audio waiting for or being decoded.", "", &decodeBacklogSeconds);
+            metrics.add("sigint_decode_queue_seconds", "Audio waiting in the decode queue, held to the backlog bound.", "", &decodeQueueSeconds);
+            metrics.add("sigint_decode_queue_jobs", "Decoder pool jobs waiting.", "", &decodeQueueJobs);
+            metrics.add("sigint_decode_threads", "Threads used by the last final decode.", "", &decodeThreads);
+            metrics.add("sigint_decode_mode", "Decode mode of the last final decode (0 accurate, 1 balanced, 2 fast).", "", &decodeMode);
+            metrics.add("sigint_dsp_cores_busy", "CPU used by SDR++ threads other than the decoders, in cores.", "", &dspCoresBusy);
+            metrics.add("sigint_remote_decodes_total", "Transmissions decoded on decode workers, by outcome.", "result=\"completed\"", &remoteDecoders.metrics.completed);
+            metrics.add("sigint_remote_decodes_total", "Transmissions decoded on decode workers, by outcome.", "result=\"failed\"", &remoteDecoders.metrics.failed);
+            metrics.add("sigint_remote_decodes_retried_total", "Jobs sent to another decode worker after one was lost or failed them.", "", &remoteDecoders.metrics.retried);
+            metrics.add("sigint_remote_decode_seconds", "Time from sending a job to a decode worker to its result.", "", &remoteDecoders.metrics.roundTripSeconds);
+            metrics.add("sigint_remote_decodes_in_flight", "Jobs out on decode workers.", "", &remoteDecoders.metrics.inFlight);
+            metrics.add("sigint_remote_workers_ready", "Decode workers connected and decoding.", "", &remoteDecoders.metrics.workersReady);
+            metrics.add("sigint_remote_workers_lost_total", "Decode workers dropped after a lost connection or missed heartbeats.", "", &remoteDecoders.metrics.workersLost);
+            for (int i = NOISE_EMPTY; i < NOISE_COUNT; i++) {
+                metrics.add("sigint_analysis_skipped_total", "Transcripts not sent to the LLM because they were noise.",
+                            std::string("reason=\"") + noiseName((TranscriptNoise)i) + "\"", &transcriptsSkipped[i]);
+            }
+            metrics.add("sigint_keyword_matches_total", "Watch terms heard in transcripts.", "kind=\"exact\"", &keywordMatches[0]);
+            metrics.add("sigint_keyword_matches_total", "Watch terms heard in transcripts.", "kind=\"fuzzy\"", &keywordMatches[1]);
+            metrics.add("sigint_keyword_match_seconds", "Time to match a transcript against the watchlist.", "", &keywordMatchSeconds);
+            metrics.add("sigint_transcripts_stored_total", "Transcripts written to the transcript store.", "", &transcriptStore.metrics.appended);
+            metrics.add("sigint_transcripts_store_dropped_total", "Transcripts the store couldn't take (queue full or no room on disk).", "", &transcriptStore.metrics.dropped);
+            metrics.add("sigint_transcript_query_seconds", "Transcript store query time.", "", &transcriptStore.metrics.querySeconds);
+            metrics.add("sigint_audio_archived_total", "Transmissions written to the audio archive.", "", &audioArchive.metrics.archived);
+            metrics.add("sigint_audio_archive_dropped_total", "Transmissions the audio archive couldn't take (queue full or write failed).", "", &audioArchive.metrics.dropped);
+            metrics.add("sigint_audio_archive_expired_files_total", "Archive files deleted to stay within the quota.", "", &audioArchive.metrics.expiredFiles);
+            metrics.add("sigint_audio_archive_raw_bytes_total", "Archived audio as 32 bit float.", "", &audioArchive.metrics.rawBytes);
+            metrics.add("sigint_audio_archive_stored_bytes_total", "Archived audio as written to disk.", "", &audioArchive.metrics.storedBytes);
+            metrics.add("sigint_audio_archive_encode_seconds", "Time to compress a transmission.", "", &audioArchive.metrics.encodeSeconds);
+            metrics.add("sigint_replays_decoded_total", "Archived transmissions decoded again.", "", &replaysDecoded);
+            metrics.add("sigint_embeddings_total", "Transcripts embedded and added to the vector index.", "", &embeddingStage.metrics.embedded);
+            metrics.add("sigint_embedding_failures_total", "Embedding requests that failed.", "", &embeddingStage.metrics.failed);
+            metrics.add("sigint_embeddings_dropped_total", "Transcripts not embedded (too many waiting, or refused by the index).", "", &embeddingStage.metrics.dropped);
+            metrics.add("sigint_embedding_request_seconds", "Embedding request time.", "", &embeddingStage.metrics.requestSeconds);
+            metrics.add("sigint_vector_insert_seconds", "Vector index insert time.", "", &vectorIndex.metrics.addSeconds);
+            metrics.add("sigint_vector_search_seconds", "Vector index search time.", "", &vectorIndex.metrics.searchSeconds);
+            metrics.add("sigint_llm_retrievals_total", "LLM requests sent with related past intercepts.", "", &llmRetrievals);
+            metrics.add("sigint_analysis_queued_total", "Transcripts queued for LLM analysis.", "", &transcriptsSkipped[NOISE_NONE]);
+            metrics.add("sigint_analysis_batch_size", "Transcripts coalesced into one LLM request.", "", &analysisBatchSize);
+            metrics.add("sigint_analysis_waiting", "Transcripts waiting to be batched.", "", &analysisWaiting);
+            metrics.add("sigint_llm_queue_length", "LLM requests waiting.", "", &llmQueueLength);
+            metrics.add("sigint_llm_in_flight", "LLM requests running.", "", &llmInFlight);
+            metrics.add("sigint_llm_queue_seconds", "Time LLM requests waited before being sent.", "", &llmExecutor.metrics.queueSeconds);
+            metrics.add("sigint_llm_first_token_seconds", "Time to the first streamed token.", "", &llmExecutor.metrics.firstTokenSeconds);
+            metrics.add("sigint_llm_request_seconds", "Time to a complete LLM response.", "", &llmExecutor.metrics.requestSeconds);
+            metrics.add("sigint_llm_prompt_eval_tokens", "Prompt tokens Ollama evaluated per request, i.e. not served from its prompt cache.", "", &llmExecutor.metrics.promptEvalTokens);
+            metrics.add("sigint_llm_eval_tokens_total", "Tokens generated by the LLM.", "", &llmExecutor.metrics.evalTokens);
+            metrics.add("sigint_llm_memory_compactions_total", "Times older conversation turns were folded into the rolling summary.", "", &memoryCompactions);
+            metrics.add("sigint_llm_requests_total", "LLM requests by outcome.", "result=\"completed\"", &llmExecutor.metrics.completed);
+            metrics.add("sigint_llm_requests_total", "LLM requests by outcome.", "result=\"failed\"", &llmExecutor.metrics.failed);
+            metrics.add("sigint_llm_requests_total", "LLM requests by outcome.", "result=\"cancelled\"", &llmExecutor.metrics.cancelled);
+            metrics.add("sigint_ollama_up", "Whether the Ollama server answered the last request.", "", &ollamaUp);
+            metrics.add("sigint_ollama_http_requests_total", "HTTP requests sent to Ollama.", "", &ollamaPool.requestCount);
+            metrics.add("sigint_ollama_http_failures_total", "HTTP requests to Ollama that failed or were cancelled.", "", &ollamaPool.failureCount);
+            metrics.add("sigint_ollama_http_connections_total", "Connections opened to Ollama.", "", &ollamaPool.connectionsOpened);
+            metrics.add("sigint_ollama_http_request_seconds", "Ollama HTTP request time, including streamed responses.", "", &ollamaPool.requestSeconds);
+            metrics.add("sigint_ollama_warmup_seconds", "Time to warm up a newly selected model.", "", &warmupSeconds);
+            metrics.add("sigint_ollama_warmup_failures_total", "Model warmups that failed.", "", &warmupFailures);
+            metrics.add("sigint_control_commands_total", "Commands received on the control socket.", "", &controlServer.metrics.commands);
+            metrics.add("sigint_control_events_total", "Event lines queued to control socket clients.", "", &controlServer.metrics.events);
+            metrics.add("sigint_control_events_dropped_total", "Event lines a control socket client was too slow for.", "", &controlServer.metrics.eventsDropped);
+            metrics.add("sigint_control_clients", "Clients connected to the control socket.", "", &controlServer.metrics.clients);
+        }
+
+        static std::string tapLabels(const AudioTap& tap) {
+            return "channel=\"" + tap.streamName + "\",tap=\"" + std::to_string(tap.id) + "\"";
+        }
+
+        void registerTapMetrics(const std::shared_ptr<AudioTap>& tap) {
+            std::string labels = tapLabels(*tap);
+            metrics.add("sigint_audio_samples_total", "16 kHz samples captured into the ring.", labels, &tap->samplesIn);
+            metrics.add("sigint_audio_dropped_samples_total", "Samples lost to ring overruns.", labels, &tap->samplesDropped);
+            metrics.add("sigint_audio_handler_seconds", "Time spent in the DSP thread audio handler.", labels, &tap->handlerSeconds);
+            metrics.add("sigint_audio_ring_depth_samples", "Samples waiting in the ring.", labels, &tap->ringDepth);
+            metrics.add("sigint_segments_shed_total", "Transmissions dropped from the decode queue because the decoders were behind.", labels, &tap->segmentsShed);
+        }
+
+        // The selected model, empty if there's none. Doesn't take logMutex.
+        std::string selectedOllamaModel() {
+            std::lock_guard<std::mutex> lck(modelsMtx);
+            return (selectedModelIndex < (int)availableModels.size()) ? availableModels[selectedModelIndex] : "";
+        }
+
+        void warmupModel(std::string newModelName, std::string oldModelName) {
+            isWarmingModel = true;
+
+            // Unload the old model first
+            if (!oldModelName.empty()) {
+                {
+                    std::lock_guard<std::mutex> lock(logMutex);
+                    warmingStatusMessage = "Unloading model: " + oldModelName + "...";
+                    logStore.push("[OLLAMA] " + warmingStatusMessage);
+                }
+                try {
+                    json unloadPayload;
+                    unloadPayload["model"] = oldModelName;
+                    unloadPayload["prompt"] = "";
+                    unloadPayload["keep_alive"] = 0;
+
+                    ollamaPool.post("/api/generate", unloadPayload.dump());
+
+                    logStore.push("[OLLAMA] Model '" + oldModelName + "' unloaded.");
+                } catch (const std::exception& e) {
+                    logStore.push("[OLLAMA Error] Failed to unload model: " + oldModelName + " - " + e.what());
+                }
+            }
+
+            // Now, warm up the new model
+            {
+                std::lock_guard<std::mutex> lock(logMutex);
+                warmingStatusMessage = "Warming model: " + newModelName + "...";
+                logStore.push("[OLLAMA] " + warmingStatusMessage);
+            }
+
+            try {
+                // Evaluating the conversation so far also fills the prompt cache for the first real request
+                telemetry::ScopedTimer timer(warmupSeconds);
+                ollamaPool.post("/api/chat", conversation.warmupBody(newModelName));
+
+                {
+                    std::lock_guard<std::mutex> lock(logMutex);
+                    warmingStatusMessage = "Model '" + newModelName + "' is ready.";
+                    logStore.push("[OLLAMA] " + warmingStatusMessage);
+                }
+            } catch (const std::exception& e) {
+                warmupFailures.add();
+                std::lock_guard<std::mutex> lock(logMutex);
+                warmingStatusMessage = "Failed to warm model: " + newModelName;
+                logStore.push("[OLLAMA Error] " + warmingStatusMessage + " - " + e.what());
+            }
+
+            std::this_thread::sleep_for(std::chrono::seconds(2));
+            warmingStatusMessage = "";
+            isWarmingModel = false;
+        }
+
+        ConfigManager& config;
+        bool headless;
+
+        uint64_t nextLlmStreamKey = 0;
+        int nextTapId = 0;
+        EventHandler<std::string> streamRegisteredHandler;
+        EventHandler<std::string> streamUnregisterHandler;
+        EventHandler<ImGui::WaterFall::FFTRedrawArgs> fftRedrawHandler;
+        std::chrono::steady_clock::time_point lastTuningRefresh;   // UI thread
+
+        Doorbell workerBell;
+        std::string whisperModelDir;
+        std::chrono::steady_clock::time_point lastDowngrade;    // Whisper worker thread
+        std::thread whisperWorker;
+        std::atomic<bool> stopWhisperWorker = false;
+
+        std::thread ollamaMonitorThread;
+        std::atomic<bool> stopOllamaMonitor = false;
+        std::mutex ollamaMonitorMtx;
+        std::condition_variable ollamaMonitorCnd;
+        bool ollamaMonitorWake = false;
+        std::string ollamaTagsDigest;
+    };
+}
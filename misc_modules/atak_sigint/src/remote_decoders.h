@@ -0,0 +1,609 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "decode_protocol.h"
+#include "decoder_pool.h"
+#include "telemetry.h"
+
+namespace sigint {
+    // Decodes on Whisper worker processes (atak_sigint_worker) instead of in SDR++, so transcription
+    // scales past one machine and a crashing decoder only takes its worker down. Jobs are queued,
+    // bounded and shed like DecoderPool's, and each goes to the least loaded worker with a free slot.
+    // Workers are pinged every heartbeatMs. One that stays silent for timeoutMs, or sits on a job past
+    // jobTimeoutSec, is dropped and reconnected with backoff, and its jobs go back into the queue for
+    // another worker, up to maxAttempts. Results are handed out per channel in submission order, on the
+    // dispatcher's thread, even when later transmissions of a channel finished first elsewhere.
+    class RemoteDecoders {
+    public:
+        typedef std::function<void(bool success, const std::string& text, double decodeSec, const std::string& worker)> ResultHandler;
+        typedef std::function<void()> DropHandler;
+        typedef std::function<void(const std::string& message)> EventHandler;
+
+        struct Config {
+            std::vector<std::string> workers;   // "host:port"
+            int heartbeatMs = 1000;
+            int timeoutMs = 5000;
+            int connectTimeoutMs = 2000;
+            int reconnectMinMs = 500;
+            int reconnectMaxMs = 10000;
+            int maxAttempts = 3;
+            int jobTimeoutSec = 120;
+        };
+
+        struct WorkerStatus {
+            std::string address;
+            std::string name;
+            std::string model;
+            bool ready = false;
+            int slots = 0;
+            int inFlight = 0;       // Jobs of ours it holds
+            int foreign = 0;        // Jobs it holds for other modules, as of its last pong
+            double rttMs = 0.0;
+            uint64_t completed = 0;
+            std::string error;
+        };
+
+        struct Metrics {
+            telemetry::Counter completed;
+            telemetry::Counter failed;          // Gave up after maxAttempts
+            telemetry::Counter retried;         // Sent again after a worker was lost or failed the job
+            telemetry::Counter workersLost;
+            telemetry::Gauge workersReady;
+            telemetry::Gauge inFlight;
+            telemetry::Histogram roundTripSeconds;  // Sent -> result, includes queueing on the worker
+        };
+
+        ~RemoteDecoders() { stop(); }
+
+        // Events (workers coming and going) are reported through onEvent, on the dispatcher's thread
+        bool start(const Config& config, EventHandler onEvent) {
+            stop();
+            cfg = config;
+            this->onEvent = onEvent;
+            workers.clear();
+            for (const auto& address : cfg.workers) {
+                auto w = std::make_unique<Worker>();
+                w->address = address;
+                if (!remote::parseAddress(address, w->host, w->port)) {
+                    error = "Invalid worker address '" + address + "'";
+                    workers.clear();
+                    return false;
+                }
+                workers.push_back(std::move(w));
+            }
+            if (workers.empty() || pipe2(wakePipe, O_NONBLOCK | O_CLOEXEC)) {
+                error = workers.empty() ? "No workers configured" : std::string("Could not create wake pipe: ") + strerror(errno);
+                workers.clear();
+                return false;
+            }
+            running = true;
+            dispatcherThread = std::thread(&RemoteDecoders::dispatcher, this);
+            return true;
+        }
+
+        // Jobs still queued or out on workers are forgotten, their handlers aren't called
+        void stop() {
+            if (!running) { return; }
+            running = false;
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                wake();
+            }
+            if (dispatcherThread.joinable()) { dispatcherThread.join(); }
+            std::lock_guard<std::mutex> lck(mtx);
+            for (auto& w : workers) { disconnect(*w); }
+            for (int* fd : { &wakePipe[0], &wakePipe[1] }) {
+                if (*fd >= 0) { ::close(*fd); }
+                *fd = -1;
+            }
+            jobs.clear();
+            queue.clear();
+            order.clear();
+            queuedSamples = 0;
+            metrics.workersReady.set(0);
+            metrics.inFlight.set(0);
+        }
+
+        // Same bound and shedding as DecoderPool, preemption doesn't apply
+        void configureQueue(const DecoderPool::QueueConfig& config) {
+            std::vector<DropHandler> dropped;
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                queueCfg = config;
+                shed(dropped);
+            }
+            for (auto& onDrop : dropped) { onDrop(); }
+        }
+
+        // Queue samples for decoding. beamSize -1 leaves the sampling to the worker's own scheduler.
+        // May shed queued jobs (possibly this one), their drop handlers are called before returning, on this thread.
+        void submit(const DecoderPool::JobInfo& info, const std::vector<float>& samples, int beamSize, ResultHandler onResult, DropHandler onDrop = NULL) {
+            // Workers refuse longer audio, nothing the module cuts comes close
+            if (samples.size() > remote::MAX_JOB_SAMPLES) {
+                if (onDrop) { onDrop(); }
+                return;
+            }
+
+            // Coded here so the queue holds the compact form, and retries don't code again
+            uint64_t id = nextJobId++;
+            auto job = std::make_unique<Job>();
+            job->info = info;
+            job->payload = remote::encodeJob(id, info.priority, beamSize, samples);
+            job->onResult = std::move(onResult);
+            job->onDrop = std::move(onDrop);
+            job->submitted = std::chrono::steady_clock::now();
+
+            std::vector<DropHandler> dropped;
+            {
+                std::lock_guard<std::mutex> lck(mtx);
+                if (running) {
+                    jobs[id] = std::move(job);
+                    queue.push_back(id);
+                    order[info.channel].push_back(id);
+                    queuedSamples += info.samples;
+                    shed(dropped);
+                    wake();
+                } else if (job->onDrop) {
+                    // Stopped, the job is dropped like a shed one so the caller's accounting stays right
+                    dropped.push_back(std::move(job->onDrop));
+                }
+            }
+            for (auto& onDrop : dropped) { onDrop(); }
+        }
+
+        int pending() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return (int)queue.size();
+        }
+
+        // Audio held by queued jobs, per JobInfo::samples
+        size_t pendingSamples() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return queuedSamples;
+        }
+
+        std::vector<WorkerStatus> getWorkers() {
+            std::lock_guard<std::mutex> lck(mtx);
+            std::vector<WorkerStatus> list;
+            for (const auto& w : workers) {
+                WorkerStatus s;
+                s.address = w->address;
+                s.name = w->hello.name;
+                s.model = w->hello.model;
+                s.ready = (w->state == READY);
+                s.slots = w->hello.slots;
+                s.inFlight = (int)w->inFlight.size();
+                s.foreign = w->foreign;
+                s.rttMs = w->rttMs;
+                s.completed = w->completed;
+                s.error = w->error;
+                list.push_back(s);
+            }
+            return list;
+        }
+
+        // Workers connected and decoding
+        int getReadyCount() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return (int)std::count_if(workers.begin(), workers.end(), [](const std::unique_ptr<Worker>& w) { return w->state == READY; });
+        }
+
+        bool isRunning() { return running; }
+        const std::string& getError() { return error; }
+
+        Metrics metrics;
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Job {
+            DecoderPool::JobInfo info;
+            std::string payload;        // JOB frame payload
+            ResultHandler onResult;
+            DropHandler onDrop;
+            Clock::time_point submitted;
+            Clock::time_point sent;
+            int attempts = 0;
+            bool done = false;          // Result in, waiting for earlier jobs of its channel
+            bool success = false;
+            std::string text;
+            double decodeSec = 0.0;
+            std::string worker;
+        };
+
+        enum WorkerState {
+            DISCONNECTED,
+            CONNECTING,
+            GREETING,       // Connected, waiting for HELLO
+            READY
+        };
+
+        struct Worker {
+            std::string address;
+            std::string host;
+            int port = 0;
+            WorkerState state = DISCONNECTED;
+            int sock = -1;
+            remote::FrameBuffer in;
+            std::string out;
+            remote::Hello hello;
+            std::set<uint64_t> inFlight;
+            int foreign = 0;
+            double rttMs = 0.0;
+            uint64_t completed = 0;
+            std::string error;
+            Clock::time_point since;        // Connect started, or last frame received
+            Clock::time_point lastPing;
+            Clock::time_point retryAt;
+            int backoffMs = 0;
+        };
+
+        // A worker due to reconnect, looked up by the dispatcher without mtx
+        struct Lookup {
+            bool due = false;
+            std::string host;
+            addrinfo* res = NULL;
+        };
+
+        // Ready to hand out, with their channel's earlier jobs
+        struct Delivery {
+            ResultHandler onResult;
+            bool success;
+            std::string text;
+            double decodeSec;
+            std::string worker;
+        };
+
+        void dispatcher() {
+            std::vector<pollfd> pfds;
+            std::vector<Delivery> deliveries;
+            std::vector<Lookup> lookups(workers.size());
+            while (running) {
+                pfds.clear();
+                pfds.push_back(pollfd{ wakePipe[0], POLLIN, 0 });
+                {
+                    std::lock_guard<std::mutex> lck(mtx);
+                    auto now = Clock::now();
+                    for (size_t i = 0; i < workers.size(); i++) {
+                        lookups[i].due = (workers[i]->state == DISCONNECTED && now >= workers[i]->retryAt);
+                        if (lookups[i].due) { lookups[i].host = workers[i]->host; }
+                    }
+                    for (auto& w : workers) {
+                        short events = 0;
+                        if (w->state == CONNECTING) { events = POLLOUT; }
+                        if (w->state == GREETING || w->state == READY) { events = POLLIN | (w->out.empty() ? 0 : POLLOUT); }
+                        pfds.push_back(pollfd{ events ? w->sock : -1, events, 0 });
+                    }
+                }
+                // Short enough for heartbeats, timeouts and reconnects to be on time
+                poll(pfds.data(), pfds.size(), 100);
+
+                if (pfds[0].revents & POLLIN) {
+                    char buf[64];
+                    while (read(wakePipe[0], buf, sizeof(buf)) > 0) {}
+                }
+
+                // Resolved without the lock, a slow DNS lookup mustn't hold up submit() or the UI
+                for (size_t i = 0; i < workers.size(); i++) {
+                    if (lookups[i].due) { resolve(lookups[i], workers[i]->port); }
+                }
+
+                {
+                    std::lock_guard<std::mutex> lck(mtx);
+                    auto now = Clock::now();
+                    for (size_t i = 0; i < workers.size(); i++) {
+                        Worker& w = *workers[i];
+                        short revents = pfds[i + 1].revents;
+                        if (w.state == CONNECTING && revents) { connected(w); }
+                        if ((w.state == GREETING || w.state == READY) && (revents & (POLLIN | POLLHUP | POLLERR))) { receive(w); }
+                        housekeeping(w, lookups[i], now);
+                    }
+                    dispatch();
+                    for (auto& w : workers) {
+                        if ((w->state == GREETING || w->state == READY) && !remote::flush(w->sock, w->out)) { lost(*w, "connection lost"); }
+                    }
+                    collect(deliveries);
+                    metrics.workersReady.set(std::count_if(workers.begin(), workers.end(), [](const std::unique_ptr<Worker>& w) { return w->state == READY; }));
+                    size_t sent = 0;
+                    for (auto& w : workers) { sent += w->inFlight.size(); }
+                    metrics.inFlight.set(sent);
+                }
+                for (auto& lookup : lookups) {
+                    if (lookup.res) { freeaddrinfo(lookup.res); }
+                    lookup = Lookup();
+                }
+
+                // Handlers run without the lock, they may submit again
+                for (auto& d : deliveries) { d.onResult(d.success, d.text, d.decodeSec, d.worker); }
+                deliveries.clear();
+                for (auto& message : events) { onEvent(message); }
+                events.clear();
+            }
+        }
+
+        // Connects, pings and timeouts. Requires mtx.
+        void housekeeping(Worker& w, const Lookup& lookup, Clock::time_point now) {
+            if (w.state == DISCONNECTED) {
+                if (lookup.due) { connect(w, lookup, now); }
+                return;
+            }
+            if (w.state == CONNECTING || w.state == GREETING) {
+                if (now - w.since > std::chrono::milliseconds(cfg.connectTimeoutMs)) { lost(w, w.state == CONNECTING ? "connect timed out" : "no greeting"); }
+                return;
+            }
+            if (now - w.since > std::chrono::milliseconds(cfg.timeoutMs)) {
+                lost(w, "heartbeat timed out");
+                return;
+            }
+            for (uint64_t id : w.inFlight) {
+                if (now - jobs[id]->sent > std::chrono::seconds(cfg.jobTimeoutSec)) {
+                    lost(w, "job timed out");
+                    return;
+                }
+            }
+            if (now - w.lastPing >= std::chrono::milliseconds(cfg.heartbeatMs)) {
+                uint64_t seq = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+                remote::frame(w.out, remote::FRAME_PING, remote::encodePing(seq));
+                w.lastPing = now;
+            }
+        }
+
+        // Blocks for as long as DNS takes, call without mtx
+        static void resolve(Lookup& lookup, int port) {
+            addrinfo hints;
+            memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            if (getaddrinfo(lookup.host.c_str(), std::to_string(port).c_str(), &hints, &lookup.res)) { lookup.res = NULL; }
+        }
+
+        // Start a nonblocking connect to the looked up address. Requires mtx.
+        void connect(Worker& w, const Lookup& lookup, Clock::time_point now) {
+            const addrinfo* res = lookup.res;
+            if (!res) {
+                retryLater(w, "could not resolve " + w.host);
+                return;
+            }
+            w.sock = socket(res->ai_family, res->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, res->ai_protocol);
+            int ret = (w.sock >= 0) ? ::connect(w.sock, res->ai_addr, res->ai_addrlen) : -1;
+            if (ret && errno != EINPROGRESS) {
+                retryLater(w, std::string("connect failed: ") + strerror(errno));
+                return;
+            }
+            int one = 1;
+            setsockopt(w.sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            w.state = CONNECTING;
+            w.since = now;
+        }
+
+        // Requires mtx
+        void connected(Worker& w) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(w.sock, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err) {
+                retryLater(w, std::string("connect failed: ") + strerror(err));
+                return;
+            }
+            w.state = GREETING;
+            w.since = Clock::now();
+        }
+
+        // Requires mtx
+        void receive(Worker& w) {
+            if (!w.in.receive(w.sock)) {
+                lost(w, "connection closed");
+                return;
+            }
+            uint32_t type;
+            std::string payload;
+            bool bad;
+            while (w.state != DISCONNECTED && w.in.next(type, payload, bad)) {
+                w.since = Clock::now();
+                if (!handleFrame(w, type, payload)) { bad = true; }
+                if (bad) { break; }
+            }
+            if (bad) { lost(w, "protocol error"); }
+        }
+
+        // False if the frame makes no sense. Requires mtx.
+        bool handleFrame(Worker& w, uint32_t type, const std::string& payload) {
+            if (w.state == GREETING) {
+                if (type != remote::FRAME_HELLO || !remote::decodeHello(payload, w.hello)) { return false; }
+                if (w.hello.version != remote::PROTOCOL_VERSION) {
+                    retryLater(w, "speaks protocol version " + std::to_string(w.hello.version) + ", not " + std::to_string(remote::PROTOCOL_VERSION));
+                    return true;
+                }
+                w.state = READY;
+                w.error.clear();
+                w.backoffMs = 0;
+                w.foreign = 0;
+                w.lastPing = Clock::time_point();
+                events.push_back("Worker " + w.address + " (" + w.hello.name + ", " + w.hello.model + ", " + std::to_string(w.hello.slots) + " slots) is up.");
+                return true;
+            }
+
+            if (type == remote::FRAME_PONG) {
+                remote::Pong pong;
+                if (!remote::decodePong(payload, pong)) { return false; }
+                uint64_t now = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch()).count();
+                w.rttMs = (now - pong.seq) / 1000.0;
+                w.foreign = std::max<int>(0, (int)pong.busy - (int)pong.mine);
+                return true;
+            }
+            if (type != remote::FRAME_RESULT) { return false; }
+
+            remote::Result result;
+            if (!remote::decodeResult(payload, result)) { return false; }
+            // A job this worker no longer holds was already given to another one
+            if (!w.inFlight.erase(result.id)) { return true; }
+            Job& job = *jobs[result.id];
+            metrics.roundTripSeconds.observe(std::chrono::duration<double>(Clock::now() - job.sent).count());
+            if (!result.success) {
+                events.push_back("Worker " + w.address + " failed a job: " + result.text);
+                retry(result.id);
+                return true;
+            }
+            w.completed++;
+            metrics.completed.add();
+            job.done = true;
+            job.success = true;
+            job.text = result.text;
+            job.decodeSec = result.decodeSec;
+            job.worker = w.hello.name;
+            return true;
+        }
+
+        // Hand queued jobs to the least loaded workers with a free slot, best scored job first. Requires mtx.
+        void dispatch() {
+            auto now = Clock::now();
+            while (!queue.empty()) {
+                Worker* best = nullptr;
+                double bestLoad = 0.0;
+                for (auto& w : workers) {
+                    if (w->state != READY) { continue; }
+                    int held = (int)w->inFlight.size() + w->foreign;
+                    if (held >= (int)w->hello.slots) { continue; }
+                    double load = (double)held / w->hello.slots;
+                    if (!best || load < bestLoad) {
+                        best = w.get();
+                        bestLoad = load;
+                    }
+                }
+                if (!best) { return; }
+
+                auto next = std::max_element(queue.begin(), queue.end(), [&](uint64_t a, uint64_t b) { return score(*jobs[a], now) < score(*jobs[b], now); });
+                uint64_t id = *next;
+                queue.erase(next);
+                Job& job = *jobs[id];
+                queuedSamples -= job.info.samples;
+                job.sent = now;
+                best->inFlight.insert(id);
+                remote::frame(best->out, remote::FRAME_JOB, job.payload);
+            }
+        }
+
+        float score(const Job& job, Clock::time_point now) {
+            float waited = std::chrono::duration<float>(now - job.submitted).count();
+            return (float)job.info.priority * queueCfg.priorityWeight + job.info.levelDb + waited * queueCfg.ageWeight;
+        }
+
+        // Drop jobs until the queue is back within its bound, always keeping at least one. Requires mtx.
+        void shed(std::vector<DropHandler>& dropped) {
+            if (!queueCfg.maxSamples) { return; }
+            auto now = Clock::now();
+            while (queuedSamples > queueCfg.maxSamples && queue.size() > 1) {
+                auto victim = queue.begin();
+                if (queueCfg.policy == DecoderPool::SHED_LOWEST_SCORE) {
+                    victim = std::min_element(queue.begin(), queue.end(), [&](uint64_t a, uint64_t b) { return score(*jobs[a], now) < score(*jobs[b], now); });
+                }
+                uint64_t id = *victim;
+                queue.erase(victim);
+                Job& job = *jobs[id];
+                queuedSamples -= job.info.samples;
+                if (job.onDrop) { dropped.push_back(std::move(job.onDrop)); }
+                auto& channel = order[job.info.channel];
+                channel.erase(std::find(channel.begin(), channel.end(), id));
+                jobs.erase(id);
+            }
+        }
+
+        // Back in the queue for another worker, or failed for good. Requires mtx.
+        void retry(uint64_t id) {
+            Job& job = *jobs[id];
+            if (++job.attempts >= cfg.maxAttempts) {
+                metrics.failed.add();
+                job.done = true;
+                job.success = false;
+                job.text = "gave up after " + std::to_string(job.attempts) + " attempts";
+                return;
+            }
+            metrics.retried.add();
+            queue.push_back(id);
+            queuedSamples += job.info.samples;
+        }
+
+        // Drop the connection and requeue what the worker held. Requires mtx.
+        void lost(Worker& w, const std::string& reason) {
+            bool wasReady = (w.state == READY);
+            size_t requeued = w.inFlight.size();
+            for (uint64_t id : w.inFlight) { retry(id); }
+            w.inFlight.clear();
+            retryLater(w, reason);
+            if (!wasReady) { return; }
+            metrics.workersLost.add();
+            events.push_back("Worker " + w.address + " lost (" + reason + ")" + (requeued ? ", " + std::to_string(requeued) + " jobs handed to other workers." : "."));
+        }
+
+        // Requires mtx
+        void retryLater(Worker& w, const std::string& reason) {
+            disconnect(w);
+            w.error = reason;
+            w.backoffMs = std::clamp<int>(w.backoffMs * 2, cfg.reconnectMinMs, cfg.reconnectMaxMs);
+            w.retryAt = Clock::now() + std::chrono::milliseconds(w.backoffMs);
+        }
+
+        // Requires mtx
+        void disconnect(Worker& w) {
+            if (w.sock >= 0) { ::close(w.sock); }
+            w.sock = -1;
+            w.state = DISCONNECTED;
+            w.in.clear();
+            w.out.clear();
+        }
+
+        // Finished jobs at the front of their channel, in order. Requires mtx.
+        void collect(std::vector<Delivery>& deliveries) {
+            for (auto it = order.begin(); it != order.end();) {
+                auto& channel = it->second;
+                while (!channel.empty() && jobs[channel.front()]->done) {
+                    Job& job = *jobs[channel.front()];
+                    deliveries.push_back(Delivery{ std::move(job.onResult), job.success, job.text, job.decodeSec, job.worker });
+                    jobs.erase(channel.front());
+                    channel.pop_front();
+                }
+                it = channel.empty() ? order.erase(it) : std::next(it);
+            }
+        }
+
+        // Requires mtx, so the pipe can't be closed underneath. A full pipe is as good as a write.
+        void wake() {
+            if (wakePipe[1] < 0) { return; }
+            ssize_t ret = write(wakePipe[1], "", 1);
+            (void)ret;
+        }
+
+        Config cfg;
+        EventHandler onEvent;
+        std::string error;
+        int wakePipe[2] = { -1, -1 };
+        std::atomic<bool> running = false;
+        std::thread dispatcherThread;
+        std::atomic<uint64_t> nextJobId = 1;
+        std::vector<std::string> events;    // Dispatcher thread only, reported without the lock
+
+        std::mutex mtx;     // Guards the jobs and the workers against submitters and status readers
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::map<uint64_t, std::unique_ptr<Job>> jobs;
+        std::deque<uint64_t> queue;                 // Waiting for a worker
+        std::map<int, std::deque<uint64_t>> order;  // Per channel, in submission order, until delivered
+        size_t queuedSamples = 0;
+        DecoderPool::QueueConfig queueCfg;
+    };
+}
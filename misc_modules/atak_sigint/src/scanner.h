@@ -0,0 +1,257 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <gui/gui.h>
+#include <gui/tuner.h>
+#include "fft_activity.h"
+
+namespace sigint {
+    // Spectrum scanner driving the selected VFO.
+    // Every interval the latest waterfall FFT is compared against a noise floor estimate. Scan list
+    // entries inside the displayed band are all checked on every frame, entries outside of it are
+    // visited in turn by retuning and waiting for the dwell time. When an entry is active the VFO locks
+    // onto it and stays there until the channel has been quiet for the hold time (and VoxHunt isn't in
+    // the middle of a transmission). A higher priority entry keying up preempts a lower priority one.
+    class Scanner {
+    public:
+        struct Entry {
+            double frequency;
+            int priority;
+
+            // Statistics, updated by the scanner
+            float levelDb = -150.0f;
+            bool active = false;
+            uint64_t hits = 0;
+            uint64_t checks = 0;
+            float revisitAvgMs = 0.0f;  // Average time between two checks of this entry
+            float revisitMaxMs = 0.0f;
+            std::chrono::steady_clock::time_point lastCheck;
+        };
+
+        struct Carrier {
+            double frequency;
+            float levelDb;
+        };
+
+        struct Config {
+            float thresholdDb = 10.0f;          // Level above noise floor that counts as activity
+            double channelBandwidth = 12500.0;  // Bandwidth checked around each entry
+            float dwellMs = 250.0f;             // Settling time after retuning, before the spectrum is trusted
+            float holdMs = 2000.0f;             // How long to stay on a channel after it goes quiet
+            int intervalMs = 50;
+        };
+
+        enum State {
+            STATE_SCANNING,
+            STATE_RECEIVING
+        };
+
+        ~Scanner() { stop(); }
+
+        void start() {
+            if (running) { return; }
+            running = true;
+            state = STATE_SCANNING;
+            workerThread = std::thread(&Scanner::worker, this);
+        }
+
+        void stop() {
+            if (!running) { return; }
+            running = false;
+            if (workerThread.joinable()) { workerThread.join(); }
+        }
+
+        bool isRunning() { return running; }
+
+        void addEntry(double frequency, int priority) {
+            std::lock_guard<std::mutex> lck(mtx);
+            Entry entry;
+            entry.frequency = frequency;
+            entry.priority = priority;
+            entries.push_back(entry);
+            current = -1;
+        }
+
+        void removeEntry(int index) {
+            std::lock_guard<std::mutex> lck(mtx);
+            if (index < 0 || index >= (int)entries.size()) { return; }
+            entries.erase(entries.begin() + index);
+            current = -1;
+            state = STATE_SCANNING;
+        }
+
+        void resetStats() {
+            std::lock_guard<std::mutex> lck(mtx);
+            for (auto& e : entries) {
+                e.hits = 0;
+                e.checks = 0;
+                e.revisitAvgMs = 0.0f;
+                e.revisitMaxMs = 0.0f;
+            }
+        }
+
+        void setConfig(const Config& config) {
+            std::lock_guard<std::mutex> lck(mtx);
+            cfg = config;
+        }
+
+        Config getConfig() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return cfg;
+        }
+
+        // Snapshot of the scan list and its statistics for display
+        std::vector<Entry> getEntries() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return entries;
+        }
+
+        std::vector<Carrier> getCarriers() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return carriers;
+        }
+
+        State getState() { return state; }
+        float getNoiseFloor() { return noiseFloorDb; }
+
+        double getCurrentFrequency() {
+            std::lock_guard<std::mutex> lck(mtx);
+            return (current >= 0 && current < (int)entries.size()) ? entries[current].frequency : 0.0;
+        }
+
+        // Set while VoxHunt is segmenting a transmission, the scanner won't leave the channel meanwhile
+        void setVoiceActive(bool active) { voiceActive = active; }
+
+    private:
+        void worker() {
+            std::vector<float> spectrum;
+            std::vector<float> scratch;
+            std::vector<fft::Carrier> found;
+            auto settleUntil = std::chrono::steady_clock::now();
+            auto lastActivity = std::chrono::steady_clock::now();
+
+            while (running) {
+                int intervalMs;
+                {
+                    std::lock_guard<std::mutex> lck(mtx);
+                    intervalMs = cfg.intervalMs;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+                auto now = std::chrono::steady_clock::now();
+                if (now < settleUntil) { continue; }
+
+                // Copy the latest FFT out so the waterfall isn't held up
+                int width = 0;
+                float* data = gui::waterfall.acquireLatestFFT(width);
+                if (!data) { continue; }
+                spectrum.assign(data, data + width);
+                gui::waterfall.releaseLatestFFT();
+                if (width <= 0) { continue; }
+
+                double wfWidth = gui::waterfall.getViewBandwidth();
+                double wfStart = gui::waterfall.getCenterFrequency() + gui::waterfall.getViewOffset() - (wfWidth / 2.0);
+                double wfEnd = wfStart + wfWidth;
+                double binWidth = wfWidth / (double)width;
+
+                double tuneTo = 0.0;
+                {
+                    std::lock_guard<std::mutex> lck(mtx);
+                    noiseFloorDb = fft::noiseFloor(spectrum.data(), width, scratch);
+                    float threshold = noiseFloorDb + cfg.thresholdDb;
+
+                    // Wideband view of everything that's keyed up right now
+                    fft::findCarriers(spectrum.data(), width, threshold, 2, found);
+                    carriers.clear();
+                    for (const auto& c : found) {
+                        carriers.push_back(Carrier{ wfStart + ((double)c.peakBin + 0.5) * binWidth, c.peakDb });
+                    }
+
+                    // Check every entry that's in view, keep the highest priority active one
+                    int best = -1;
+                    for (int i = 0; i < (int)entries.size(); i++) {
+                        Entry& e = entries[i];
+                        double low = e.frequency - cfg.channelBandwidth / 2.0;
+                        double high = e.frequency + cfg.channelBandwidth / 2.0;
+                        if (low < wfStart || high > wfEnd) { continue; }
+                        int startBin = std::clamp<int>((int)((low - wfStart) / binWidth), 0, width - 1);
+                        int endBin = std::clamp<int>((int)((high - wfStart) / binWidth) + 1, startBin + 1, width);
+                        e.levelDb = fft::maxInRange(spectrum.data(), startBin, endBin);
+                        e.active = (e.levelDb > threshold);
+
+                        // Revisit latency, exponentially averaged
+                        if (e.checks) {
+                            float dt = std::chrono::duration<float, std::milli>(now - e.lastCheck).count();
+                            e.revisitAvgMs = (e.checks == 1) ? dt : (e.revisitAvgMs * 0.9f + dt * 0.1f);
+                            e.revisitMaxMs = std::max<float>(e.revisitMaxMs, dt);
+                        }
+                        e.lastCheck = now;
+                        e.checks++;
+
+                        if (e.active && (best < 0 || e.priority > entries[best].priority)) { best = i; }
+                    }
+
+                    if (state == STATE_RECEIVING && current >= 0 && current < (int)entries.size()) {
+                        if (entries[current].active) { lastActivity = now; }
+                        bool holdExpired = std::chrono::duration<float, std::milli>(now - lastActivity).count() > cfg.holdMs;
+                        if (best >= 0 && best != current && entries[best].priority > entries[current].priority) {
+                            // Priority channel keyed up
+                            current = best;
+                            entries[current].hits++;
+                            lastActivity = now;
+                            tuneTo = entries[current].frequency;
+                        } else if (holdExpired && !voiceActive) {
+                            state = STATE_SCANNING;
+                        }
+                    } else {
+                        state = STATE_SCANNING;
+                    }
+
+                    if (state == STATE_SCANNING && !entries.empty()) {
+                        if (best >= 0) {
+                            // Lock on
+                            current = best;
+                            entries[current].hits++;
+                            lastActivity = now;
+                            state = STATE_RECEIVING;
+                            tuneTo = entries[current].frequency;
+                        } else {
+                            // Nothing in view, visit the next entry that's out of view
+                            for (size_t n = 0; n < entries.size(); n++) {
+                                cursor = (cursor + 1) % entries.size();
+                                const Entry& e = entries[cursor];
+                                if (e.frequency - cfg.channelBandwidth / 2.0 < wfStart || e.frequency + cfg.channelBandwidth / 2.0 > wfEnd) {
+                                    tuneTo = e.frequency;
+                                    settleUntil = now + std::chrono::milliseconds((int)cfg.dwellMs);
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+
+                // Retune outside the lock, this can restart the source
+                if (tuneTo != 0.0 && !gui::waterfall.selectedVFO.empty()) {
+                    tuner::normalTuning(gui::waterfall.selectedVFO, tuneTo);
+                }
+            }
+        }
+
+        Config cfg;
+        std::mutex mtx;
+        std::vector<Entry> entries;
+        std::vector<Carrier> carriers;
+        int current = -1;
+        int cursor = 0;
+
+        std::atomic<State> state = STATE_SCANNING;
+        std::atomic<float> noiseFloorDb = -150.0f;
+        std::atomic<bool> voiceActive = false;
+        std::atomic<bool> running = false;
+        std::thread workerThread;
+    };
+}
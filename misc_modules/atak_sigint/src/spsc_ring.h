@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+namespace sigint {
+    // Cache line size used to keep producer and consumer indices apart
+    constexpr size_t CACHE_LINE_SIZE = 64;
+
+    // Fixed-capacity, lock-free single-producer/single-consumer ring.
+    // The producer (DSP thread) writes whole blocks with memcpy and never blocks:
+    // samples that do not fit are dropped and counted as an overrun.
+    // The consumer reads contiguous spans directly out of the storage, then commits them.
+    template <class T>
+    class SpscRing {
+    public:
+        SpscRing(size_t capacity) {
+            // Round up to a power of two so indices can be masked instead of divided
+            size_t cap = 1;
+            while (cap < capacity) { cap <<= 1; }
+            buffer.resize(cap);
+            mask = cap - 1;
+        }
+
+        // Producer side. Returns the number of elements actually written.
+        size_t write(const T* data, size_t count) {
+            size_t w = writeIdx.load(std::memory_order_relaxed);
+            size_t r = readIdx.load(std::memory_order_acquire);
+            size_t space = buffer.size() - (w - r);
+            size_t n = std::min<size_t>(count, space);
+            if (n < count) {
+                overrunCount.fetch_add(count - n, std::memory_order_relaxed);
+            }
+            if (!n) { return 0; }
+
+            size_t start = w & mask;
+            size_t first = std::min<size_t>(n, buffer.size() - start);
+            memcpy(&buffer[start], data, first * sizeof(T));
+            if (n > first) {
+                memcpy(&buffer[0], data + first, (n - first) * sizeof(T));
+            }
+            writeIdx.store(w + n, std::memory_order_release);
+            return n;
+        }
+
+        // Consumer side. Exposes the longest contiguous readable span without copying.
+        // The span stays valid until commit() is called.
+        size_t readSpan(const T*& data) {
+            size_t r = readIdx.load(std::memory_order_relaxed);
+            size_t w = writeIdx.load(std::memory_order_acquire);
+            size_t start = r & mask;
+            data = &buffer[start];
+            return std::min<size_t>(w - r, buffer.size() - start);
+        }
+
+        // Consumer side. Releases count elements previously obtained from readSpan()
+        void commit(size_t count) {
+            readIdx.store(readIdx.load(std::memory_order_relaxed) + count, std::memory_order_release);
+        }
+
+        // Consumer side. Drops everything currently buffered
+        void clear() {
+            readIdx.store(writeIdx.load(std::memory_order_acquire), std::memory_order_release);
+        }
+
+        size_t available() const {
+            return writeIdx.load(std::memory_order_acquire) - readIdx.load(std::memory_order_acquire);
+        }
+
+        size_t capacity() const { return buffer.size(); }
+
+        // Total number of elements dropped because the ring was full
+        uint64_t overruns() const { return overrunCount.load(std::memory_order_relaxed); }
+
+    private:
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> writeIdx = 0;
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> readIdx = 0;
+        alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> overrunCount = 0;
+        alignas(CACHE_LINE_SIZE) std::vector<T> buffer;
+        size_t mask;
+    };
+}
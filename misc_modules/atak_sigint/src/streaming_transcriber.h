@@ -0,0 +1,195 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdint.h>
+#include "whisper.h"
+
+namespace sigint {
+    // Low-latency incremental transcription of a transmission that is still in progress.
+    // The audio of the open segment is re-decoded every step over a sliding window. Tokens that two
+    // consecutive hypotheses agree on are committed (local agreement), the rest is shown as partial
+    // text that gets rewritten on the next step. Once the window grows past windowMs it slides forward
+    // to the end of the committed text, and committed tokens are carried into the next decode (and the
+    // next transmission) as prompt_tokens.
+    class StreamingTranscriber {
+    public:
+        struct Config {
+            int sampleRate = 16000;
+            float stepMs = 500.0f;      // Minimum new audio between two partial decodes
+            float windowMs = 8000.0f;   // Window length before it slides forward
+            int maxPromptTokens = 64;   // Tokens carried forward as context
+            int nThreads = 4;
+        };
+
+        StreamingTranscriber() {}
+
+        // Bind to a model. Prompt context carried from another model is dropped, token IDs differ between vocabularies.
+        void init(whisper_context* ctx) {
+            this->ctx = ctx;
+            promptTokens.clear();
+            reset();
+        }
+
+        whisper_context* getContext() { return ctx; }
+
+        void configure(const Config& config) { cfg = config; }
+        const Config& getConfig() { return cfg; }
+
+        // Hooked into every decode. An interrupted update() or finish() leaves the state as it was, so it
+        // can simply be called again.
+        void setAbortCallback(ggml_abort_callback callback, void* data) {
+            abortCallback = callback;
+            abortData = data;
+        }
+
+        // Called with the audio of the segment in progress. Decodes a new partial hypothesis on the given
+        // decoder state when enough new audio has arrived. Returns true if the partial text changed.
+        bool update(const std::vector<float>& audio, whisper_state* state) {
+            if (!ctx) { return false; }
+            size_t step = (size_t)(cfg.sampleRate * cfg.stepMs / 1000.0f);
+            if (audio.size() < decodedSize + step) { return false; }
+
+            std::vector<Token> hyp;
+            if (!decode(audio, state, true, hyp)) { return false; }
+            decodedSize = audio.size();
+
+            // Commit the prefix the last two hypotheses agree on
+            size_t agreed = 0;
+            while (agreed < hyp.size() && agreed < pending.size() && hyp[agreed].id == pending[agreed].id) { agreed++; }
+            for (size_t i = 0; i < agreed; i++) {
+                committedText += hyp[i].text;
+                windowCommitted.push_back(hyp[i]);
+            }
+            pending.assign(hyp.begin() + agreed, hyp.end());
+
+            // Slide the window to the end of the committed text once it gets too long
+            size_t maxWindow = (size_t)(cfg.sampleRate * cfg.windowMs / 1000.0f);
+            if (audio.size() - windowStart > maxWindow && !windowCommitted.empty()) {
+                windowStart = std::max<size_t>(windowStart, windowCommitted.back().end);
+                carryForward(windowCommitted);
+                windowCommitted.clear();
+            }
+
+            std::string newPartial = committedText;
+            for (const auto& t : pending) { newPartial += t.text; }
+            if (newPartial == partialText) { return false; }
+            partialText = newPartial;
+            return true;
+        }
+
+        // Called with the complete segment once the transmission ends. Decodes whatever hasn't been
+        // committed yet with full context and returns the whole transcript of the transmission.
+        std::string finish(const std::vector<float>& audio, whisper_state* state) {
+            std::string text = committedText;
+            std::vector<Token> hyp;
+            if (ctx && windowStart < audio.size()) {
+                if (decode(audio, state, false, hyp)) {
+                    for (const auto& t : hyp) { text += t.text; }
+                    windowCommitted.insert(windowCommitted.end(), hyp.begin(), hyp.end());
+                } else if (abortCallback && abortCallback(abortData)) {
+                    return "";
+                }
+            }
+            carryForward(windowCommitted);
+            reset();
+            return text;
+        }
+
+        // Forget the transmission in progress, but keep the prompt context
+        void reset() {
+            windowStart = 0;
+            decodedSize = 0;
+            committedText.clear();
+            partialText.clear();
+            windowCommitted.clear();
+            pending.clear();
+        }
+
+        const std::string& getPartial() { return partialText; }
+
+    private:
+        struct Token {
+            whisper_token id;
+            std::string text;
+            size_t end; // Absolute sample position where the token ends
+        };
+
+        bool decode(const std::vector<float>& audio, whisper_state* state, bool partial, std::vector<Token>& hyp) {
+            // Whisper needs at least a second of audio, pad the window with silence if needed
+            size_t minSize = (size_t)cfg.sampleRate + cfg.sampleRate / 10;
+            window.assign(audio.begin() + windowStart, audio.end());
+            size_t audioSize = window.size();
+            if (window.size() < minSize) { window.resize(minSize, 0.0f); }
+
+            whisper_full_params params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+            params.print_progress = false;
+            params.print_special = false;
+            params.print_timestamps = false;
+            params.print_realtime = false;
+            params.translate = false;
+            params.language = "en";
+            params.n_threads = cfg.nThreads;
+            params.no_context = true;
+            params.single_segment = partial;
+            params.token_timestamps = true;
+            params.prompt_tokens = promptTokens.empty() ? nullptr : promptTokens.data();
+            params.prompt_n_tokens = (int)promptTokens.size();
+            params.abort_callback = abortCallback;
+            params.abort_callback_user_data = abortData;
+            if (partial) {
+                // Only encode as much context as there is audio (50 frames per second), much faster than the full 30s
+                params.audio_ctx = std::min<int>(1500, (int)(window.size() * 50 / cfg.sampleRate) + 32);
+                params.temperature_inc = 0.0f;
+            }
+
+            if (whisper_full_with_state(ctx, state, params, window.data(), window.size()) != 0) { return false; }
+
+            // Collect text tokens, skipping timestamps and other special tokens
+            whisper_token eot = whisper_token_eot(ctx);
+            std::vector<Token> all;
+            int nSegments = whisper_full_n_segments_from_state(state);
+            for (int s = 0; s < nSegments; s++) {
+                int nTokens = whisper_full_n_tokens_from_state(state, s);
+                for (int i = 0; i < nTokens; i++) {
+                    whisper_token_data data = whisper_full_get_token_data_from_state(state, s, i);
+                    if (data.id >= eot) { continue; }
+                    size_t end = windowStart + std::min<size_t>(audioSize, (size_t)std::max<int64_t>(data.t1, 0) * cfg.sampleRate / 100);
+                    all.push_back(Token{ data.id, whisper_full_get_token_text_from_state(ctx, state, s, i), end });
+                }
+            }
+
+            // The window still contains audio whose tokens were already committed, skip them
+            size_t skip = 0;
+            while (skip < all.size() && skip < windowCommitted.size() && all[skip].id == windowCommitted[skip].id) { skip++; }
+            if (skip < windowCommitted.size()) {
+                // Whisper revised committed text, fall back to skipping by time
+                size_t committedEnd = windowCommitted.back().end;
+                while (skip < all.size() && all[skip].end <= committedEnd) { skip++; }
+            }
+            hyp.assign(all.begin() + skip, all.end());
+            return true;
+        }
+
+        void carryForward(const std::vector<Token>& tokens) {
+            for (const auto& t : tokens) { promptTokens.push_back(t.id); }
+            if (promptTokens.size() > (size_t)cfg.maxPromptTokens) {
+                promptTokens.erase(promptTokens.begin(), promptTokens.end() - cfg.maxPromptTokens);
+            }
+        }
+
+        Config cfg;
+        whisper_context* ctx = nullptr;
+        ggml_abort_callback abortCallback = nullptr;
+        void* abortData = nullptr;
+
+        std::vector<float> window;
+        size_t windowStart = 0;
+        size_t decodedSize = 0;
+        std::string committedText;
+        std::string partialText;
+        std::vector<Token> windowCommitted;
+        std::vector<Token> pending;
+        std::vector<whisper_token> promptTokens;
+    };
+}
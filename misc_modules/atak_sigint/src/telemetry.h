@@ -0,0 +1,294 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+namespace sigint::telemetry {
+    // Hot path metrics. Updating one is a relaxed atomic add (a histogram adds to its bucket, its count
+    // and its sum), nothing ever locks or allocates, so they can stay on in the DSP and decoder threads.
+
+    class Counter {
+    public:
+        void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+        uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> value = 0;
+    };
+
+    class Gauge {
+    public:
+        void set(double v) { value.store(v, std::memory_order_relaxed); }
+        double get() const { return value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<double> value = 0.0;
+    };
+
+    // Fixed bucket histogram of durations or sizes
+    class Histogram {
+    public:
+        // Upper bounds suited to latencies in seconds, from 100us to a minute
+        static constexpr double LATENCY_BOUNDS[] = { 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0 };
+        static constexpr int MAX_BUCKETS = 24;
+
+        Histogram() : Histogram(LATENCY_BOUNDS, sizeof(LATENCY_BOUNDS) / sizeof(double)) {}
+
+        Histogram(const double* bounds, int count) {
+            boundCount = std::min<int>(count, MAX_BUCKETS - 1);
+            for (int i = 0; i < boundCount; i++) { this->bounds[i] = bounds[i]; }
+        }
+
+        void observe(double v) {
+            int i = 0;
+            while (i < boundCount && v > bounds[i]) { i++; }
+            buckets[i].fetch_add(1, std::memory_order_relaxed);
+            total.fetch_add(1, std::memory_order_relaxed);
+            sumMicros.fetch_add((int64_t)(v * 1e6), std::memory_order_relaxed);
+        }
+
+        uint64_t count() const { return total.load(std::memory_order_relaxed); }
+        double sum() const { return (double)sumMicros.load(std::memory_order_relaxed) / 1e6; }
+        int getBoundCount() const { return boundCount; }
+        double getBound(int i) const { return bounds[i]; }
+        uint64_t getBucket(int i) const { return buckets[i].load(std::memory_order_relaxed); }
+
+        // Quantile estimate, interpolated inside the bucket it falls in
+        double quantile(double q) const {
+            uint64_t n = count();
+            if (!n) { return 0.0; }
+            double rank = q * (double)n;
+            uint64_t seen = 0;
+            for (int i = 0; i <= boundCount; i++) {
+                uint64_t b = getBucket(i);
+                if (b && (double)(seen + b) >= rank) {
+                    double low = (i > 0) ? bounds[i - 1] : 0.0;
+                    double high = (i < boundCount) ? bounds[i] : bounds[boundCount - 1] * 2.0;
+                    return low + (high - low) * std::clamp<double>((rank - (double)seen) / (double)b, 0.0, 1.0);
+                }
+                seen += b;
+            }
+            return bounds[boundCount - 1];
+        }
+
+    private:
+        double bounds[MAX_BUCKETS];
+        int boundCount;
+        std::atomic<uint64_t> buckets[MAX_BUCKETS] = {};
+        std::atomic<uint64_t> total = 0;
+        std::atomic<int64_t> sumMicros = 0;
+    };
+
+    // Time a scope into a histogram
+    class ScopedTimer {
+    public:
+        ScopedTimer(Histogram& hist) : hist(hist), start(std::chrono::steady_clock::now()) {}
+        ~ScopedTimer() { hist.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()); }
+
+    private:
+        Histogram& hist;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    // Names the metrics for export. Registration takes a lock, updating the metrics doesn't involve
+    // the registry at all. The registry doesn't own the metrics, owners must remove theirs before
+    // destroying them.
+    class Registry {
+    public:
+        void add(const std::string& name, const std::string& help, const std::string& labels, Counter* counter) {
+            insert(Entry{ name, help, labels, "counter", counter, nullptr, nullptr });
+        }
+
+        void add(const std::string& name, const std::string& help, const std::string& labels, Gauge* gauge) {
+            insert(Entry{ name, help, labels, "gauge", nullptr, gauge, nullptr });
+        }
+
+        void add(const std::string& name, const std::string& help, const std::string& labels, Histogram* hist) {
+            insert(Entry{ name, help, labels, "histogram", nullptr, nullptr, hist });
+        }
+
+        // Remove every metric registered with exactly these labels, e.g. those of a channel going away
+        void removeLabels(const std::string& labels) {
+            std::lock_guard<std::mutex> lck(mtx);
+            entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const Entry& e) { return e.labels == labels; }), entries.end());
+        }
+
+        // Prometheus text exposition format (version 0.0.4)
+        std::string exportText() {
+            std::lock_guard<std::mutex> lck(mtx);
+            std::string out;
+            char buf[64];
+            for (size_t i = 0; i < entries.size(); i++) {
+                const Entry& e = entries[i];
+                // Entries are kept grouped by name, HELP and TYPE are written once per family
+                if (!i || entries[i - 1].name != e.name) {
+                    out += "# HELP " + e.name + " " + e.help + "\n";
+                    out += "# TYPE " + e.name + " " + e.type + "\n";
+                }
+                std::string labels = e.labels.empty() ? "" : "{" + e.labels + "}";
+                if (e.counter) {
+                    snprintf(buf, sizeof(buf), " %llu\n", (unsigned long long)e.counter->get());
+                    out += e.name + labels + buf;
+                } else if (e.gauge) {
+                    snprintf(buf, sizeof(buf), " %g\n", e.gauge->get());
+                    out += e.name + labels + buf;
+                } else if (e.hist) {
+                    std::string sep = e.labels.empty() ? "" : ",";
+                    uint64_t cumulative = 0;
+                    for (int b = 0; b < e.hist->getBoundCount(); b++) {
+                        cumulative += e.hist->getBucket(b);
+                        snprintf(buf, sizeof(buf), "%g\"} %llu\n", e.hist->getBound(b), (unsigned long long)cumulative);
+                        out += e.name + "_bucket{" + e.labels + sep + "le=\"" + buf;
+                    }
+                    // Read the count once and use it for +Inf as well, so the exposition stays consistent
+                    uint64_t count = e.hist->count();
+                    snprintf(buf, sizeof(buf), "+Inf\"} %llu\n", (unsigned long long)std::max<uint64_t>(count, cumulative));
+                    out += e.name + "_bucket{" + e.labels + sep + "le=\"" + buf;
+                    snprintf(buf, sizeof(buf), " %g\n", e.hist->sum());
+                    out += e.name + "_sum" + labels + buf;
+                    snprintf(buf, sizeof(buf), " %llu\n", (unsigned long long)std::max<uint64_t>(count, cumulative));
+                    out += e.name + "_count" + labels + buf;
+                }
+            }
+            return out;
+        }
+
+    private:
+        struct Entry {
+            std::string name;
+            std::string help;
+            std::string labels;
+            const char* type;
+            Counter* counter;
+            Gauge* gauge;
+            Histogram* hist;
+        };
+
+        void insert(Entry entry) {
+            std::lock_guard<std::mutex> lck(mtx);
+            auto it = std::find_if(entries.rbegin(), entries.rend(), [&](const Entry& e) { return e.name == entry.name; });
+            entries.insert((it == entries.rend()) ? entries.end() : it.base(), std::move(entry));
+        }
+
+        std::mutex mtx;
+        std::vector<Entry> entries;
+    };
+
+    // Periodically writes the registry to a file (atomically replaced, as node_exporter's textfile
+    // collector expects) and/or serves it over HTTP on a localhost port for Prometheus to scrape.
+    class Exporter {
+    public:
+        struct Config {
+            std::string path;       // Empty to disable the file
+            int port = 0;           // 0 to disable the socket
+            int intervalSec = 10;
+        };
+
+        ~Exporter() { stop(); }
+
+        bool start(Registry* registry, const Config& config) {
+            stop();
+            this->registry = registry;
+            cfg = config;
+            if (cfg.port > 0) {
+                listenSock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                int one = 1;
+                setsockopt(listenSock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+                sockaddr_in addr;
+                memset(&addr, 0, sizeof(addr));
+                addr.sin_family = AF_INET;
+                addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                addr.sin_port = htons(cfg.port);
+                if (listenSock < 0 || bind(listenSock, (sockaddr*)&addr, sizeof(addr)) || listen(listenSock, 4)) {
+                    if (listenSock >= 0) { ::close(listenSock); }
+                    listenSock = -1;
+                }
+            }
+            running = true;
+            workerThread = std::thread(&Exporter::worker, this);
+            return cfg.port <= 0 || listenSock >= 0;
+        }
+
+        void stop() {
+            if (!running) { return; }
+            running = false;
+            if (workerThread.joinable()) { workerThread.join(); }
+            if (listenSock >= 0) {
+                ::close(listenSock);
+                listenSock = -1;
+            }
+        }
+
+    private:
+        void worker() {
+            auto nextWrite = std::chrono::steady_clock::now();
+            while (running) {
+                auto now = std::chrono::steady_clock::now();
+                if (!cfg.path.empty() && now >= nextWrite) {
+                    writeFile();
+                    nextWrite = now + std::chrono::seconds(cfg.intervalSec);
+                }
+
+                if (listenSock < 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    continue;
+                }
+                pollfd pfd = { listenSock, POLLIN, 0 };
+                if (poll(&pfd, 1, 100) <= 0) { continue; }
+                int sock = accept4(listenSock, NULL, NULL, SOCK_CLOEXEC);
+                if (sock < 0) { continue; }
+                serve(sock);
+                ::close(sock);
+            }
+            if (!cfg.path.empty()) { writeFile(); }
+        }
+
+        void writeFile() {
+            std::string text = registry->exportText();
+            std::string tmp = cfg.path + ".tmp";
+            FILE* f = fopen(tmp.c_str(), "wb");
+            if (!f) { return; }
+            bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+            ok &= (fclose(f) == 0);
+            if (ok) { rename(tmp.c_str(), cfg.path.c_str()); }
+        }
+
+        // Answer a single scrape. Whatever was asked for, the metrics are returned.
+        void serve(int sock) {
+            std::string req;
+            char buf[1024];
+            while (req.find("\r\n\r\n") == std::string::npos && req.size() < 8192) {
+                pollfd pfd = { sock, POLLIN, 0 };
+                if (poll(&pfd, 1, 1000) <= 0) { return; }
+                ssize_t len = recv(sock, buf, sizeof(buf), 0);
+                if (len <= 0) { return; }
+                req.append(buf, len);
+            }
+            std::string body = registry->exportText();
+            std::string resp = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+            size_t done = 0;
+            while (done < resp.size()) {
+                ssize_t ret = send(sock, resp.data() + done, resp.size() - done, MSG_NOSIGNAL);
+                if (ret <= 0) { return; }
+                done += ret;
+            }
+        }
+
+        Registry* registry = nullptr;
+        Config cfg;
+        int listenSock = -1;
+        std::atomic<bool> running = false;
+        std::thread workerThread;
+    };
+}
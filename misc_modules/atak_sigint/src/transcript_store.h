@@ -0,0 +1,498 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "telemetry.h"
+
+namespace sigint {
+    // Every transcript with where and when it was heard, kept on disk for later search.
+    // Records are appended to fixed size segment files in a directory, which are memory-mapped: the
+    // writer thread copies a record into the map and bumps the segment's fill mark, readers decode
+    // records straight out of it. Segments are opened with the module and indexed on the writer thread:
+    // a sparse time index (every TIME_INDEX_STRIDE-th record), a frequency index (record ids per kHz)
+    // and a word index (record ids per word), so time ranges, frequencies and full text lookups touch
+    // only the records they return, also with millions of them.
+    // Times never go backwards in the store, a record stamped before the previous one (the wall clock
+    // was stepped back) is moved up to it. Record ids are therefore in time order.
+    class TranscriptStore {
+    public:
+        struct Config {
+            std::string dir;
+            size_t segmentBytes = 64 << 20;     // Size of a segment file, allocated on disk when it's created
+            size_t queueCapacity = 4096;
+        };
+
+        struct Record {
+            int64_t timeMs = 0;         // Unix time the transmission started
+            double frequency = 0.0;     // Hz, 0 if unknown
+            std::string mode;           // Demodulator ("NFM", "USB", ...), empty if unknown
+            float levelDb = 0.0f;       // Peak level
+            float snrDb = 0.0f;         // Peak over the noise floor
+            float durationSec = 0.0f;
+            std::string channel;
+            std::string text;
+        };
+
+        struct Query {
+            int64_t fromMs = 0;
+            int64_t toMs = INT64_MAX;
+            double frequency = 0.0;         // 0 for any
+            double toleranceHz = 5000.0;
+            std::string text;               // Words that must all appear, in any case and order
+            size_t limit = 500;             // Newest first
+        };
+
+        struct Metrics {
+            telemetry::Counter appended;
+            telemetry::Counter dropped;         // Queue full or no room on disk
+            telemetry::Histogram querySeconds;
+        };
+
+        ~TranscriptStore() { stop(); }
+
+        void start(const Config& config) {
+            stop();
+            cfg = config;
+            cfg.segmentBytes = std::max<size_t>(cfg.segmentBytes, 1 << 20);
+            stopWriter = false;
+            loading = true;
+            workerThread = std::thread(&TranscriptStore::worker, this);
+        }
+
+        // Writes everything still queued before returning
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lck(queueMtx);
+                if (!workerThread.joinable()) { return; }
+                stopWriter = true;
+            }
+            queueCnd.notify_all();
+            workerThread.join();
+
+            std::unique_lock<std::shared_mutex> lck(indexMtx);
+            for (auto& seg : segments) { seg->close(); }
+            segments.clear();
+            locations.clear();
+            blockTimes.clear();
+            byFrequency.clear();
+            byWord.clear();
+            lastTimeMs = 0;
+        }
+
+        // Queue a record, never blocks on disk
+        void append(Record record) {
+            {
+                std::lock_guard<std::mutex> lck(queueMtx);
+                if (!workerThread.joinable() || queue.size() >= cfg.queueCapacity) {
+                    metrics.dropped.add();
+                    return;
+                }
+                queue.push_back(std::move(record));
+            }
+            queueCnd.notify_one();
+        }
+
+        // Matching records, newest first. Any thread, runs alongside appends.
+        std::vector<Record> query(const Query& q) {
+            telemetry::ScopedTimer timer(metrics.querySeconds);
+            std::vector<Record> results;
+            std::shared_lock<std::shared_mutex> lck(indexMtx);
+            uint32_t lo = firstAtOrAfter(q.fromMs);
+            uint32_t hi = (q.toMs == INT64_MAX) ? (uint32_t)locations.size() : firstAtOrAfter(q.toMs + 1);
+            if (lo >= hi) { return results; }
+
+            std::vector<std::string> words = tokenize(q.text);
+            auto accept = [&](uint32_t id) {
+                Record rec = read(id);
+                if (q.frequency > 0.0 && std::abs(rec.frequency - q.frequency) > q.toleranceHz) { return; }
+                if (!words.empty()) {
+                    std::vector<std::string> have = tokenize(rec.text);
+                    for (const auto& w : words) {
+                        if (std::find(have.begin(), have.end(), w) == have.end()) { return; }
+                    }
+                }
+                results.push_back(std::move(rec));
+            };
+
+            if (!words.empty()) {
+                // Walk the shortest posting list, the others are checked by binary search
+                std::vector<const std::vector<uint32_t>*> lists;
+                for (const auto& w : words) {
+                    auto it = byWord.find(hashWord(w));
+                    if (it == byWord.end()) { return results; }
+                    lists.push_back(&it->second);
+                }
+                std::sort(lists.begin(), lists.end(), [](auto a, auto b) { return a->size() < b->size(); });
+                const std::vector<uint32_t>& shortest = *lists[0];
+                auto begin = std::lower_bound(shortest.begin(), shortest.end(), lo);
+                auto end = std::lower_bound(shortest.begin(), shortest.end(), hi);
+                for (auto it = end; it != begin && results.size() < q.limit;) {
+                    uint32_t id = *--it;
+                    bool inAll = true;
+                    for (size_t i = 1; i < lists.size() && inAll; i++) {
+                        inAll = std::binary_search(lists[i]->begin(), lists[i]->end(), id);
+                    }
+                    if (inAll) { accept(id); }
+                }
+            } else if (q.frequency > 0.0) {
+                std::vector<uint32_t> ids;
+                int64_t fromKhz = (int64_t)std::floor((q.frequency - q.toleranceHz) / 1000.0);
+                int64_t toKhz = (int64_t)std::ceil((q.frequency + q.toleranceHz) / 1000.0);
+                for (int64_t khz = fromKhz; khz <= toKhz; khz++) {
+                    auto it = byFrequency.find(khz);
+                    if (it == byFrequency.end()) { continue; }
+                    auto begin = std::lower_bound(it->second.begin(), it->second.end(), lo);
+                    auto end = std::lower_bound(it->second.begin(), it->second.end(), hi);
+                    ids.insert(ids.end(), begin, end);
+                }
+                std::sort(ids.begin(), ids.end());
+                for (auto it = ids.rbegin(); it != ids.rend() && results.size() < q.limit; it++) { accept(*it); }
+            } else {
+                for (uint32_t id = hi; id > lo && results.size() < q.limit; id--) { accept(id - 1); }
+            }
+            return results;
+        }
+
+        size_t size() {
+            std::shared_lock<std::shared_mutex> lck(indexMtx);
+            return locations.size();
+        }
+
+        // Bytes of records on disk
+        uint64_t getBytes() {
+            std::shared_lock<std::shared_mutex> lck(indexMtx);
+            uint64_t bytes = 0;
+            for (const auto& seg : segments) { bytes += seg->used(); }
+            return bytes;
+        }
+
+        // True until the segments on disk are indexed, queries only see part of the store meanwhile
+        bool isLoading() { return loading; }
+
+        std::string getError() {
+            std::lock_guard<std::mutex> lck(queueMtx);
+            return error;
+        }
+
+        // Lower case words, digits included ("146.52" is "146" and "52")
+        static std::vector<std::string> tokenize(const std::string& text) {
+            std::vector<std::string> words;
+            std::string word;
+            for (char c : text) {
+                if (isalnum((unsigned char)c)) {
+                    word += (char)tolower((unsigned char)c);
+                } else if (!word.empty()) {
+                    words.push_back(word);
+                    word.clear();
+                }
+            }
+            if (!word.empty()) { words.push_back(word); }
+            return words;
+        }
+
+        Metrics metrics;
+
+    private:
+        static constexpr uint32_t TIME_INDEX_STRIDE = 64;
+        static constexpr char MAGIC[8] = { 'S', 'I', 'G', 'T', 'R', 'S', '0', '1' };
+
+        struct SegmentHeader {
+            char magic[8];
+            uint64_t used;          // Bytes of the file holding records, header included
+            uint64_t capacity;
+            uint64_t reserved;
+        };
+
+        // Followed by mode, channel and text, the whole record padded to 8 bytes
+        struct RecordHeader {
+            uint32_t size;
+            uint32_t textLen;
+            int64_t timeMs;
+            double frequency;
+            float levelDb;
+            float snrDb;
+            float durationSec;
+            uint8_t modeLen;
+            uint8_t channelLen;
+            uint16_t reserved;
+        };
+
+        struct Segment {
+            std::string path;
+            int fd = -1;
+            uint8_t* base = NULL;
+            size_t capacity = 0;
+            bool writable = false;  // Its blocks are allocated, records can be appended
+
+            SegmentHeader* header() { return (SegmentHeader*)base; }
+            uint64_t used() { return header()->used; }
+
+            // Writes through the map to a page the file system can't back (disk full) raise SIGBUS, so
+            // a segment gets all its blocks up front. One created without them isn't created at all, one
+            // from an older version that can't get them is only read.
+            bool open(const std::string& path, size_t createBytes) {
+                this->path = path;
+                fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+                if (fd < 0) { return false; }
+                struct stat st;
+                if (fstat(fd, &st)) { return false; }
+                bool fresh = (st.st_size == 0);
+                capacity = fresh ? createBytes : st.st_size;
+                int ret = posix_fallocate(fd, 0, (off_t)capacity);
+                if (ret && fresh) {
+                    errno = ret;
+                    unlink(path.c_str());
+                    return false;
+                }
+                writable = !ret;
+                if (capacity < sizeof(SegmentHeader)) { return false; }
+                void* map = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (map == MAP_FAILED) { return false; }
+                base = (uint8_t*)map;
+                if (fresh) {
+                    memcpy(header()->magic, MAGIC, sizeof(MAGIC));
+                    header()->capacity = capacity;
+                    header()->used = sizeof(SegmentHeader);
+                }
+                return !memcmp(header()->magic, MAGIC, sizeof(MAGIC)) && used() >= sizeof(SegmentHeader) && used() <= capacity;
+            }
+
+            void close() {
+                if (base) {
+                    msync(base, capacity, MS_SYNC);
+                    munmap(base, capacity);
+                    base = NULL;
+                }
+                if (fd >= 0) {
+                    ::close(fd);
+                    fd = -1;
+                }
+            }
+        };
+
+        struct Location {
+            uint32_t segment;
+            uint32_t offset;
+        };
+
+        void worker() {
+            loadSegments();
+            loading = false;
+
+            std::vector<Record> batch;
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lck(queueMtx);
+                    queueCnd.wait(lck, [this]() { return stopWriter || !queue.empty(); });
+                    batch.swap(queue);
+                    if (batch.empty() && stopWriter) { break; }
+                }
+                for (auto& rec : batch) { write(rec); }
+                batch.clear();
+            }
+        }
+
+        // Open and index the segments already on disk, in name (i.e. creation) order
+        void loadSegments() {
+            mkdir(cfg.dir.c_str(), 0755);
+            std::vector<std::string> names;
+            if (DIR* dir = opendir(cfg.dir.c_str())) {
+                while (dirent* entry = readdir(dir)) {
+                    std::string name = entry->d_name;
+                    if (!name.compare(0, 12, "transcripts-") && name.size() > 4 && !name.compare(name.size() - 4, 4, ".seg")) { names.push_back(name); }
+                }
+                closedir(dir);
+            }
+            std::sort(names.begin(), names.end());
+
+            for (const auto& name : names) {
+                nextSegmentNumber = std::max<int>(nextSegmentNumber, atoi(name.c_str() + 12) + 1);
+                auto seg = std::make_unique<Segment>();
+                if (!seg->open(cfg.dir + "/" + name, cfg.segmentBytes)) {
+                    setError("Could not open " + seg->path + ", skipped");
+                    seg->close();
+                    continue;
+                }
+                std::unique_lock<std::shared_mutex> lck(indexMtx);
+                uint32_t segIndex = (uint32_t)segments.size();
+                uint64_t end = seg->used();
+                uint64_t offset = sizeof(SegmentHeader);
+                segments.push_back(std::move(seg));
+                // The fill mark and the records are written back independently, after a crash it may
+                // count records that never reached the disk. The segment ends at the first bad one.
+                while (offset + sizeof(RecordHeader) <= end) {
+                    const RecordHeader* hdr = (const RecordHeader*)(segments.back()->base + offset);
+                    if (hdr->size < sizeof(RecordHeader) || hdr->size % 8 || offset + hdr->size > end ||
+                        sizeof(RecordHeader) + (uint64_t)hdr->modeLen + hdr->channelLen + hdr->textLen > hdr->size) {
+                        break;
+                    }
+                    index(Location{ segIndex, (uint32_t)offset });
+                    offset += hdr->size;
+                }
+                if (offset != end) {
+                    setError(segments.back()->path + " was cut short at a damaged record");
+                    segments.back()->header()->used = offset;
+                }
+            }
+        }
+
+        void write(Record& rec) {
+            // Lengths are bounded by the header's fields
+            rec.mode.resize(std::min<size_t>(rec.mode.size(), 255));
+            rec.channel.resize(std::min<size_t>(rec.channel.size(), 255));
+            size_t size = (sizeof(RecordHeader) + rec.mode.size() + rec.channel.size() + rec.text.size() + 7) & ~(size_t)7;
+            if (size > cfg.segmentBytes / 2) {
+                rec.text.resize(cfg.segmentBytes / 4);
+                size = (sizeof(RecordHeader) + rec.mode.size() + rec.channel.size() + rec.text.size() + 7) & ~(size_t)7;
+            }
+
+            Segment* seg = segments.empty() ? NULL : segments.back().get();
+            if (!seg || !seg->writable || seg->used() + size > seg->capacity) {
+                char name[64];
+                snprintf(name, sizeof(name), "/transcripts-%06d.seg", nextSegmentNumber++);
+                auto fresh = std::make_unique<Segment>();
+                if (!fresh->open(cfg.dir + name, cfg.segmentBytes) || fresh->used() + size > fresh->capacity) {
+                    setError("Could not create " + fresh->path + ": " + strerror(errno));
+                    fresh->close();
+                    metrics.dropped.add();
+                    return;
+                }
+                std::unique_lock<std::shared_mutex> lck(indexMtx);
+                segments.push_back(std::move(fresh));
+                seg = segments.back().get();
+            }
+
+            // Copied in beyond the fill mark, readers can't see it until it's indexed. The segment's
+            // blocks are allocated, so the copy can't fault on a full file system.
+            uint64_t offset = seg->used();
+            RecordHeader hdr = {};
+            hdr.size = (uint32_t)size;
+            hdr.textLen = (uint32_t)rec.text.size();
+            hdr.timeMs = std::max<int64_t>(rec.timeMs, lastTimeMs);
+            hdr.frequency = rec.frequency;
+            hdr.levelDb = rec.levelDb;
+            hdr.snrDb = rec.snrDb;
+            hdr.durationSec = rec.durationSec;
+            hdr.modeLen = (uint8_t)rec.mode.size();
+            hdr.channelLen = (uint8_t)rec.channel.size();
+            uint8_t* dst = seg->base + offset;
+            memcpy(dst, &hdr, sizeof(hdr));
+            dst += sizeof(hdr);
+            memcpy(dst, rec.mode.data(), rec.mode.size());
+            dst += rec.mode.size();
+            memcpy(dst, rec.channel.data(), rec.channel.size());
+            dst += rec.channel.size();
+            memcpy(dst, rec.text.data(), rec.text.size());
+
+            std::unique_lock<std::shared_mutex> lck(indexMtx);
+            seg->header()->used = offset + size;
+            index(Location{ (uint32_t)(segments.size() - 1), (uint32_t)offset });
+            metrics.appended.add();
+        }
+
+        // Add a record to the indexes. Requires indexMtx held exclusively.
+        void index(Location loc) {
+            uint32_t id = (uint32_t)locations.size();
+            locations.push_back(loc);
+            const RecordHeader* hdr = header(loc);
+            lastTimeMs = std::max<int64_t>(lastTimeMs, hdr->timeMs);
+            if (id % TIME_INDEX_STRIDE == 0) { blockTimes.push_back(lastTimeMs); }
+            if (hdr->frequency > 0.0) { byFrequency[(int64_t)std::llround(hdr->frequency / 1000.0)].push_back(id); }
+
+            const char* text = (const char*)(hdr + 1) + hdr->modeLen + hdr->channelLen;
+            std::vector<std::string> words = tokenize(std::string(text, hdr->textLen));
+            std::sort(words.begin(), words.end());
+            words.erase(std::unique(words.begin(), words.end()), words.end());
+            for (const auto& w : words) {
+                std::vector<uint32_t>& postings = byWord[hashWord(w)];
+                // Two words of a record may share a hash
+                if (postings.empty() || postings.back() != id) { postings.push_back(id); }
+            }
+        }
+
+        const RecordHeader* header(Location loc) const {
+            return (const RecordHeader*)(segments[loc.segment]->base + loc.offset);
+        }
+
+        // Requires indexMtx
+        Record read(uint32_t id) const {
+            const RecordHeader* hdr = header(locations[id]);
+            const char* p = (const char*)(hdr + 1);
+            Record rec;
+            rec.timeMs = hdr->timeMs;
+            rec.frequency = hdr->frequency;
+            rec.levelDb = hdr->levelDb;
+            rec.snrDb = hdr->snrDb;
+            rec.durationSec = hdr->durationSec;
+            rec.mode.assign(p, hdr->modeLen);
+            p += hdr->modeLen;
+            rec.channel.assign(p, hdr->channelLen);
+            p += hdr->channelLen;
+            rec.text.assign(p, hdr->textLen);
+            return rec;
+        }
+
+        // Id of the first record at or after the given time. Requires indexMtx.
+        uint32_t firstAtOrAfter(int64_t timeMs) const {
+            // Last indexed block starting before the time, then a scan through it
+            auto it = std::lower_bound(blockTimes.begin(), blockTimes.end(), timeMs);
+            uint32_t id = (it == blockTimes.begin()) ? 0 : (uint32_t)((it - blockTimes.begin() - 1) * TIME_INDEX_STRIDE);
+            while (id < locations.size() && header(locations[id])->timeMs < timeMs) { id++; }
+            return id;
+        }
+
+        // FNV-1a
+        static uint32_t hashWord(const std::string& word) {
+            uint32_t h = 2166136261u;
+            for (char c : word) {
+                h ^= (uint8_t)c;
+                h *= 16777619u;
+            }
+            return h;
+        }
+
+        void setError(const std::string& message) {
+            std::lock_guard<std::mutex> lck(queueMtx);
+            error = message;
+        }
+
+        Config cfg;
+        std::thread workerThread;
+        std::atomic<bool> loading = false;
+
+        // Queue between producers and the writer thread
+        std::mutex queueMtx;
+        std::condition_variable queueCnd;
+        std::vector<Record> queue;
+        bool stopWriter = false;
+        std::string error;
+
+        // Segments and indexes, written by the writer thread, read by queries
+        std::shared_mutex indexMtx;
+        std::vector<std::unique_ptr<Segment>> segments;
+        std::vector<Location> locations;                                // Record id -> where it is
+        std::vector<int64_t> blockTimes;                                // Time of every TIME_INDEX_STRIDE-th record
+        std::unordered_map<int64_t, std::vector<uint32_t>> byFrequency; // kHz -> record ids
+        std::unordered_map<uint32_t, std::vector<uint32_t>> byWord;     // Word hash -> record ids
+        int64_t lastTimeMs = 0;
+        int nextSegmentNumber = 0;
+    };
+}
@@ -0,0 +1,221 @@
+#pragma once
+#include <vector>
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+
+namespace sigint {
+    // One keyed transmission, as cut out of the audio stream by the segmenter
+    struct VadSegment {
+        std::vector<float> samples;
+        uint64_t startSample;   // Position of the first sample in the stream
+        float peakDb;           // Loudest frame of the segment
+        float noiseFloorDb;     // Noise floor estimate when the segment opened
+    };
+
+    // Streaming energy-based voice activity segmenter.
+    // Audio is analysed in short frames against an adaptive noise floor. A segment opens when a frame
+    // rises above the floor by openDb, and closes once the level has stayed below closeDb for the hang time.
+    // While a segment is open the floor may still creep up to the quietest level of the last few seconds,
+    // so a carrier or open squelch that never dips (speech always does) ends up closing its segment.
+    // Each segment is prefixed with pre-roll audio so the first syllable isn't clipped. Anything outside
+    // a segment (dead air, squelched audio) is discarded and never reaches the decoder.
+    class VadSegmenter {
+    public:
+        static constexpr float MIN_NOISE_FLOOR_DB = -70.0f;
+        static constexpr float FLOOR_BLOCK_MS = 1000.0f;
+
+        struct Config {
+            int sampleRate = 16000;
+            float frameMs = 20.0f;
+            float openDb = 9.0f;        // Level above noise floor required to open a segment
+            float closeDb = 6.0f;       // Level above noise floor required to keep it open
+            float hangMs = 800.0f;      // How long the level must stay low before the segment closes
+            float tailMs = 200.0f;      // How much of the hang time is kept at the end of the segment
+            float preRollMs = 300.0f;   // Audio kept from before the segment opened
+            float minSpeechMs = 250.0f; // Segments with less active audio than this are dropped as clicks
+            float maxSegmentMs = 28000.0f; // Long transmissions are split to fit Whisper's 30s window
+        };
+
+        VadSegmenter() { configure(Config()); }
+
+        void configure(const Config& config) {
+            cfg = config;
+            frameSize = std::max<int>(1, (int)(cfg.sampleRate * cfg.frameMs / 1000.0f));
+            hangFrames = std::max<int>(1, (int)(cfg.hangMs / cfg.frameMs));
+            tailFrames = std::min<int>(hangFrames, (int)(cfg.tailMs / cfg.frameMs));
+            preRollSize = (size_t)(cfg.sampleRate * cfg.preRollMs / 1000.0f);
+            minSpeechFrames = (int)(cfg.minSpeechMs / cfg.frameMs);
+            maxSegmentSize = (size_t)(cfg.sampleRate * cfg.maxSegmentMs / 1000.0f);
+            floorBlockFrames = std::max<int>(1, (int)(FLOOR_BLOCK_MS / cfg.frameMs));
+            frame.clear();
+            frame.reserve(frameSize);
+            preRoll.assign(std::max<size_t>(preRollSize, 1), 0.0f);
+            preRollPos = 0;
+            preRollFill = 0;
+        }
+
+        const Config& getConfig() { return cfg; }
+
+        // Feed audio into the segmenter. Completed segments are appended to out.
+        // Returns the number of segments that were completed.
+        int process(const float* data, size_t count, std::vector<VadSegment>& out) {
+            int completed = 0;
+            for (size_t i = 0; i < count;) {
+                size_t n = std::min<size_t>(count - i, frameSize - frame.size());
+                frame.insert(frame.end(), data + i, data + i + n);
+                i += n;
+                if (frame.size() == frameSize) {
+                    completed += processFrame(out);
+                    frame.clear();
+                }
+            }
+            return completed;
+        }
+
+        // Close any segment in progress, for example when VoxHunt is switched off
+        int flush(std::vector<VadSegment>& out) {
+            if (!active) { return 0; }
+            return closeSegment(out, 0) ? 1 : 0;
+        }
+
+        void reset() {
+            active = false;
+            current.samples.clear();
+            frame.clear();
+            preRollFill = 0;
+            preRollPos = 0;
+        }
+
+        bool isActive() { return active; }
+
+        // Audio of the segment in progress, including pre-roll
+        const std::vector<float>& getActiveAudio() { return current.samples; }
+        float getNoiseFloorDb() { return noiseFloorDb; }
+        float getLevelDb() { return levelDb; }
+
+    private:
+        int processFrame(std::vector<VadSegment>& out) {
+            float energy = 0.0f;
+            for (float s : frame) { energy += s * s; }
+            levelDb = 10.0f * log10f(energy / (float)frameSize + 1e-10f);
+            int completed = 0;
+
+            if (!active) {
+                if (levelDb > noiseFloorDb + cfg.openDb) {
+                    openSegment();
+                } else {
+                    // Track the noise floor only while nobody is talking: fall fast, rise slowly
+                    noiseFloorDb = (levelDb < noiseFloorDb) ? levelDb : (noiseFloorDb * 0.995f + levelDb * 0.005f);
+                    // Squelched audio is digital silence, don't let the floor follow it all the way down
+                    noiseFloorDb = std::max<float>(noiseFloorDb, MIN_NOISE_FLOOR_DB);
+                    pushPreRoll();
+                    streamPos += frameSize;
+                    return 0;
+                }
+            }
+
+            current.samples.insert(current.samples.end(), frame.begin(), frame.end());
+            current.peakDb = std::max<float>(current.peakDb, levelDb);
+            trackOpenFloor();
+            if (levelDb > noiseFloorDb + cfg.closeDb) {
+                quietFrames = 0;
+                speechFrames++;
+            } else {
+                quietFrames++;
+            }
+            streamPos += frameSize;
+
+            if (quietFrames >= hangFrames) {
+                if (closeSegment(out, quietFrames - tailFrames)) { completed++; }
+            } else if (current.samples.size() >= maxSegmentSize) {
+                // Split, but keep the transmission open so the rest of it becomes the next segment
+                if (closeSegment(out, 0)) { completed++; }
+                openSegment();
+            }
+            return completed;
+        }
+
+        // Quietest frame of the current and previous floor block. Speech has gaps well inside that window,
+        // steady noise doesn't, so only the latter lifts the floor.
+        void trackOpenFloor() {
+            blockMinDb = std::min<float>(blockMinDb, levelDb);
+            if (++blockFrames >= floorBlockFrames) {
+                lastBlockMinDb = blockMinDb;
+                blockMinDb = INFINITY;
+                blockFrames = 0;
+            }
+            if (lastBlockMinDb == INFINITY) { return; }
+            float quietest = std::min<float>(lastBlockMinDb, blockMinDb);
+            if (quietest > noiseFloorDb) { noiseFloorDb += (quietest - noiseFloorDb) * 0.01f; }
+        }
+
+        void openSegment() {
+            active = true;
+            quietFrames = 0;
+            speechFrames = 0;
+            blockMinDb = INFINITY;
+            lastBlockMinDb = INFINITY;
+            blockFrames = 0;
+            current.samples.clear();
+            current.samples.reserve(maxSegmentSize + frameSize);
+            current.peakDb = levelDb;
+            current.noiseFloorDb = noiseFloorDb;
+
+            // Unroll the pre-roll history, oldest first
+            size_t start = (preRollPos + preRoll.size() - preRollFill) % preRoll.size();
+            for (size_t i = 0; i < preRollFill; i++) {
+                current.samples.push_back(preRoll[(start + i) % preRoll.size()]);
+            }
+            current.startSample = streamPos - preRollFill;
+            preRollFill = 0;
+        }
+
+        bool closeSegment(std::vector<VadSegment>& out, int trimFrames) {
+            active = false;
+            size_t trim = std::min<size_t>((size_t)std::max<int>(trimFrames, 0) * frameSize, current.samples.size());
+            current.samples.resize(current.samples.size() - trim);
+            if (speechFrames < minSpeechFrames || current.samples.empty()) {
+                current.samples.clear();
+                return false;
+            }
+            out.push_back(std::move(current));
+            current = VadSegment();
+            return true;
+        }
+
+        void pushPreRoll() {
+            if (!preRollSize) { return; }
+            for (float s : frame) {
+                preRoll[preRollPos] = s;
+                preRollPos = (preRollPos + 1) % preRoll.size();
+            }
+            preRollFill = std::min<size_t>(preRollFill + frame.size(), preRollSize);
+        }
+
+        Config cfg;
+        size_t frameSize;
+        int hangFrames;
+        int tailFrames;
+        size_t preRollSize;
+        int minSpeechFrames;
+        size_t maxSegmentSize;
+        int floorBlockFrames;
+
+        std::vector<float> frame;
+        std::vector<float> preRoll;
+        size_t preRollPos = 0;
+        size_t preRollFill = 0;
+
+        bool active = false;
+        int quietFrames = 0;
+        int speechFrames = 0;
+        float noiseFloorDb = -60.0f;
+        float levelDb = -100.0f;
+        float blockMinDb = INFINITY;
+        float lastBlockMinDb = INFINITY;
+        int blockFrames = 0;
+        uint64_t streamPos = 0;
+        VadSegment current;
+    };
+}
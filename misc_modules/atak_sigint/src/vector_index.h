@@ -0,0 +1,519 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <queue>
+#include <random>
+#include <mutex>
+#include <shared_mutex>
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#include "telemetry.h"
+
+namespace sigint {
+    // Approximate nearest neighbour search over transcript embeddings, for finding transcripts by
+    // meaning rather than by their words.
+    // The index is an HNSW graph (hierarchical navigable small world) in a single memory-mapped file:
+    // fixed size nodes holding the transcript's time, frequency, channel and text, its links on every
+    // layer and its unit length vector. Opening maps the file and is ready at once, nothing is rebuilt.
+    // Vectors are normalized on the way in, so the score is the cosine similarity, a dot product
+    // computed with AVX2/FMA or SSE (picked at run time) or NEON.
+    // Inserts take the lock exclusively for a millisecond or so, searches share it.
+    class VectorIndex {
+    public:
+        struct Doc {
+            int64_t timeMs = 0;
+            double frequency = 0.0;
+            std::string channel;
+            std::string text;
+        };
+
+        struct Hit {
+            float score;            // Cosine similarity, 1 is the same direction
+            Doc doc;
+        };
+
+        struct Metrics {
+            telemetry::Counter added;
+            telemetry::Histogram addSeconds;
+            telemetry::Histogram searchSeconds;
+        };
+
+        ~VectorIndex() { close(); }
+
+        // Maps the index file if there is one, otherwise it's created with the first vector
+        bool open(const std::string& path) {
+            close();
+            std::unique_lock<std::shared_mutex> lck(mtx);
+            this->path = path;
+            fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+            if (fd < 0) { return errno == ENOENT; }
+            struct stat st;
+            if (fstat(fd, &st) || (size_t)st.st_size < sizeof(FileHeader) || !mapFile((size_t)st.st_size)) {
+                error = "Could not map " + path;
+                unmap();
+                return false;
+            }
+            FileHeader* hdr = header();
+            size_t expected = nodeBytesFor(hdr->dim);
+            if (memcmp(hdr->magic, MAGIC, sizeof(MAGIC)) || hdr->nodeBytes != expected || hdr->count > hdr->capacity ||
+                sizeof(FileHeader) + hdr->capacity * hdr->nodeBytes > mapBytes) {
+                error = path + " is not a vector index or is damaged";
+                unmap();
+                return false;
+            }
+            // An index created sparse by an older version gets its blocks now, search still works without them
+            writable = !posix_fallocate(fd, 0, st.st_size);
+            if (!writable) { error = "No room on disk for " + path + ", new transcripts aren't indexed"; }
+            return true;
+        }
+
+        void close() {
+            std::unique_lock<std::shared_mutex> lck(mtx);
+            unmap();
+        }
+
+        // Adds a document with its embedding. Fails if the file can't grow, or if the vector's dimension
+        // differs from the ones already in the index (the embedding model was changed).
+        bool add(const Doc& doc, std::vector<float> vector) {
+            telemetry::ScopedTimer timer(metrics.addSeconds);
+            if (vector.empty() || !normalize(vector)) { return false; }
+            std::unique_lock<std::shared_mutex> lck(mtx);
+            if (!map && !create((uint32_t)vector.size())) { return false; }
+            if (!writable) { return false; }
+            FileHeader* hdr = header();
+            if (vector.size() != hdr->dim) {
+                error = "Embeddings have " + std::to_string(vector.size()) + " dimensions, the index " + std::to_string(hdr->dim) +
+                        ". Delete " + path + " after changing the embedding model.";
+                return false;
+            }
+            if (hdr->count == hdr->capacity && !grow()) { return false; }
+            hdr = header();
+
+            uint32_t id = (uint32_t)hdr->count;
+            int level = randomLevel();
+            NodeHeader* node = nodeHeader(id);
+            memset(node, 0, hdr->nodeBytes);
+            node->timeMs = doc.timeMs;
+            node->frequency = doc.frequency;
+            node->channelLen = (uint8_t)utf8Prefix(doc.channel, CHANNEL_BYTES);
+            node->textLen = (uint16_t)utf8Prefix(doc.text, TEXT_BYTES);
+            node->level = (uint8_t)level;
+            memcpy(node->channel, doc.channel.data(), node->channelLen);
+            memcpy(node->text, doc.text.data(), node->textLen);
+            memcpy(vectorOf(id), vector.data(), vector.size() * sizeof(float));
+
+            if (hdr->count > 0) {
+                const float* q = vectorOf(id);
+                uint32_t ep = hdr->entryPoint;
+                for (int l = hdr->maxLevel; l > level; l--) { ep = greedy(q, ep, l, id); }
+                for (int l = std::min<int>(level, hdr->maxLevel); l >= 0; l--) {
+                    std::vector<Candidate> found = searchLayer(q, ep, EF_CONSTRUCTION, l, id);
+                    std::vector<Candidate> chosen = selectNeighbors(found, M);
+                    uint32_t* links = linksOf(id, l);
+                    for (const auto& c : chosen) { links[++links[0]] = c.id; }
+                    for (const auto& c : chosen) { connect(c.id, id, l); }
+                    ep = found.front().id;
+                }
+            }
+            if (hdr->count == 0 || level > (int)hdr->maxLevel) {
+                hdr->entryPoint = id;
+                hdr->maxLevel = level;
+            }
+            // Published last: links to the node from before a crash point past the count and are ignored
+            hdr->count++;
+            metrics.added.add();
+            return true;
+        }
+
+        // The k documents closest to the query, best first, optionally only those before a time
+        std::vector<Hit> search(std::vector<float> query, size_t k, int64_t beforeMs = INT64_MAX) {
+            telemetry::ScopedTimer timer(metrics.searchSeconds);
+            std::vector<Hit> hits;
+            if (!k || !normalize(query)) { return hits; }
+            std::shared_lock<std::shared_mutex> lck(mtx);
+            if (!map || !header()->count || query.size() != header()->dim) { return hits; }
+
+            const FileHeader* hdr = header();
+            uint32_t ep = hdr->entryPoint;
+            for (int l = hdr->maxLevel; l > 0; l--) { ep = greedy(query.data(), ep, l, UINT32_MAX); }
+            // Filtered searches look further so enough candidates are left over
+            size_t ef = std::max<size_t>(EF_SEARCH, (beforeMs == INT64_MAX) ? k : k * 4);
+            std::vector<Candidate> found = searchLayer(query.data(), ep, ef, 0, UINT32_MAX);
+            for (const auto& c : found) {
+                const NodeHeader* node = nodeHeader(c.id);
+                if (node->timeMs >= beforeMs) { continue; }
+                Hit hit;
+                hit.score = 1.0f - c.distance;
+                hit.doc.timeMs = node->timeMs;
+                hit.doc.frequency = node->frequency;
+                hit.doc.channel.assign(node->channel, node->channelLen);
+                hit.doc.text.assign(node->text, node->textLen);
+                hits.push_back(std::move(hit));
+                if (hits.size() >= k) { break; }
+            }
+            return hits;
+        }
+
+        size_t size() {
+            std::shared_lock<std::shared_mutex> lck(mtx);
+            return map ? header()->count : 0;
+        }
+
+        std::string getError() {
+            std::shared_lock<std::shared_mutex> lck(mtx);
+            return error;
+        }
+
+        // Dot product of two vectors, with the best kernel this CPU has
+        static float dot(const float* a, const float* b, size_t n) {
+            static const DotKernel kernel = pickKernel();
+            return kernel(a, b, n);
+        }
+
+        Metrics metrics;
+
+    private:
+        static constexpr uint32_t M = 16;               // Links per node on the upper layers
+        static constexpr uint32_t M0 = 2 * M;           // and on the bottom layer
+        static constexpr int MAX_LEVEL = 8;
+        static constexpr size_t EF_CONSTRUCTION = 100;
+        static constexpr size_t EF_SEARCH = 64;
+        static constexpr size_t CHANNEL_BYTES = 32;
+        static constexpr size_t TEXT_BYTES = 472;       // Longer transcripts are cut, the full text is in the transcript store
+        static constexpr size_t INITIAL_CAPACITY = 1024;
+        static constexpr char MAGIC[8] = { 'S', 'I', 'G', 'H', 'N', 'S', 'W', '1' };
+
+        struct FileHeader {
+            char magic[8];
+            uint32_t dim;
+            uint32_t nodeBytes;
+            uint64_t count;
+            uint64_t capacity;
+            uint32_t entryPoint;
+            uint32_t maxLevel;
+            uint8_t reserved[24];
+        };
+
+        // Followed by the links of layer 0 (count, then M0 ids), of layers 1 to MAX_LEVEL (count, then
+        // M ids each) and the vector
+        struct NodeHeader {
+            int64_t timeMs;
+            double frequency;
+            uint16_t textLen;
+            uint8_t channelLen;
+            uint8_t level;
+            uint32_t reserved;
+            char channel[CHANNEL_BYTES];
+            char text[TEXT_BYTES];
+        };
+
+        static constexpr size_t LINK_WORDS = (1 + M0) + MAX_LEVEL * (1 + M);
+
+        struct Candidate {
+            float distance;
+            uint32_t id;
+            bool operator<(const Candidate& other) const { return distance < other.distance; }
+            bool operator>(const Candidate& other) const { return distance > other.distance; }
+        };
+
+        typedef float (*DotKernel)(const float* a, const float* b, size_t n);
+
+        static size_t nodeBytesFor(uint32_t dim) {
+            return (sizeof(NodeHeader) + LINK_WORDS * sizeof(uint32_t) + dim * sizeof(float) + 31) & ~(size_t)31;
+        }
+
+        FileHeader* header() const { return (FileHeader*)map; }
+
+        NodeHeader* nodeHeader(uint32_t id) const {
+            return (NodeHeader*)(map + sizeof(FileHeader) + (size_t)id * header()->nodeBytes);
+        }
+
+        uint32_t* linksOf(uint32_t id, int level) const {
+            uint32_t* links = (uint32_t*)(nodeHeader(id) + 1);
+            return level ? links + (1 + M0) + (level - 1) * (1 + M) : links;
+        }
+
+        float* vectorOf(uint32_t id) const {
+            return (float*)(linksOf(id, 0) + LINK_WORDS);
+        }
+
+        float distance(const float* q, uint32_t id) const {
+            return 1.0f - dot(q, vectorOf(id), header()->dim);
+        }
+
+        // Files are allocated on disk, not just sized: a write through the map to a page the file system
+        // can't back (disk full) raises SIGBUS
+        bool create(uint32_t dim) {
+            fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            size_t bytes = sizeof(FileHeader) + INITIAL_CAPACITY * nodeBytesFor(dim);
+            if (fd < 0 || allocate(bytes) || !mapFile(bytes)) {
+                error = "Could not create " + path + ": " + strerror(errno);
+                unmap();
+                return false;
+            }
+            writable = true;
+            FileHeader* hdr = header();
+            memcpy(hdr->magic, MAGIC, sizeof(MAGIC));
+            hdr->dim = dim;
+            hdr->nodeBytes = (uint32_t)nodeBytesFor(dim);
+            hdr->capacity = INITIAL_CAPACITY;
+            return true;
+        }
+
+        // Doubles the capacity, the file is mapped again
+        bool grow() {
+            uint64_t capacity = header()->capacity * 2;
+            size_t bytes = sizeof(FileHeader) + capacity * header()->nodeBytes;
+            size_t oldBytes = mapBytes;
+            munmap(map, mapBytes);
+            map = NULL;
+            if (allocate(bytes) || !mapFile(bytes)) {
+                error = "Could not grow " + path + ": " + strerror(errno);
+                // Back to the size that's fully allocated
+                if (ftruncate(fd, (off_t)oldBytes) || !mapFile(oldBytes)) { unmap(); }
+                return false;
+            }
+            header()->capacity = capacity;
+            return true;
+        }
+
+        // Returns 0 or the error, also left in errno
+        int allocate(size_t bytes) {
+            int ret = posix_fallocate(fd, 0, (off_t)bytes);
+            if (ret) { errno = ret; }
+            return ret;
+        }
+
+        bool mapFile(size_t bytes) {
+            void* m = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (m == MAP_FAILED) { return false; }
+            map = (uint8_t*)m;
+            mapBytes = bytes;
+            return true;
+        }
+
+        void unmap() {
+            if (map) {
+                msync(map, mapBytes, MS_SYNC);
+                munmap(map, mapBytes);
+                map = NULL;
+            }
+            writable = false;
+            if (fd >= 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+
+        int randomLevel() {
+            // Geometric with p = 1/M, as in the HNSW paper
+            double r = std::uniform_real_distribution<double>(std::nextafter(0.0, 1.0), 1.0)(rng);
+            return std::min<int>(MAX_LEVEL, (int)(-std::log(r) / std::log((double)M)));
+        }
+
+        // Closest node to q on a layer, walking greedily from ep. skip is a node being inserted.
+        uint32_t greedy(const float* q, uint32_t ep, int level, uint32_t skip) const {
+            uint32_t count = (uint32_t)header()->count;
+            float best = distance(q, ep);
+            bool moved = true;
+            while (moved) {
+                moved = false;
+                const uint32_t* links = linksOf(ep, level);
+                for (uint32_t i = 1; i <= links[0]; i++) {
+                    uint32_t n = links[i];
+                    if (n >= count || n == skip) { continue; }
+                    float d = distance(q, n);
+                    if (d < best) {
+                        best = d;
+                        ep = n;
+                        moved = true;
+                    }
+                }
+            }
+            return ep;
+        }
+
+        // The ef nearest nodes found on a layer starting from ep, nearest first
+        std::vector<Candidate> searchLayer(const float* q, uint32_t ep, size_t ef, int level, uint32_t skip) const {
+            // Visited marks are per thread, a generation number saves clearing them
+            thread_local std::vector<uint32_t> visited;
+            thread_local uint32_t generation = 0;
+            uint32_t count = (uint32_t)header()->count;
+            if (visited.size() < count) { visited.resize(count + count / 2, 0); }
+            if (++generation == 0) {
+                std::fill(visited.begin(), visited.end(), 0);
+                generation = 1;
+            }
+
+            std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> frontier;
+            std::priority_queue<Candidate> nearest;
+            Candidate start{ distance(q, ep), ep };
+            frontier.push(start);
+            nearest.push(start);
+            visited[ep] = generation;
+            while (!frontier.empty()) {
+                Candidate c = frontier.top();
+                if (c.distance > nearest.top().distance && nearest.size() >= ef) { break; }
+                frontier.pop();
+                const uint32_t* links = linksOf(c.id, level);
+                for (uint32_t i = 1; i <= links[0]; i++) {
+                    uint32_t n = links[i];
+                    if (n >= count || n == skip || visited[n] == generation) { continue; }
+                    visited[n] = generation;
+                    float d = distance(q, n);
+                    if (nearest.size() < ef || d < nearest.top().distance) {
+                        frontier.push(Candidate{ d, n });
+                        nearest.push(Candidate{ d, n });
+                        if (nearest.size() > ef) { nearest.pop(); }
+                    }
+                }
+            }
+
+            std::vector<Candidate> result(nearest.size());
+            for (size_t i = result.size(); i > 0; i--) {
+                result[i - 1] = nearest.top();
+                nearest.pop();
+            }
+            return result;
+        }
+
+        // Neighbours that aren't closer to an already chosen neighbour than to the node, so links spread
+        // out in all directions (the paper's heuristic). candidates are nearest first.
+        std::vector<Candidate> selectNeighbors(const std::vector<Candidate>& candidates, size_t max) const {
+            std::vector<Candidate> chosen;
+            for (const auto& c : candidates) {
+                if (chosen.size() >= max) { break; }
+                bool diverse = true;
+                for (const auto& s : chosen) {
+                    if (1.0f - dot(vectorOf(c.id), vectorOf(s.id), header()->dim) < c.distance) {
+                        diverse = false;
+                        break;
+                    }
+                }
+                if (diverse) { chosen.push_back(c); }
+            }
+            return chosen;
+        }
+
+        // Link node to target on a layer, pruning node's links if they overflow
+        void connect(uint32_t node, uint32_t target, int level) {
+            uint32_t* links = linksOf(node, level);
+            uint32_t max = level ? M : M0;
+            if (links[0] < max) {
+                links[++links[0]] = target;
+                return;
+            }
+            const float* v = vectorOf(node);
+            std::vector<Candidate> candidates;
+            candidates.push_back(Candidate{ distance(v, target), target });
+            for (uint32_t i = 1; i <= links[0]; i++) { candidates.push_back(Candidate{ distance(v, links[i]), links[i] }); }
+            std::sort(candidates.begin(), candidates.end());
+            std::vector<Candidate> chosen = selectNeighbors(candidates, max);
+            links[0] = (uint32_t)chosen.size();
+            for (size_t i = 0; i < chosen.size(); i++) { links[i + 1] = chosen[i].id; }
+        }
+
+        // Length of the longest prefix within max bytes that doesn't cut a UTF-8 character in half
+        static size_t utf8Prefix(const std::string& s, size_t max) {
+            if (s.size() <= max) { return s.size(); }
+            size_t len = max;
+            while (len > 0 && ((uint8_t)s[len] & 0xC0) == 0x80) { len--; }
+            return len;
+        }
+
+        static bool normalize(std::vector<float>& v) {
+            float norm = std::sqrt(dot(v.data(), v.data(), v.size()));
+            if (!(norm > 0.0f) || !std::isfinite(norm)) { return false; }
+            for (float& x : v) { x /= norm; }
+            return true;
+        }
+
+        static float dotScalar(const float* a, const float* b, size_t n) {
+            float sum = 0.0f;
+            for (size_t i = 0; i < n; i++) { sum += a[i] * b[i]; }
+            return sum;
+        }
+
+#if defined(__x86_64__) || defined(__i386__)
+        __attribute__((target("avx2,fma")))
+        static float dotAvx2(const float* a, const float* b, size_t n) {
+            __m256 acc0 = _mm256_setzero_ps();
+            __m256 acc1 = _mm256_setzero_ps();
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+                acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+            }
+            __m256 acc = _mm256_add_ps(acc0, acc1);
+            __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+            sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+            sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+            float result = _mm_cvtss_f32(sum);
+            for (; i < n; i++) { result += a[i] * b[i]; }
+            return result;
+        }
+
+        static float dotSse(const float* a, const float* b, size_t n) {
+            __m128 acc0 = _mm_setzero_ps();
+            __m128 acc1 = _mm_setzero_ps();
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+                acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+            }
+            __m128 sum = _mm_add_ps(acc0, acc1);
+            sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+            sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+            float result = _mm_cvtss_f32(sum);
+            for (; i < n; i++) { result += a[i] * b[i]; }
+            return result;
+        }
+
+        static DotKernel pickKernel() {
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) { return dotAvx2; }
+            return dotSse;
+        }
+#elif defined(__ARM_NEON)
+        static float dotNeon(const float* a, const float* b, size_t n) {
+            float32x4_t acc0 = vdupq_n_f32(0.0f);
+            float32x4_t acc1 = vdupq_n_f32(0.0f);
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+                acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+            }
+            float32x4_t acc = vaddq_f32(acc0, acc1);
+            float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+            float result = vget_lane_f32(vpadd_f32(pair, pair), 0);
+            for (; i < n; i++) { result += a[i] * b[i]; }
+            return result;
+        }
+
+        static DotKernel pickKernel() { return dotNeon; }
+#else
+        static DotKernel pickKernel() { return dotScalar; }
+#endif
+
+        std::shared_mutex mtx;
+        std::string path;
+        std::string error;
+        int fd = -1;
+        uint8_t* map = NULL;
+        size_t mapBytes = 0;
+        bool writable = false;      // The file's blocks are allocated
+        std::mt19937 rng{ 0x5167 };
+    };
+}
@@ -0,0 +1,31 @@
+// Noise filtering of transcripts before analysis and embedding
+#include "analysis_stage.h"
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+int main() {
+    using sigint::transcriptNoise;
+
+    // Real traffic passes
+    CHECK(transcriptNoise("zero zero zero zero") == sigint::NOISE_NONE);
+    CHECK(transcriptNoise("Niner niner niner niner.") == sigint::NOISE_NONE);
+    CHECK(transcriptNoise("Grid 4 4 4 4 4 4 7") == sigint::NOISE_NONE);
+    CHECK(transcriptNoise("Thanks.") == sigint::NOISE_NONE);
+    CHECK(transcriptNoise("Bye.") == sigint::NOISE_NONE);
+    CHECK(transcriptNoise("Thank you.") == sigint::NOISE_NONE);
+    CHECK(transcriptNoise("Mayday mayday mayday, this is Viper 6.") == sigint::NOISE_NONE);
+    CHECK(transcriptNoise("Okay, okay, okay, copy that.") == sigint::NOISE_NONE);
+
+    // Noise doesn't
+    CHECK(transcriptNoise("") == sigint::NOISE_EMPTY);
+    CHECK(transcriptNoise("[BLANK_AUDIO]") == sigint::NOISE_NON_SPEECH);
+    CHECK(transcriptNoise("Thanks for watching!") == sigint::NOISE_HALLUCINATION);
+    CHECK(transcriptNoise("the the the the the the") == sigint::NOISE_REPETITION);
+    CHECK(transcriptNoise("I'm going to go, I'm going to go, I'm going to go, I'm going to go, I'm going to go, I'm going to go") == sigint::NOISE_REPETITION);
+
+    if (failures) { printf("%d check(s) failed\n", failures); }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,28 @@
+// Watchlist parsing and matching of KeywordSpotter
+#include "keyword_spotter.h"
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+int main() {
+    sigint::KeywordSpotter spotter;
+
+    // A bare "!" or one followed only by a comment has no term and is skipped
+    spotter.setText("!\n!  # note\n! \t\nmayday\n! Viper Six\n");
+    CHECK(spotter.getTermCount() == 2);
+
+    auto matches = spotter.match("Mayday mayday, this is Viper 6.");
+    CHECK(matches.size() == 2);
+    for (const auto& m : matches) {
+        CHECK(m.boost == (m.term == "Viper Six"));
+    }
+
+    spotter.setText("!");
+    CHECK(spotter.getTermCount() == 0);
+    CHECK(spotter.match("anything at all").empty());
+
+    if (failures) { printf("%d check(s) failed\n", failures); }
+    return failures ? 1 : 0;
+}
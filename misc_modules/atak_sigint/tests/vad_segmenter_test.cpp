@@ -0,0 +1,82 @@
+// Segmentation of VadSegmenter on synthetic audio
+#include "vad_segmenter.h"
+#include <stdio.h>
+#include <random>
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+static const int RATE = 16000;
+
+// Gaussian noise
+static std::vector<float> noise(std::mt19937& rng, float seconds, float rms) {
+    std::normal_distribution<float> dist(0.0f, rms);
+    std::vector<float> out((size_t)(seconds * RATE));
+    for (auto& s : out) { s = dist(rng); }
+    return out;
+}
+
+// A syllabic tone burst where speech would be
+static void addSpeech(std::vector<float>& audio, float start, float seconds, float amplitude = 0.3f) {
+    for (size_t i = (size_t)(start * RATE); i < (size_t)((start + seconds) * RATE) && i < audio.size(); i++) {
+        float t = (float)i / RATE;
+        // 4 Hz syllables with short gaps between them
+        float envelope = std::max<float>(0.0f, sinf(2.0f * (float)M_PI * 4.0f * t));
+        audio[i] += amplitude * envelope * sinf(2.0f * (float)M_PI * 440.0f * t);
+    }
+}
+
+static std::vector<sigint::VadSegment> run(sigint::VadSegmenter& vad, const std::vector<float>& audio) {
+    std::vector<sigint::VadSegment> out;
+    for (size_t i = 0; i < audio.size(); i += 1000) {
+        vad.process(audio.data() + i, std::min<size_t>(1000, audio.size() - i), out);
+    }
+    return out;
+}
+
+int main() {
+    std::mt19937 rng(1);
+
+    // A transmission on a quiet channel is one segment
+    {
+        sigint::VadSegmenter vad;
+        auto audio = noise(rng, 10.0f, 0.001f);
+        addSpeech(audio, 3.0f, 2.0f);
+        auto segs = run(vad, audio);
+        CHECK(segs.size() == 1);
+        CHECK(!vad.isActive());
+    }
+
+    // A long transmission is split to fit Whisper's window, the floor doesn't swallow it
+    {
+        sigint::VadSegmenter vad;
+        auto audio = noise(rng, 70.0f, 0.001f);
+        addSpeech(audio, 2.0f, 60.0f);
+        auto segs = run(vad, audio);
+        CHECK(segs.size() == 3);
+        CHECK(!vad.isActive());
+    }
+
+    // Continuous white noise from an open squelch closes its segment and stays closed
+    {
+        sigint::VadSegmenter vad;
+        auto audio = noise(rng, 2.0f, 0.001f);
+        auto hiss = noise(rng, 120.0f, 0.1f);
+        audio.insert(audio.end(), hiss.begin(), hiss.end());
+        auto segs = run(vad, audio);
+        CHECK(segs.size() <= 1);
+        for (const auto& s : segs) { CHECK(s.samples.size() < (size_t)(15 * RATE)); }
+        CHECK(!vad.isActive());
+        CHECK(vad.getNoiseFloorDb() > -30.0f);
+
+        // Speech over the hiss still opens a segment
+        auto more = noise(rng, 10.0f, 0.1f);
+        addSpeech(more, 3.0f, 2.0f, 0.9f);
+        auto speech = run(vad, more);
+        CHECK(speech.size() == 1);
+    }
+
+    if (failures) { printf("%d check(s) failed\n", failures); }
+    return failures ? 1 : 0;
+}
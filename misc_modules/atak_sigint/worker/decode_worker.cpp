@@ -0,0 +1,342 @@
+// Whisper decode worker for the SIGINT module.
+// Loads a model into a decoder pool and serves decode jobs from one or more modules over TCP (see
+// decode_protocol.h), so transcription can run in other processes and on other machines. Jobs are
+// decoded with the same adaptive scheduling as in the module, heartbeats are answered from the network
+// thread while every decoder is busy. Run one per machine (or several with fewer states each), and list
+// them in the module's decodeWorkers setting.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "decoder_pool.h"
+#include "decode_scheduler.h"
+#include "decode_protocol.h"
+
+// Same values as the module
+#define WHISPER_SAMPLE_RATE 16000
+#define WHISPER_MIN_SAMPLES (WHISPER_SAMPLE_RATE + WHISPER_SAMPLE_RATE / 10)
+
+// Modules served at once
+#define MAX_CONNECTIONS 16
+
+struct Options {
+    std::string model = "ggml-tiny.en.bin";
+    std::string listen = "127.0.0.1";   // Address to accept modules on, 0.0.0.0 for every interface
+    int port = sigint::remote::DEFAULT_PORT;
+    int states = 2;
+    int threads = 0;                    // Per state, 0 = split the cores
+    std::string name;                   // Reported to modules, defaults to host:port
+};
+
+// A module connected to the worker. Decoder threads queue results through it, the network thread sends them.
+struct Connection {
+    int sock;
+    std::string peer;
+    sigint::remote::FrameBuffer in;     // Network thread only
+    std::string out;                    // Guarded by outMtx
+    std::atomic<bool> open = true;
+    std::atomic<int> jobs = 0;          // Queued and running
+};
+
+static std::atomic<bool> stopRequested = false;
+static std::mutex outMtx;
+static int wakePipe[2] = { -1, -1 };
+static std::atomic<int> busyJobs = 0;
+
+static void usage() {
+    fprintf(stderr,
+        "Usage: atak_sigint_worker [options]\n"
+        "  Decodes transmissions for the SIGINT module, which connects to it (decodeWorkers).\n"
+        "  --model <path>          Whisper model (default ggml-tiny.en.bin)\n"
+        "  --listen <address>      Address to listen on (default 127.0.0.1, 0.0.0.0 for every interface)\n"
+        "  --port <port>           TCP port (default 7355)\n"
+        "  --states <n>            Decodes run at once, each with its own decoder state (default 2)\n"
+        "  --threads <n>           Threads per decoder state (default: cores / states)\n"
+        "  --name <name>           Name reported to the module (default host:port)\n");
+}
+
+static bool parseArgs(int argc, char** argv, Options& opts) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Missing value for %s\n", arg.c_str());
+                exit(1);
+            }
+            return argv[++i];
+        };
+        if (arg == "--model") { opts.model = next(); }
+        else if (arg == "--listen") { opts.listen = next(); }
+        else if (arg == "--port") { opts.port = atoi(next()); }
+        else if (arg == "--states") { opts.states = std::max<int>(1, atoi(next())); }
+        else if (arg == "--threads") { opts.threads = atoi(next()); }
+        else if (arg == "--name") { opts.name = next(); }
+        else if (arg == "-h" || arg == "--help") { return false; }
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return false;
+        }
+    }
+    if (opts.port <= 0 || opts.port >= 65536) {
+        fprintf(stderr, "Invalid port %d\n", opts.port);
+        return false;
+    }
+    return true;
+}
+
+static void onSignal(int) {
+    stopRequested = true;
+}
+
+// Requires outMtx. A full pipe is as good as a write.
+static void wake() {
+    ssize_t ret = write(wakePipe[1], "", 1);
+    (void)ret;
+}
+
+static void reply(const std::shared_ptr<Connection>& conn, const sigint::remote::Result& result) {
+    busyJobs--;
+    conn->jobs--;
+    std::lock_guard<std::mutex> lck(outMtx);
+    if (!conn->open) { return; }
+    sigint::remote::frame(conn->out, sigint::remote::FRAME_RESULT, sigint::remote::encodeResult(result));
+    wake();
+}
+
+static int listenOn(const Options& opts) {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* res = NULL;
+    if (getaddrinfo(opts.listen.c_str(), std::to_string(opts.port).c_str(), &hints, &res) || !res) {
+        fprintf(stderr, "Could not resolve %s\n", opts.listen.c_str());
+        return -1;
+    }
+    int sock = socket(res->ai_family, res->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, res->ai_protocol);
+    int one = 1;
+    if (sock >= 0) { setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)); }
+    if (sock < 0 || bind(sock, res->ai_addr, res->ai_addrlen) || listen(sock, 8)) {
+        fprintf(stderr, "Could not listen on %s:%d: %s\n", opts.listen.c_str(), opts.port, strerror(errno));
+        if (sock >= 0) { close(sock); }
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    return sock;
+}
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parseArgs(argc, argv, opts)) {
+        usage();
+        return 1;
+    }
+    if (opts.name.empty()) {
+        char host[256] = "localhost";
+        gethostname(host, sizeof(host) - 1);
+        opts.name = std::string(host) + ":" + std::to_string(opts.port);
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    int listenSock = listenOn(opts);
+    if (listenSock < 0 || pipe2(wakePipe, O_NONBLOCK | O_CLOEXEC)) { return 1; }
+
+    sigint::DecoderPool decoderPool;
+    if (!decoderPool.load(opts.model, opts.states, opts.threads)) {
+        fprintf(stderr, "Failed to load Whisper model %s\n", opts.model.c_str());
+        return 1;
+    }
+    sigint::DecodeScheduler scheduler;
+    sigint::DecodeScheduler::Config scfg;
+    if (opts.threads > 0) { scfg.maxThreads = opts.threads * decoderPool.getStateCount(); }
+    scheduler.configure(scfg, decoderPool.getStateCount());
+
+    sigint::remote::Hello hello;
+    hello.slots = decoderPool.getStateCount();
+    hello.name = opts.name;
+    hello.model = opts.model.substr(opts.model.find_last_of('/') + 1);
+    std::string helloFrame;
+    sigint::remote::frame(helloFrame, sigint::remote::FRAME_HELLO, sigint::remote::encodeHello(hello));
+    fprintf(stderr, "Serving %s on %s:%d with %d decoder states\n", hello.model.c_str(), opts.listen.c_str(), opts.port, hello.slots);
+
+    // Every job gets a channel of its own, so the pool runs them in parallel
+    int nextChannel = 0;
+    std::list<std::shared_ptr<Connection>> connections;
+
+    auto submit = [&](const std::shared_ptr<Connection>& conn, std::shared_ptr<sigint::remote::Job> job) {
+        busyJobs++;
+        conn->jobs++;
+        sigint::DecoderPool::JobInfo info;
+        info.channel = nextChannel++;
+        info.priority = job->priority;
+        info.samples = job->samples;
+        decoderPool.submit(info, [&, conn, job](whisper_context* ctx, whisper_state* state, int, sigint::DecoderPool::Cancel& cancel) {
+            sigint::remote::Result result;
+            result.id = job->id;
+            // Nobody is waiting for it anymore
+            if (!conn->open) {
+                reply(conn, result);
+                return;
+            }
+            std::vector<float> samples;
+            if (!sigint::remote::decodeAudio(*job, samples)) {
+                result.text = "corrupt audio";
+                reply(conn, result);
+                return;
+            }
+
+            // Sampling picked by the module for this job, or by the scheduler from this worker's backlog
+            auto decodeStart = std::chrono::steady_clock::now();
+            sigint::DecodeScheduler::Plan plan = scheduler.begin(samples.size(), (double)decoderPool.pendingSamples() / WHISPER_SAMPLE_RATE);
+            int beamSize = (job->beamSize >= 0) ? job->beamSize : plan.beamSize;
+            whisper_full_params params = whisper_full_default_params(beamSize ? WHISPER_SAMPLING_BEAM_SEARCH : WHISPER_SAMPLING_GREEDY);
+            params.print_progress = false;
+            params.print_special = false;
+            params.print_timestamps = false;
+            params.print_realtime = false;
+            params.translate = false;
+            params.language = "en";
+            params.n_threads = plan.nThreads;
+            if (beamSize) { params.beam_search.beam_size = beamSize; }
+            params.audio_ctx = plan.audioCtx;
+            cancel.attach(params);
+
+            if (samples.size() < WHISPER_MIN_SAMPLES) { samples.resize(WHISPER_MIN_SAMPLES, 0.0f); }
+            int ret = whisper_full_with_state(ctx, state, params, samples.data(), samples.size());
+            double decodeSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - decodeStart).count();
+            // Only shutdown interrupts decodes here
+            if (cancel.interrupted()) {
+                scheduler.end(0.0, 0.0, false);
+                return;
+            }
+            if (ret != 0) {
+                scheduler.end(0.0, 0.0, false);
+                result.text = "whisper_full failed";
+                reply(conn, result);
+                return;
+            }
+            scheduler.end(decodeSec, (double)job->samples / WHISPER_SAMPLE_RATE, true);
+            int n = whisper_full_n_segments_from_state(state);
+            for (int i = 0; i < n; i++) { result.text += whisper_full_get_segment_text_from_state(state, i); }
+            result.success = true;
+            result.decodeSec = (float)decodeSec;
+            reply(conn, result);
+        });
+    };
+
+    // Returns false once the connection should be closed
+    auto handleFrame = [&](const std::shared_ptr<Connection>& conn, uint32_t type, const std::string& payload) {
+        if (type == sigint::remote::FRAME_PING) {
+            sigint::remote::Pong pong;
+            if (!sigint::remote::decodePing(payload, pong.seq)) { return false; }
+            pong.busy = busyJobs;
+            pong.mine = conn->jobs;
+            std::lock_guard<std::mutex> lck(outMtx);
+            sigint::remote::frame(conn->out, sigint::remote::FRAME_PONG, sigint::remote::encodePong(pong));
+            return true;
+        }
+        if (type != sigint::remote::FRAME_JOB) { return false; }
+        auto job = std::make_shared<sigint::remote::Job>();
+        if (!sigint::remote::decodeJob(payload, *job)) { return false; }
+        submit(conn, job);
+        return true;
+    };
+
+    std::vector<pollfd> pfds;
+    while (!stopRequested) {
+        pfds.clear();
+        pfds.push_back(pollfd{ wakePipe[0], POLLIN, 0 });
+        pfds.push_back(pollfd{ listenSock, POLLIN, 0 });
+        {
+            std::lock_guard<std::mutex> lck(outMtx);
+            for (auto& conn : connections) {
+                pfds.push_back(pollfd{ conn->sock, (short)(POLLIN | (conn->out.empty() ? 0 : POLLOUT)), 0 });
+            }
+        }
+        if (poll(pfds.data(), pfds.size(), 1000) <= 0) { continue; }
+
+        if (pfds[0].revents & POLLIN) {
+            char buf[64];
+            while (read(wakePipe[0], buf, sizeof(buf)) > 0) {}
+        }
+        if (pfds[1].revents & POLLIN) {
+            sockaddr_storage addr;
+            socklen_t addrLen = sizeof(addr);
+            int sock = accept4(listenSock, (sockaddr*)&addr, &addrLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            char host[NI_MAXHOST] = "?", port[NI_MAXSERV] = "?";
+            if (sock >= 0) { getnameinfo((sockaddr*)&addr, addrLen, host, sizeof(host), port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV); }
+            if (sock >= 0 && connections.size() >= MAX_CONNECTIONS) {
+                fprintf(stderr, "Refused %s:%s, %d modules connected already\n", host, port, MAX_CONNECTIONS);
+                close(sock);
+            } else if (sock >= 0) {
+                int one = 1;
+                setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                auto conn = std::make_shared<Connection>();
+                conn->sock = sock;
+                conn->peer = std::string(host) + ":" + port;
+                conn->out = helloFrame;
+                fprintf(stderr, "Module %s connected\n", conn->peer.c_str());
+                // Not in this round's poll set, the hello goes out on the next one
+                std::lock_guard<std::mutex> lck(outMtx);
+                connections.push_back(conn);
+            }
+        }
+
+        // Connections are only added and removed on this thread, the list still matches pfds
+        size_t i = 2;
+        for (auto it = connections.begin(); it != connections.end() && i < pfds.size(); i++) {
+            auto& conn = *it;
+            bool alive = true;
+            if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                alive = conn->in.receive(conn->sock);
+                uint32_t type;
+                std::string payload;
+                bool bad = false;
+                while (alive && conn->in.next(type, payload, bad)) { alive = handleFrame(conn, type, payload); }
+                if (bad) { alive = false; }
+            }
+            if (alive) {
+                std::lock_guard<std::mutex> lck(outMtx);
+                alive = sigint::remote::flush(conn->sock, conn->out);
+            }
+            if (alive) {
+                it++;
+                continue;
+            }
+            // Its queued jobs are skipped when their turn comes
+            fprintf(stderr, "Module %s disconnected, %d jobs abandoned\n", conn->peer.c_str(), (int)conn->jobs);
+            std::lock_guard<std::mutex> lck(outMtx);
+            conn->open = false;
+            close(conn->sock);
+            it = connections.erase(it);
+        }
+    }
+
+    fprintf(stderr, "Shutting down\n");
+    close(listenSock);
+    decoderPool.unload();
+    for (auto& conn : connections) { close(conn->sock); }
+    return 0;
+}